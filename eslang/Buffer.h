@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <boost/asio/buffer.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <cassert>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace s {
+
+class Buffer {
+public:
+  unsigned char* data() const { return buffer_->data() + offset_; }
+  size_t size() const { return length_; }
+  boost::asio::const_buffer range() const {
+    return boost::asio::const_buffer{data(), size()};
+  }
+  static Buffer makeCopy(void const* data, size_t len) {
+    BuffIP b(new Buff(data, len));
+    return Buffer(b);
+  }
+  static Buffer makeCopy(std::string const& s) {
+    return makeCopy(s.data(), s.size());
+  }
+  static Buffer make(std::vector<unsigned char> data) {
+    BuffIP b(new Buff(std::move(data)));
+    return Buffer(b);
+  }
+  void consume(size_t n) {
+    assert(length_ >= n);
+    length_ -= n;
+    offset_ += n;
+  }
+  // a buffer of [offset, offset + len) sharing our underlying storage
+  Buffer slice(size_t offset, size_t len) const {
+    assert(offset + len <= length_);
+    Buffer ret(*this);
+    ret.offset_ += offset;
+    ret.length_ = len;
+    return ret;
+  }
+  // is [p, p + len) inside our (unconsumed) range
+  bool contains(void const* p, size_t len) const {
+    auto const* c = static_cast<unsigned char const*>(p);
+    return c >= data() && c + len <= data() + size();
+  }
+  bool sameStorage(Buffer const& b) const { return buffer_ == b.buffer_; }
+  void append(Buffer const& b) {
+    buffer_->append(b.data(), b.size());
+    length_ += b.size();
+  }
+  Buffer() = delete;
+
+private:
+  class Buff {
+  public:
+    unsigned char const* data() const { return data_.data(); }
+    unsigned char* data() { return data_.data(); }
+    size_t size() const { return data_.size(); }
+    size_t capacity() const { return data_.capacity(); }
+    void append(void* data, size_t len) {}
+    void reserve(size_t n) { data_.reserve(n); }
+    friend void intrusive_ptr_add_ref(Buff* p) { ++p->refs_; }
+    friend void intrusive_ptr_release(Buff* p) {
+      if (--p->refs_ == 0)
+        delete p;
+    }
+    Buff(void const* data, size_t len)
+        : data_(static_cast<unsigned char const*>(data),
+                static_cast<unsigned char const*>(data) + len) {}
+    Buff(std::vector<unsigned char> data) : data_(std::move(data)) {}
+
+  private:
+    std::vector<unsigned char> data_;
+    uint32_t refs_ = 0;
+  };
+  using BuffIP = boost::intrusive_ptr<Buff>;
+  Buffer(BuffIP b) : buffer_(std::move(b)), length_(buffer_->size()) {}
+  BuffIP buffer_;
+  size_t offset_ = 0;
+  size_t length_ = 0;
+};
+
+struct BufferCollection {
+  std::vector<Buffer> buffers;
+  Buffer combine() const {
+    size_t len = std::accumulate(
+        buffers.begin(), buffers.end(), size_t(0),
+        [](size_t acc, Buffer const& b) -> size_t { return acc + b.size(); });
+    std::vector<unsigned char> v;
+    v.reserve(len);
+    std::for_each(buffers.begin(), buffers.end(), [&](Buffer const& b) {
+      v.insert(v.end(), b.data(), b.data() + b.size());
+    });
+    return Buffer::make(std::move(v));
+  }
+};
+
+// bytes that never change once made, like an erlang binary. Copies and
+// slices share the bytes through Buffer's refcount, so sending one Binary to
+// many processes costs a message each and no copying of the bytes
+class Binary {
+public:
+  static Binary make(std::vector<unsigned char> data) {
+    return Binary(Buffer::make(std::move(data)));
+  }
+  static Binary makeCopy(void const* data, size_t len) {
+    return Binary(Buffer::makeCopy(data, len));
+  }
+  static Binary makeCopy(std::string_view s) {
+    return makeCopy(s.data(), s.size());
+  }
+  // shares b's bytes, which whoever made b must not change after this
+  static Binary fromBuffer(Buffer b) { return Binary(std::move(b)); }
+
+  unsigned char const* data() const { return buffer_.data(); }
+  size_t size() const { return buffer_.size(); }
+  bool empty() const { return size() == 0; }
+  std::string_view view() const {
+    return std::string_view(reinterpret_cast<char const*>(data()), size());
+  }
+  // [offset, offset + len) of this, sharing the bytes
+  Binary slice(size_t offset, size_t len) const {
+    return Binary(buffer_.slice(offset, len));
+  }
+  // shares the bytes, eg to write them to a socket. Not to be written to
+  Buffer const& buffer() const { return buffer_; }
+  bool sameStorage(Binary const& b) const {
+    return buffer_.sameStorage(b.buffer_);
+  }
+  friend bool operator==(Binary const& a, Binary const& b) {
+    return a.view() == b.view();
+  }
+  Binary() = delete;
+
+private:
+  explicit Binary(Buffer b) : buffer_(std::move(b)) {}
+  Buffer buffer_;
+};
+}
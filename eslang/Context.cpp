@@ -17,16 +17,24 @@ void Context::RunningProcess::resume() {
     if (dead) {
       return;
     }
+    resumeQueued = false;
 
     // cleanup old waiting things:
     timer.cancel();
     try {
       if (lastWaiting) {
+        lastWaiting->arm(false);
         if (auto* p = lastWaiting->wakeOnFuture()) {
           p->process();
         }
       }
       ++resumes;
+      struct InProcess {
+        bool& in;
+        bool const was;
+        explicit InProcess(bool& in) : in(in), was(in) { in = true; }
+        ~InProcess() { in = was; }
+      } in_process{parent->inProcess_};
       lastWaiting = task.resume();
       if (task.done()) {
         parent->addtoDestroy(pid, {});
@@ -38,26 +46,27 @@ void Context::RunningProcess::resume() {
       return;
     }
 
+    lastWaiting->arm(true);
     if (lastWaiting->isReadyForResume()) {
       parent->queueResume(pid, resumes);
     } else {
       if (lastWaiting->sleepFor()) {
         timer.expires_from_now(
             boost::posix_time::milliseconds(lastWaiting->sleepFor()->count()));
-        timer.async_wait([this](const boost::system::error_code& error) {
-          if (error == boost::asio::error::operation_aborted) {
+        // the timer may have already fired (and be queued) by the time
+        // something else wakes us and cancels it, so check it is still for
+        // this wait
+        timer.async_wait([ this, resumes = this->resumes ](
+            const boost::system::error_code& error) {
+          if (error == boost::asio::error::operation_aborted ||
+              this->resumes != resumes) {
             return;
           }
           this->resume();
         });
       }
       if (auto* promise = lastWaiting->wakeOnFuture()) {
-        promise->setContinuation(parent->ioService(),
-                                 [ this, resumes = this->resumes ]() {
-                                   if (this->resumes == resumes) {
-                                     resume();
-                                   }
-                                 });
+        promise->setContinuation(parent, pid, resumes);
       }
     }
   } catch (std::exception const& e) {
@@ -65,15 +74,17 @@ void Context::RunningProcess::resume() {
   }
 }
 
-bool Context::RunningProcess::waitingFor(SlotId s) const {
-  return lastWaiting && lastWaiting->isWaiting(s);
-}
-
 void Context::RunningProcess::send(SendAddress s, MessageBase m) {
-  bool waiting = waitingFor(s.slot());
-  process->push(s.slot(), std::move(m));
-  if (waiting) {
+  auto* slot = static_cast<SlotBase*>(s.slot());
+  slot->push(std::move(m));
+  if (!slot->armed()) {
+    return;
+  }
+  if (!lastWaiting->resumeAfterQueue()) {
     resume();
+  } else if (!resumeQueued) {
+    resumeQueued = true;
+    parent->queueResume(pid, resumes);
   }
 }
 
@@ -114,6 +125,26 @@ void Context::destroy(std::unique_ptr<RunningProcess> p, std::string reason) {
   for (auto to_notify : p->process->notifyOnDie()) {
     queueSend(to_notify, Message<Pid>(pid));
   }
+
+  for (auto const& group : p->process->groups()) {
+    leave(group, pid);
+  }
+}
+
+void Context::leave(std::string const& group, Pid member) {
+  auto it = groups_.find(group);
+  if (it == groups_.end()) {
+    return;
+  }
+  it->second->remove(member);
+  if (!it->second->size()) {
+    groups_.erase(it);
+  }
+}
+
+size_t Context::groupSize(std::string const& group) const {
+  auto it = groups_.find(group);
+  return it == groups_.end() ? 0 : it->second->size();
 }
 
 Pid Context::nextPid() {
@@ -139,6 +170,18 @@ void Context::queueResume(Pid p, uint64_t resumes) {
   queue_.emplace_back(p).resume = resumes;
 }
 
+void Context::wake(Pid p, uint64_t resumes) {
+  if (!inProcess_) {
+    // set from an io handler (eg a socket's read or write finishing)
+    queueResume(p, resumes);
+    return;
+  }
+  // set by a running process (eg taking from a throttled slot). These wait
+  // until the io already pending has run, so that senders it releases do not
+  // wake ahead of the sockets they send to and those keep gathering writes
+  deferredWakes_.emplace_back(p, resumes);
+}
+
 void Context::queueSend(SendAddress a, MessageBase m) {
   queue_.emplace_back(a.pid()).message =
       std::make_pair(std::move(a), std::move(m));
@@ -151,6 +194,9 @@ void Context::processQueueItem(ToProcessItem i) {
       (*it)->send(i.message->first, std::move(i.message->second));
     }
   }
+  if (i.broadcast) {
+    i.broadcast->deliver(*this);
+  }
   if (i.resume) {
     auto it = findProc(i.pid);
     if (it != processes_.end() && (*it)->resumes == *i.resume) {
@@ -166,7 +212,22 @@ void Context::run() {
         auto i = std::move(queue_.front());
         queue_.pop_front();
         processQueueItem(std::move(i));
+      } else if (deferredWakes_.size()) {
+        if (ioService_.stopped()) {
+          ioService_.restart();
+        }
+        while (ioService_.poll())
+          ;
+        for (auto const& [p, resumes] : deferredWakes_) {
+          queueResume(p, resumes);
+        }
+        deferredWakes_.clear();
       } else {
+        // running out of work (say, in the poll below) stops the service, and
+        // timers set since then would never fire until it is restarted
+        if (ioService_.stopped()) {
+          ioService_.restart();
+        }
         ioService_.run_one();
         // make sure to flush the queue so that anything that we are about to
         // kill, if it has timers, they will not be already on the queue
@@ -5,13 +5,14 @@
 #include "Slot.h"
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/io_service.hpp>
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <memory>
 #include <unordered_map>
 
 namespace s {
-class Context {
+class Context : public ProcessWaker {
 public:
   TimePoint now() const;
 
@@ -33,6 +34,15 @@ public:
     return nullptr;
   }
 
+  // messages delivered to t that its process has not taken yet
+  template <class T> size_t queued(TSendAddress<T> t) const {
+    auto it = findProc(t.pid());
+    if (it == processes_.end()) {
+      return 0;
+    }
+    return static_cast<TSlotBase<T>*>(t.slot())->queue()->size();
+  }
+
   template <class T, class Y>
   TSendAddress<T> makeSendAddress(Pid pid, Slot<T> Y::*slot) {
     auto it = findProc(pid);
@@ -74,9 +84,130 @@ public:
   // for now, processes don't move, so can keep event base pointers
   boost::asio::io_service& ioService() { return ioService_; }
 
+  // processes in the group, which Process::join and leave change
+  size_t groupSize(std::string const& group) const;
+
 private:
+  // a process is in a group through one of its slots, replacing any slot it
+  // joined with before. Groups hold one type of message
+  template <class T>
+  void join(std::string const& group, TSendAddress<T> member) {
+    findGroup<T>(group, true)->add(std::move(member));
+  }
+  void leave(std::string const& group, Pid member);
+
+  struct GroupBase {
+    virtual ~GroupBase() = default;
+    virtual void remove(Pid member) = 0;
+    virtual size_t size() const = 0;
+  };
+
+  template <class T> struct Group : GroupBase {
+    using Members = std::vector<TSendAddress<T>>;
+    // shared with broadcasts still queued, so copied before changing if they
+    // still have it
+    std::shared_ptr<Members> members = std::make_shared<Members>();
+    // where each pid is in members
+    std::unordered_map<Pid, size_t> index;
+
+    Members& mutableMembers() {
+      if (members.use_count() > 1) {
+        members = std::make_shared<Members>(*members);
+      }
+      return *members;
+    }
+    void add(TSendAddress<T> member) {
+      auto& m = mutableMembers();
+      auto it = index.find(member.pid());
+      if (it != index.end()) {
+        m[it->second] = std::move(member);
+        return;
+      }
+      index.emplace(member.pid(), m.size());
+      m.push_back(std::move(member));
+    }
+    void remove(Pid member) override {
+      auto it = index.find(member);
+      if (it == index.end()) {
+        return;
+      }
+      auto& m = mutableMembers();
+      size_t const at = it->second;
+      index.erase(it);
+      if (at != m.size() - 1) {
+        m[at] = std::move(m.back());
+        index[m[at].pid()] = at;
+      }
+      m.pop_back();
+    }
+    size_t size() const override { return members->size(); }
+  };
+
+  template <class T> Group<T>* findGroup(std::string const& name, bool create) {
+    auto it = groups_.find(name);
+    if (it == groups_.end()) {
+      if (!create) {
+        return nullptr;
+      }
+      it = groups_.emplace(name, std::make_unique<Group<T>>()).first;
+    }
+    auto* ret = dynamic_cast<Group<T>*>(it->second.get());
+    if (!ret) {
+      ESLANGEXCEPT("Group ", name, " holds another type of message");
+    }
+    return ret;
+  }
+
+  // the throttle of a member of group that cannot take more
+  template <class T> EslangPromise* groupThrottle(std::string const& group) {
+    auto* g = findGroup<T>(group, false);
+    if (!g) {
+      return nullptr;
+    }
+    for (auto const& member : *g->members) {
+      if (auto* promise = canQueue(member)) {
+        return promise;
+      }
+    }
+    return nullptr;
+  }
+
+  // one queue item for every member, delivered in one go
+  struct BroadcastBase {
+    virtual ~BroadcastBase() = default;
+    virtual void deliver(Context& c) = 0;
+  };
+
+  template <class T> struct Broadcast : BroadcastBase {
+    Broadcast(std::shared_ptr<typename Group<T>::Members const> to, T value)
+        : to(std::move(to)), value(std::move(value)) {}
+    std::shared_ptr<typename Group<T>::Members const> to;
+    T value;
+    void deliver(Context& c) override {
+      for (auto const& member : *to) {
+        // looked up each time, as delivering may resume the member, which
+        // can spawn or kill processes
+        auto it = c.findProc(member.pid());
+        if (it != c.processes_.end()) {
+          (*it)->send(member, Message<T>(value));
+        }
+      }
+    }
+  };
+
+  template <class T>
+  void queueBroadcast(Pid from, std::string const& group, T value) {
+    auto* g = findGroup<T>(group, false);
+    if (!g || !g->size()) {
+      return;
+    }
+    queue_.emplace_back(from).broadcast =
+        std::make_unique<Broadcast<T>>(g->members, std::move(value));
+  }
+
   friend class Process;
   void queueResume(Pid p, uint64_t expected_resumes);
+  void wake(Pid p, uint64_t resumes) override;
   void queueSend(SendAddress a, MessageBase m);
 
   Pid nextPid();
@@ -98,7 +229,6 @@ private:
     RunningProcess(Pid pid, std::unique_ptr<Process> proc, ProcessTask t,
                    Context* parent);
     void send(SendAddress s, MessageBase m);
-    bool waitingFor(SlotId s) const;
     void resume();
     bool dead = false;
     Pid pid;
@@ -107,6 +237,7 @@ private:
     IWaiting* lastWaiting = nullptr;
     Context* parent;
     uint64_t resumes = 0;
+    bool resumeQueued = false;
     boost::asio::deadline_timer timer;
   };
 
@@ -115,6 +246,7 @@ private:
     Pid pid;
     std::optional<uint64_t> resume;
     std::optional<std::pair<SendAddress, MessageBase>> message;
+    std::unique_ptr<BroadcastBase> broadcast;
   };
 
   void addtoDestroy(Pid p, std::string s);
@@ -129,6 +261,11 @@ private:
   std::deque<std::pair<std::unique_ptr<RunningProcess>, std::string>>
       toDestroy_;
   std::deque<ToProcessItem> queue_;
+  std::unordered_map<std::string, std::unique_ptr<GroupBase>> groups_;
+  // whether a process is running, rather than an io handler or the run queue
+  bool inProcess_ = false;
+  // wakes from running processes, queued once pending io has been polled
+  std::vector<std::pair<Pid, uint64_t>> deferredWakes_;
   boost::asio::io_service ioService_;
 };
 
@@ -154,6 +291,13 @@ Pid Process::spawnLinkNotify(TSendAddress<Pid> send_address, Args... args) {
   return new_pid;
 }
 
+template <class T, class... Args>
+Pid Process::spawnNotify(TSendAddress<Pid> send_address, Args... args) {
+  return c_->spawnWith<T>([s = std::move(send_address)](
+                              ProcessArgs & a) { a.notifyOnDead = s; },
+                          std::forward<Args>(args)...);
+}
+
 template <class T>
 MethodTask<void> Process::sendThrottled(TSendAddress<T> p, Message<T> message) {
   if (c_->waitOnQueue()) {
@@ -174,6 +318,124 @@ WaitingMaybe Process::send(TSendAddress<T> p, Args&&... params) {
   return WaitingMaybe(c_->waitOnQueue());
 }
 
+template <class T> GenTask<T> Process::drain(Slot<T>& slot) {
+  auto* queue = slot.queue();
+  while (!queue->empty()) {
+    co_yield std::move(queue->pop().val());
+  }
+}
+
+template <class T, class Pred>
+MethodTask<T> Process::recvMatch(Slot<T>& slot, Pred pred) {
+  size_t scanned = slot.queue()->marked();
+  while (true) {
+    auto* queue = slot.queue();
+    scanned = queue->find(scanned, pred);
+    if (scanned < queue->size()) {
+      queue->clearMark();
+      co_return std::move(queue->take(scanned).val());
+    }
+    co_await WaitingMore<T>(slot, scanned);
+  }
+}
+
+template <class T, class Pred>
+MethodTask<std::optional<T>>
+Process::timedRecvMatch(std::chrono::milliseconds time, Slot<T>& slot,
+                        Pred pred) {
+  auto const deadline = now() + time;
+  size_t scanned = slot.queue()->marked();
+  while (true) {
+    auto* queue = slot.queue();
+    scanned = queue->find(scanned, pred);
+    if (scanned < queue->size()) {
+      queue->clearMark();
+      co_return std::move(queue->take(scanned).val());
+    }
+    auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - now());
+    if (left.count() <= 0) {
+      co_return std::nullopt;
+    }
+    co_await WithWaitingTimeout<WaitingMore<T>>(left, slot, scanned);
+  }
+}
+
+template <class T> Slot<Reply<T>>& Process::replySlot() {
+  static size_t const type = nextReplyType();
+  if (replySlots_.size() <= type) {
+    replySlots_.resize(type + 1);
+  }
+  if (!replySlots_[type]) {
+    replySlots_[type] = std::make_unique<Slot<Reply<T>>>(this);
+  }
+  return static_cast<Slot<Reply<T>>&>(*replySlots_[type]);
+}
+
+template <class Req, class Rep>
+MethodTask<std::optional<Rep>>
+Process::call(TSendAddress<Call<Req, Rep>> target, Req request,
+              std::chrono::milliseconds timeout) {
+  auto& replies = replySlot<Rep>();
+  // replies to earlier calls that came too late
+  while (!replies.queue()->empty()) {
+    replies.queue()->pop();
+  }
+  uint64_t const id = ++lastCall_;
+  c_->queueSend(target, Message<Call<Req, Rep>>(Call<Req, Rep>{
+                            std::move(request), {replies.address(), id}}));
+  auto const deadline = now() + timeout;
+  while (true) {
+    auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - now());
+    if (left.count() <= 0) {
+      co_return std::nullopt;
+    }
+    auto r = co_await timedRecv(left, replies);
+    if (!std::get<0>(r)) {
+      co_return std::nullopt;
+    }
+    if (std::get<0>(r)->id == id) {
+      co_return std::move(std::get<0>(r)->value);
+    }
+  }
+}
+
+template <class T, class... Args>
+WaitingMaybe Process::reply(ReplyTo<T> const& to, Args&&... params) {
+  c_->queueSend(to.address, Message<Reply<T>>(Reply<T>{
+                                to.id, T(std::forward<Args>(params)...)}));
+  return WaitingMaybe(c_->waitOnQueue());
+}
+
+template <class T>
+void Process::join(std::string const& group, Slot<T> const& slot) {
+  c_->join(group, slot.address());
+  if (std::find(groups_.begin(), groups_.end(), group) == groups_.end()) {
+    groups_.push_back(group);
+  }
+}
+
+template <class T>
+WaitingMaybe Process::broadcast(std::string const& group, T value) {
+  c_->queueBroadcast(pid_, group, std::move(value));
+  return WaitingMaybe(c_->waitOnQueue());
+}
+
+template <class T>
+MethodTask<void> Process::broadcastThrottled(std::string group, T value) {
+  if (c_->waitOnQueue()) {
+    co_await WaitingYield();
+  }
+  auto* promise = c_->groupThrottle<T>(group);
+  while (promise) {
+    co_await WaitingFuture(promise);
+    promise = c_->groupThrottle<T>(group);
+  }
+  c_->queueBroadcast(pid_, group, std::move(value));
+  co_return;
+}
+
 template <class T, class Y>
 TSendAddress<T> Process::makeSendAddress(Pid pid, Slot<T> Y::*slot) {
   return c_->makeSendAddress(pid, slot);
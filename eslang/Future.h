@@ -1,10 +1,22 @@
 #pragma once
 #include <memory>
+#include <optional>
 
-#include <boost/asio/io_service.hpp>
+#include "BaseTypes.h"
 
 namespace s {
 
+// what a promise wakes once it is set. The context queues a resume for the
+// process on its run queue (after polling pending io, if set by a running
+// process), which is dropped if it has died or been resumed since
+class ProcessWaker {
+public:
+  virtual void wake(Pid pid, uint64_t resumes) = 0;
+
+protected:
+  ~ProcessWaker() = default;
+};
+
 class ExceptionWrapper {
 public:
   static ExceptionWrapper makeFromCurrentException() {
@@ -52,18 +64,17 @@ public:
   EslangPromise& operator=(EslangPromise const&) = delete;
 
   EslangPromise(EslangPromise&& rhs)
-      : exec_(std::move(rhs.exec_)), set_(rhs.set_),
+      : waiter_(std::move(rhs.waiter_)), set_(rhs.set_),
         exception_(std::move(rhs.exception_)) {}
 
   EslangPromise& operator=(EslangPromise&& rhs) {
     using std::swap;
-    exec_ = std::move(rhs.exec_);
+    waiter_ = std::move(rhs.waiter_);
     set_ = std::move(rhs.set_);
     exception_ = std::move(rhs.exception_);
     return *this;
   }
 
-  using Function = std::function<void()>;
   void setIfUnset() {
     if (!set_) {
       set();
@@ -76,7 +87,7 @@ public:
       exception_.reset();
     }
     if (set_) {
-      exec_.reset();
+      waiter_.reset();
     }
     set_ = false;
   }
@@ -90,25 +101,31 @@ public:
 
   bool isReady() { return set_; }
 
-  void setContinuation(boost::asio::io_service& io_service, Function func) {
-    exec_ = std::make_pair(&io_service, std::move(func));
+  // wakes pid through waker once set, unless it has been resumed since
+  void setContinuation(ProcessWaker* waker, Pid pid, uint64_t resumes) {
+    waiter_.emplace(Waiter{waker, pid, resumes});
     if (set_) {
       set();
     }
   }
 
 private:
+  struct Waiter {
+    ProcessWaker* waker;
+    Pid pid;
+    uint64_t resumes;
+  };
+
   void set() {
     set_ = true;
-    if (exec_) {
-      // exec_->first.post(std::move(exec_->second));
-      // the worst part of asio is handlers must be copyable
-      exec_->first->post(std::move(exec_->second));
-      exec_.reset();
+    if (waiter_) {
+      auto const w = *waiter_;
+      waiter_.reset();
+      w.waker->wake(w.pid, w.resumes);
     }
   }
 
-  std::optional<std::pair<boost::asio::io_service*, Function>> exec_;
+  std::optional<Waiter> waiter_;
   bool set_ = false;
   std::optional<ExceptionWrapper> exception_;
 };
@@ -22,7 +22,12 @@ struct IWaiting {
 
   virtual EslangPromise* wakeOnFuture() { return nullptr; }
 
-  virtual bool isWaiting(SlotId s) const { return false; }
+  // marks the slots this waits on while we are suspended, so a message to
+  // one of them knows to wake us
+  virtual void arm(bool armed) {}
+  // when a message wakes us, resume through the run queue rather than
+  // straight away, so whatever else is already queued for us arrives first
+  virtual bool resumeAfterQueue() const { return false; }
 
   template <class TPromise>
   void
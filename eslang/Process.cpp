@@ -1,5 +1,6 @@
 #include "Process.h"
 #include "Context.h"
+#include <atomic>
 
 namespace s {
 
@@ -8,4 +9,17 @@ TimePoint Process::now() const { return c_->now(); }
 void Process::link(Pid p) { c_->link(this, p); }
 
 void Process::queueKill(Pid p) { c_->addtoDestroy(p, ""); }
+
+size_t Process::nextReplyType() {
+  static std::atomic<size_t> next{0};
+  return next++;
+}
+
+void Process::leave(std::string const& group) {
+  auto it = std::find(groups_.begin(), groups_.end(), group);
+  if (it != groups_.end()) {
+    groups_.erase(it);
+    c_->leave(group, pid_);
+  }
+}
 }
@@ -2,19 +2,44 @@
 #include <chrono>
 #include <cstdint>
 #include <experimental/coroutine>
+#include <memory>
 #include <optional>
+#include <string>
 #include <tuple>
 #include <unordered_set>
 
 #include "BaseTypes.h"
 #include "Except.h"
 #include "Slot.h"
+#include "TypedFuture.h"
 #include "Waiting.h"
 
 namespace s {
 
 class Context;
 class SlotBase;
+
+// a reply to a call, tagged with the call it is for so that late ones (to
+// calls that timed out) can be told apart
+template <class T> struct Reply {
+  uint64_t id;
+  T value;
+};
+
+// where the reply to a call goes
+template <class T> struct ReplyTo {
+  TSendAddress<Reply<T>> address;
+  uint64_t id;
+};
+
+// what a process serving calls receives, to answer with Process::reply
+template <class Req, class Rep> struct Call {
+  using Request = Req;
+  using Response = Rep;
+  Req request;
+  ReplyTo<Rep> replyTo;
+};
+
 struct ProcessArgs {
   explicit ProcessArgs(Pid p) : pid(p) {}
   Context* c = nullptr;
@@ -46,6 +71,10 @@ public:
   TimePoint now() const;
 
   void addKillOnDie(Pid b) { killOnDie_.push_back(b); }
+  // a is sent our pid when we die
+  void addNotifyOnDie(TSendAddress<Pid> a) {
+    notifyOnDie_.push_back(std::move(a));
+  }
   std::vector<Pid> const& killOnDie() const { return killOnDie_; }
   std::vector<TSendAddress<Pid>> const& notifyOnDie() const {
     return notifyOnDie_;
@@ -56,6 +85,9 @@ public:
   // spawn a process, link it to us (if we die), but notify us if they die
   template <class T, class... Args>
   Pid spawnLinkNotify(TSendAddress<Pid> send_address, Args... args);
+  // spawn a process, and notify us when it dies (however it does)
+  template <class T, class... Args>
+  Pid spawnNotify(TSendAddress<Pid> send_address, Args... args);
 
   template <class T, class Y>
   TSendAddress<T> makeSendAddress(Pid pid, Slot<T> Y::*slot);
@@ -71,13 +103,43 @@ public:
   template <class T, class... Args>
   WaitingMaybe send(TSendAddress<T> p, Args&&... params);
 
+  // sends request to target and waits for its reply, or for timeout to pass.
+  // Replies come to a slot of ours made on our first call for each type of
+  // reply, so calling allocates nothing but the messages
+  template <class Req, class Rep>
+  MethodTask<std::optional<Rep>> call(TSendAddress<Call<Req, Rep>> target,
+                                      Req request,
+                                      std::chrono::milliseconds timeout);
+  template <class Req, class Rep, class Y>
+  MethodTask<std::optional<Rep>>
+  call(Pid target, Slot<Call<Req, Rep>> Y::*slot,
+       typename Call<Req, Rep>::Request request,
+       std::chrono::milliseconds timeout) {
+    return call(makeSendAddress(target, slot), std::move(request), timeout);
+  }
+  template <class T, class... Args>
+  WaitingMaybe reply(ReplyTo<T> const& to, Args&&... params);
+
+  // groups are named per context. We are in a group through one slot, and
+  // leave all our groups when we die
+  template <class T> void join(std::string const& group, Slot<T> const& slot);
+  void leave(std::string const& group);
+  std::vector<std::string> const& groups() const { return groups_; }
+
+  // sends value to everyone in group, delivered all in one go. Each gets a
+  // copy of value, so big payloads want to be shared (eg Binary)
+  template <class T> WaitingMaybe broadcast(std::string const& group, T value);
+  // waits first until every member's slot can take more
+  template <class T>
+  MethodTask<void> broadcastThrottled(std::string group, T value);
+
   Context* c() { return c_; }
 
   template <class... TSlots>
   WithWaitingTimeout<WaitingMessages<TSlots...>>
   timedRecv(std::chrono::milliseconds time, Slot<TSlots>&... slots) {
-    TimePoint t = now() + time;
-    return WithWaitingTimeout<WaitingMessages<TSlots...>>(t, slots...);
+    // every slot empty means it timed out
+    return WithWaitingTimeout<WaitingMessages<TSlots...>>(time, slots...);
   }
 
   template <class... TSlots>
@@ -94,6 +156,30 @@ public:
     return WaitingMessage<T>(this->tryRecv<T>(slot));
   }
 
+  // up to max messages from slot, waiting for there to be at least one
+  template <class T> WaitingBatch<T> recvBatch(Slot<T>& slot, size_t max) {
+    return WaitingBatch<T>(slot, max);
+  }
+
+  // each message already queued in slot, ending once it is empty
+  template <class T> GenTask<T> drain(Slot<T>& slot);
+
+  // the first message in slot that pred accepts, leaving the others queued
+  // in order. Each message is looked at once, however often we wake.
+  // Scanning starts at the slot's mark (the front, if unset), and a match
+  // clears it. Mark the slot before sending a request, and matching its
+  // reply only looks at what came in since, so a loop of request and reply
+  // stays linear however big the backlog in front:
+  //   in.mark();
+  //   co_await send(server, Request{id, in.address()});
+  //   auto reply = co_await recvMatch(in, [id](auto& r) { return r.id == id; });
+  template <class T, class Pred>
+  MethodTask<T> recvMatch(Slot<T>& slot, Pred pred);
+  // or nothing, if no match comes within time
+  template <class T, class Pred>
+  MethodTask<std::optional<T>>
+  timedRecvMatch(std::chrono::milliseconds time, Slot<T>& slot, Pred pred);
+
   void queueKill(Pid p);
 
 protected:
@@ -107,5 +193,12 @@ private:
   template <class T> friend class Slot;
   std::vector<Pid> killOnDie_;
   std::vector<TSendAddress<Pid>> notifyOnDie_;
+  std::vector<std::string> groups_;
+
+  template <class T> Slot<Reply<T>>& replySlot();
+  static size_t nextReplyType();
+  // by reply type, made as needed
+  std::vector<std::unique_ptr<SlotBase>> replySlots_;
+  uint64_t lastCall_ = 0;
 };
 }
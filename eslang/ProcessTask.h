@@ -145,7 +145,8 @@ template <> struct MethodTaskPromiseWithReturn<void> : MethodTaskPromise {
 };
 
 template <class T> struct MethodTaskPromiseWithReturn : MethodTaskPromise {
-  T t_;
+  // optional so that T does not need to be default constructible
+  std::optional<T> t_;
   void return_value(T t) { t_ = std::move(t); }
   MethodTask<T> get_return_object();
   std::experimental::coroutine_handle<> getHandle() override {
@@ -195,7 +196,19 @@ template <class T> struct GenPromise : MethodTaskPromise {
   }
   GenTask<T> get_return_object();
   auto initial_suspend() { return std::experimental::suspend_always{}; }
-  auto final_suspend() { return std::experimental::suspend_always{}; }
+  auto final_suspend() {
+    // as with a yield we are no longer waiting, else a later next() would
+    // suspend on what we last waited for
+    this->waiting = nullptr;
+    // if we finished after suspending, our parent is waiting in next() and
+    // nothing else will wake it, so (as with a yield) run it now
+    if (auto parent = this->parent) {
+      this->parent = nullptr;
+      parent->subCoroutineChild = nullptr;
+      return SuspendRunNext{parent->getHandle()};
+    }
+    return SuspendRunNext{};
+  }
   std::experimental::coroutine_handle<> getHandle() override {
     return std::experimental::coroutine_handle<GenPromise<T>>::from_promise(
         *this);
@@ -258,7 +271,7 @@ class MethodTask : public MethodTaskBase<T, MethodTaskPromiseWithReturn<T>> {
 public:
   using TParent = MethodTaskBase<T, MethodTaskPromiseWithReturn<T>>;
   using TParent::TParent;
-  T& await_resume() { return this->coroutine_.promise().t_; }
+  T& await_resume() { return *this->coroutine_.promise().t_; }
 };
 
 template <class T> struct GenTask {
@@ -293,7 +306,10 @@ public:
   T& take() { return coroutine_.promise().t_.value(); }
 
   NextAwaitable next() {
-    coroutine_.resume();
+    // once finished, keep saying so
+    if (!coroutine_.atFinalSuspend()) {
+      coroutine_.resume();
+    }
     return NextAwaitable(this);
   }
 
@@ -36,12 +36,60 @@ public:
     }
   }
 
+  // index of the first message from start on that pred accepts (0 being the
+  // next to pop), or size() if none does
+  template <class Pred> size_t find(size_t start, Pred& pred) const {
+    if (start >= size()) {
+      return size();
+    }
+    if (start == 0) {
+      if (pred(stackStorage->val())) {
+        return 0;
+      }
+      start = 1;
+    }
+    for (auto it = others.begin() + (start - 1); it != others.end(); ++it) {
+      if (pred(it->val())) {
+        return 1 + (it - others.begin());
+      }
+    }
+    return size();
+  }
+
+  // Takes the i-th message, leaving the rest in order. Erasing from the deque
+  // moves every message between i and the nearer end, so this is O(size())
+  // from the middle of a long queue, but cheap near the back.
+  Message<T> take(size_t i) {
+    if (i == 0) {
+      return pop();
+    }
+    if (i < mark_) {
+      --mark_;
+    }
+    Message<T> ret = std::move(others[i - 1]);
+    others.erase(others.begin() + (i - 1));
+    if (size() == kThrottle - 1) {
+      p_.setIfUnset();
+    }
+    return ret;
+  }
+
   static constexpr size_t kThrottle = 10;
   bool shouldThrottle() const { return size() >= kThrottle; }
 
   EslangPromise* throttlePromise() { return &p_; }
 
+  // messages queued before a mark are left alone by the next match (see
+  // Process::recvMatch), which starts from it. It moves down as messages in
+  // front of it are taken, so it keeps pointing at the same message
+  void mark() { mark_ = size(); }
+  size_t marked() const { return mark_; }
+  void clearMark() { mark_ = 0; }
+
   Message<T> pop() {
+    if (mark_) {
+      --mark_;
+    }
     Message<T> ret = std::move(*stackStorage);
     if (others.empty()) {
       stackStorage.reset();
@@ -62,6 +110,7 @@ public:
   std::optional<Message<T>> stackStorage;
   std::deque<Message<T>> others;
   EslangPromise p_;
+  size_t mark_ = 0;
 };
 
 class SlotBase {
@@ -75,9 +124,16 @@ public:
   virtual ~SlotBase();
   virtual void push(MessageBase message) = 0;
 
+  // set while our process is suspended waiting on this slot
+  bool armed() const { return armed_; }
+  void arm(bool armed) { armed_ = armed; }
+
 protected:
   Process* const parent_;
   SlotId const id_;
+
+private:
+  bool armed_ = false;
 };
 
 template <class T> class TSlotBase : public SlotBase {
@@ -100,6 +156,9 @@ public:
 
   SlotId id() const { return this->id_; }
 
+  // see MessageQueue::mark
+  void mark() { messages_.mark(); }
+
   void push(MessageBase message) override {
     Message<T>* m = static_cast<Message<T>*>(&message);
     messages_.push(std::move(*m));
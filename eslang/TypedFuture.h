@@ -0,0 +1,238 @@
+#pragma once
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Except.h"
+#include "Future.h"
+#include "IWaiting.h"
+
+namespace s {
+
+template <class T> class Promise;
+template <class T> class Future;
+
+namespace detail {
+
+template <class T> struct FutureState;
+
+// takes over a future's result when it is set, used by whenAll and whenAny
+template <class T> struct FutureListener {
+  virtual ~FutureListener() = default;
+  virtual void onSet(size_t index, FutureState<T>& state) = 0;
+};
+
+// shared by a promise and its future, so one allocation for the pair. The
+// process awaiting the future is woken through ready, which queues its resume
+// on the run queue. Set from a running process, that waits until the context
+// has polled the io already pending
+template <class T> struct FutureState {
+  EslangPromise ready;
+  std::optional<T> value;
+  std::exception_ptr exception;
+  bool done = false;
+  std::shared_ptr<FutureListener<T>> listener;
+  size_t index = 0;
+
+  void finish() {
+    done = true;
+    if (listener) {
+      auto l = std::move(listener);
+      l->onSet(index, *this);
+    } else {
+      ready.setIfUnset();
+    }
+  }
+};
+
+template <class T> struct WaitingFutureValue : IWaiting {
+  std::shared_ptr<FutureState<T>> state;
+
+  explicit WaitingFutureValue(std::shared_ptr<FutureState<T>> s)
+      : state(std::move(s)) {
+    ESLANGREQUIRE(state, "Awaiting a future with no state");
+  }
+
+  bool await_ready() noexcept { return state->done; }
+
+  EslangPromise* wakeOnFuture() override { return &state->ready; }
+
+  T await_resume() {
+    if (state->exception) {
+      std::rethrow_exception(state->exception);
+    }
+    return std::move(*state->value);
+  }
+};
+} // namespace detail
+
+// the result of a Promise, which any process can co_await (once) for the
+// value or the exception set on the promise
+template <class T> class Future {
+public:
+  Future() = default;
+  Future(Future const&) = delete;
+  Future& operator=(Future const&) = delete;
+  Future(Future&&) = default;
+  Future& operator=(Future&&) = default;
+
+  bool valid() const { return state_ != nullptr; }
+  bool isReady() const { return state_ && state_->done; }
+
+  detail::WaitingFutureValue<T> operator co_await() {
+    return detail::WaitingFutureValue<T>(std::move(state_));
+  }
+
+private:
+  friend class Promise<T>;
+  template <class U>
+  friend Future<std::vector<U>> whenAll(std::vector<Future<U>> futures);
+  template <class U>
+  friend Future<std::pair<size_t, U>> whenAny(std::vector<Future<U>> futures);
+
+  explicit Future(std::shared_ptr<detail::FutureState<T>> s)
+      : state_(std::move(s)) {}
+
+  // hands our result to listener once there is one
+  void listen(std::shared_ptr<detail::FutureListener<T>> listener,
+              size_t index) {
+    ESLANGREQUIRE(state_, "Listening to a future with no state");
+    auto s = std::move(state_);
+    if (s->done) {
+      listener->onSet(index, *s);
+    } else {
+      s->listener = std::move(listener);
+      s->index = index;
+    }
+  }
+
+  std::shared_ptr<detail::FutureState<T>> state_;
+};
+
+// set once, from a process or an asio handler. Destroying it unset breaks it,
+// so its future throws rather than waiting forever
+template <class T> class Promise {
+public:
+  Promise() : state_(std::make_shared<detail::FutureState<T>>()) {}
+  Promise(Promise const&) = delete;
+  Promise& operator=(Promise const&) = delete;
+  Promise(Promise&& rhs) = default;
+
+  Promise& operator=(Promise&& rhs) {
+    breakIfUnset();
+    state_ = std::move(rhs.state_);
+    futureTaken_ = rhs.futureTaken_;
+    return *this;
+  }
+
+  ~Promise() { breakIfUnset(); }
+
+  Future<T> getFuture() {
+    ESLANGREQUIRE((state_ && !futureTaken_), "Future already taken");
+    futureTaken_ = true;
+    return Future<T>(state_);
+  }
+
+  bool isSet() const { return !state_ || state_->done; }
+
+  template <class... Args> void setValue(Args&&... args) {
+    ESLANGREQUIRE(!isSet(), "Promise already set");
+    state_->value.emplace(std::forward<Args>(args)...);
+    state_->finish();
+  }
+
+  void setException(std::exception_ptr e) {
+    ESLANGREQUIRE(!isSet(), "Promise already set");
+    state_->exception = std::move(e);
+    state_->finish();
+  }
+
+  template <class E> void setException(E e) {
+    setException(std::make_exception_ptr(std::move(e)));
+  }
+
+private:
+  void breakIfUnset() {
+    if (!isSet()) {
+      setException(EslangException("Broken promise"));
+    }
+  }
+
+  std::shared_ptr<detail::FutureState<T>> state_;
+  bool futureTaken_ = false;
+};
+
+// ready with all the values, in order, once every future is, or with the
+// first exception any of them has
+template <class T>
+Future<std::vector<T>> whenAll(std::vector<Future<T>> futures) {
+  struct All : detail::FutureListener<T> {
+    Promise<std::vector<T>> promise;
+    std::vector<std::optional<T>> values;
+    size_t left = 0;
+
+    void onSet(size_t index, detail::FutureState<T>& state) override {
+      if (promise.isSet()) {
+        return;
+      }
+      if (state.exception) {
+        promise.setException(state.exception);
+        return;
+      }
+      values[index] = std::move(state.value);
+      if (--left) {
+        return;
+      }
+      std::vector<T> ret;
+      ret.reserve(values.size());
+      for (auto& v : values) {
+        ret.push_back(std::move(*v));
+      }
+      promise.setValue(std::move(ret));
+    }
+  };
+
+  auto all = std::make_shared<All>();
+  auto ret = all->promise.getFuture();
+  all->values.resize(futures.size());
+  all->left = futures.size();
+  if (futures.empty()) {
+    all->promise.setValue();
+  }
+  for (size_t i = 0; i < futures.size(); ++i) {
+    futures[i].listen(all, i);
+  }
+  return ret;
+}
+
+// ready with the index and value of the first of futures to be, or with its
+// exception
+template <class T>
+Future<std::pair<size_t, T>> whenAny(std::vector<Future<T>> futures) {
+  struct Any : detail::FutureListener<T> {
+    Promise<std::pair<size_t, T>> promise;
+
+    void onSet(size_t index, detail::FutureState<T>& state) override {
+      if (promise.isSet()) {
+        return;
+      }
+      if (state.exception) {
+        promise.setException(state.exception);
+        return;
+      }
+      promise.setValue(index, std::move(*state.value));
+    }
+  };
+
+  ESLANGREQUIRE(futures.size(), "whenAny needs at least one future");
+  auto any = std::make_shared<Any>();
+  auto ret = any->promise.getFuture();
+  for (size_t i = 0; i < futures.size(); ++i) {
+    futures[i].listen(any, i);
+  }
+  return ret;
+}
+
+} // namespace s
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <vector>
 
 #include "Except.h"
 #include "IWaiting.h"
@@ -77,7 +79,7 @@ using WaitingFuture = WithWaitingFuture<WaitingAlways>;
 
 template <class... TTypes> struct WaitingMessages : IWaiting {
   std::tuple<MessageQueue<TTypes>*...> messages;
-  std::array<SendAddress, sizeof...(TTypes)> addresses;
+  std::array<SlotBase*, sizeof...(TTypes)> slots;
 
   WaitingMessages(TSlotBase<TTypes>&... args);
 
@@ -121,12 +123,54 @@ template <class... TTypes> struct WaitingMessages : IWaiting {
     return get_vals(std::index_sequence_for<TTypes...>{});
   }
 
-  bool isWaiting(SlotId s) const override {
-    return std::any_of(addresses.begin(), addresses.end(),
-                       [s](auto const& add) { return add.slot() == s; });
+  void arm(bool armed) override {
+    for (auto* slot : slots) {
+      slot->arm(armed);
+    }
   }
 };
 
+// ready once slot holds more than seen messages
+template <class T> struct WaitingMore : IWaiting {
+  MessageQueue<T>* queue;
+  SlotBase* slot;
+  size_t seen;
+
+  WaitingMore(TSlotBase<T>& s, size_t seen)
+      : queue(s.queue()), slot(&s), seen(seen) {}
+
+  bool await_ready() noexcept { return queue->size() > seen; }
+  void await_resume() {}
+  void arm(bool armed) override { slot->arm(armed); }
+};
+
+// up to max messages from slot, once it has any
+template <class T> struct WaitingBatch : IWaiting {
+  MessageQueue<T>* queue;
+  SlotBase* slot;
+  size_t max;
+
+  WaitingBatch(TSlotBase<T>& s, size_t max)
+      : queue(s.queue()), slot(&s), max(max) {}
+
+  bool await_ready() noexcept { return !queue->empty(); }
+
+  std::vector<T> await_resume() {
+    if (queue->empty()) {
+      ESLANGEXCEPT("Message was not ready");
+    }
+    std::vector<T> ret;
+    ret.reserve(std::min(max, queue->size()));
+    while (ret.size() < max && !queue->empty()) {
+      ret.push_back(std::move(queue->pop().val()));
+    }
+    return ret;
+  }
+
+  void arm(bool armed) override { slot->arm(armed); }
+  bool resumeAfterQueue() const override { return true; }
+};
+
 template <class T> struct WaitingMessage {
   WaitingMessages<T> underlying;
 
@@ -150,5 +194,5 @@ template <class T> struct WaitingMessage {
 
 template <class... TTypes>
 WaitingMessages<TTypes...>::WaitingMessages(TSlotBase<TTypes>&... args)
-    : messages(args.queue()...), addresses({args.address()...}) {}
+    : messages(args.queue()...), slots({&args...}) {}
 }
@@ -0,0 +1,129 @@
+#include "Ktls.h"
+#include <memory>
+#include <openssl/kdf.h>
+#include <string>
+
+namespace s {
+
+namespace {
+size_t keyLength(KtlsKeys::Cipher cipher) {
+  return cipher == KtlsKeys::Cipher::Aes128Gcm ? 16 : 32;
+}
+
+// the implicit (fixed) part of each nonce in TLS 1.2
+size_t fixedIvLength(KtlsKeys::Cipher cipher) {
+  return cipher == KtlsKeys::Cipher::Chacha20Poly1305 ? 12 : 4;
+}
+
+// HKDF-Expand-Label from RFC 8446, with no context
+std::vector<unsigned char> expandLabel(EVP_MD const* md,
+                                       std::vector<unsigned char> const& secret,
+                                       std::string const& label, size_t len) {
+  std::string const full = "tls13 " + label;
+  std::vector<unsigned char> info = {static_cast<unsigned char>(len >> 8),
+                                     static_cast<unsigned char>(len),
+                                     static_cast<unsigned char>(full.size())};
+  info.insert(info.end(), full.begin(), full.end());
+  info.push_back(0);
+  std::vector<unsigned char> ret(len);
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr), EVP_PKEY_CTX_free);
+  if (!ctx || EVP_PKEY_derive_init(ctx.get()) <= 0 ||
+      EVP_PKEY_CTX_hkdf_mode(ctx.get(),
+                             EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) <= 0 ||
+      EVP_PKEY_CTX_set_hkdf_md(ctx.get(), md) <= 0 ||
+      EVP_PKEY_CTX_set1_hkdf_key(ctx.get(), secret.data(), secret.size()) <=
+          0 ||
+      EVP_PKEY_CTX_add1_hkdf_info(ctx.get(), info.data(), info.size()) <= 0 ||
+      EVP_PKEY_derive(ctx.get(), ret.data(), &len) <= 0) {
+    return {};
+  }
+  return ret;
+}
+
+// the TLS 1.2 key block (RFC 5246 6.3)
+std::vector<unsigned char>
+keyBlock(EVP_MD const* md, std::vector<unsigned char> const& master,
+         std::vector<unsigned char> const& client_random,
+         std::vector<unsigned char> const& server_random, size_t len) {
+  static char const kLabel[] = "key expansion";
+  std::vector<unsigned char> ret(len);
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr), EVP_PKEY_CTX_free);
+  if (!ctx || EVP_PKEY_derive_init(ctx.get()) <= 0 ||
+      EVP_PKEY_CTX_set_tls1_prf_md(ctx.get(), md) <= 0 ||
+      EVP_PKEY_CTX_set1_tls1_prf_secret(ctx.get(), master.data(),
+                                        master.size()) <= 0 ||
+      EVP_PKEY_CTX_add1_tls1_prf_seed(
+          ctx.get(), reinterpret_cast<unsigned char const*>(kLabel),
+          sizeof(kLabel) - 1) <= 0 ||
+      EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), server_random.data(),
+                                      server_random.size()) <= 0 ||
+      EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), client_random.data(),
+                                      client_random.size()) <= 0 ||
+      EVP_PKEY_derive(ctx.get(), ret.data(), &len) <= 0) {
+    return {};
+  }
+  return ret;
+}
+
+KtlsKeys startKeys(KtlsKeys::Cipher cipher, bool tls13, uint64_t records) {
+  KtlsKeys keys;
+  keys.cipher = cipher;
+  keys.tls13 = tls13;
+  for (int i = 0; i < 8; ++i) {
+    keys.seq[i] = static_cast<unsigned char>(records >> (56 - 8 * i));
+  }
+  return keys;
+}
+
+// splits the whole 12 byte nonce into the salt and the iv
+std::optional<KtlsKeys> finishKeys(KtlsKeys keys,
+                                   std::vector<unsigned char> const& nonce) {
+  if (keys.key.size() != keyLength(keys.cipher) || nonce.size() != 12) {
+    return std::nullopt;
+  }
+  // chacha has no salt, its whole nonce is the iv
+  size_t const salt_len =
+      keys.cipher == KtlsKeys::Cipher::Chacha20Poly1305 ? 0 : 4;
+  keys.salt.assign(nonce.begin(), nonce.begin() + salt_len);
+  keys.iv.assign(nonce.begin() + salt_len, nonce.end());
+  return keys;
+}
+} // namespace
+
+std::optional<KtlsKeys>
+KtlsKeys::fromTls13Secret(Cipher cipher, EVP_MD const* md,
+                          std::vector<unsigned char> const& secret,
+                          uint64_t records) {
+  auto keys = startKeys(cipher, true, records);
+  keys.key = expandLabel(md, secret, "key", keyLength(cipher));
+  return finishKeys(std::move(keys), expandLabel(md, secret, "iv", 12));
+}
+
+std::optional<KtlsKeys>
+KtlsKeys::fromTls12Master(Cipher cipher, EVP_MD const* md,
+                          std::vector<unsigned char> const& master,
+                          std::vector<unsigned char> const& client_random,
+                          std::vector<unsigned char> const& server_random,
+                          uint64_t records) {
+  auto keys = startKeys(cipher, false, records);
+  size_t const key_len = keyLength(cipher);
+  size_t const fixed_len = fixedIvLength(cipher);
+  // client key, server key, client iv, server iv
+  auto block = keyBlock(md, master, client_random, server_random,
+                        2 * key_len + 2 * fixed_len);
+  if (block.empty()) {
+    return std::nullopt;
+  }
+  keys.key.assign(block.begin() + key_len, block.begin() + 2 * key_len);
+  std::vector<unsigned char> nonce(block.begin() + 2 * key_len + fixed_len,
+                                   block.end());
+  if (cipher != Cipher::Chacha20Poly1305) {
+    // the explicit part of the nonce goes with each record. OpenSSL uses
+    // the sequence number, so carry on doing so
+    nonce.insert(nonce.end(), keys.seq, keys.seq + 8);
+  }
+  return finishKeys(std::move(keys), nonce);
+}
+}
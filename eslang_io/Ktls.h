@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <openssl/evp.h>
+#include <optional>
+#include <vector>
+
+namespace s {
+
+// The keys and state the kernel needs to carry on encrypting a TLS
+// connection's records where OpenSSL left off (see Tcp::TlsOptions::ktls),
+// derived from the handshake's secrets the same way OpenSSL derives its own.
+// Laid out as linux/tls.h wants them
+struct KtlsKeys {
+  enum class Cipher { Aes128Gcm, Aes256Gcm, Chacha20Poly1305 };
+
+  Cipher cipher;
+  bool tls13;
+  std::vector<unsigned char> key;
+  // the implicit part of the nonce
+  std::vector<unsigned char> salt;
+  // the explicit part of the nonce (TLS 1.2) or the rest of it (TLS 1.3)
+  std::vector<unsigned char> iv;
+  // the sequence number of the next record, big endian
+  unsigned char seq[8];
+
+  // From a TLS 1.3 traffic secret (eg the key log's SERVER_TRAFFIC_SECRET_0),
+  // once records have been sent with it. md is the cipher suite's hash.
+  // nullopt if the derivation fails
+  static std::optional<KtlsKeys>
+  fromTls13Secret(Cipher cipher, EVP_MD const* md,
+                  std::vector<unsigned char> const& secret, uint64_t records);
+  // The server's keys in TLS 1.2, from the master secret and both randoms,
+  // once records have been sent with them. md is the PRF's hash
+  static std::optional<KtlsKeys>
+  fromTls12Master(Cipher cipher, EVP_MD const* md,
+                  std::vector<unsigned char> const& master,
+                  std::vector<unsigned char> const& client_random,
+                  std::vector<unsigned char> const& server_random,
+                  uint64_t records);
+};
+}
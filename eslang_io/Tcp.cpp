@@ -1,13 +1,371 @@
 #include "Tcp.h"
+#include "Ktls.h"
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <cstring>
+#include <deque>
 #include <numeric>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS) && !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ESLANG_UNIX_SOCKETS 1
+#endif
+#if defined(__linux__) && __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#define ESLANG_KTLS 1
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
 
 #include <eslang/Logging.h>
 
 namespace s {
 using namespace boost::asio;
 
+namespace {
+// what a listener's TLS callbacks need, kept on its SSL_CTX
+struct TlsState {
+  struct TicketKey {
+    unsigned char name[16];
+    unsigned char aes[32];
+    unsigned char hmac[32];
+    TimePoint created;
+  };
+
+  explicit TlsState(Tcp::TlsOptions options) : options(std::move(options)) {}
+
+  // the key for new tickets, made if the last one is too old. null if there
+  // is no randomness to make one with
+  TicketKey const* encryptingKey() {
+    auto const now = std::chrono::steady_clock::now();
+    if (keys.empty() ||
+        now - keys.front().created >= options.ticketKeyLifetime) {
+      TicketKey key;
+      if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+          RAND_bytes(key.aes, sizeof(key.aes)) != 1 ||
+          RAND_bytes(key.hmac, sizeof(key.hmac)) != 1) {
+        return nullptr;
+      }
+      key.created = now;
+      keys.push_front(key);
+      if (options.stats) {
+        ++options.stats->ticketKeyRotations;
+      }
+    }
+    // every ticket these made has expired
+    auto const keep = options.ticketKeyLifetime + options.sessionTimeout;
+    while (keys.size() > 1 && now - keys.back().created >= keep) {
+      keys.pop_back();
+    }
+    return &keys.front();
+  }
+
+  TicketKey const* findKey(unsigned char const* name) {
+    encryptingKey();
+    for (auto const& key : keys) {
+      if (!std::memcmp(key.name, name, sizeof(key.name))) {
+        return &key;
+      }
+    }
+    return nullptr;
+  }
+
+  Tcp::TlsOptions const options;
+  // options.alpn in the wire format, each prefixed by its length
+  std::string alpn;
+  // newest first
+  std::deque<TicketKey> keys;
+};
+
+int tlsStateIndex() {
+  static int const index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+TlsState* tlsStateOf(SSL* ssl) {
+  return static_cast<TlsState*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), tlsStateIndex()));
+}
+
+// returns the key to use for a ticket (filling in name and iv if making one),
+// and whether it is an old key, in which case the ticket gets renewed
+TlsState::TicketKey const* ticketKey(SSL* ssl, unsigned char* name,
+                                     unsigned char* iv, bool encrypt,
+                                     bool& renew) {
+  auto* state = tlsStateOf(ssl);
+  if (encrypt) {
+    auto const* key = state->encryptingKey();
+    if (!key ||
+        RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+      return nullptr;
+    }
+    std::memcpy(name, key->name, sizeof(key->name));
+    return key;
+  }
+  auto const* key = state->findKey(name);
+  renew = key && key != &state->keys.front();
+  return key;
+}
+
+// OpenSSL's session ticket callback: 1 to use the key, 2 to use it and renew
+// the ticket, 0 for an unknown key (so a full handshake), -1 on failure
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt) {
+  bool renew = false;
+  auto const* key = ticketKey(ssl, name, iv, encrypt, renew);
+  if (!key) {
+    return encrypt ? -1 : 0;
+  }
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_octet_string(
+          OSSL_MAC_PARAM_KEY, const_cast<unsigned char*>(key->hmac),
+          sizeof(key->hmac)),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                       const_cast<char*>("SHA256"), 0),
+      OSSL_PARAM_construct_end()};
+  if (!EVP_CipherInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key->aes, iv,
+                         encrypt) ||
+      !EVP_MAC_CTX_set_params(mac, params)) {
+    return -1;
+  }
+  return renew ? 2 : 1;
+}
+#else
+int ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int encrypt) {
+  bool renew = false;
+  auto const* key = ticketKey(ssl, name, iv, encrypt, renew);
+  if (!key) {
+    return encrypt ? -1 : 0;
+  }
+  if (!EVP_CipherInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key->aes, iv,
+                         encrypt) ||
+      !HMAC_Init_ex(mac, key->hmac, sizeof(key->hmac), EVP_sha256(),
+                    nullptr)) {
+    return -1;
+  }
+  return renew ? 2 : 1;
+}
+#endif
+
+int alpnCallback(SSL*, unsigned char const** out, unsigned char* out_len,
+                 unsigned char const* in, unsigned int in_len, void* arg) {
+  auto const& ours = static_cast<TlsState*>(arg)->alpn;
+  unsigned char* selected = nullptr;
+  // ours first, so that our preference wins
+  if (SSL_select_next_proto(
+          &selected, out_len,
+          reinterpret_cast<unsigned char const*>(ours.data()), ours.size(),
+          in, in_len) != OPENSSL_NPN_NEGOTIATED) {
+    return SSL_TLSEXT_ERR_NOACK;
+  }
+  *out = selected;
+  return SSL_TLSEXT_ERR_OK;
+}
+
+// What is needed to hand a connection's sending to the kernel, gathered by
+// OpenSSL's callbacks during the handshake. Only sending, as by the time the
+// handshake is done what the client sent next may already be read into
+// OpenSSL
+struct KtlsTx {
+  // what our application data is encrypted from, in TLS 1.3
+  std::vector<unsigned char> secret;
+  // records sent since we started using the keys for application data,
+  // which is the sequence number the kernel carries on from
+  bool counting = false;
+  uint64_t records = 0;
+};
+
+int ktlsTxIndex() {
+  static int const index =
+      SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+KtlsTx* ktlsTxOf(SSL const* ssl) {
+  return static_cast<KtlsTx*>(SSL_get_ex_data(ssl, ktlsTxIndex()));
+}
+
+std::vector<unsigned char> fromHex(std::string_view hex) {
+  std::vector<unsigned char> ret;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    ret.push_back(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16));
+  }
+  return ret;
+}
+
+// lines in the NSS key log format, eg "SERVER_TRAFFIC_SECRET_0 <client
+// random> <secret>"
+void keylogCallback(SSL const* ssl, char const* line) {
+  auto* tx = ktlsTxOf(ssl);
+  std::string_view const prefix = "SERVER_TRAFFIC_SECRET_0 ";
+  std::string_view l(line);
+  if (!tx || l.substr(0, prefix.size()) != prefix) {
+    return;
+  }
+  // records from here on are sent with the application keys
+  tx->secret = fromHex(l.substr(l.rfind(' ') + 1));
+  tx->counting = true;
+  tx->records = 0;
+}
+
+void msgCallback(int write, int, int content_type, void const*, size_t,
+                 SSL* ssl, void*) {
+  auto* tx = ktlsTxOf(ssl);
+  if (!tx || !write) {
+    return;
+  }
+  if (content_type == SSL3_RT_HEADER) {
+    tx->records += tx->counting;
+  } else if (content_type == SSL3_RT_CHANGE_CIPHER_SPEC &&
+             SSL_version(ssl) <= TLS1_2_VERSION) {
+    // before TLS 1.3, everything after this is with the new keys
+    tx->counting = true;
+    tx->records = 0;
+  }
+}
+
+// the keys for sending from here on, if the kernel can use them
+std::optional<KtlsKeys> ktlsTxKeys(SSL* ssl, KtlsTx const& tx) {
+#ifdef ESLANG_KTLS
+  if (!tx.counting) {
+    return std::nullopt;
+  }
+  auto const* cipher = SSL_get_current_cipher(ssl);
+  if (!cipher) {
+    return std::nullopt;
+  }
+  KtlsKeys::Cipher kernel_cipher;
+  switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+  case NID_aes_128_gcm:
+    kernel_cipher = KtlsKeys::Cipher::Aes128Gcm;
+    break;
+  case NID_aes_256_gcm:
+    kernel_cipher = KtlsKeys::Cipher::Aes256Gcm;
+    break;
+  case NID_chacha20_poly1305:
+    kernel_cipher = KtlsKeys::Cipher::Chacha20Poly1305;
+    break;
+  default:
+    return std::nullopt;
+  }
+  auto const* md = SSL_CIPHER_get_handshake_digest(cipher);
+  if (SSL_version(ssl) == TLS1_3_VERSION) {
+    return KtlsKeys::fromTls13Secret(kernel_cipher, md, tx.secret,
+                                     tx.records);
+  }
+  if (SSL_version(ssl) == TLS1_2_VERSION) {
+    std::vector<unsigned char> master(SSL_MAX_MASTER_KEY_LENGTH);
+    master.resize(SSL_SESSION_get_master_key(SSL_get_session(ssl),
+                                             master.data(), master.size()));
+    std::vector<unsigned char> client_random(SSL3_RANDOM_SIZE);
+    std::vector<unsigned char> server_random(SSL3_RANDOM_SIZE);
+    SSL_get_client_random(ssl, client_random.data(), client_random.size());
+    SSL_get_server_random(ssl, server_random.data(), server_random.size());
+    auto keys = KtlsKeys::fromTls12Master(kernel_cipher, md, master,
+                                          client_random, server_random,
+                                          tx.records);
+    OPENSSL_cleanse(master.data(), master.size());
+    return keys;
+  }
+#endif
+  return std::nullopt;
+}
+
+#ifdef ESLANG_KTLS
+template <class T>
+bool setKtlsTx(int fd, int cipher_type, KtlsKeys const& keys) {
+  T info{};
+  info.info.version = keys.tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+  info.info.cipher_type = cipher_type;
+  std::memcpy(info.key, keys.key.data(), sizeof(info.key));
+  std::memcpy(info.iv, keys.iv.data(), sizeof(info.iv));
+  std::memcpy(info.rec_seq, keys.seq, sizeof(info.rec_seq));
+  if constexpr (sizeof(info.salt) > 0) {
+    std::memcpy(info.salt, keys.salt.data(), sizeof(info.salt));
+  }
+  return !setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+}
+#endif
+
+// hands encrypting what is sent on fd to the kernel. false if it cannot, in
+// which case OpenSSL carries on doing it
+bool installKtlsTx(int fd, KtlsKeys const& keys) {
+#ifdef ESLANG_KTLS
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"))) {
+    // no tls module, or not a tcp socket
+    return false;
+  }
+  switch (keys.cipher) {
+  case KtlsKeys::Cipher::Aes128Gcm:
+    return setKtlsTx<tls12_crypto_info_aes_gcm_128>(
+        fd, TLS_CIPHER_AES_GCM_128, keys);
+  case KtlsKeys::Cipher::Aes256Gcm:
+    return setKtlsTx<tls12_crypto_info_aes_gcm_256>(
+        fd, TLS_CIPHER_AES_GCM_256, keys);
+  case KtlsKeys::Cipher::Chacha20Poly1305:
+    return setKtlsTx<tls12_crypto_info_chacha20_poly1305>(
+        fd, TLS_CIPHER_CHACHA20_POLY1305, keys);
+  }
+#endif
+  return false;
+}
+
+std::shared_ptr<TlsState> configureTls(ssl::context& context,
+                                       Tcp::TlsOptions const& options) {
+  auto state = std::make_shared<TlsState>(options);
+  auto* native = context.native_handle();
+  if (options.sessionCacheSize) {
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(native, options.sessionCacheSize);
+    // sessions are only resumed into a context with the same id
+    static unsigned char const kSessionId[] = "eslang";
+    SSL_CTX_set_session_id_context(native, kSessionId,
+                                   sizeof(kSessionId) - 1);
+  } else {
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_OFF);
+  }
+  SSL_CTX_set_timeout(native, options.sessionTimeout.count());
+  if (options.tickets) {
+    SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(native, ticketKeyCallback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(native, ticketKeyCallback);
+#endif
+  } else {
+    SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+  }
+  for (auto const& protocol : options.alpn) {
+    if (protocol.empty() || protocol.size() > 255) {
+      ESLANGEXCEPT("Bad ALPN protocol '", protocol, "'");
+    }
+    state->alpn += char(protocol.size());
+    state->alpn += protocol;
+  }
+  if (state->alpn.size()) {
+    SSL_CTX_set_alpn_select_cb(native, alpnCallback, state.get());
+  }
+  if (options.ktls) {
+    SSL_CTX_set_keylog_callback(native, keylogCallback);
+    SSL_CTX_set_msg_callback(native, msgCallback);
+    // OpenSSL must not send anything once the kernel does
+    SSL_CTX_set_options(native, SSL_OP_NO_RENEGOTIATION);
+  }
+  SSL_CTX_set_ex_data(native, tlsStateIndex(), state.get());
+  return state;
+}
+} // namespace
+
 Tcp::ListenerOptions Tcp::ListenerOptions::withSslFiles(std::string ca,
                                                         std::string cert,
                                                         std::string key) const {
@@ -24,25 +382,62 @@ Tcp::ListenerOptions Tcp::ListenerOptions::withSslFiles(std::string ca,
   return r;
 }
 
+void Tcp::Fd::reset(int fd) {
+  if (fd_ >= 0) {
+#ifdef _WIN32
+    closesocket(fd_);
+#else
+    ::close(fd_);
+#endif
+  }
+  fd_ = fd;
+}
+
+namespace {
+// the most fds passed with one message
+size_t constexpr kMaxFds = 64;
+} // namespace
+
+// what Tcp::sendFdsThrottled sends
+struct FdMessage {
+  Buffer data;
+  std::vector<Tcp::Fd> fds;
+};
+
 struct SocketProcess : public Process {
   Slot<Buffer> send_data{this};
   Slot<BufferCollection> send_many_data{this};
+  Slot<FdMessage> send_fds{this};
   Slot<TSendAddress<Tcp::ReceiveData>> init{this};
   using Process::Process;
+
+  // only unix sockets pass fds
+  static constexpr bool kPassesFds = false;
+  std::vector<Tcp::Fd> takeFds() { return {}; }
 };
 
 struct SslSocketTraits : SocketProcess {
-  // sigh - boost ssl socket is non-movable :(
-  using Socket = std::unique_ptr<ssl::stream<ip::tcp::socket>>;
+  struct Socket {
+    // sigh - boost ssl socket is non-movable :(
+    std::unique_ptr<ssl::stream<ip::tcp::socket>> stream;
+    // the listener's, which its context's callbacks use
+    std::shared_ptr<TlsState> tls;
+  };
   SslSocketTraits(ProcessArgs i, Socket socket)
-      : SocketProcess(std::move(i)), socket_(std::move(socket)) {}
+      : SocketProcess(std::move(i)), socket_(std::move(socket)) {
+    if (socket_.tls->options.ktls) {
+      SSL_set_ex_data(socket_.stream->native_handle(), ktlsTxIndex(),
+                      &ktlsTx_);
+    }
+  }
 
-  ssl::stream<ip::tcp::socket>& socket() { return *socket_; }
+  ssl::stream<ip::tcp::socket>& socket() { return *socket_.stream; }
   auto toId() { return socket().native_handle(); }
 
   MethodTask<void> start() {
     EslangPromise p_;
     ESLOG(LL::TRACE, "Handshaking ", toId());
+    auto* stats = socket_.tls->options.stats.get();
     socket().async_handshake(
         boost::asio::ssl::stream_base::server,
         [&](const boost::system::error_code& error) {
@@ -51,15 +446,80 @@ struct SslSocketTraits : SocketProcess {
           }
           if (error) {
             ESLOG(LL::TRACE, "Handshaking threw ", toId());
+            if (stats) {
+              ++stats->failed;
+            }
             p_.setException(std::runtime_error(
                 concatString("SSL handshake threw ", error.message())));
             return;
           }
+          if (stats) {
+            ++stats->handshakes;
+            stats->resumed += SSL_session_reused(socket().native_handle());
+          }
+          if (socket_.tls->options.ktls) {
+            startKtls();
+            if (stats) {
+              stats->ktls += kernelTx_;
+            }
+          }
           p_.setIfUnset();
         });
     co_await WaitOnFuture(&p_);
   }
+
+  void startKtls() {
+    auto* native = socket().native_handle();
+    SSL_set_ex_data(native, ktlsTxIndex(), nullptr);
+    // OpenSSL may still have something to send
+    if (BIO_ctrl_pending(SSL_get_wbio(native))) {
+      return;
+    }
+    auto keys = ktlsTxKeys(native, ktlsTx_);
+    kernelTx_ =
+        keys && installKtlsTx(socket().next_layer().native_handle(), *keys);
+    if (keys) {
+      OPENSSL_cleanse(keys->key.data(), keys->key.size());
+    }
+    OPENSSL_cleanse(ktlsTx_.secret.data(), ktlsTx_.secret.size());
+    ESLOG(LL::TRACE, "Kernel TLS for ", toId(), ": ", kernelTx_);
+  }
+
+  template <class Handler> void asyncReadSome(mutable_buffer b, Handler&& h) {
+    socket().async_read_some(b, std::forward<Handler>(h));
+  }
+
+  // whether a read now would not have to wait
+  bool readable() {
+    boost::system::error_code ec;
+    return SSL_pending(socket().native_handle()) > 0 ||
+           socket().next_layer().available(ec) > 0;
+  }
+
+  template <class Handler>
+  void asyncWrite(std::vector<const_buffer> const& b, Handler&& h) {
+    if (kernelTx_) {
+      // the kernel encrypts it
+      async_write(socket().next_layer(), b, std::forward<Handler>(h));
+    } else if (b.size() == 1) {
+      async_write(socket(), b, std::forward<Handler>(h));
+    } else {
+      // the stream writes each buffer as its own records, so put them
+      // together first
+      gathered_.clear();
+      for (auto const& r : b) {
+        auto const* data = static_cast<unsigned char const*>(r.data());
+        gathered_.insert(gathered_.end(), data, data + r.size());
+      }
+      async_write(socket(), buffer(gathered_), std::forward<Handler>(h));
+    }
+  }
   ~SslSocketTraits() {
+    // OpenSSL drops sessions from the cache if they end without a
+    // close_notify from us, which we never send. Mark it as sent so the
+    // session can still be resumed
+    SSL_set_shutdown(socket().native_handle(),
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
     boost::system::error_code ec;
     socket().lowest_layer().cancel(ec);
     socket().lowest_layer().close(ec);
@@ -67,6 +527,11 @@ struct SslSocketTraits : SocketProcess {
 
 private:
   Socket socket_;
+  KtlsTx ktlsTx_;
+  // whether the kernel is encrypting what we send
+  bool kernelTx_ = false;
+  // what is being written, when it was sent in more than one buffer
+  std::vector<unsigned char> gathered_;
 };
 
 struct PlainSocketTraits : SocketProcess {
@@ -81,6 +546,20 @@ public:
 
   MethodTask<void> start() { co_return; }
 
+  template <class Handler> void asyncReadSome(mutable_buffer b, Handler&& h) {
+    socket_.async_read_some(b, std::forward<Handler>(h));
+  }
+
+  bool readable() {
+    boost::system::error_code ec;
+    return socket_.available(ec) > 0;
+  }
+
+  template <class Handler>
+  void asyncWrite(std::vector<const_buffer> const& b, Handler&& h) {
+    async_write(socket_, b, std::forward<Handler>(h));
+  }
+
   ~PlainSocketTraits() {
     boost::system::error_code ec;
     socket().cancel(ec);
@@ -91,6 +570,146 @@ private:
   Socket socket_;
 };
 
+#ifdef ESLANG_UNIX_SOCKETS
+struct UnixSocketTraits : SocketProcess {
+public:
+  using Socket = local::stream_protocol::socket;
+  static constexpr bool kPassesFds = true;
+
+  UnixSocketTraits(ProcessArgs i, Socket socket)
+      : SocketProcess(std::move(i)), socket_(std::move(socket)) {}
+
+  Socket& socket() { return socket_; }
+  auto toId() { return socket().native_handle(); }
+
+  MethodTask<void> start() { co_return; }
+
+  // through recvmsg, to pick up fds passed with the data
+  template <class Handler> void asyncReadSome(mutable_buffer b, Handler&& h) {
+    socket_.async_wait(
+        socket_base::wait_read,
+        [this, b, h = std::forward<Handler>(h)](
+            boost::system::error_code const& ec) mutable {
+          if (ec) {
+            h(ec, 0);
+            return;
+          }
+          iovec iov{b.data(), b.size()};
+          alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+          msghdr m{};
+          m.msg_iov = &iov;
+          m.msg_iovlen = 1;
+          m.msg_control = control;
+          m.msg_controllen = sizeof(control);
+          int flags = MSG_DONTWAIT;
+#ifdef MSG_CMSG_CLOEXEC
+          flags |= MSG_CMSG_CLOEXEC;
+#endif
+          auto const n = recvmsg(socket_.native_handle(), &m, flags);
+          if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+              asyncReadSome(b, std::move(h));
+            } else {
+              h(boost::system::error_code(errno,
+                                          boost::system::system_category()),
+                0);
+            }
+            return;
+          }
+          for (auto* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+              size_t const count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+              for (size_t i = 0; i < count; ++i) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(fd));
+                fds_.emplace_back(fd);
+              }
+            }
+          }
+          if (n == 0) {
+            h(boost::system::error_code(error::eof), 0);
+            return;
+          }
+          h(boost::system::error_code(), n);
+        });
+  }
+
+  std::vector<Tcp::Fd> takeFds() { return std::move(fds_); }
+
+  bool readable() {
+    boost::system::error_code ec;
+    return socket_.available(ec) > 0;
+  }
+
+  template <class Handler>
+  void asyncWrite(std::vector<const_buffer> const& b, Handler&& h) {
+    async_write(socket_, b, std::forward<Handler>(h));
+  }
+
+  // the fds go with the first part of b that the socket takes. They have to
+  // stay alive until h is called
+  template <class Handler>
+  void asyncWriteFds(const_buffer b, std::vector<Tcp::Fd> const& fds,
+                     Handler&& h) {
+    socket_.async_wait(
+        socket_base::wait_write,
+        [this, b, &fds, h = std::forward<Handler>(h)](
+            boost::system::error_code const& ec) mutable {
+          if (ec) {
+            h(ec, 0);
+            return;
+          }
+          iovec iov{const_cast<void*>(b.data()), b.size()};
+          std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+          msghdr m{};
+          m.msg_iov = &iov;
+          m.msg_iovlen = 1;
+          m.msg_control = control.data();
+          m.msg_controllen = control.size();
+          auto* c = CMSG_FIRSTHDR(&m);
+          c->cmsg_level = SOL_SOCKET;
+          c->cmsg_type = SCM_RIGHTS;
+          c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+          for (size_t i = 0; i < fds.size(); ++i) {
+            int const fd = fds[i].get();
+            std::memcpy(CMSG_DATA(c) + i * sizeof(int), &fd, sizeof(fd));
+          }
+          auto const n = sendmsg(socket_.native_handle(), &m,
+                                 MSG_DONTWAIT | MSG_NOSIGNAL);
+          if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+              asyncWriteFds(b, fds, std::move(h));
+            } else {
+              h(boost::system::error_code(errno,
+                                          boost::system::system_category()),
+                0);
+            }
+            return;
+          }
+          if (size_t(n) < b.size()) {
+            async_write(socket_, b + n,
+                        [n, h = std::move(h)](
+                            boost::system::error_code const& ec,
+                            size_t more) mutable { h(ec, n + more); });
+            return;
+          }
+          h(boost::system::error_code(), n);
+        });
+  }
+
+  ~UnixSocketTraits() {
+    boost::system::error_code ec;
+    socket().cancel(ec);
+    socket().close(ec);
+  }
+
+private:
+  Socket socket_;
+  // passed to us, to go with the next ReceiveData
+  std::vector<Tcp::Fd> fds_;
+};
+#endif
+
 template <class Traits> struct TSocketProcess : public Traits {
   bool eof_ = false;
 
@@ -101,6 +720,8 @@ template <class Traits> struct TSocketProcess : public Traits {
 
   TSendAddress<Tcp::Socket> onReady;
   Tcp::SocketOptions options_;
+  std::shared_ptr<Tcp::SocketStats> stats_ =
+      std::make_shared<Tcp::SocketStats>();
 
   TSocketProcess(ProcessArgs i, typename Traits::Socket socket,
                  TSendAddress<Tcp::Socket> onReady,
@@ -137,7 +758,11 @@ template <class Traits> struct TSocketProcess : public Traits {
   char readBuff[16000];
   std::optional<Tcp::ReceiveData> nextRead;
   void asyncRead() {
-    this->socket().async_read_some(
+    if (!options_.throttled && options_.receiveBatchBytes) {
+      asyncReadBatch();
+      return;
+    }
+    this->asyncReadSome(
         buffer(readBuff, sizeof(readBuff)),
         [this](const boost::system::error_code& error, std::size_t bytes) {
           if (error == error::operation_aborted) {
@@ -154,8 +779,11 @@ template <class Traits> struct TSocketProcess : public Traits {
             return;
           }
           if (bytes > 0) {
+            ++stats_->reads;
+            stats_->bytesRead += bytes;
             Tcp::ReceiveData rd(this->pid(),
                                 Buffer::makeCopy(&readBuff, bytes));
+            rd.fds = this->takeFds();
             if (options_.throttled) {
               nextRead = std::move(rd);
               p_.setIfUnset();
@@ -169,58 +797,221 @@ template <class Traits> struct TSocketProcess : public Traits {
         });
   }
 
+  // what has been gathered for the next ReceiveData, and how much that may
+  // be, between sizeof(readBuff) and options_.receiveBatchBytes
+  std::unique_ptr<unsigned char[]> batch_;
+  size_t batchFilled_ = 0;
+  size_t batchBudget_ = sizeof(readBuff);
+  void asyncReadBatch() {
+    if (!batch_) {
+      batch_.reset(new unsigned char[std::max(options_.receiveBatchBytes,
+                                              sizeof(readBuff))]);
+    }
+    this->asyncReadSome(
+        buffer(batch_.get() + batchFilled_, batchBudget_ - batchFilled_),
+        [this](const boost::system::error_code& error, std::size_t bytes) {
+          if (error == error::operation_aborted) {
+            return;
+          }
+          batchFilled_ += bytes;
+          stats_->reads += bytes > 0;
+          stats_->bytesRead += bytes;
+          if (error == error::eof) {
+            sendBatch();
+            eof_ = true;
+            ESLOG(LL::TRACE, this->pid(), ": EOF");
+            setValue();
+            return;
+          }
+          if (error) {
+            setError(error);
+            return;
+          }
+          if (batchFilled_ < batchBudget_ && this->readable()) {
+            asyncReadBatch();
+            return;
+          }
+          sendBatch();
+          asyncReadBatch();
+        });
+  }
+
+  void sendBatch() {
+    if (!batchFilled_) {
+      return;
+    }
+    // grow while there is more to read than fits, or the owner is behind
+    // (then fewer bigger messages are cheaper for it), and shrink back once
+    // it keeps up with less
+    if (batchFilled_ == batchBudget_ || this->c()->queued(*toSend)) {
+      batchBudget_ = std::min(batchBudget_ * 2, options_.receiveBatchBytes);
+    } else if (batchFilled_ < batchBudget_ / 2) {
+      batchBudget_ = std::max(batchBudget_ / 2, sizeof(readBuff));
+    }
+    Tcp::ReceiveData rd(this->pid(),
+                        Buffer::makeCopy(batch_.get(), batchFilled_));
+    rd.fds = this->takeFds();
+    batchFilled_ = 0;
+    this->send(*toSend, std::move(rd));
+  }
+
+  struct Queued {
+    Buffer data;
+    // passed along with data, over a unix socket
+    std::vector<Tcp::Fd> fds;
+  };
+  // sent to us and not yet written, with what is being written at the front
+  std::deque<Queued> queued_;
   bool isWriting = false;
-  void write(Buffer buff) {
+  // how many of queued_ are being written
+  size_t writing_ = 0;
+  std::vector<const_buffer> writingRanges_;
+
+  void queue(Buffer b) {
+    if (b.size()) {
+      stats_->queuedBytes += b.size();
+      queued_.push_back(Queued{std::move(b), {}});
+    }
+  }
+
+  void queue(BufferCollection c) {
+    for (auto& b : c.buffers) {
+      queue(std::move(b));
+    }
+  }
+
+  void queue(FdMessage m) {
+    if (!Traits::kPassesFds) {
+      setException(std::runtime_error("Cannot pass fds over this socket"));
+    } else if (m.fds.size() > kMaxFds) {
+      setException(std::runtime_error(
+          concatString("Cannot pass more than ", kMaxFds, " fds at once")));
+    } else {
+      stats_->queuedBytes += m.data.size();
+      queued_.push_back(Queued{std::move(m.data), std::move(m.fds)});
+    }
+  }
+
+  bool full() const { return stats_->queuedBytes >= options_.maxQueuedBytes; }
+
+  // everything queued goes in one write, up to the next that passes fds,
+  // which goes on its own
+  void write() {
     isWriting = true;
-    p_ = EslangPromise();
-    async_write(this->socket(), buffer(buff.data(), buff.size()),
-                [this](const boost::system::error_code& ec,
-                       std::size_t bytes_transferred) {
-                  if (ec == error::operation_aborted) {
-                    return;
-                  }
-                  isWriting = false;
-                  if (ec) {
-                    ESLOG(LL::TRACE, "Write error ", ec.message());
-                    setError(ec);
-                  } else {
-                    ESLOG(LL::TRACE, "Wrote ", bytes_transferred);
-                    setValue();
-                  }
-                });
+    auto onWritten = [this](const boost::system::error_code& ec,
+                            std::size_t bytes_transferred) {
+      written(ec, bytes_transferred);
+    };
+    if constexpr (Traits::kPassesFds) {
+      if (queued_.front().fds.size()) {
+        writing_ = 1;
+        this->asyncWriteFds(queued_.front().data.range(),
+                            queued_.front().fds, onWritten);
+        return;
+      }
+    }
+    writing_ = 0;
+    writingRanges_.clear();
+    for (auto const& q : queued_) {
+      if (q.fds.size()) {
+        break;
+      }
+      writingRanges_.push_back(q.data.range());
+      ++writing_;
+    }
+    this->asyncWrite(writingRanges_, onWritten);
+  }
+
+  void written(const boost::system::error_code& ec,
+               std::size_t bytes_transferred) {
+    if (ec == error::operation_aborted) {
+      return;
+    }
+    isWriting = false;
+    ++stats_->writes;
+    stats_->buffersWritten += writing_;
+    stats_->bytesWritten += bytes_transferred;
+    for (; writing_; --writing_) {
+      stats_->queuedBytes -= queued_.front().data.size();
+      queued_.pop_front();
+    }
+    if (ec) {
+      ESLOG(LL::TRACE, "Write error ", ec.message());
+      setError(ec);
+    } else {
+      ESLOG(LL::TRACE, "Wrote ", bytes_transferred);
+      setValue();
+    }
+  }
+
+  template <class TReceived> void takeSent(TReceived ret) {
+    checkExcept();
+    if (std::get<0>(ret)) {
+      queue(std::move(*std::get<0>(ret)));
+    }
+    if (std::get<1>(ret)) {
+      queue(std::move(*std::get<1>(ret)));
+    }
+    if (std::get<2>(ret)) {
+      queue(std::move(*std::get<2>(ret)));
+    }
+    // and anything else already sent, to go in the same write
+    while (!full() && !this->send_data.queue()->empty()) {
+      queue(this->send_data.queue()->pop().val());
+    }
+    while (!full() && !this->send_many_data.queue()->empty()) {
+      queue(this->send_many_data.queue()->pop().val());
+    }
+    while (!full() && !this->send_fds.queue()->empty()) {
+      queue(std::move(this->send_fds.queue()->pop().val()));
+    }
+    checkExcept();
   }
 
   ProcessTask run() {
     // init the socket
     co_await this->start();
     // tell our owner about us
-    this->send(onReady, Tcp::Socket(this->pid()));
+    Tcp::Socket ready(this->pid());
+    ready.stats = stats_;
+    ready.sendData = this->send_data.address();
+    ready.sendManyData = this->send_many_data.address();
+    ready.init = this->init.address();
+    this->send(onReady, std::move(ready));
 
     // now can process
     toSend = co_await this->recv(this->init);
     asyncRead();
     while (!eof_) {
+      // a read waits for room with the owner, but we keep writing what it
+      // sends meanwhile, as it may be waiting on that before it reads more
+      EslangPromise* owner_full = nullptr;
       if (nextRead) {
-        co_await this->sendThrottled(*toSend, std::move(*nextRead));
-        nextRead.reset();
-        asyncRead();
+        owner_full = this->c()->canQueue(*toSend);
+        if (!owner_full) {
+          this->send(*toSend, std::move(*nextRead));
+          nextRead.reset();
+          asyncRead();
+        }
       }
-      if (isWriting) {
-        // don't get a message to write until we are done with writing the last
-        // one
-        co_await WaitOnFuture(&p_);
+      if (owner_full && !isWriting) {
+        auto ret = co_await makeWithWaitingFuture(
+            owner_full, this->tryRecv(this->send_data, this->send_many_data,
+                                      this->send_fds));
+        takeSent(std::move(ret));
+      } else if (full()) {
+        // leave what else is sent in the slots, which throttles the senders,
+        // until the write finishes
+        co_await WaitingFuture(&p_);
         checkExcept();
       } else {
         auto ret = co_await makeWithWaitingFuture(
-            &p_, this->tryRecv(this->send_data, this->send_many_data));
-        checkExcept();
-        if (std::get<0>(ret)) {
-          write(std::get<0>(ret).value());
-        } else if (std::get<1>(ret)) {
-          // windows doesn't do chains well unfortunately, one day we should use
-          // the chaining
-          write(std::get<1>(ret).value().combine());
-        }
+            &p_, this->tryRecv(this->send_data, this->send_many_data,
+                               this->send_fds));
+        takeSent(std::move(ret));
+      }
+      if (!isWriting && queued_.size()) {
+        write();
       }
     }
   }
@@ -232,12 +1023,14 @@ struct ListenerProcess : public Process {
   EslangPromise error_;
   ip::tcp const protocol = ip::tcp::v4();
   std::shared_ptr<ssl::context> sslContext;
+  std::shared_ptr<TlsState> tls;
   ListenerProcess(ProcessArgs i, TSendAddress<Tcp::Socket> new_socket_address,
                   Tcp::ListenerOptions options)
       : Process(std::move(i)), newSocket(std::move(new_socket_address)),
         options(options) {
     if (options.sslContextFactory) {
       sslContext = (*options.sslContextFactory)(c_->ioService());
+      tls = configureTls(*sslContext, options.tls);
     }
   }
 
@@ -265,12 +1058,19 @@ struct ListenerProcess : public Process {
             ip::tcp::no_delay option(true);
             next.set_option(option);
 
-            if (sslContext) {
+            if (options.acceptFds) {
+              boost::system::error_code release_error;
+              Tcp::Fd fd(next.release(release_error));
+              if (!release_error) {
+                send(*options.acceptFds, std::move(fd));
+              }
+            } else if (sslContext) {
               auto ssl = std::make_unique<ssl::stream<ip::tcp::socket>>(
                   c_->ioService(), *sslContext);
               ssl->lowest_layer() = std::move(next);
               addKillOnDie(spawn<TSocketProcess<SslSocketTraits>>(
-                  std::move(ssl), newSocket, options));
+                  SslSocketTraits::Socket{std::move(ssl), tls}, newSocket,
+                  options));
             } else {
               addKillOnDie(spawn<TSocketProcess<PlainSocketTraits>>(
                   std::move(next), newSocket, options));
@@ -293,42 +1093,247 @@ struct ListenerProcess : public Process {
   }
 };
 
+#ifdef ESLANG_UNIX_SOCKETS
+struct UnixListenerProcess : public Process {
+  TSendAddress<Tcp::Socket> newSocket;
+  Tcp::UnixListenerOptions options;
+  EslangPromise error_;
+  bool bound_ = false;
+  UnixListenerProcess(ProcessArgs i,
+                      TSendAddress<Tcp::Socket> new_socket_address,
+                      Tcp::UnixListenerOptions options)
+      : Process(std::move(i)), newSocket(std::move(new_socket_address)),
+        options(std::move(options)) {}
+
+  ~UnixListenerProcess() {
+    if (bound_) {
+      ::unlink(options.path.c_str());
+    }
+  }
+
+  local::stream_protocol::socket next{c_->ioService()};
+  void asyncAccept(local::stream_protocol::acceptor& socket) {
+    socket.async_accept(
+        next, [this, &socket](const boost::system::error_code& ec) {
+          if (ec == error::operation_aborted) {
+            return;
+          }
+          if (ec) {
+            error_.setException(std::runtime_error(
+                concatString("Listener threw ", ec.message())));
+            return;
+          }
+          addKillOnDie(spawn<TSocketProcess<UnixSocketTraits>>(
+              std::move(next), newSocket, options));
+          next = local::stream_protocol::socket(c_->ioService());
+          asyncAccept(socket);
+        });
+  }
+
+  ProcessTask run() {
+    local::stream_protocol::acceptor socket(c_->ioService());
+    ESLOG(LL::INFO, "Bind to ", options.path);
+    // a socket left behind (eg by a process that crashed) would fail the bind
+    struct stat st;
+    if (::stat(options.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+      ::unlink(options.path.c_str());
+    }
+    socket.open(local::stream_protocol());
+    socket.bind(local::stream_protocol::endpoint(options.path));
+    bound_ = true;
+    socket.listen(10000);
+    asyncAccept(socket);
+    co_await WaitOnFuture(&error_);
+  }
+};
+#endif
+
 Pid Tcp::makeListener(Process* parent, TSendAddress<Socket> new_socket_address,
                       Tcp::ListenerOptions options) {
   return parent->spawnLink<ListenerProcess>(std::move(new_socket_address),
                                             options);
 }
 
-void Tcp::initRecvSocket(Process* sender, Socket socket,
+MethodTask<Tcp::Socket> Tcp::connect(Process* parent,
+                                     ConnectOptions options) {
+  auto& io_service = parent->c()->ioService();
+  ip::tcp::resolver resolver(io_service);
+  ip::tcp::socket socket(io_service);
+  EslangPromise p;
+  boost::system::error_code error;
+  ESLOG(LL::DEBUG, "Connect to ", options.host, ":", options.port);
+  resolver.async_resolve(
+      options.host, std::to_string(options.port),
+      [&](const boost::system::error_code& ec,
+          ip::tcp::resolver::results_type results) {
+        if (ec == error::operation_aborted) {
+          return;
+        }
+        if (ec) {
+          error = ec;
+          p.setIfUnset();
+          return;
+        }
+        async_connect(socket, results,
+                      [&](const boost::system::error_code& ec,
+                          ip::tcp::endpoint const&) {
+                        if (ec == error::operation_aborted) {
+                          return;
+                        }
+                        error = ec;
+                        p.setIfUnset();
+                      });
+      });
+  co_await WaitOnFuture(&p);
+  if (error) {
+    ESLANGEXCEPT("Connect to ", options.host, ":", options.port, " failed ",
+                 error.message());
+  }
+  socket.set_option(ip::tcp::no_delay(true));
+
+  Slot<Socket> ready{parent};
+  auto const& socket_options = static_cast<SocketOptions const&>(options);
+  auto pid = options.notifyOnClose
+                 ? parent->spawnNotify<TSocketProcess<PlainSocketTraits>>(
+                       *options.notifyOnClose, std::move(socket),
+                       ready.address(), socket_options)
+                 : parent->spawn<TSocketProcess<PlainSocketTraits>>(
+                       std::move(socket), ready.address(), socket_options);
+  parent->addKillOnDie(pid);
+  co_return co_await parent->recv(ready);
+}
+
+Pid Tcp::makeUnixListener(Process* parent,
+                          TSendAddress<Socket> new_socket_address,
+                          UnixListenerOptions options) {
+#ifdef ESLANG_UNIX_SOCKETS
+  return parent->spawnLink<UnixListenerProcess>(std::move(new_socket_address),
+                                                std::move(options));
+#else
+  ESLANGEXCEPT("No unix sockets here");
+#endif
+}
+
+MethodTask<Tcp::Socket> Tcp::connectUnix(Process* parent,
+                                         UnixConnectOptions options) {
+#ifdef ESLANG_UNIX_SOCKETS
+  local::stream_protocol::socket socket(parent->c()->ioService());
+  EslangPromise p;
+  boost::system::error_code error;
+  ESLOG(LL::DEBUG, "Connect to ", options.path);
+  socket.async_connect(local::stream_protocol::endpoint(options.path),
+                       [&](const boost::system::error_code& ec) {
+                         if (ec == error::operation_aborted) {
+                           return;
+                         }
+                         error = ec;
+                         p.setIfUnset();
+                       });
+  co_await WaitOnFuture(&p);
+  if (error) {
+    ESLANGEXCEPT("Connect to ", options.path, " failed ", error.message());
+  }
+
+  Slot<Socket> ready{parent};
+  auto const& socket_options = static_cast<SocketOptions const&>(options);
+  auto pid = options.notifyOnClose
+                 ? parent->spawnNotify<TSocketProcess<UnixSocketTraits>>(
+                       *options.notifyOnClose, std::move(socket),
+                       ready.address(), socket_options)
+                 : parent->spawn<TSocketProcess<UnixSocketTraits>>(
+                       std::move(socket), ready.address(), socket_options);
+  parent->addKillOnDie(pid);
+  co_return co_await parent->recv(ready);
+#else
+  ESLANGEXCEPT("No unix sockets here");
+#endif
+}
+
+MethodTask<Tcp::Socket> Tcp::adopt(Process* parent, Fd fd,
+                                   SocketOptions options) {
+#ifdef ESLANG_UNIX_SOCKETS
+  sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  if (!fd || ::getsockname(fd.get(), reinterpret_cast<sockaddr*>(&addr),
+                           &len) != 0) {
+    ESLANGEXCEPT("Cannot adopt fd ", fd.get(), ": ", std::strerror(errno));
+  }
+  auto& io_service = parent->c()->ioService();
+  Slot<Socket> ready{parent};
+  auto spawn = [&]() {
+    if (addr.ss_family == AF_UNIX) {
+      local::stream_protocol::socket socket(io_service);
+      socket.assign(local::stream_protocol(), fd.release());
+      return parent->spawn<TSocketProcess<UnixSocketTraits>>(
+          std::move(socket), ready.address(), options);
+    }
+    ip::tcp::socket socket(io_service);
+    socket.assign(addr.ss_family == AF_INET6 ? ip::tcp::v6() : ip::tcp::v4(),
+                  fd.release());
+    return parent->spawn<TSocketProcess<PlainSocketTraits>>(
+        std::move(socket), ready.address(), options);
+  };
+  parent->addKillOnDie(spawn());
+  co_return co_await parent->recv(ready);
+#else
+  ESLANGEXCEPT("Cannot adopt fds here");
+#endif
+}
+
+void Tcp::initRecvSocket(Process* sender, Socket const& socket,
                          TSendAddress<ReceiveData> new_socket_address) {
   ESLOG(LL::DEBUG, "Init ", socket.pid);
-  sender->send(sender->makeSendAddress(socket.pid, &SocketProcess::init),
+  sender->send(socket.init ? *socket.init
+                           : sender->makeSendAddress(socket.pid,
+                                                     &SocketProcess::init),
                std::move(new_socket_address));
 }
 
-MethodTask<> Tcp::sendThrottled(Process* sender, Socket socket, Buffer data) {
-  return sender->sendThrottled(
-      sender->makeSendAddress(socket.pid, &SocketProcess::send_data),
-      std::move(data));
+namespace {
+TSendAddress<Buffer> sendDataAddress(Process* sender,
+                                     Tcp::Socket const& socket) {
+  return socket.sendData ? *socket.sendData
+                         : sender->makeSendAddress(socket.pid,
+                                                   &SocketProcess::send_data);
+}
+
+TSendAddress<BufferCollection> sendManyAddress(Process* sender,
+                                               Tcp::Socket const& socket) {
+  return socket.sendManyData
+             ? *socket.sendManyData
+             : sender->makeSendAddress(socket.pid,
+                                       &SocketProcess::send_many_data);
+}
+} // namespace
+
+MethodTask<> Tcp::sendThrottled(Process* sender, Socket const& socket,
+                                Buffer data) {
+  return sender->sendThrottled(sendDataAddress(sender, socket),
+                               std::move(data));
 }
 
-MethodTask<> Tcp::sendManyThrottled(Process* sender, Socket socket,
+MethodTask<> Tcp::sendManyThrottled(Process* sender, Socket const& socket,
                                     BufferCollection buffs) {
+  return sender->sendThrottled(sendManyAddress(sender, socket),
+                               std::move(buffs));
+}
+
+MethodTask<> Tcp::sendFdsThrottled(Process* sender, Socket const& socket,
+                                   Buffer data, std::vector<Fd> fds) {
+  if (!data.size()) {
+    ESLANGEXCEPT("Fds have to be sent with some data");
+  }
   return sender->sendThrottled(
-      sender->makeSendAddress(socket.pid, &SocketProcess::send_many_data),
-      std::move(buffs));
+      sender->makeSendAddress(socket.pid, &SocketProcess::send_fds),
+      FdMessage{std::move(data), std::move(fds)});
 }
 
-WaitingMaybe Tcp::send(Process* sender, Socket socket, Buffer data) {
-  return sender->send(
-      sender->makeSendAddress(socket.pid, &SocketProcess::send_data),
-      std::move(data));
+WaitingMaybe Tcp::send(Process* sender, Socket const& socket, Buffer data) {
+  return sender->send(sendDataAddress(sender, socket), std::move(data));
 }
 
-WaitingMaybe Tcp::sendMany(Process* sender, Socket socket,
+WaitingMaybe Tcp::sendMany(Process* sender, Socket const& socket,
                            BufferCollection data) {
-  return sender->send(
-      sender->makeSendAddress(socket.pid, &SocketProcess::send_many_data),
-      std::move(data));
+  return sender->send(sendManyAddress(sender, socket), std::move(data));
 }
 }
@@ -1,95 +1,114 @@
-#include <boost/intrusive_ptr.hpp>
+#pragma once
 #include <eslang/BaseTypes.h>
+#include <eslang/Buffer.h>
 #include <eslang/Context.h>
-#include <numeric>
 
 #include <boost/asio/ssl/context.hpp>
 
 namespace s {
 
-class Buffer {
+class Tcp {
 public:
-  unsigned char* data() const { return buffer_->data() + offset_; }
-  size_t size() const { return length_; }
-  boost::asio::const_buffer range() const {
-    return boost::asio::const_buffer{data(), size()};
-  }
-  static Buffer makeCopy(void const* data, size_t len) {
-    BuffIP b(new Buff(data, len));
-    return Buffer(b);
-  }
-  static Buffer makeCopy(std::string const& s) {
-    return makeCopy(s.data(), s.size());
-  }
-  static Buffer make(std::vector<unsigned char> data) {
-    BuffIP b(new Buff(std::move(data)));
-    return Buffer(b);
-  }
-  void consume(size_t n) {
-    assert(length_ >= n);
-    length_ -= n;
-    offset_ += n;
-  }
-  void append(Buffer const& b) {
-    buffer_->append(b.data(), b.size());
-    length_ += b.size();
-  }
-  Buffer() = delete;
+  struct SocketOptions {
+    bool throttled = true;
+    // when not throttled, gather what is readable into one ReceiveData of up
+    // to this many bytes rather than sending each read on its own. How much
+    // is gathered adapts to the owner: more while it has earlier ones still
+    // to take, less when it keeps up. 0 sends each read
+    size_t receiveBatchBytes = 0;
+    // the most the socket takes from its send slots ahead of writing it.
+    // Past this it leaves them in the slots, so sendThrottled waits
+    size_t maxQueuedBytes = 1024 * 1024;
+  };
 
-private:
-  class Buff {
-  public:
-    unsigned char const* data() const { return data_.data(); }
-    unsigned char* data() { return data_.data(); }
-    size_t size() const { return data_.size(); }
-    size_t capacity() const { return data_.capacity(); }
-    void append(void* data, size_t len) {}
-    void reserve(size_t n) { data_.reserve(n); }
-    friend void intrusive_ptr_add_ref(Buff* p) { ++p->refs_; }
-    friend void intrusive_ptr_release(Buff* p) {
-      if (--p->refs_ == 0)
-        delete p;
-    }
-    Buff(void const* data, size_t len)
-        : data_(static_cast<unsigned char const*>(data),
-                static_cast<unsigned char const*>(data) + len) {}
-    Buff(std::vector<unsigned char> data) : data_(std::move(data)) {}
+  // kept by a socket as it goes
+  struct SocketStats {
+    uint64_t bytesRead = 0;
+    uint64_t reads = 0;
+    uint64_t bytesWritten = 0;
+    // each write gathers all the buffers sent to the socket since the last
+    // one started
+    uint64_t writes = 0;
+    uint64_t buffersWritten = 0;
+    // sent to the socket but not yet written
+    size_t queuedBytes = 0;
+  };
 
-  private:
-    std::vector<unsigned char> data_;
-    uint32_t refs_ = 0;
+  // counted by a listener's TLS sockets as their handshakes finish
+  struct TlsStats {
+    uint64_t handshakes = 0;
+    // handshakes that resumed an earlier session (from the cache or a
+    // ticket) rather than doing the full key exchange
+    uint64_t resumed = 0;
+    uint64_t failed = 0;
+    uint64_t ticketKeyRotations = 0;
+    // handshakes after which the kernel took over encrypting what we send
+    uint64_t ktls = 0;
   };
-  using BuffIP = boost::intrusive_ptr<Buff>;
-  Buffer(BuffIP b) : buffer_(std::move(b)), length_(buffer_->size()) {}
-  BuffIP buffer_;
-  size_t offset_ = 0;
-  size_t length_ = 0;
-};
 
-struct BufferCollection {
-  std::vector<Buffer> buffers;
-  Buffer combine() const {
-    size_t len = std::accumulate(
-        buffers.begin(), buffers.end(), size_t(0),
-        [](size_t acc, Buffer const& b) -> size_t { return acc + b.size(); });
-    std::vector<unsigned char> v;
-    v.reserve(len);
-    std::for_each(buffers.begin(), buffers.end(), [&](Buffer const& b) {
-      v.insert(v.end(), b.data(), b.data() + b.size());
-    });
-    return Buffer::make(std::move(v));
-  }
-};
+  // how a listener's TLS sessions are resumed, applied on top of whatever
+  // sslContextFactory builds
+  struct TlsOptions {
+    // sessions kept for clients resuming by session id. 0 turns it off
+    size_t sessionCacheSize = 20 * 1024;
+    std::chrono::seconds sessionTimeout{2 * 60 * 60};
+    // stateless resumption, where the session is sent to the client
+    // encrypted with a key only we know
+    bool tickets = true;
+    // how long a key encrypts new tickets. It decrypts them for
+    // sessionTimeout more, and tickets it made are renewed with the newer key
+    std::chrono::seconds ticketKeyLifetime{60 * 60};
+    // protocols offered through ALPN, most preferred first, eg "http/1.1".
+    // Clients offering none of them carry on without ALPN
+    std::vector<std::string> alpn;
+    // on Linux with the tls module loaded, hand encrypting what we send to
+    // the kernel once the handshake is done, saving a copy through OpenSSL.
+    // Receiving stays in OpenSSL. Where the kernel cannot (or for other
+    // ciphers than AES-GCM and ChaCha20-Poly1305) OpenSSL carries on as
+    // before. Once the kernel is sending, OpenSSL never sends again:
+    // renegotiation is refused, a TLS 1.3 KeyUpdate asking us to update our
+    // keys goes unanswered (so a peer insisting on it will give up on the
+    // connection), and an alert OpenSSL sends about something the peer sent
+    // is encrypted with a sequence number the kernel has moved past, so the
+    // peer sees a bad record rather than the alert
+    bool ktls = false;
+    std::shared_ptr<TlsStats> stats;
+  };
 
-class Tcp {
-public:
-  struct SocketOptions {
-    bool throttled = true;
+  // a file descriptor we own, closed when this goes
+  class Fd {
+  public:
+    Fd() = default;
+    explicit Fd(int fd) : fd_(fd) {}
+    Fd(Fd&& rhs) : fd_(rhs.release()) {}
+    Fd& operator=(Fd&& rhs) {
+      reset(rhs.release());
+      return *this;
+    }
+    Fd(Fd const&) = delete;
+    Fd& operator=(Fd const&) = delete;
+    ~Fd() { reset(); }
+    int get() const { return fd_; }
+    explicit operator bool() const { return fd_ >= 0; }
+    int release() {
+      int ret = fd_;
+      fd_ = -1;
+      return ret;
+    }
+    void reset(int fd = -1);
+
+  private:
+    int fd_ = -1;
   };
 
   struct ListenerOptions : SocketOptions {
     explicit ListenerOptions(uint32_t port) : port(port) {}
     uint32_t port;
+    TlsOptions tls;
+    // send accepted connections here as they are, rather than making
+    // sockets of them, eg to pass them to another process with sendFds.
+    // Not with TLS
+    std::optional<TSendAddress<Fd>> acceptFds;
     struct SslFiles {
       std::string ca;
       std::string cert;
@@ -101,30 +120,82 @@ public:
     ListenerOptions withSslFiles(std::string ca, std::string cert,
                                  std::string key) const;
   };
+  struct ConnectOptions : SocketOptions {
+    ConnectOptions(std::string host, uint32_t port)
+        : host(std::move(host)), port(port) {}
+    std::string host;
+    uint32_t port;
+    // sent the socket's pid once it has closed (eg the other end hung up)
+    std::optional<TSendAddress<Pid>> notifyOnClose;
+  };
+  // unix domain stream sockets, which are the same Sockets once made
+  struct UnixListenerOptions : SocketOptions {
+    explicit UnixListenerOptions(std::string path) : path(std::move(path)) {}
+    // replaced if there is a socket there already, and removed when the
+    // listener dies
+    std::string path;
+  };
+  struct UnixConnectOptions : SocketOptions {
+    explicit UnixConnectOptions(std::string path) : path(std::move(path)) {}
+    std::string path;
+    // sent the socket's pid once it has closed (eg the other end hung up)
+    std::optional<TSendAddress<Pid>> notifyOnClose;
+  };
+  struct ReceiveData;
   struct Socket {
     explicit Socket(Pid p) : pid(std::move(p)) {}
     Pid pid;
+    // the socket's, to look at. Stays valid after the socket dies
+    std::shared_ptr<SocketStats const> stats;
+    // the socket's slots, set by the socket so that sending to it does not
+    // look them up each time. Left unset they are looked up
+    std::optional<TSendAddress<Buffer>> sendData;
+    std::optional<TSendAddress<BufferCollection>> sendManyData;
+    std::optional<TSendAddress<TSendAddress<ReceiveData>>> init;
   };
   struct ReceiveData {
     explicit ReceiveData(Pid p, Buffer data)
         : sender(p), data(std::move(data)) {}
     Pid sender;
     Buffer data;
+    // passed over a unix socket, with the start of data
+    std::vector<Fd> fds;
   };
   static Pid makeListener(Process* parent,
                           TSendAddress<Socket> new_socket_address,
                           ListenerOptions options);
+  static Pid makeUnixListener(Process* parent,
+                              TSendAddress<Socket> new_socket_address,
+                              UnixListenerOptions options);
+
+  // connect to a remote host. The socket process is killed when parent dies.
+  // throws if the connection fails
+  static MethodTask<Socket> connect(Process* parent, ConnectOptions options);
+  static MethodTask<Socket> connectUnix(Process* parent,
+                                        UnixConnectOptions options);
+
+  // makes a socket of a connected tcp or unix socket, eg one passed from
+  // another process. The socket process is killed when parent dies
+  static MethodTask<Socket> adopt(Process* parent, Fd fd,
+                                  SocketOptions options);
 
-  static void initRecvSocket(Process* sender, Socket socket,
+  static void initRecvSocket(Process* sender, Socket const& socket,
                              TSendAddress<ReceiveData> new_socket_address);
 
-  static MethodTask<> sendThrottled(Process* sender, Socket socket,
+  static MethodTask<> sendThrottled(Process* sender, Socket const& socket,
                                     Buffer data);
-  static MethodTask<> sendManyThrottled(Process* sender, Socket socket,
+  static MethodTask<> sendManyThrottled(Process* sender,
+                                        Socket const& socket,
                                         BufferCollection buffs);
-  static WaitingMaybe send(Process* sender, Socket socket, Buffer data);
-  static WaitingMaybe sendMany(Process* sender, Socket socket,
+  static WaitingMaybe send(Process* sender, Socket const& socket,
+                           Buffer data);
+  static WaitingMaybe sendMany(Process* sender, Socket const& socket,
                                BufferCollection buffs);
+  // passes fds over a unix socket along with data, which cannot be empty.
+  // Other sockets die of it
+  static MethodTask<> sendFdsThrottled(Process* sender,
+                                       Socket const& socket, Buffer data,
+                                       std::vector<Fd> fds);
 };
 
 struct StreamBatcher : NonMovable {
@@ -0,0 +1,576 @@
+#include "Udp.h"
+#include <boost/asio.hpp>
+#include <cstring>
+#include <deque>
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+#include <eslang/Logging.h>
+
+namespace s {
+
+using namespace boost::asio;
+
+namespace {
+// what the kernel takes in one GSO send
+size_t constexpr kMaxGsoSegments = 64;
+size_t constexpr kMaxGsoBytes = 65000;
+// what a GRO read can be
+size_t constexpr kMaxGroBytes = 65535;
+// system calls made each time the socket is ready, so that one busy socket
+// does not keep others from their turn
+int constexpr kMaxReadsPerWake = 16;
+int constexpr kMaxWritesPerWake = 16;
+
+bool wouldBlock(int err) {
+  return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+}
+
+// errors sending a GSO run that mean the kernel (or the device the route goes
+// through) cannot segment it, rather than that the run could not go this
+// time (eg ENOBUFS) or to this peer (eg ECONNREFUSED or EHOSTUNREACH)
+bool gsoUnsupported(int err) {
+  return err == EIO || err == EINVAL || err == EOPNOTSUPP;
+}
+} // namespace
+
+struct UdpSocketProcess : public Process {
+  Slot<Udp::Datagram> send_data{this};
+  Slot<std::vector<Udp::Datagram>> send_many_data{this};
+  Slot<TSendAddress<Udp::ReceiveData>> init{this};
+
+  UdpSocketProcess(ProcessArgs i, ip::udp::socket socket,
+                   Udp::SocketOptions const& options,
+                   std::shared_ptr<Udp::SocketStats> stats)
+      : Process(std::move(i)), socket_(std::move(socket)), options_(options),
+        stats_(std::move(stats)),
+        readSize_(options_.gro ? kMaxGroBytes : options_.maxDatagram),
+        slab_(std::max<size_t>(options_.batch, 1) * readSize_) {
+    options_.batch = std::max<size_t>(options_.batch, 1);
+#ifdef __linux__
+    reads_.resize(options_.batch);
+#endif
+  }
+
+  ~UdpSocketProcess() {
+    boost::system::error_code ec;
+    socket_.cancel(ec);
+    socket_.close(ec);
+  }
+
+  EslangPromise p_;
+  std::optional<ExceptionWrapper> except_;
+
+  void checkExcept() {
+    if (except_) {
+      except_->maybeThrowException();
+    }
+  }
+
+  void setValue() { p_.setIfUnset(); }
+
+  void setError(boost::system::error_code const& ec) {
+    setValue();
+    if (!except_) {
+      except_ = ExceptionWrapper::make(
+          std::runtime_error(concatString("Udp socket threw ", ec.message())));
+    }
+  }
+
+  std::optional<TSendAddress<Udp::ReceiveData>> toSend;
+  std::optional<Udp::ReceiveData> nextRead;
+
+  void asyncRead() {
+    socket_.async_wait(socket_base::wait_read,
+                       [this](boost::system::error_code const& ec) {
+                         if (ec == error::operation_aborted) {
+                           return;
+                         }
+                         if (ec) {
+                           setError(ec);
+                           return;
+                         }
+                         onReadable();
+                       });
+  }
+
+  void onReadable() {
+    auto rd = readBatch();
+    if (!rd) {
+      if (!except_) {
+        asyncRead();
+      }
+      return;
+    }
+    if (options_.throttled) {
+      nextRead = std::move(rd);
+      setValue();
+      return;
+    }
+    // read on while there is more
+    for (int i = 0; rd && i < kMaxReadsPerWake; ++i) {
+      this->send(*toSend, std::move(*rd));
+      rd = readBatch();
+    }
+    if (rd) {
+      this->send(*toSend, std::move(*rd));
+    }
+    if (!except_) {
+      asyncRead();
+    }
+  }
+
+  // a datagram (or a GRO run of them) in slab_
+  struct Read {
+    Udp::Endpoint peer;
+    unsigned char const* data;
+    size_t size;
+    // the size of each datagram in data, if GRO put several together
+    size_t segment;
+  };
+
+  // copies what was read into slab_ into one buffer the datagrams share,
+  // splitting up any that GRO put together
+  std::optional<Udp::ReceiveData>
+  toReceiveData(std::vector<Read> const& reads) {
+    if (reads.empty()) {
+      return std::nullopt;
+    }
+    std::vector<unsigned char> all;
+    for (auto const& r : reads) {
+      all.insert(all.end(), r.data, r.data + r.size);
+    }
+    auto const whole = Buffer::make(std::move(all));
+    std::vector<Udp::Datagram> datagrams;
+    datagrams.reserve(reads.size());
+    size_t offset = 0;
+    for (auto const& r : reads) {
+      size_t const segment = r.segment ? r.segment : r.size;
+      for (size_t at = 0; at < r.size; at += segment) {
+        datagrams.emplace_back(
+            r.peer, whole.slice(offset + at, std::min(segment, r.size - at)));
+      }
+      offset += r.size;
+      stats_->bytesRead += r.size;
+    }
+    stats_->datagramsRead += datagrams.size();
+    ++stats_->reads;
+    return Udp::ReceiveData(this->pid(), std::move(datagrams));
+  }
+
+#ifdef __linux__
+  struct ReadSlot {
+    sockaddr_storage addr;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    iovec iov;
+  };
+  std::vector<ReadSlot> reads_;
+  std::vector<mmsghdr> readHeaders_;
+
+  std::optional<Udp::ReceiveData> readBatch() {
+    readHeaders_.assign(options_.batch, mmsghdr{});
+    for (size_t i = 0; i < options_.batch; ++i) {
+      auto& slot = reads_[i];
+      slot.iov = {slab_.data() + i * readSize_, readSize_};
+      auto& h = readHeaders_[i].msg_hdr;
+      h.msg_name = &slot.addr;
+      h.msg_namelen = sizeof(slot.addr);
+      h.msg_iov = &slot.iov;
+      h.msg_iovlen = 1;
+      h.msg_control = slot.control;
+      h.msg_controllen = sizeof(slot.control);
+    }
+    int const got = recvmmsg(socket_.native_handle(), readHeaders_.data(),
+                             options_.batch, MSG_DONTWAIT, nullptr);
+    if (got < 0) {
+      if (!wouldBlock(errno)) {
+        setError(boost::system::error_code(errno,
+                                           boost::system::system_category()));
+      }
+      return std::nullopt;
+    }
+    std::vector<Read> reads;
+    for (int i = 0; i < got; ++i) {
+      auto& h = readHeaders_[i].msg_hdr;
+      Read r{{}, slab_.data() + i * readSize_, readHeaders_[i].msg_len, 0};
+      std::memcpy(r.peer.data(), h.msg_name, h.msg_namelen);
+      r.peer.resize(h.msg_namelen);
+      for (auto* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)) {
+        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+          int segment;
+          std::memcpy(&segment, CMSG_DATA(c), sizeof(segment));
+          r.segment = segment;
+        }
+      }
+      reads.push_back(r);
+    }
+    return toReceiveData(reads);
+  }
+#else
+  std::optional<Udp::ReceiveData> readBatch() {
+    std::vector<Read> reads;
+    for (size_t i = 0; i < options_.batch; ++i) {
+      Read r{{}, slab_.data() + i * readSize_, 0, 0};
+      boost::system::error_code ec;
+      r.size = socket_.receive_from(
+          buffer(slab_.data() + i * readSize_, readSize_), r.peer, 0, ec);
+      if (ec == error::would_block || ec == error::try_again) {
+        break;
+      }
+      if (ec) {
+        setError(ec);
+        break;
+      }
+      reads.push_back(r);
+    }
+    return toReceiveData(reads);
+  }
+#endif
+
+  // sent to us and not yet written
+  std::deque<Udp::Datagram> queued_;
+  size_t queuedBytes_ = 0;
+  // waiting for the socket to take more
+  bool isWriting = false;
+
+  void queue(Udp::Datagram d) {
+    queuedBytes_ += d.data.size();
+    queued_.push_back(std::move(d));
+  }
+
+  void queue(std::vector<Udp::Datagram> many) {
+    for (auto& d : many) {
+      queue(std::move(d));
+    }
+  }
+
+  bool full() const { return queuedBytes_ >= options_.maxQueuedBytes; }
+
+  void popWritten(size_t n, bool ok) {
+    for (size_t i = 0; i < n; ++i) {
+      auto const size = queued_.front().data.size();
+      queuedBytes_ -= size;
+      if (ok) {
+        ++stats_->datagramsWritten;
+        stats_->bytesWritten += size;
+      } else {
+        ++stats_->writeErrors;
+      }
+      queued_.pop_front();
+    }
+  }
+
+  // writes what is queued once the socket can take it. Always waiting for
+  // that, even though loopback sends never block, lets the context get to
+  // its io between writes
+  void write() {
+    isWriting = true;
+    socket_.async_wait(socket_base::wait_write,
+                       [this](boost::system::error_code const& ec) {
+                         if (ec == error::operation_aborted) {
+                           return;
+                         }
+                         if (ec) {
+                           isWriting = false;
+                           setError(ec);
+                           return;
+                         }
+                         // a few at a time, like reads
+                         for (int i = 0; queued_.size(); ++i) {
+                           if (i == kMaxWritesPerWake || !writeBatch()) {
+                             write();
+                             return;
+                           }
+                         }
+                         isWriting = false;
+                         setValue();
+                       });
+  }
+
+#ifdef __linux__
+  struct WriteSlot {
+    // how many datagrams of queued_ this sends
+    size_t datagrams;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+  };
+  std::vector<WriteSlot> writes_;
+  std::vector<mmsghdr> writeHeaders_;
+  std::vector<iovec> writeIov_;
+
+  // false if the socket would block
+  bool writeBatch() {
+    writes_.clear();
+    writeHeaders_.clear();
+    writeIov_.clear();
+    // so that pointers into it stay good
+    writeIov_.reserve(options_.batch * (options_.gso ? kMaxGsoSegments : 1));
+    size_t at = 0;
+    while (at < queued_.size() && writes_.size() < options_.batch) {
+      auto const& first = queued_[at];
+      size_t const segment = first.data.size();
+      size_t n = 1;
+      size_t bytes = segment;
+      if (options_.gso && segment) {
+        // a run to the same peer all of the same size, bar a shorter last
+        while (at + n < queued_.size() && n < kMaxGsoSegments) {
+          auto const& next = queued_[at + n];
+          if (next.peer != first.peer || next.data.size() > segment ||
+              bytes + next.data.size() > kMaxGsoBytes) {
+            break;
+          }
+          bytes += next.data.size();
+          ++n;
+          if (next.data.size() < segment) {
+            break;
+          }
+        }
+      }
+      size_t const iov = writeIov_.size();
+      for (size_t i = 0; i < n; ++i) {
+        auto const& d = queued_[at + i].data;
+        writeIov_.push_back({d.data(), d.size()});
+      }
+      auto& slot = writes_.emplace_back();
+      slot.datagrams = n;
+      mmsghdr header{};
+      auto& h = header.msg_hdr;
+      h.msg_name =
+          const_cast<void*>(static_cast<void const*>(first.peer.data()));
+      h.msg_namelen = first.peer.size();
+      h.msg_iov = writeIov_.data() + iov;
+      h.msg_iovlen = n;
+      if (n > 1) {
+        h.msg_control = slot.control;
+        h.msg_controllen = sizeof(slot.control);
+        auto* c = CMSG_FIRSTHDR(&h);
+        c->cmsg_level = SOL_UDP;
+        c->cmsg_type = UDP_SEGMENT;
+        c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t const size = segment;
+        std::memcpy(CMSG_DATA(c), &size, sizeof(size));
+      }
+      writeHeaders_.push_back(header);
+      at += n;
+    }
+    // writes_ may have moved while growing
+    for (size_t i = 0; i < writes_.size(); ++i) {
+      if (writeHeaders_[i].msg_hdr.msg_control) {
+        writeHeaders_[i].msg_hdr.msg_control = writes_[i].control;
+      }
+    }
+    int const sent = sendmmsg(socket_.native_handle(), writeHeaders_.data(),
+                              writeHeaders_.size(), MSG_DONTWAIT);
+    if (sent < 0) {
+      int const err = errno;
+      if (wouldBlock(err)) {
+        return false;
+      }
+      size_t const first = writes_.front().datagrams;
+      if (first > 1 && gsoUnsupported(err)) {
+        // stop asking for GSO and try again, a datagram at a time
+        ESLOG(LL::DEBUG, "Udp GSO send failed, turning it off: ",
+              std::strerror(err));
+        options_.gso = false;
+        return true;
+      }
+      // the first one (or GSO run) cannot be sent, so drop it and carry on
+      ++stats_->writes;
+      popWritten(first, false);
+      return true;
+    }
+    ++stats_->writes;
+    for (int i = 0; i < sent; ++i) {
+      popWritten(writes_[i].datagrams, true);
+    }
+    return true;
+  }
+#else
+  bool writeBatch() {
+    for (size_t i = 0; i < options_.batch && queued_.size(); ++i) {
+      auto const& d = queued_.front();
+      boost::system::error_code ec;
+      socket_.send_to(d.data.range(), d.peer, 0, ec);
+      if (ec == error::would_block || ec == error::try_again) {
+        return i > 0;
+      }
+      ++stats_->writes;
+      popWritten(1, !ec);
+    }
+    return true;
+  }
+#endif
+
+  ProcessTask run() {
+    while (true) {
+      if (nextRead) {
+        co_await this->sendThrottled(*toSend, std::move(*nextRead));
+        nextRead.reset();
+        asyncRead();
+      }
+      if (full()) {
+        // leave what else is sent in the slots, which throttles the senders,
+        // until the socket takes more
+        co_await WaitingFuture(&p_);
+      } else {
+        auto ret = co_await makeWithWaitingFuture(
+            &p_, this->tryRecv(init, send_data, send_many_data));
+        if (std::get<0>(ret)) {
+          bool const first = !toSend;
+          toSend = std::move(*std::get<0>(ret));
+          if (first) {
+            asyncRead();
+          }
+        }
+        if (std::get<1>(ret)) {
+          queue(std::move(*std::get<1>(ret)));
+        }
+        if (std::get<2>(ret)) {
+          queue(std::move(*std::get<2>(ret)));
+        }
+        // and anything else already sent, to go in the same writes
+        while (!full() && !send_data.queue()->empty()) {
+          queue(send_data.queue()->pop().val());
+        }
+        while (!full() && !send_many_data.queue()->empty()) {
+          queue(send_many_data.queue()->pop().val());
+        }
+      }
+      checkExcept();
+      if (!isWriting && queued_.size()) {
+        write();
+      }
+    }
+  }
+
+private:
+  ip::udp::socket socket_;
+  Udp::SocketOptions options_;
+  std::shared_ptr<Udp::SocketStats> stats_;
+  size_t const readSize_;
+  // what each read is read into
+  std::vector<unsigned char> slab_;
+};
+
+Udp::Endpoint Udp::makeEndpoint(std::string const& address, uint32_t port) {
+  boost::system::error_code ec;
+  auto const a = ip::make_address(address, ec);
+  if (ec) {
+    ESLANGEXCEPT("Bad address '", address, "' ", ec.message());
+  }
+  return Endpoint(a, port);
+}
+
+Udp::Socket Udp::bind(Process* parent, SocketOptions options) {
+  auto const local = makeEndpoint(options.address, options.port);
+  ip::udp::socket socket(parent->c()->ioService());
+  boost::system::error_code ec;
+  socket.open(local.protocol(), ec);
+  if (!ec) {
+    socket.bind(local, ec);
+  }
+  if (!ec) {
+    socket.non_blocking(true, ec);
+  }
+  if (!ec && options.receiveBufferBytes) {
+    socket.set_option(socket_base::receive_buffer_size(
+                          static_cast<int>(options.receiveBufferBytes)),
+                      ec);
+  }
+  if (!ec && options.sendBufferBytes) {
+    socket.set_option(socket_base::send_buffer_size(
+                          static_cast<int>(options.sendBufferBytes)),
+                      ec);
+  }
+  if (ec) {
+    ESLANGEXCEPT("Bind udp to ", options.address, ":", options.port,
+                 " failed ", ec.message());
+  }
+#ifdef __linux__
+  int const one = 1;
+  if (options.gro && setsockopt(socket.native_handle(), SOL_UDP, UDP_GRO,
+                                &one, sizeof(one))) {
+    ESLOG(LL::DEBUG, "No udp GRO: ", std::strerror(errno));
+    options.gro = false;
+  }
+  int const zero = 0;
+  if (options.gso && setsockopt(socket.native_handle(), SOL_UDP, UDP_SEGMENT,
+                                &zero, sizeof(zero))) {
+    ESLOG(LL::DEBUG, "No udp GSO: ", std::strerror(errno));
+    options.gso = false;
+  }
+#else
+  options.gro = false;
+  options.gso = false;
+#endif
+  auto stats = std::make_shared<SocketStats>();
+  auto const bound = socket.local_endpoint();
+  auto pid =
+      parent->spawn<UdpSocketProcess>(std::move(socket), options, stats);
+  parent->addKillOnDie(pid);
+  Socket ret(pid);
+  ret.local = bound;
+  ret.stats = std::move(stats);
+  ret.sendData = parent->makeSendAddress(pid, &UdpSocketProcess::send_data);
+  ret.sendManyData =
+      parent->makeSendAddress(pid, &UdpSocketProcess::send_many_data);
+  ret.init = parent->makeSendAddress(pid, &UdpSocketProcess::init);
+  return ret;
+}
+
+void Udp::initRecvSocket(Process* sender, Socket const& socket,
+                         TSendAddress<ReceiveData> address) {
+  sender->send(socket.init ? *socket.init
+                           : sender->makeSendAddress(socket.pid,
+                                                     &UdpSocketProcess::init),
+               std::move(address));
+}
+
+namespace {
+TSendAddress<Udp::Datagram> sendDataAddress(Process* sender,
+                                            Udp::Socket const& socket) {
+  return socket.sendData
+             ? *socket.sendData
+             : sender->makeSendAddress(socket.pid,
+                                       &UdpSocketProcess::send_data);
+}
+
+TSendAddress<std::vector<Udp::Datagram>>
+sendManyAddress(Process* sender, Udp::Socket const& socket) {
+  return socket.sendManyData
+             ? *socket.sendManyData
+             : sender->makeSendAddress(socket.pid,
+                                       &UdpSocketProcess::send_many_data);
+}
+} // namespace
+
+MethodTask<> Udp::sendThrottled(Process* sender, Socket const& socket,
+                                Datagram datagram) {
+  return sender->sendThrottled(sendDataAddress(sender, socket),
+                               std::move(datagram));
+}
+
+MethodTask<> Udp::sendManyThrottled(Process* sender, Socket const& socket,
+                                    std::vector<Datagram> datagrams) {
+  return sender->sendThrottled(sendManyAddress(sender, socket),
+                               std::move(datagrams));
+}
+
+WaitingMaybe Udp::send(Process* sender, Socket const& socket,
+                       Datagram datagram) {
+  return sender->send(sendDataAddress(sender, socket), std::move(datagram));
+}
+
+WaitingMaybe Udp::sendMany(Process* sender, Socket const& socket,
+                           std::vector<Datagram> datagrams) {
+  return sender->send(sendManyAddress(sender, socket), std::move(datagrams));
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <boost/asio/ip/udp.hpp>
+#include <eslang/BaseTypes.h>
+#include <eslang/Context.h>
+#include <eslang_io/Tcp.h>
+
+namespace s {
+
+class Udp {
+public:
+  using Endpoint = boost::asio::ip::udp::endpoint;
+
+  struct SocketOptions {
+    SocketOptions() = default;
+    explicit SocketOptions(uint32_t port) : port(port) {}
+    std::string address = "0.0.0.0";
+    // 0 picks a free one, which Socket::local has
+    uint32_t port = 0;
+    // wait for the owner to take each ReceiveData before reading more, like
+    // Tcp. Otherwise what the owner does not keep up with piles up in its
+    // slot rather than being dropped by the kernel
+    bool throttled = true;
+    // datagrams read (and written) per system call, through
+    // recvmmsg/sendmmsg where there are those
+    size_t batch = 32;
+    // the biggest datagram read. Longer ones are cut short
+    size_t maxDatagram = 2048;
+    // on Linux, have the kernel hand us runs of datagrams from one peer as
+    // one (GRO), and send runs of same sized datagrams to one peer as one
+    // (GSO). Either is dropped where the kernel refuses it
+    bool gro = false;
+    bool gso = false;
+    // SO_RCVBUF and SO_SNDBUF, 0 leaves the system's
+    size_t receiveBufferBytes = 0;
+    size_t sendBufferBytes = 0;
+    // the most the socket takes from its send slots ahead of writing it.
+    // Past this it leaves them in the slots, so sendThrottled waits
+    size_t maxQueuedBytes = 1024 * 1024;
+  };
+
+  // kept by a socket as it goes
+  struct SocketStats {
+    uint64_t datagramsRead = 0;
+    uint64_t bytesRead = 0;
+    uint64_t reads = 0;
+    uint64_t datagramsWritten = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t writes = 0;
+    // datagrams the kernel would not send (eg too big, or the peer's port
+    // was unreachable), which are dropped
+    uint64_t writeErrors = 0;
+  };
+
+  struct Datagram;
+  struct ReceiveData;
+  struct Socket {
+    explicit Socket(Pid p) : pid(std::move(p)) {}
+    Pid pid;
+    Endpoint local;
+    // the socket's, to look at. Stays valid after the socket dies
+    std::shared_ptr<SocketStats const> stats;
+    // the socket's slots, so that sending to it does not look them up each
+    // time. Left unset they are looked up
+    std::optional<TSendAddress<Datagram>> sendData;
+    std::optional<TSendAddress<std::vector<Datagram>>> sendManyData;
+    std::optional<TSendAddress<TSendAddress<ReceiveData>>> init;
+  };
+
+  struct Datagram {
+    Datagram(Endpoint peer, Buffer data)
+        : peer(std::move(peer)), data(std::move(data)) {}
+    // who it is from, or to
+    Endpoint peer;
+    Buffer data;
+  };
+
+  // what one read got. The datagrams share one allocation
+  struct ReceiveData {
+    ReceiveData(Pid p, std::vector<Datagram> datagrams)
+        : sender(p), datagrams(std::move(datagrams)) {}
+    Pid sender;
+    std::vector<Datagram> datagrams;
+  };
+
+  // opens and binds a socket, throwing if it cannot. The socket process is
+  // killed when parent dies
+  static Socket bind(Process* parent, SocketOptions options);
+
+  // where to send what the socket reads. Nothing is read before this
+  static void initRecvSocket(Process* sender, Socket const& socket,
+                             TSendAddress<ReceiveData> address);
+
+  static MethodTask<> sendThrottled(Process* sender, Socket const& socket,
+                                    Datagram datagram);
+  static MethodTask<> sendManyThrottled(Process* sender,
+                                        Socket const& socket,
+                                        std::vector<Datagram> datagrams);
+  static WaitingMaybe send(Process* sender, Socket const& socket,
+                           Datagram datagram);
+  static WaitingMaybe sendMany(Process* sender, Socket const& socket,
+                               std::vector<Datagram> datagrams);
+
+  static Endpoint makeEndpoint(std::string const& address, uint32_t port);
+};
+}
@@ -0,0 +1,649 @@
+#include "Client.h"
+#include <atomic>
+#include <boost/beast/http.hpp>
+#include <eslang/Logging.h>
+
+namespace s {
+
+namespace http = boost::beast::http;
+using error_code = boost::system::error_code;
+
+namespace {
+// calls can move between pools and contexts, so ids are unique per program
+std::atomic<uint64_t> nextCallId{0};
+
+// how many connections a request is tried on
+constexpr uint32_t kMaxAttempts = 3;
+
+std::string hostKey(std::string const& host, uint32_t port) {
+  return concatString(host, ":", port);
+}
+
+// requests that are safe to send again if we never heard back
+bool isIdempotent(http::verb method) {
+  switch (method) {
+  case http::verb::get:
+  case http::verb::head:
+  case http::verb::put:
+  case http::verb::delete_:
+  case http::verb::options:
+  case http::verb::trace:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// the whole request, head and body, in one buffer
+Buffer serialize(Www::Request& req) {
+  http::request_serializer<http::string_body> serializer(req.message);
+  std::vector<unsigned char> out;
+  error_code ec;
+  while (!serializer.is_done()) {
+    size_t used = 0;
+    serializer.next(ec, [&](error_code&, auto const& buffs) {
+      for (auto const& b : buffs) {
+        auto const* p = static_cast<unsigned char const*>(b.data());
+        out.insert(out.end(), p, p + b.size());
+        used += b.size();
+      }
+    });
+    if (ec) {
+      ESLANGEXCEPT("Cannot serialize request: ", ec.message());
+    }
+    serializer.consume(used);
+  }
+  return Buffer::make(std::move(out));
+}
+} // namespace
+
+class Www::Client::Pool : public Process {
+public:
+  // from a connection
+  struct Event {
+    enum class Kind {
+      // the response to ids[0] has been sent
+      Finished,
+      // nothing is in flight, and has not been for Options::idleTimeout
+      Idle,
+      // the connection is going away. Calls on it other than ids (which
+      // have been answered) got none of their response
+      Closing,
+    };
+    Kind kind;
+    Pid connection;
+    std::vector<uint64_t> ids;
+  };
+
+  Pool(ProcessArgs i, Options options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Call> calls{this};
+  Slot<Cancel> cancels{this};
+  Slot<Event> events{this};
+  Slot<Pid> connectionDied{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto [call, cancel, event, died] =
+          co_await tryRecv(calls, cancels, events, connectionDied);
+      if (call) {
+        dispatch(std::move(*call));
+      }
+      if (event) {
+        onEvent(std::move(*event));
+      }
+      if (cancel) {
+        onCancel(cancel->id);
+      }
+      if (died) {
+        onDied(*died);
+      }
+    }
+  }
+
+private:
+  struct ConnectionState {
+    Pid pid;
+    // made while it is alive, as it may have gone (and not said so yet) by
+    // the time we next send to it
+    TSendAddress<Call> calls;
+    TSendAddress<Cancel> cancels;
+    // written to the connection, and not answered yet
+    std::deque<Call> outstanding;
+    bool closing = false;
+  };
+
+  struct Host {
+    std::string name;
+    uint32_t port = 0;
+    std::string key;
+    std::vector<ConnectionState> connections;
+    // calls waiting for room on a connection
+    std::deque<Call> waiting;
+  };
+
+  void dispatch(Call call);
+  // a connection to host with room for another call, if there is (or there
+  // can be) one
+  ConnectionState* pick(Host& host);
+  void sendTo(ConnectionState& connection, Call call);
+  void pump(Host& host);
+  void retry(Call call);
+  void fail(Call const& call, std::string reason);
+
+  void onEvent(Event event);
+  void onCancel(uint64_t id);
+  void onDied(Pid pid);
+
+  Host* findHost(Pid connection);
+  std::vector<ConnectionState>::iterator find(Host& host, Pid connection);
+
+  Options const options_;
+  std::unordered_map<std::string, Host> hosts_;
+  // which host each connection is to
+  std::unordered_map<Pid, std::string> hostOf_;
+};
+
+// One keep-alive connection to a host, writing calls as they arrive and
+// answering them in order as their responses come back.
+class Www::Client::Connection : public Process {
+public:
+  Connection(ProcessArgs i, std::string host, uint32_t port, Options options,
+             TSendAddress<Pool::Event> events)
+      : Process(std::move(i)), host_(std::move(host)), port_(port),
+        options_(std::move(options)), events_(events) {}
+
+  Slot<Call> calls{this};
+  Slot<Cancel> cancels{this};
+  Slot<Tcp::ReceiveData> recv{this};
+  Slot<Pid> socketClosed{this};
+
+  ProcessTask run() {
+    Tcp::ConnectOptions connect(host_, port_);
+    connect.notifyOnClose = socketClosed.address();
+    auto socket = co_await Tcp::connect(this, std::move(connect));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::tuple<std::optional<Call>, std::optional<Cancel>,
+               std::optional<Tcp::ReceiveData>, std::optional<Pid>>
+        got;
+    while (true) {
+      if (inFlight_.empty()) {
+        got = co_await timedRecv(options_.idleTimeout, calls, cancels, recv,
+                                 socketClosed);
+      } else {
+        got = co_await tryRecv(calls, cancels, recv, socketClosed);
+      }
+      auto& [call, cancel, data, closed] = got;
+      if (!call && !cancel && !data && !closed) {
+        // the pool kills us, unless it has just sent us something
+        send(events_, Pool::Event{Pool::Event::Kind::Idle, pid(), {}});
+        continue;
+      }
+      if (call) {
+        Tcp::send(this, socket, call->request);
+        inFlight_.push_back(std::move(*call));
+      }
+      if (data) {
+        try {
+          if (!receive(std::move(data->data))) {
+            close("Connection closed by the server");
+            co_return;
+          }
+        } catch (std::exception const& e) {
+          close(e.what());
+          co_return;
+        }
+      }
+      if (cancel && isInFlight(cancel->id)) {
+        // the only way to stop a response is to drop the connection
+        close("Connection closed by a cancelled request", cancel->id);
+        co_return;
+      }
+      if (closed) {
+        try {
+          receiveEof();
+          close("Connection closed by the server");
+        } catch (std::exception const& e) {
+          close(e.what());
+        }
+        co_return;
+      }
+    }
+  }
+
+private:
+  bool isInFlight(uint64_t id) const {
+    return std::any_of(inFlight_.begin(), inFlight_.end(),
+                       [id](Call const& c) { return c.id == id; });
+  }
+
+  void reply(Call const& call, Reply r) { send(call.reply, std::move(r)); }
+
+  // parses what it can of data, returning false if the connection must not
+  // be used again. throws on a malformed response
+  bool receive(Buffer data) {
+    if (pending_) {
+      pending_ = BufferCollection{{std::move(*pending_), std::move(data)}}
+                     .combine();
+    } else {
+      pending_ = std::move(data);
+    }
+    while (pending_->size()) {
+      if (inFlight_.empty()) {
+        ESLANGEXCEPT("Unexpected data from ", host_, ":", port_);
+      }
+      if (!parser_) {
+        startParser();
+      }
+      error_code ec;
+      size_t const used = parser_->put(
+          boost::asio::buffer(pending_->data(), pending_->size()), ec);
+      pending_->consume(used);
+      started_ = started_ || used;
+      if (ec == http::error::need_more) {
+        break;
+      }
+      if (ec) {
+        ESLANGEXCEPT("Bad response from ", host_, ":", port_, ": ",
+                     ec.message());
+      }
+      if (!progress()) {
+        return false;
+      }
+    }
+    if (!pending_->size()) {
+      pending_.reset();
+    }
+    return true;
+  }
+
+  // for responses that end when the connection does
+  void receiveEof() {
+    if (!parser_ || !started_) {
+      return;
+    }
+    error_code ec;
+    parser_->put_eof(ec);
+    if (ec) {
+      ESLANGEXCEPT("Bad response from ", host_, ":", port_, ": ",
+                   ec.message());
+    }
+    progress();
+  }
+
+  void startParser() {
+    parser_.emplace();
+    parser_->eager(true);
+    parser_->body_limit(options_.maxBodySize);
+    // the response to a HEAD has a Content-Length, but no body
+    parser_->skip(inFlight_.front().head);
+  }
+
+  // sends on whatever has been parsed of the front call's response, returning
+  // false if the connection must not be used again
+  bool progress() {
+    auto& call = inFlight_.front();
+    auto& m = parser_->get();
+    if (parser_->is_done() && m.result_int() / 100 == 1) {
+      // an interim response, the real one follows
+      parser_.reset();
+      return true;
+    }
+    if (call.stream) {
+      if (!headSent_ && parser_->is_header_done()) {
+        headSent_ = true;
+        Response head;
+        head.message = http::response<http::string_body>(m.base());
+        reply(call, Reply{call.id, std::move(head), {}, false});
+      }
+      if (m.body().size()) {
+        reply(call, Reply{call.id, {}, Buffer::makeCopy(m.body()), false});
+        m.body().clear();
+      }
+    }
+    if (!parser_->is_done()) {
+      return true;
+    }
+    bool const keep_alive = m.keep_alive();
+    if (!call.stream) {
+      Response resp;
+      resp.message = parser_->release();
+      reply(call, Reply{call.id, std::move(resp), {}, true});
+    } else {
+      reply(call, Reply{call.id, {}, {}, true});
+    }
+    send(events_, Pool::Event{Pool::Event::Kind::Finished, pid(), {call.id}});
+    inFlight_.pop_front();
+    parser_.reset();
+    started_ = false;
+    headSent_ = false;
+    return keep_alive;
+  }
+
+  // tells the pool we are going. A response that is part way through fails,
+  // and the pool sends the calls that got nothing elsewhere
+  void close(std::string const& reason,
+             std::optional<uint64_t> cancelled = {}) {
+    Pool::Event event{Pool::Event::Kind::Closing, pid(), {}};
+    if (cancelled) {
+      event.ids.push_back(*cancelled);
+    }
+    if (started_ && inFlight_.size()) {
+      auto const& call = inFlight_.front();
+      if (call.id != cancelled) {
+        reply(call, Reply{call.id, {}, {}, true, reason});
+        event.ids.push_back(call.id);
+      }
+    }
+    ESLOG(LL::DEBUG, "Closing connection to ", host_, ":", port_, ": ",
+          reason);
+    send(events_, std::move(event));
+  }
+
+  std::string const host_;
+  uint32_t const port_;
+  Options const options_;
+  TSendAddress<Pool::Event> events_;
+  // written, in order, and not answered yet
+  std::deque<Call> inFlight_;
+  std::optional<Buffer> pending_;
+  std::optional<http::response_parser<http::string_body>> parser_;
+  // whether any of the front call's response has arrived
+  bool started_ = false;
+  bool headSent_ = false;
+};
+
+void Www::Client::Pool::dispatch(Call call) {
+  auto key = hostKey(call.host, call.port);
+  auto [it, inserted] = hosts_.try_emplace(key);
+  auto& host = it->second;
+  if (inserted) {
+    host.name = call.host;
+    host.port = call.port;
+    host.key = std::move(key);
+  }
+  if (host.waiting.empty()) {
+    if (auto* connection = pick(host)) {
+      sendTo(*connection, std::move(call));
+      return;
+    }
+  }
+  host.waiting.push_back(std::move(call));
+}
+
+Www::Client::Pool::ConnectionState* Www::Client::Pool::pick(Host& host) {
+  ConnectionState* best = nullptr;
+  size_t open = 0;
+  for (auto& c : host.connections) {
+    if (c.closing) {
+      continue;
+    }
+    ++open;
+    if (!best || c.outstanding.size() < best->outstanding.size()) {
+      best = &c;
+    }
+  }
+  // rather a new connection than queueing behind another response
+  if ((!best || best->outstanding.size()) && open < options_.maxConnections) {
+    auto pid = spawnLinkNotify<Connection>(connectionDied.address(), host.name,
+                                           host.port, options_,
+                                           events.address());
+    hostOf_.emplace(pid, host.key);
+    host.connections.push_back(
+        ConnectionState{pid, makeSendAddress(pid, &Connection::calls),
+                        makeSendAddress(pid, &Connection::cancels)});
+    return &host.connections.back();
+  }
+  if (best && best->outstanding.size() < options_.maxPipeline) {
+    return best;
+  }
+  return nullptr;
+}
+
+void Www::Client::Pool::sendTo(ConnectionState& connection, Call call) {
+  send(connection.calls, call);
+  connection.outstanding.push_back(std::move(call));
+}
+
+void Www::Client::Pool::pump(Host& host) {
+  while (host.waiting.size()) {
+    auto* connection = pick(host);
+    if (!connection) {
+      return;
+    }
+    auto call = std::move(host.waiting.front());
+    host.waiting.pop_front();
+    sendTo(*connection, std::move(call));
+  }
+}
+
+void Www::Client::Pool::retry(Call call) {
+  if (!call.idempotent || ++call.attempts >= kMaxAttempts) {
+    fail(call, concatString("Connection to ", call.host, ":", call.port,
+                            " closed before the response"));
+    return;
+  }
+  dispatch(std::move(call));
+}
+
+void Www::Client::Pool::fail(Call const& call, std::string reason) {
+  send(call.reply, Reply{call.id, {}, {}, true, std::move(reason)});
+}
+
+void Www::Client::Pool::onEvent(Event event) {
+  auto* host = findHost(event.connection);
+  if (!host) {
+    return;
+  }
+  auto connection = find(*host, event.connection);
+  auto& outstanding = connection->outstanding;
+  switch (event.kind) {
+  case Event::Kind::Finished: {
+    auto it = std::find_if(
+        outstanding.begin(), outstanding.end(),
+        [&](Call const& c) { return c.id == event.ids.front(); });
+    if (it != outstanding.end()) {
+      outstanding.erase(it);
+    }
+    break;
+  }
+  case Event::Kind::Idle:
+    if (outstanding.empty() && !connection->closing) {
+      queueKill(connection->pid);
+      hostOf_.erase(connection->pid);
+      host->connections.erase(connection);
+    }
+    break;
+  case Event::Kind::Closing: {
+    connection->closing = true;
+    auto calls = std::move(outstanding);
+    outstanding.clear();
+    for (auto& call : calls) {
+      if (std::find(event.ids.begin(), event.ids.end(), call.id) ==
+          event.ids.end()) {
+        retry(std::move(call));
+      }
+    }
+    break;
+  }
+  }
+  pump(*host);
+}
+
+void Www::Client::Pool::onCancel(uint64_t id) {
+  auto is = [id](Call const& c) { return c.id == id; };
+  for (auto& [key, host] : hosts_) {
+    auto waiting = std::find_if(host.waiting.begin(), host.waiting.end(), is);
+    if (waiting != host.waiting.end()) {
+      host.waiting.erase(waiting);
+      return;
+    }
+    for (auto& c : host.connections) {
+      if (!c.closing &&
+          std::any_of(c.outstanding.begin(), c.outstanding.end(), is)) {
+        send(c.cancels, Cancel{id});
+        return;
+      }
+    }
+  }
+}
+
+void Www::Client::Pool::onDied(Pid pid) {
+  auto* host = findHost(pid);
+  if (!host) {
+    return;
+  }
+  auto connection = find(*host, pid);
+  // it did not say it was closing, so it never connected (or broke)
+  for (auto const& call : connection->outstanding) {
+    fail(call,
+         concatString("Connection to ", host->name, ":", host->port, " failed"));
+  }
+  hostOf_.erase(pid);
+  host->connections.erase(connection);
+  pump(*host);
+}
+
+Www::Client::Pool::Host* Www::Client::Pool::findHost(Pid connection) {
+  auto it = hostOf_.find(connection);
+  if (it == hostOf_.end()) {
+    return nullptr;
+  }
+  return &hosts_.at(it->second);
+}
+
+std::vector<Www::Client::Pool::ConnectionState>::iterator
+Www::Client::Pool::find(Host& host, Pid connection) {
+  return std::find_if(
+      host.connections.begin(), host.connections.end(),
+      [&](ConnectionState const& c) { return c.pid == connection; });
+}
+
+Pid Www::Client::spawnPool(Process* owner) {
+  return spawnPool(owner, Options());
+}
+
+Pid Www::Client::spawnPool(Process* owner, Options options) {
+  return owner->spawnLink<Pool>(std::move(options));
+}
+
+Www::Client::Client(Process* owner, Pid pool,
+                    std::chrono::milliseconds timeout)
+    : owner_(owner), timeout_(timeout),
+      calls_(owner->makeSendAddress(pool, &Pool::calls)),
+      cancels_(owner->makeSendAddress(pool, &Pool::cancels)),
+      replies_(owner) {}
+
+uint64_t Www::Client::start(std::string host, uint32_t port, Request& req,
+                            bool stream) {
+  auto& m = req.message;
+  if (m.find(http::field::host) == m.end()) {
+    m.set(http::field::host,
+          port == 80 ? host : concatString(host, ":", port));
+  }
+  if (!m.has_content_length() && !m.chunked()) {
+    m.prepare_payload();
+  }
+  uint64_t const id = ++nextCallId;
+  owner_->send(calls_, Call{id, std::move(host), port, serialize(req),
+                            m.method() == http::verb::head,
+                            isIdempotent(m.method()), stream,
+                            replies_.address()});
+  return id;
+}
+
+MethodTask<Www::Client::Reply> Www::Client::next(uint64_t id) {
+  auto stream = streams_.find(id);
+  if (stream != streams_.end() && stream->second.size()) {
+    auto reply = std::move(stream->second.front());
+    stream->second.pop_front();
+    if (reply.error) {
+      streams_.erase(id);
+      throw Error(*reply.error);
+    }
+    co_return reply;
+  }
+  auto const deadline = owner_->now() + timeout_;
+  while (true) {
+    auto const left = std::max(
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                              owner_->now()),
+        std::chrono::milliseconds(0));
+    auto [reply] = co_await owner_->timedRecv(left, replies_);
+    if (!reply) {
+      cancel(id);
+      throw Timeout(concatString("No response after ", timeout_.count(), "ms"));
+    }
+    if (reply->id == id) {
+      // thrown from here rather than by our callers, as this is what gets
+      // resumed when the reply arrives
+      if (reply->error) {
+        streams_.erase(id);
+        throw Error(*reply->error);
+      }
+      co_return std::move(*reply);
+    }
+    auto it = streams_.find(reply->id);
+    if (it != streams_.end()) {
+      it->second.push_back(std::move(*reply));
+    }
+    // anything else is for a request that has been given up on
+  }
+}
+
+void Www::Client::cancel(uint64_t id) {
+  streams_.erase(id);
+  owner_->send(cancels_, Cancel{id});
+}
+
+MethodTask<Www::Response> Www::Client::request(std::string host, uint32_t port,
+                                               Request req) {
+  auto const id = start(std::move(host), port, req, false);
+  auto reply = std::move(co_await next(id));
+  co_return std::move(*reply.head);
+}
+
+MethodTask<Www::Response> Www::Client::get(std::string host, uint32_t port,
+                                           std::string target) {
+  Request req;
+  req.message.method(http::verb::get);
+  req.message.target(target);
+  req.message.version(11);
+  return request(std::move(host), port, std::move(req));
+}
+
+MethodTask<Www::Client::Streamed>
+Www::Client::stream(std::string host, uint32_t port, Request req) {
+  auto const id = start(std::move(host), port, req, true);
+  streams_[id];
+  auto reply = std::move(co_await next(id));
+  if (reply.done) {
+    streams_.erase(id);
+  }
+  co_return Streamed{std::move(*reply.head), body(id, reply.done)};
+}
+
+GenTask<Buffer> Www::Client::body(uint64_t id, bool done) {
+  // if the body is abandoned part way through, the rest of it is not wanted
+  struct Forget {
+    Client* client;
+    uint64_t id;
+    bool done;
+    ~Forget() {
+      if (done) {
+        client->streams_.erase(id);
+      } else {
+        client->cancel(id);
+      }
+    }
+  } forget{this, id, done};
+  while (!forget.done) {
+    auto reply = std::move(co_await next(id));
+    forget.done = reply.done;
+    if (reply.body) {
+      co_yield std::move(*reply.body);
+    }
+  }
+}
+}
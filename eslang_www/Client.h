@@ -0,0 +1,111 @@
+#pragma once
+#include "Www.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace s {
+
+// An HTTP/1.1 client for processes.
+// Connections are owned by a Client::Pool process, which keeps up to
+// Options::maxConnections keep-alive connections per host and pipelines up to
+// Options::maxPipeline requests on each. Processes share connections by
+// sharing a pool.
+// A Client is one process's handle on a pool. Responses come back through a
+// slot it owns, so it must live as long as its process (ie be a member).
+// Failures (connecting, a malformed response, or a timeout) throw, which
+// kills the calling process like any other exception.
+class Www::Client : NonMovable {
+public:
+  struct Options {
+    // keep-alive connections per host
+    size_t maxConnections = 4;
+    // requests written to a connection before the earlier ones are answered
+    size_t maxPipeline = 8;
+    // how long an unused connection is kept open
+    std::chrono::milliseconds idleTimeout{60000};
+    uint64_t maxBodySize = 64 * 1024 * 1024;
+  };
+
+  class Error : public EslangException {
+    using EslangException::EslangException;
+  };
+  class Timeout : public Error {
+    using Error::Error;
+  };
+
+  // a response whose body is read as it arrives
+  struct Streamed {
+    // with an empty body
+    Response head;
+    GenTask<Buffer> body;
+  };
+
+  // the process holding the connections, see spawnPool
+  class Pool;
+
+  // a pool that dies with owner (and kills it if it dies)
+  static Pid spawnPool(Process* owner);
+  static Pid spawnPool(Process* owner, Options options);
+
+  // timeout is how long to wait for each part of a response (its head, or
+  // the next piece of its body)
+  Client(Process* owner, Pid pool,
+         std::chrono::milliseconds timeout = std::chrono::seconds(30));
+
+  // Host and Content-Length are filled in if they are missing. Idempotent
+  // requests are retried on another connection if theirs closes before any
+  // of the response arrives.
+  MethodTask<Response> request(std::string host, uint32_t port, Request req);
+  MethodTask<Response> get(std::string host, uint32_t port,
+                           std::string target);
+  // As request, but the body is yielded in pieces as it arrives. Stopping
+  // early (destroying body) closes the connection it was on.
+  MethodTask<Streamed> stream(std::string host, uint32_t port, Request req);
+
+private:
+  class Connection;
+
+  struct Reply {
+    uint64_t id;
+    // the response, with its whole body unless it is streamed
+    std::optional<Response> head;
+    // a piece of a streamed body
+    std::optional<Buffer> body;
+    bool done = false;
+    std::optional<std::string> error;
+  };
+
+  struct Call {
+    uint64_t id;
+    std::string host;
+    uint32_t port;
+    // the serialized request
+    Buffer request;
+    bool head;
+    bool idempotent;
+    bool stream;
+    TSendAddress<Reply> reply;
+    uint32_t attempts = 0;
+  };
+
+  struct Cancel {
+    uint64_t id;
+  };
+
+  uint64_t start(std::string host, uint32_t port, Request& req, bool stream);
+  // the next reply for id, throwing if it is an error
+  MethodTask<Reply> next(uint64_t id);
+  GenTask<Buffer> body(uint64_t id, bool done);
+  void cancel(uint64_t id);
+
+  Process* const owner_;
+  std::chrono::milliseconds const timeout_;
+  TSendAddress<Call> calls_;
+  TSendAddress<Cancel> cancels_;
+  Slot<Reply> replies_;
+  // replies for streamed bodies that are still being read, held while
+  // waiting for another response
+  std::unordered_map<uint64_t, std::deque<Reply>> streams_;
+};
+}
@@ -0,0 +1,352 @@
+#include "Compression.h"
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/beast/http.hpp>
+#include <mutex>
+#include <zlib.h>
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+namespace {
+// zlib's windowBits for each content coding. "deflate" is the zlib format
+int windowBits(Www::Compression::Encoding encoding) {
+  return encoding == Www::Compression::Encoding::Gzip ? 15 + 16 : 15;
+}
+
+std::string_view toStd(boost::beast::string_view s) {
+  return std::string_view(s.data(), s.size());
+}
+
+bool iequals(std::string_view a, boost::beast::string_view b) {
+  return boost::beast::iequals(boost::beast::string_view(a.data(), a.size()),
+                               b);
+}
+
+std::string_view trim(std::string_view s) {
+  while (s.size() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (s.size() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+// the q value of one element of Accept-Encoding, eg "gzip;q=0.5"
+double quality(std::string_view params) {
+  while (params.size()) {
+    auto const end = std::min(params.find(';'), params.size());
+    auto param = trim(params.substr(0, end));
+    params.remove_prefix(std::min(end + 1, params.size()));
+    if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') &&
+        param[1] == '=') {
+      return std::atof(std::string(param.substr(2)).c_str());
+    }
+  }
+  return 1;
+}
+
+size_t cacheKey(std::string_view body, Www::Compression::Encoding encoding) {
+  return std::hash<std::string_view>()(body) ^ size_t(encoding);
+}
+
+bool defaultShouldCompress(Www::Response const& resp) {
+  auto it = resp.message.find(http::field::content_type);
+  if (it == resp.message.end()) {
+    return false;
+  }
+  auto const type = toStd(it->value());
+  auto has = [&](std::string_view s) {
+    return type.find(s) != std::string_view::npos;
+  };
+  return type.substr(0, 5) == "text/" || has("json") || has("javascript") ||
+         has("xml") || has("svg");
+}
+} // namespace
+
+class Www::Compression::Stream : NonMovable {
+public:
+  Stream(Encoding encoding, int level) {
+    if (deflateInit2(&z_, level, Z_DEFLATED, windowBits(encoding), 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      ESLANGEXCEPT("deflateInit2 failed");
+    }
+  }
+  ~Stream() { deflateEnd(&z_); }
+
+  // flush is one of zlib's Z_NO_FLUSH, Z_SYNC_FLUSH or Z_FINISH. This runs
+  // on the pool too, so it returns bytes rather than a Buffer
+  std::vector<unsigned char> deflate(void const* data, size_t len,
+                                     int flush) {
+    if (len > std::numeric_limits<uInt>::max()) {
+      ESLANGEXCEPT("Cannot compress ", len, " bytes at once");
+    }
+    std::vector<unsigned char> out;
+    z_.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+    z_.avail_in = len;
+    // deflateBound is enough for everything so far, but loop anyway
+    do {
+      size_t const have = out.size();
+      out.resize(have + deflateBound(&z_, z_.avail_in) + 16);
+      z_.next_out = out.data() + have;
+      z_.avail_out = out.size() - have;
+      if (::deflate(&z_, flush) == Z_STREAM_ERROR) {
+        ESLANGEXCEPT("deflate failed");
+      }
+      out.resize(out.size() - z_.avail_out);
+    } while (z_.avail_out == 0);
+    return out;
+  }
+
+private:
+  z_stream z_{};
+};
+
+Www::Compression::Compression() : Compression(Options()) {}
+
+Www::Compression::Compression(Options options)
+    : options_(std::move(options)) {
+  if (options_.offloadThreads) {
+    pool_ =
+        std::make_unique<boost::asio::thread_pool>(options_.offloadThreads);
+  }
+}
+
+Www::Compression::~Compression() {
+  if (pool_) {
+    pool_->join();
+  }
+}
+
+std::optional<Www::Compression::Encoding>
+Www::Compression::negotiate(RequestView const& req) {
+  auto accept = req.find(http::field::accept_encoding);
+  if (!accept) {
+    return {};
+  }
+  std::optional<Encoding> ret;
+  double best = 0;
+  auto list = toStd(*accept);
+  while (list.size()) {
+    auto const end = std::min(list.find(','), list.size());
+    auto item = trim(list.substr(0, end));
+    list.remove_prefix(std::min(end + 1, list.size()));
+    auto const semi = std::min(item.find(';'), item.size());
+    auto const coding = trim(item.substr(0, semi));
+    std::optional<Encoding> encoding;
+    if (iequals(coding, "gzip") || iequals(coding, "x-gzip") ||
+        coding == "*") {
+      encoding = Encoding::Gzip;
+    } else if (iequals(coding, "deflate")) {
+      encoding = Encoding::Deflate;
+    }
+    if (!encoding) {
+      continue;
+    }
+    double const q = quality(item.substr(semi));
+    // ties go to gzip, which clients get right more often than deflate
+    if (q > best || (q == best && q > 0 && encoding == Encoding::Gzip)) {
+      best = q;
+      ret = encoding;
+    }
+  }
+  return ret;
+}
+
+boost::beast::string_view Www::Compression::name(Encoding encoding) {
+  return encoding == Encoding::Gzip ? "gzip" : "deflate";
+}
+
+bool Www::Compression::shouldCompress(Response const& resp) const {
+  if (resp.message.find(http::field::content_encoding) !=
+      resp.message.end()) {
+    return false;
+  }
+  return options_.shouldCompress ? options_.shouldCompress(resp)
+                                 : defaultShouldCompress(resp);
+}
+
+MethodTask<std::optional<Buffer>>
+Www::Compression::compress(Process* p, std::optional<Encoding> encoding,
+                           Response& resp) {
+  auto& m = resp.message;
+  if (!shouldCompress(resp)) {
+    co_return std::nullopt;
+  }
+  m.set(http::field::vary, "Accept-Encoding");
+  if (!encoding || m.body().size() < options_.minSize) {
+    co_return std::nullopt;
+  }
+  std::optional<Buffer> compressed;
+  if (resp.cacheFor) {
+    auto [begin, end] = index_.equal_range(cacheKey(m.body(), *encoding));
+    for (auto it = begin; it != end; ++it) {
+      auto& entry = *it->second;
+      if (entry.encoding == *encoding && entry.body == m.body()) {
+        ++stats_.cacheHits;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        compressed = entry.compressed;
+        break;
+      }
+    }
+    if (!compressed) {
+      ++stats_.cacheMisses;
+    }
+  }
+  // the body goes to the pool, so it must not be owned by resp
+  auto body = std::make_shared<std::string>(std::move(m.body()));
+  m.body().clear();
+  if (!compressed) {
+    auto job = [body, encoding = *encoding, level = options_.level] {
+      Stream stream(encoding, level);
+      return stream.deflate(body->data(), body->size(), Z_FINISH);
+    };
+    if (pool_ && body->size() >= options_.offloadMinSize) {
+      compressed = co_await offload(p, job);
+    } else {
+      compressed = Buffer::make(job());
+    }
+    ++stats_.compressed;
+    stats_.bytesIn += body->size();
+    stats_.bytesOut += compressed->size();
+    if (resp.cacheFor) {
+      remember(*body, *encoding, *compressed);
+    }
+  }
+  if (compressed->size() >= body->size()) {
+    // not worth it
+    m.body() = std::move(*body);
+    co_return std::nullopt;
+  }
+  m.set(http::field::content_encoding, name(*encoding));
+  m.content_length(compressed->size());
+  co_return compressed;
+}
+
+std::shared_ptr<Www::Compression::Stream>
+Www::Compression::startStream(std::optional<Encoding> encoding,
+                              Response& resp) const {
+  if (!shouldCompress(resp)) {
+    return nullptr;
+  }
+  resp.message.set(http::field::vary, "Accept-Encoding");
+  if (!encoding) {
+    return nullptr;
+  }
+  resp.message.set(http::field::content_encoding, name(*encoding));
+  return std::make_shared<Stream>(*encoding, options_.level);
+}
+
+MethodTask<Buffer> Www::Compression::write(Process* p,
+                                           std::shared_ptr<Stream> stream,
+                                           Buffer data) {
+  std::optional<Buffer> out;
+  if (pool_ && data.size() >= options_.offloadMinSize) {
+    // Buffer's refcount is not atomic, so the pool gets its own copy of the
+    // bytes rather than a reference to data
+    auto bytes = std::make_shared<std::string>(
+        reinterpret_cast<char const*>(data.data()), data.size());
+    out = co_await offload(p, [stream, bytes] {
+      return stream->deflate(bytes->data(), bytes->size(), Z_SYNC_FLUSH);
+    });
+  } else {
+    out = Buffer::make(
+        stream->deflate(data.data(), data.size(), Z_SYNC_FLUSH));
+  }
+  stats_.bytesIn += data.size();
+  stats_.bytesOut += out->size();
+  co_return std::move(*out);
+}
+
+Buffer Www::Compression::finish(Stream& stream) {
+  ++stats_.compressed;
+  Buffer out = Buffer::make(stream.deflate(nullptr, 0, Z_FINISH));
+  stats_.bytesOut += out.size();
+  return out;
+}
+
+Buffer Www::Compression::compress(Encoding encoding, int level,
+                                  void const* data, size_t len) {
+  Stream stream(encoding, level);
+  return Buffer::make(stream.deflate(data, len, Z_FINISH));
+}
+
+MethodTask<Buffer>
+Www::Compression::offload(Process* p,
+                          std::function<std::vector<unsigned char>()> fn) {
+  ++stats_.offloaded;
+  // shared with the pool, as p may die (and take this frame with it) while
+  // the pool is still working. Once it has, io is cleared, since the context
+  // may be gone by the time the pool is done
+  struct Job {
+    std::mutex mutex;
+    boost::asio::io_service* io;
+    // keeps the context's io_service from running out of work meanwhile
+    std::optional<boost::asio::executor_work_guard<
+        boost::asio::io_service::executor_type>>
+        work;
+    EslangPromise done;
+    std::optional<std::vector<unsigned char>> result;
+    std::exception_ptr error;
+  };
+  auto job = std::make_shared<Job>();
+  job->io = &p->c()->ioService();
+  job->work.emplace(job->io->get_executor());
+  boost::asio::post(*pool_, [job, fn = std::move(fn)] {
+    try {
+      job->result = fn();
+    } catch (...) {
+      job->error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (!job->io) {
+      return;
+    }
+    boost::asio::post(*job->io, [job] {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      job->work.reset();
+      if (job->io) {
+        job->done.setIfUnset();
+      }
+    });
+  });
+  struct Abandon {
+    std::shared_ptr<Job> job;
+    ~Abandon() {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      job->io = nullptr;
+      job->work.reset();
+    }
+  } abandon{job};
+  co_await WaitOnFuture(&job->done);
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+  co_return Buffer::make(std::move(*job->result));
+}
+
+void Www::Compression::remember(std::string body, Encoding encoding,
+                                Buffer compressed) {
+  if (!options_.cacheEntries) {
+    return;
+  }
+  while (lru_.size() >= options_.cacheEntries) {
+    auto last = std::prev(lru_.end());
+    auto [begin, end] =
+        index_.equal_range(cacheKey(last->body, last->encoding));
+    for (auto it = begin; it != end; ++it) {
+      if (it->second == last) {
+        index_.erase(it);
+        break;
+      }
+    }
+    lru_.erase(last);
+  }
+  size_t const key = cacheKey(body, encoding);
+  lru_.push_front(CacheEntry{std::move(body), encoding, std::move(compressed)});
+  index_.emplace(key, lru_.begin());
+}
+}
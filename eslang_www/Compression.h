@@ -0,0 +1,107 @@
+#pragma once
+#include "Www.h"
+
+#include <list>
+#include <unordered_map>
+
+namespace boost::asio {
+class thread_pool;
+}
+
+namespace s {
+
+// gzip and deflate Content-Encoding of responses, negotiated through the
+// request's Accept-Encoding. Share one between sessions (or servers) through
+// Server::ServerOptions.
+// Compressed bodies of cacheable responses (see Response::cacheFor) are kept
+// by content, so repeated static responses are only compressed once. Large
+// bodies are compressed on a thread pool rather than the scheduler thread.
+class Www::Compression : NonMovable {
+public:
+  enum class Encoding { Gzip, Deflate };
+
+  struct Options {
+    // zlib level, 1 (fastest) to 9 (smallest)
+    int level = 6;
+    // smaller bodies are sent as they are
+    size_t minSize = 256;
+    // whether a response is worth compressing, given its headers. defaults
+    // to text, json, javascript, xml and svg content types
+    std::function<bool(Response const&)> shouldCompress;
+    // how many compressed bodies of cacheable responses to keep
+    size_t cacheEntries = 256;
+    // bodies (and chunks) at least this big are compressed on the pool
+    size_t offloadMinSize = 32 * 1024;
+    // 0 compresses everything on the scheduler thread
+    size_t offloadThreads = 2;
+  };
+
+  struct Stats {
+    uint64_t compressed = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t offloaded = 0;
+  };
+
+  // An incremental compressor, for chunked responses. Each write is
+  // flushed, so that the client gets whatever has been written so far.
+  class Stream;
+
+  Compression();
+  explicit Compression(Options options);
+  ~Compression();
+
+  // the client's preferred encoding, if it accepts one we do
+  static std::optional<Encoding> negotiate(RequestView const& req);
+  static boost::beast::string_view name(Encoding encoding);
+
+  // whether resp's Content-Type is worth compressing (ignoring its size)
+  bool shouldCompress(Response const& resp) const;
+
+  // Compresses the body of resp if it is worth it. If it does, the body is
+  // cleared (with Content-Encoding and Content-Length set) and this returns
+  // the body to send instead. Sets Vary either way.
+  MethodTask<std::optional<Buffer>>
+  compress(Process* p, std::optional<Encoding> encoding, Response& resp);
+
+  // For a chunked resp: a stream to pass its chunks through, if it is worth
+  // compressing, having set Content-Encoding. Sets Vary either way.
+  std::shared_ptr<Stream> startStream(std::optional<Encoding> encoding,
+                                      Response& resp) const;
+  // the compressed bytes for data so far, which may be empty
+  MethodTask<Buffer> write(Process* p, std::shared_ptr<Stream> stream,
+                           Buffer data);
+  // the rest of the compressed bytes
+  Buffer finish(Stream& stream);
+
+  // one shot compression
+  static Buffer compress(Encoding encoding, int level, void const* data,
+                         size_t len);
+
+  Stats const& stats() const { return stats_; }
+
+private:
+  struct CacheEntry {
+    std::string body;
+    Encoding encoding;
+    Buffer compressed;
+  };
+  using CacheList = std::list<CacheEntry>;
+
+  // Runs fn on the pool, resuming p once it is done. Buffers are only ever
+  // touched on the scheduler thread, so fn works on bytes it owns and its
+  // result is made into a Buffer after p resumes.
+  MethodTask<Buffer> offload(Process* p,
+                             std::function<std::vector<unsigned char>()> fn);
+  void remember(std::string body, Encoding encoding, Buffer compressed);
+
+  Options const options_;
+  Stats stats_;
+  std::unique_ptr<boost::asio::thread_pool> pool_;
+  // most recently used at the front
+  CacheList lru_;
+  std::unordered_multimap<size_t, CacheList::iterator> index_;
+};
+}
@@ -0,0 +1,105 @@
+#include "ResponseCache.h"
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+Www::ResponseCache::ResponseCache() : ResponseCache(Options()) {}
+
+Www::ResponseCache::ResponseCache(Options options)
+    : options_(std::move(options)) {}
+
+std::string const& Www::ResponseCache::makeKey(RequestView const& req,
+                                               string_view variant) {
+  key_.clear();
+  key_.append(req.methodString.data(), req.methodString.size());
+  key_ += ' ';
+  key_.append(req.target.data(), req.target.size());
+  key_ += ' ';
+  key_ += char('0' + req.version / 10);
+  key_ += char('0' + req.version % 10);
+  for (auto f : options_.keyFields) {
+    key_ += '\n';
+    if (auto v = req.find(f)) {
+      key_.append(v->data(), v->size());
+    }
+  }
+  key_ += '\n';
+  key_.append(variant.data(), variant.size());
+  return key_;
+}
+
+std::optional<Www::SerializedResponse>
+Www::ResponseCache::lookup(RequestView const& req, TimePoint now,
+                           string_view variant) {
+  auto it = index_.find(makeKey(req, variant));
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return {};
+  }
+  if (it->second->expires <= now) {
+    ++stats_.expired;
+    ++stats_.misses;
+    erase(it->second);
+    return {};
+  }
+  ++stats_.hits;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->response;
+}
+
+void Www::ResponseCache::store(RequestView const& req,
+                               SerializedResponse response,
+                               TimePoint expires, string_view variant) {
+  auto const& key = makeKey(req, variant);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    erase(it->second);
+  }
+  while (!lru_.empty() && index_.size() >= options_.maxEntries) {
+    ++stats_.evicted;
+    erase(std::prev(lru_.end()));
+  }
+  if (!options_.maxEntries) {
+    return;
+  }
+  ++stats_.stores;
+  lru_.push_front(Entry{key, req.method,
+                        std::string(req.target.data(), req.target.size()),
+                        std::move(response), expires});
+  index_.emplace(key, lru_.begin());
+}
+
+void Www::ResponseCache::invalidate(http::verb method, string_view target) {
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    auto next = std::next(it);
+    if (it->method == method && it->target == target) {
+      ++stats_.invalidated;
+      erase(it);
+    }
+    it = next;
+  }
+}
+
+void Www::ResponseCache::invalidatePrefix(string_view prefix) {
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    auto next = std::next(it);
+    if (string_view(it->target).starts_with(prefix)) {
+      ++stats_.invalidated;
+      erase(it);
+    }
+    it = next;
+  }
+}
+
+void Www::ResponseCache::clear() {
+  stats_.invalidated += index_.size();
+  index_.clear();
+  lru_.clear();
+}
+
+void Www::ResponseCache::erase(EntryList::iterator it) {
+  index_.erase(it->key);
+  lru_.erase(it);
+}
+}
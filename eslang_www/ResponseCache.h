@@ -0,0 +1,74 @@
+#pragma once
+#include "Www.h"
+
+#include <list>
+#include <unordered_map>
+
+namespace s {
+
+// In process cache of serialized responses, for hot and mostly static
+// endpoints. Share one between sessions (or servers) through
+// Server::ServerOptions.
+// Entries are keyed on method, target, HTTP version and the values of
+// Options::keyFields in the request. Hits hand out the same refcounted
+// Buffers to every connection.
+class Www::ResponseCache : NonMovable {
+public:
+  using string_view = boost::beast::string_view;
+
+  struct Options {
+    size_t maxEntries = 1024;
+    // request fields that change the response, eg Accept-Encoding
+    std::vector<boost::beast::http::field> keyFields;
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t expired = 0;
+    uint64_t evicted = 0;
+    uint64_t invalidated = 0;
+  };
+
+  ResponseCache();
+  explicit ResponseCache(Options options);
+
+  // variant tells apart responses to the same request that the server
+  // changes on the way out, eg the Content-Encoding it picked
+  std::optional<SerializedResponse> lookup(RequestView const& req,
+                                           TimePoint now,
+                                           string_view variant = {});
+  void store(RequestView const& req, SerializedResponse response,
+             TimePoint expires, string_view variant = {});
+
+  void invalidate(boost::beast::http::verb method, string_view target);
+  // anything whose target starts with prefix
+  void invalidatePrefix(string_view prefix);
+  void clear();
+
+  size_t size() const { return index_.size(); }
+  Stats const& stats() const { return stats_; }
+
+private:
+  struct Entry {
+    std::string key;
+    boost::beast::http::verb method;
+    std::string target;
+    SerializedResponse response;
+    TimePoint expires;
+  };
+  using EntryList = std::list<Entry>;
+
+  std::string const& makeKey(RequestView const& req, string_view variant);
+  void erase(EntryList::iterator it);
+
+  Options const options_;
+  Stats stats_;
+  // most recently used at the front
+  EntryList lru_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+  // reused so that lookups do not allocate
+  std::string key_;
+};
+}
@@ -0,0 +1,231 @@
+#include "Router.h"
+#include <algorithm>
+#include <boost/beast/http.hpp>
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+namespace {
+class FunctionRoute : public Www::Router::IRoute {
+public:
+  explicit FunctionRoute(Www::Router::Handler fn) : fn_(std::move(fn)) {}
+  MethodTask<Www::Response> getResponse(
+      Process* p, Www::RequestView const& req,
+      Www::Router::Params const& params) override {
+    return fn_(p, req, params);
+  }
+
+private:
+  Www::Router::Handler fn_;
+};
+
+std::string_view toStd(boost::beast::string_view s) {
+  return std::string_view(s.data(), s.size());
+}
+
+boost::beast::string_view fromStd(std::string_view s) {
+  return boost::beast::string_view(s.data(), s.size());
+}
+
+// the path part of a request target
+std::string_view pathOf(boost::beast::string_view target) {
+  auto path = toStd(target);
+  return path.substr(0, path.find('?'));
+}
+
+std::string_view nextSegment(std::string_view& path) {
+  while (path.size() && path.front() == '/') {
+    path.remove_prefix(1);
+  }
+  auto const end = std::min(path.find('/'), path.size());
+  auto ret = path.substr(0, end);
+  path.remove_prefix(end);
+  return ret;
+}
+
+Www::Response makeError(http::status status, Www::RequestView const& req) {
+  Www::Response resp;
+  resp.message.result(status);
+  resp.message.set(http::field::content_type, "text/plain");
+  resp.message.body() = concatString(int(status), " ", status, " ",
+                                     std::string(req.target));
+  resp.message.prepare_payload();
+  return resp;
+}
+} // namespace
+
+std::optional<boost::beast::string_view>
+Www::Router::Params::find(string_view name) const {
+  for (auto const& [k, v] : values) {
+    if (k == name) {
+      return v;
+    }
+  }
+  return {};
+}
+
+GenTask<Buffer> Www::Router::IRoute::getChunked(Process*,
+                                                RequestView const& req,
+                                                Params const&) {
+  ESLANGEXCEPT("Route does not implement getChunked for ", req.toString());
+}
+
+std::string_view Www::Router::intern(std::string_view s) {
+  strings_.emplace_back(s);
+  return strings_.back();
+}
+
+void Www::Router::add(http::verb method, string_view pattern,
+                      Handler handler) {
+  add(method, pattern, std::make_shared<FunctionRoute>(std::move(handler)));
+}
+
+void Www::Router::add(http::verb method, string_view pattern,
+                      std::shared_ptr<IRoute> route) {
+  uint32_t node = 0;
+  auto path = toStd(pattern);
+  // nodes_ grows as we go, so only hold on to indices
+  auto child = [&](std::optional<uint32_t> Node::*slot,
+                   std::string_view name) {
+    if (!(nodes_[node].*slot)) {
+      nodes_.emplace_back();
+      nodes_.back().name = intern(name);
+      nodes_[node].*slot = nodes_.size() - 1;
+    } else if (nodes_[*(nodes_[node].*slot)].name != name) {
+      ESLANGEXCEPT("Route ", pattern, " conflicts with the existing name ",
+                   nodes_[*(nodes_[node].*slot)].name);
+    }
+    return *(nodes_[node].*slot);
+  };
+  for (auto seg = nextSegment(path); seg.size(); seg = nextSegment(path)) {
+    if (seg.front() == ':') {
+      node = child(&Node::param, seg.substr(1));
+    } else if (seg.front() == '*') {
+      if (nextSegment(path).size()) {
+        ESLANGEXCEPT("Route ", pattern, " has segments after a wildcard");
+      }
+      node = child(&Node::wildcard, seg.substr(1));
+    } else {
+      auto it = nodes_[node].literals.find(seg);
+      if (it == nodes_[node].literals.end()) {
+        nodes_.emplace_back();
+        it = nodes_[node].literals.emplace(intern(seg), nodes_.size() - 1).first;
+      }
+      node = it->second;
+    }
+  }
+  for (auto const& r : nodes_[node].routes) {
+    if (r.first == method) {
+      ESLANGEXCEPT("Duplicate route ", http::to_string(method), " ", pattern);
+    }
+  }
+  nodes_[node].routes.emplace_back(method, std::move(route));
+  ++routes_;
+}
+
+Www::Router::IRoute* Www::Router::routeFor(Node const& n, http::verb method,
+                                           Methods* allow) const {
+  for (auto const& r : n.routes) {
+    if (r.first == method) {
+      return r.second.get();
+    }
+  }
+  if (allow) {
+    for (auto const& r : n.routes) {
+      if (std::find(allow->begin(), allow->end(), r.first) == allow->end()) {
+        allow->push_back(r.first);
+      }
+    }
+  }
+  return nullptr;
+}
+
+Www::Router::IRoute* Www::Router::find(uint32_t node, std::string_view path,
+                                       http::verb method, Params& params,
+                                       Methods* allow) const {
+  auto const& n = nodes_[node];
+  auto rest = path;
+  auto const seg = nextSegment(rest);
+  size_t const mark = params.values.size();
+  if (seg.empty()) {
+    if (auto* route = routeFor(n, method, allow)) {
+      return route;
+    }
+    if (n.wildcard) {
+      params.values.emplace_back(fromStd(nodes_[*n.wildcard].name),
+                                 string_view());
+      if (auto* route = routeFor(nodes_[*n.wildcard], method, allow)) {
+        return route;
+      }
+      params.values.resize(mark);
+    }
+    return nullptr;
+  }
+  auto it = n.literals.find(seg);
+  if (it != n.literals.end()) {
+    if (auto* route = find(it->second, rest, method, params, allow)) {
+      return route;
+    }
+  }
+  if (n.param) {
+    params.values.emplace_back(fromStd(nodes_[*n.param].name), fromStd(seg));
+    if (auto* route = find(*n.param, rest, method, params, allow)) {
+      return route;
+    }
+    params.values.resize(mark);
+  }
+  if (n.wildcard) {
+    // from the start of this segment, without the leading '/'
+    params.values.emplace_back(
+        fromStd(nodes_[*n.wildcard].name),
+        fromStd(std::string_view(seg.data(), path.data() + path.size() -
+                                                 seg.data())));
+    if (auto* route = routeFor(nodes_[*n.wildcard], method, allow)) {
+      return route;
+    }
+    params.values.resize(mark);
+  }
+  return nullptr;
+}
+
+Www::Router::IRoute* Www::Router::match(http::verb method, string_view target,
+                                        Params& params) const {
+  return find(0, pathOf(target), method, params, nullptr);
+}
+
+MethodTask<Www::Response> Www::Router::getResponse(Process* p,
+                                                   RequestView const& req) {
+  Params params;
+  Methods allow;
+  auto* route = find(0, pathOf(req.target), req.method, params, &allow);
+  if (!route && allow.empty()) {
+    co_return makeError(http::status::not_found, req);
+  }
+  if (!route) {
+    std::string allowed;
+    for (auto m : allow) {
+      if (allowed.size()) {
+        allowed += ", ";
+      }
+      allowed += std::string(http::to_string(m));
+    }
+    auto resp = makeError(http::status::method_not_allowed, req);
+    resp.message.set(http::field::allow, allowed);
+    co_return resp;
+  }
+  co_return std::move(co_await route->getResponse(p, req, params));
+}
+
+GenTask<Buffer> Www::Router::getChunked(Process* p, RequestView const& req) {
+  Params params;
+  auto* route = match(req.method, req.target, params);
+  if (!route) {
+    ESLANGEXCEPT("No route for chunked response to ", req.toString());
+  }
+  auto chunks = route->getChunked(p, req, params);
+  while (co_await chunks.next()) {
+    co_yield std::move(chunks.take());
+  }
+}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "Www.h"
+
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+namespace s {
+
+// Dispatches requests by method and path to registered routes.
+// Patterns are split on '/', and each segment is one of:
+//   literal   matched exactly
+//   :name     matches any one segment, captured as name
+//   *name     matches the rest of the path (possibly empty), captured as name
+// eg "/users/:id/files/*path".
+// Routes are compiled into a trie of segments with a hash map of literals per
+// node, so matching costs O(path length) however many routes there are.
+// Literals win over :params, which win over *wildcards, falling back to the
+// less specific branch if the more specific one does not match the path or
+// has no route for the method.
+// The query string is ignored. Unmatched paths get a 404, and paths that only
+// match with other methods get a 405 listing all of them.
+class Www::Router : public Server::IHandler {
+public:
+  using string_view = boost::beast::string_view;
+
+  // captured path parameters, as views into the request target
+  struct Params {
+    boost::container::small_vector<std::pair<string_view, string_view>, 4>
+        values;
+    std::optional<string_view> find(string_view name) const;
+  };
+
+  class IRoute {
+  public:
+    virtual ~IRoute() = default;
+    virtual MethodTask<Response> getResponse(Process*, RequestView const&,
+                                             Params const&) = 0;
+    virtual GenTask<Buffer> getChunked(Process*, RequestView const&,
+                                       Params const&);
+  };
+
+  using Handler = std::function<MethodTask<Response>(
+      Process*, RequestView const&, Params const&)>;
+
+  // throws if the pattern is malformed, or already has a route for method
+  void add(boost::beast::http::verb method, string_view pattern,
+           std::shared_ptr<IRoute> route);
+  void add(boost::beast::http::verb method, string_view pattern,
+           Handler handler);
+
+  size_t size() const { return routes_; }
+
+  // the route for method and target (and its parameters), if there is one
+  IRoute* match(boost::beast::http::verb method, string_view target,
+                Params& params) const;
+
+  MethodTask<Response> getResponse(Process*, RequestView const&) override;
+  GenTask<Buffer> getChunked(Process*, RequestView const&) override;
+
+private:
+  struct Node {
+    std::unordered_map<std::string_view, uint32_t> literals;
+    std::optional<uint32_t> param;
+    std::optional<uint32_t> wildcard;
+    // the name of the segment leading here if it is a :param or *wildcard
+    std::string_view name;
+    boost::container::small_vector<
+        std::pair<boost::beast::http::verb, std::shared_ptr<IRoute>>, 2>
+        routes;
+  };
+
+  using Methods =
+      boost::container::small_vector<boost::beast::http::verb, 4>;
+
+  // the most specific route for method that path matches from node, or
+  // nullptr. If allow is set, the methods of routes that match path but not
+  // method are added to it.
+  IRoute* find(uint32_t node, std::string_view path,
+               boost::beast::http::verb method, Params& params,
+               Methods* allow) const;
+  IRoute* routeFor(Node const& n, boost::beast::http::verb method,
+                   Methods* allow) const;
+  std::string_view intern(std::string_view s);
+
+  std::vector<Node> nodes_{1};
+  // stable storage for the keys and names in nodes_
+  std::deque<std::string> strings_;
+  size_t routes_ = 0;
+};
+}
@@ -0,0 +1,224 @@
+#include "WebSocket.h"
+#include <cstring>
+#include <openssl/evp.h>
+
+namespace s {
+
+namespace {
+bool isControl(WebSocket::Opcode opcode) { return uint8_t(opcode) & 0x8; }
+
+bool isKnown(WebSocket::Opcode opcode) {
+  switch (opcode) {
+  case WebSocket::Opcode::Continuation:
+  case WebSocket::Opcode::Text:
+  case WebSocket::Opcode::Binary:
+  case WebSocket::Opcode::Close:
+  case WebSocket::Opcode::Ping:
+  case WebSocket::Opcode::Pong:
+    return true;
+  }
+  return false;
+}
+
+Buffer serializeFrame(WebSocket::Opcode opcode, unsigned char const* payload,
+                      size_t len) {
+  std::vector<unsigned char> frame;
+  frame.reserve(10 + len);
+  frame.push_back(0x80 | uint8_t(opcode));
+  if (len < 126) {
+    frame.push_back(len);
+  } else if (len <= 0xffff) {
+    frame.push_back(126);
+    frame.push_back(len >> 8);
+    frame.push_back(len);
+  } else {
+    frame.push_back(127);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      frame.push_back(uint64_t(len) >> shift);
+    }
+  }
+  frame.insert(frame.end(), payload, payload + len);
+  return Buffer::make(std::move(frame));
+}
+} // namespace
+
+void WebSocket::FrameParser::push(Buffer data) {
+  if (data.size()) {
+    buffered_ += data.size();
+    pending_.push_back(std::move(data));
+  }
+}
+
+void WebSocket::FrameParser::peek(unsigned char* out, size_t n) const {
+  for (auto const& b : pending_) {
+    size_t const len = std::min(n, b.size());
+    std::memcpy(out, b.data(), len);
+    out += len;
+    n -= len;
+    if (!n) {
+      return;
+    }
+  }
+}
+
+void WebSocket::FrameParser::consume(size_t n) {
+  buffered_ -= n;
+  while (n) {
+    auto& front = pending_.front();
+    size_t const len = std::min(n, front.size());
+    front.consume(len);
+    n -= len;
+    if (!front.size()) {
+      pending_.pop_front();
+    }
+  }
+}
+
+Buffer WebSocket::FrameParser::take(size_t n) {
+  if (pending_.empty()) {
+    return Buffer::makeCopy(nullptr, 0);
+  }
+  if (pending_.front().size() >= n) {
+    auto ret = pending_.front().slice(0, n);
+    consume(n);
+    return ret;
+  }
+  BufferCollection pieces;
+  size_t left = n;
+  for (auto it = pending_.begin(); left; ++it) {
+    size_t const len = std::min(left, it->size());
+    pieces.buffers.push_back(it->slice(0, len));
+    left -= len;
+  }
+  consume(n);
+  return pieces.combine();
+}
+
+std::optional<WebSocket::Frame> WebSocket::FrameParser::next() {
+  if (buffered_ < 2) {
+    return {};
+  }
+  unsigned char head[14];
+  peek(head, 2);
+  if (head[0] & 0x70) {
+    throw ProtocolViolation(ProtocolError, "Reserved bits set");
+  }
+  bool const fin = head[0] & 0x80;
+  auto const opcode = Opcode(head[0] & 0x0f);
+  if (!isKnown(opcode)) {
+    throw ProtocolViolation(ProtocolError,
+                            concatString("Bad opcode ", int(opcode)));
+  }
+  // clients always mask
+  if (!(head[1] & 0x80)) {
+    throw ProtocolViolation(ProtocolError, "Unmasked frame");
+  }
+  uint64_t len = head[1] & 0x7f;
+  size_t header = 2;
+  if (len == 126) {
+    header += 2;
+  } else if (len == 127) {
+    header += 8;
+  }
+  header += 4;
+  if (buffered_ < header) {
+    return {};
+  }
+  peek(head, header);
+  if (len >= 126) {
+    len = 0;
+    for (size_t i = 2; i < header - 4; ++i) {
+      len = (len << 8) | head[i];
+    }
+  }
+  if (isControl(opcode) && (!fin || len > 125)) {
+    throw ProtocolViolation(ProtocolError, "Bad control frame");
+  }
+  if (len > maxPayload_) {
+    throw ProtocolViolation(MessageTooBig,
+                            concatString("Frame of ", len, " bytes"));
+  }
+  if (buffered_ < header + len) {
+    return {};
+  }
+  uint32_t key;
+  std::memcpy(&key, head + header - 4, 4);
+  consume(header);
+  Buffer payload = take(len);
+  mask(payload.data(), payload.size(), key);
+  return Frame{fin, opcode, std::move(payload)};
+}
+
+Buffer WebSocket::makeFrame(Opcode opcode, Buffer const& payload) {
+  return serializeFrame(opcode, payload.data(), payload.size());
+}
+
+Buffer WebSocket::makeFrame(Opcode opcode, boost::beast::string_view payload) {
+  return serializeFrame(
+      opcode, reinterpret_cast<unsigned char const*>(payload.data()),
+      payload.size());
+}
+
+Buffer WebSocket::makeClose(uint16_t code, boost::beast::string_view reason) {
+  std::string payload;
+  payload.push_back(char(code >> 8));
+  payload.push_back(char(code));
+  // control frames are at most 125 bytes, and the reason has to stay valid
+  // UTF-8, so a cut one ends before the code point it would split
+  size_t len = std::min<size_t>(reason.size(), 123);
+  if (len < reason.size()) {
+    while (len && (uint8_t(reason[len]) & 0xc0) == 0x80) {
+      --len;
+    }
+  }
+  payload.append(reason.data(), len);
+  return makeFrame(Opcode::Close, payload);
+}
+
+std::string WebSocket::acceptKey(boost::beast::string_view key) {
+  static char const guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  std::string in(key.data(), key.size());
+  in += guid;
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len = 0;
+  if (!EVP_Digest(in.data(), in.size(), digest, &digest_len, EVP_sha1(),
+                  nullptr)) {
+    ESLANGEXCEPT("SHA1 failed");
+  }
+  // base64 of the 20 byte digest is 28 characters
+  unsigned char out[32];
+  int const out_len = EVP_EncodeBlock(out, digest, digest_len);
+  return std::string(reinterpret_cast<char const*>(out), out_len);
+}
+
+void WebSocket::mask(unsigned char* data, size_t len, uint32_t key) {
+  uint64_t wide = key;
+  wide |= wide << 32;
+  size_t i = 0;
+  for (; i + sizeof(wide) <= len; i += sizeof(wide)) {
+    uint64_t v;
+    std::memcpy(&v, data + i, sizeof(v));
+    v ^= wide;
+    std::memcpy(data + i, &v, sizeof(v));
+  }
+  auto const* k = reinterpret_cast<unsigned char const*>(&key);
+  for (; i < len; ++i) {
+    data[i] ^= k[i % 4];
+  }
+}
+
+WaitingMaybe WebSocket::send(Process* sender, Connection const& c,
+                             Buffer frame) {
+  return Tcp::send(sender, c.socket, std::move(frame));
+}
+
+MethodTask<> WebSocket::sendThrottled(Process* sender, Connection const& c,
+                                      Buffer frame) {
+  return Tcp::sendThrottled(sender, c.socket, std::move(frame));
+}
+
+void WebSocket::close(Process* sender, Connection const& c, uint16_t code,
+                      std::string reason) {
+  sender->send(c.closer, CloseRequest{code, std::move(reason)});
+}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <eslang/Context.h>
+#include <eslang_io/Tcp.h>
+
+#include <boost/beast/core/string.hpp>
+#include <deque>
+
+namespace s {
+
+// WebSocket (RFC 6455) framing for connections upgraded by Www::Server.
+// Frames are parsed straight out of the Tcp::ReceiveData buffers: a payload
+// that arrived in one read is a slice of that read, unmasked in place, so it
+// is only copied when it was split over reads (or over fragments).
+class WebSocket {
+public:
+  enum class Opcode : uint8_t {
+    Continuation = 0,
+    Text = 1,
+    Binary = 2,
+    Close = 8,
+    Ping = 9,
+    Pong = 10,
+  };
+
+  // close status codes that we send
+  enum CloseCode : uint16_t {
+    NormalClosure = 1000,
+    ProtocolError = 1002,
+    MessageTooBig = 1009,
+  };
+
+  struct CloseRequest {
+    uint16_t code;
+    std::string reason;
+  };
+
+  // an upgraded connection. Writes go straight to the socket, and the session
+  // owns the reading side (and the close handshake)
+  struct Connection {
+    Tcp::Socket socket;
+    TSendAddress<CloseRequest> closer;
+    Pid session() const { return closer.pid(); }
+  };
+
+  // a whole (reassembled) message from a client. Pings and pongs are answered
+  // by the session, and a Close message (with the status code and reason as
+  // its data) is the last one a connection delivers
+  struct Message {
+    Connection connection;
+    Opcode opcode;
+    Buffer data;
+  };
+
+  // where an accepted connection delivers its messages, see
+  // Www::Server::IHandler::acceptWebSocket
+  struct Accept {
+    explicit Accept(TSendAddress<Message> messages)
+        : messages(std::move(messages)) {}
+    TSendAddress<Message> messages;
+    // told the session pid when the connection is gone, however it went
+    std::optional<TSendAddress<Pid>> closed;
+    // sent back in the Sec-WebSocket-Protocol header
+    std::optional<std::string> protocol;
+  };
+
+  class ProtocolViolation : public EslangException {
+  public:
+    ProtocolViolation(CloseCode code, std::string what)
+        : EslangException(std::move(what)), code(code) {}
+    CloseCode code;
+  };
+
+  struct Frame {
+    bool fin;
+    Opcode opcode;
+    Buffer payload;
+  };
+
+  // Splits the byte stream from a client into unmasked frames.
+  class FrameParser {
+  public:
+    explicit FrameParser(uint64_t max_payload) : maxPayload_(max_payload) {}
+
+    void push(Buffer data);
+
+    // The next complete frame, if there is one. throws ProtocolViolation
+    // for frames a server must not accept
+    std::optional<Frame> next();
+
+  private:
+    // copies the first n bytes buffered into out, without consuming them
+    void peek(unsigned char* out, size_t n) const;
+    void consume(size_t n);
+    // the next n bytes as one buffer, sliced if they are in one piece
+    Buffer take(size_t n);
+
+    uint64_t const maxPayload_;
+    std::deque<Buffer> pending_;
+    uint64_t buffered_ = 0;
+  };
+
+  // a complete unmasked (server to client) frame. Make it once and send the
+  // same Buffer to any number of connections
+  static Buffer makeFrame(Opcode opcode, Buffer const& payload);
+  static Buffer makeFrame(Opcode opcode, boost::beast::string_view payload);
+  static Buffer makeClose(uint16_t code,
+                          boost::beast::string_view reason = {});
+
+  // the Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key
+  static std::string acceptKey(boost::beast::string_view key);
+
+  // XORs data with a masking key (its 4 bytes as they are on the wire)
+  static void mask(unsigned char* data, size_t len, uint32_t key);
+
+  static WaitingMaybe send(Process* sender, Connection const& c, Buffer frame);
+  static MethodTask<> sendThrottled(Process* sender, Connection const& c,
+                                    Buffer frame);
+  // serializes one frame and writes it to each connection
+  template <class Connections>
+  static void broadcast(Process* sender, Connections const& connections,
+                        Opcode opcode, Buffer const& payload) {
+    Buffer const frame = makeFrame(opcode, payload);
+    for (Connection const& c : connections) {
+      send(sender, c, frame);
+    }
+  }
+  // Has the session start a close handshake. Messages keep arriving until
+  // the client's Close, and then the client disconnects.
+  static void close(Process* sender, Connection const& c,
+                    uint16_t code = NormalClosure, std::string reason = {});
+};
+}
@@ -1,8 +1,12 @@
 #include "Www.h"
+#include "Compression.h"
+#include "ResponseCache.h"
+#include "WwwParser.h"
 #include <boost/asio/buffer.hpp>
 #include <boost/beast.hpp>
 
 #include <eslang/Logging.h>
+#include <deque>
 
 namespace s {
 
@@ -18,170 +22,876 @@ std::string Www::Request::toString() const {
   return ss.str();
 }
 
+std::optional<boost::beast::string_view>
+Www::RequestView::find(http::field f) const {
+  for (auto const& field : fields) {
+    if (field.name == f) {
+      return field.value;
+    }
+  }
+  return {};
+}
+
+std::optional<boost::beast::string_view>
+Www::RequestView::find(string_view name) const {
+  for (auto const& field : fields) {
+    if (iequals(field.nameString, name)) {
+      return field.value;
+    }
+  }
+  return {};
+}
+
+Www::Request Www::RequestView::toRequest() const {
+  Request ret;
+  auto& m = ret.message;
+  if (method == http::verb::unknown) {
+    m.method_string(methodString);
+  } else {
+    m.method(method);
+  }
+  m.target(target);
+  m.version(version);
+  for (auto const& f : fields) {
+    if (f.name == http::field::unknown) {
+      m.insert(f.nameString, f.value);
+    } else {
+      m.insert(f.name, f.value);
+    }
+  }
+  m.body().assign(body.data(), body.size());
+  return ret;
+}
+
+std::string Www::RequestView::toString() const {
+  std::stringstream ss;
+  ss << methodString << " " << target;
+  if (auto h = find(http::field::host)) {
+    ss << " host:" << *h;
+  }
+  return ss.str();
+}
+
+BufferCollection Www::SerializedResponse::toBuffers(bool keep_alive) const {
+  static Buffer const keep_alive_tail =
+      Buffer::makeCopy(std::string("Connection: keep-alive\r\n\r\n"));
+  static Buffer const close_tail =
+      Buffer::makeCopy(std::string("Connection: close\r\n\r\n"));
+  static Buffer const crlf = Buffer::makeCopy(std::string("\r\n"));
+  BufferCollection ret;
+  ret.buffers.reserve(3);
+  ret.buffers.push_back(head);
+  // as message::keep_alive would have it, only saying what differs from the
+  // version's default
+  if (version >= 11) {
+    ret.buffers.push_back(keep_alive ? crlf : close_tail);
+  } else {
+    ret.buffers.push_back(keep_alive ? keep_alive_tail : crlf);
+  }
+  if (body) {
+    ret.buffers.push_back(*body);
+  }
+  return ret;
+}
+
+MethodTask<Www::Response>
+Www::Server::IHandler::getResponse(Process*, Request const& r) {
+  ESLANGEXCEPT("Handler does not implement getResponse for ", r.toString());
+}
+
+GenTask<Buffer> Www::Server::IHandler::getChunked(Process*,
+                                                  Request const& r) {
+  ESLANGEXCEPT("Handler does not implement getChunked for ", r.toString());
+}
+
+MethodTask<Www::Response>
+Www::Server::IHandler::getResponse(Process* p, RequestView const& view) {
+  Request const req = view.toRequest();
+  co_return std::move(co_await getResponse(p, req));
+}
+
+GenTask<Buffer> Www::Server::IHandler::getChunked(Process* p,
+                                                  RequestView const& view) {
+  Request const req = view.toRequest();
+  auto chunks = getChunked(p, req);
+  while (co_await chunks.next()) {
+    co_yield std::move(chunks.take());
+  }
+}
+
+bool Www::Server::IHandler::streamBody(RequestView const&) { return false; }
+
+MethodTask<Www::Response>
+Www::Server::IHandler::getStreamingResponse(Process*, RequestView const& head,
+                                            GenTask<Buffer>&) {
+  ESLANGEXCEPT("Handler does not implement getStreamingResponse for ",
+               head.toString());
+}
+
+std::optional<WebSocket::Accept>
+Www::Server::IHandler::acceptWebSocket(Process*, RequestView const&,
+                                       WebSocket::Connection const&) {
+  return {};
+}
+
 namespace {
-void checkOrThrow(error_code& ec) {
-  if (ec) {
-    ESLANGEXCEPT("Bad error code:", ec.message());
+// where a response ends up: straight onto the socket, or back to the session
+class IResponseSink {
+public:
+  virtual ~IResponseSink() = default;
+  virtual void write(BufferCollection buffers, bool last) = 0;
+};
+
+class SocketSink : public IResponseSink {
+public:
+  SocketSink(Process* p, Tcp::Socket const& s) : p_(p), s_(s) {}
+  void write(BufferCollection buffers, bool) override {
+    if (buffers.buffers.size()) {
+      Tcp::sendMany(p_, s_, std::move(buffers));
+    }
+  }
+
+private:
+  Process* p_;
+  Tcp::Socket const& s_;
+};
+
+BufferCollection makeChunk(Buffer data) {
+  static Buffer const crlf = Buffer::makeCopy(std::string("\r\n"));
+  std::stringstream ss;
+  ss << std::hex << data.size() << "\r\n";
+  BufferCollection ret;
+  ret.buffers.reserve(3);
+  ret.buffers.push_back(Buffer::makeCopy(ss.str()));
+  ret.buffers.push_back(std::move(data));
+  ret.buffers.push_back(crlf);
+  return ret;
+}
+
+// what responses pass through on their way out, shared by every session
+struct ResponseStages {
+  std::shared_ptr<Www::ResponseCache> cache;
+  std::shared_ptr<Www::Compression> compression;
+};
+
+// what tells apart cached responses to the same request
+boost::beast::string_view cacheVariant(ResponseStages const& stages,
+                                       Www::RequestView const& req) {
+  if (stages.compression) {
+    if (auto encoding = Www::Compression::negotiate(req)) {
+      return Www::Compression::name(*encoding);
+    }
+  }
+  return {};
+}
+
+MethodTask<> writeResponse(Process* p, Www::Server::IHandler& handler,
+                           ResponseStages const& stages,
+                           Www::RequestView const& req, Www::Response resp,
+                           IResponseSink& sink) {
+  resp.message.version(req.version);
+  resp.message.set(http::field::server, "Eslang");
+  auto* compression = stages.compression.get();
+  std::optional<Www::Compression::Encoding> encoding;
+  if (compression) {
+    encoding = Www::Compression::negotiate(req);
+  }
+  if (!resp.message.chunked()) {
+    std::optional<Buffer> compressed;
+    if (compression) {
+      compressed = co_await compression->compress(p, encoding, resp);
+    }
+    auto const cache_for = resp.cacheFor;
+    auto serialized = WwwParser::serialize(resp);
+    if (compressed) {
+      serialized.body = std::move(*compressed);
+    }
+    sink.write(serialized.toBuffers(req.keepAlive), true);
+    if (stages.cache && cache_for) {
+      stages.cache->store(req, std::move(serialized), p->now() + *cache_for,
+                          cacheVariant(stages, req));
+    }
+    co_return;
+  }
+  static Buffer const last_chunk = Buffer::makeCopy(std::string("0\r\n\r\n"));
+  resp.message.keep_alive(req.keepAlive);
+  std::shared_ptr<Www::Compression::Stream> stream;
+  if (compression) {
+    stream = compression->startStream(encoding, resp);
+  }
+  BufferCollection head;
+  auto header = WwwParser::convertHeaderOnly(resp);
+  while (co_await header.next()) {
+    head.buffers.push_back(std::move(header.take()));
+  }
+  sink.write(std::move(head), false);
+  auto chunks = handler.getChunked(p, req);
+  while (co_await chunks.next()) {
+    auto buff = std::move(chunks.take());
+    if (stream) {
+      buff = co_await compression->write(p, stream, std::move(buff));
+    }
+    // an empty chunk would end the response
+    if (buff.size()) {
+      sink.write(makeChunk(std::move(buff)), false);
+    }
+  }
+  if (stream) {
+    sink.write(makeChunk(compression->finish(*stream)), false);
   }
+  sink.write(BufferCollection{{last_chunk}}, true);
+}
+
+Www::Response statusResponse(http::status status) {
+  Www::Response resp;
+  resp.message.result(status);
+  resp.message.set(http::field::content_type, "text/plain");
+  resp.message.body() = concatString(int(status), " ", status);
+  resp.message.prepare_payload();
+  return resp;
 }
 
-template <class T> Buffer makeBuffer(T buff) {
-  return Buffer::makeCopy(boost::asio::buffer_cast<char const*>(buff),
-                          boost::asio::buffer_size(buff));
+// asking to switch to a WebSocket
+bool isUpgrade(Www::RequestView const& req) {
+  auto upgrade = req.find(http::field::upgrade);
+  if (!upgrade) {
+    return false;
+  }
+  for (auto const& token : http::token_list(*upgrade)) {
+    if (iequals(token, "websocket")) {
+      return true;
+    }
+  }
+  return false;
 }
 
-template <class T> GenTask<Buffer> makeBuffersFromSequence(T seq) {
-  for (auto buff : seq) {
-    co_yield Buffer::makeCopy(boost::asio::buffer_cast<char const*>(buff),
-                              boost::asio::buffer_size(buff));
+MethodTask<> respond(Process* p, Www::Server::IHandler& handler,
+                     ResponseStages const& stages, Www::RequestView const& req,
+                     IResponseSink& sink) {
+  if (stages.cache) {
+    if (auto hit =
+            stages.cache->lookup(req, p->now(), cacheVariant(stages, req))) {
+      sink.write(hit->toBuffers(req.keepAlive), true);
+      co_return;
+    }
   }
+  auto resp = co_await handler.getResponse(p, req);
+  co_await writeResponse(p, handler, stages, req, std::move(resp), sink);
 }
 
-class WwwParser : NonMovable {
+// part of the response to the seq'th request on a session
+struct ResponsePart {
+  uint64_t seq;
+  BufferCollection buffers;
+  bool last;
+  std::optional<std::string> error;
+};
+
+class PartSink : public IResponseSink {
 public:
-  GenTask<Www::Request> push(Buffer data) {
-    error_code ec;
-    do {
-      boost::asio::buffer_copy(
-          currentRead_.prepare(data.size()),
-          boost::asio::const_buffer(data.data(), data.size()));
-      size_t read =
-          parser_->put(boost::asio::buffer(data.data(), data.size()), ec);
-      currentRead_.consume(read);
-      if (ec == http::error::need_more) {
-        co_return;
-      }
-      checkOrThrow(ec);
-      if (parser_->is_done()) {
-        co_yield Www::Request{parser_->release()};
-        parser_.reset();
-        parser_.emplace();
-      }
-    } while (currentRead_.size());
+  PartSink(Process* p, TSendAddress<ResponsePart> to, uint64_t seq)
+      : p_(p), to_(to), seq_(seq) {}
+  void write(BufferCollection buffers, bool last) override {
+    p_->send(to_, ResponsePart{seq_, std::move(buffers), last, {}});
   }
 
-  struct SerializeVisitor {
-    SerializeVisitor(std::vector<Buffer>& buffs) : buffs(buffs) {}
-    std::vector<Buffer>& buffs;
-    size_t last = 0;
+private:
+  Process* p_;
+  TSendAddress<ResponsePart> to_;
+  uint64_t seq_;
+};
+
+// Handles one request for a session running with maxInFlight > 1. Not linked
+// to the session, if that has gone the response is just dropped. If the
+// handler throws this dies, and the session hears about it through
+// spawnNotify.
+class RequestRunner : public Process {
+public:
+  RequestRunner(ProcessArgs i, std::shared_ptr<Www::Server::IHandler> h,
+                ResponseStages stages, Www::RequestView req, uint64_t seq,
+                TSendAddress<ResponsePart> reply)
+      : Process(std::move(i)), handler_(std::move(h)),
+        stages_(std::move(stages)), req_(std::move(req)), seq_(seq),
+        reply_(reply) {}
 
-    template <class T> void operator()(error_code& ec, T b) {
-      checkOrThrow(ec);
-      last = 0;
-      for (auto const& buff : b) {
-        last += boost::asio::buffer_size(buff);
-        buffs.push_back(makeBuffer(buff));
-      }
+  ProcessTask run() {
+    PartSink sink(this, reply_, seq_);
+    co_await respond(this, *handler_, stages_, req_, sink);
+  }
+
+private:
+  std::shared_ptr<Www::Server::IHandler> handler_;
+  ResponseStages stages_;
+  Www::RequestView req_;
+  uint64_t seq_;
+  TSendAddress<ResponsePart> reply_;
+};
+struct WorkItem {
+  Www::RequestView req;
+  uint64_t seq;
+  TSendAddress<ResponsePart> reply;
+};
+} // namespace
+
+class Www::Server::Pool : public std::enable_shared_from_this<Pool> {
+public:
+  Pool(std::shared_ptr<IHandler> handler, PoolOptions options,
+       ResponseStages stages)
+      : handler_(std::move(handler)), options_(std::move(options)),
+        stages_(std::move(stages)), outstanding_(options_.workers) {
+    if (!options_.workers) {
+      ESLANGEXCEPT("Handler pool needs at least one worker");
     }
-  };
+  }
 
-  GenTask<Buffer> convert(Www::Response& response_in) {
-    Www::Response response(std::move(response_in));
-    http::response_serializer<http::string_body> serializer(
-        std::move(response.message));
-    std::vector<Buffer> buffs;
-    error_code ec;
-    SerializeVisitor visitor(buffs);
-    while (!serializer.is_done()) {
-      visitor.last = 0;
-      serializer.next(ec, visitor);
-      for (auto&& b : buffs) {
-        co_yield std::move(b);
-      }
-      buffs.clear();
-      serializer.consume(visitor.last);
-    }
-  }
-
-  GenTask<Buffer> convertHeaderOnly(Www::Response const& response) {
-    http::response_serializer<http::string_body> serializer(
-        std::move(response.message));
-    std::vector<Buffer> buffs;
-    error_code ec;
-    SerializeVisitor visitor(buffs);
-    serializer.split(true);
-    while (!serializer.is_done()) {
-      visitor.last = 0;
-      serializer.next(ec, visitor);
-      for (auto&& b : buffs) {
-        co_yield std::move(b);
-      }
-      buffs.clear();
-      serializer.consume(visitor.last);
-      if (serializer.is_header_done()) {
-        co_return;
+  // spawns the workers, linked to parent which is told if any die
+  void start(Process* parent, TSendAddress<Pid> died);
+
+  void dispatch(Process* from, RequestView req, uint64_t seq,
+                TSendAddress<ResponsePart> reply) {
+    size_t const i = pick(req);
+    outstanding_[i].emplace_back(reply, seq);
+    from->send(workers_[i], WorkItem{std::move(req), seq, reply});
+  }
+
+  void done(size_t worker) { outstanding_[worker].pop_front(); }
+
+  // A handler threw, so the worker is dead along with everything queued for
+  // it. Fail those requests (their sessions answer them with a 500, as they
+  // would for a RequestRunner dying) and replace the worker.
+  void onDied(Process* parent, Pid pid);
+
+private:
+  size_t pick(RequestView const& req) {
+    switch (options_.routing) {
+    case PoolRouting::RoundRobin:
+      return next_++ % workers_.size();
+    case PoolRouting::LeastLoaded: {
+      // start from a different worker each time, so that ties are spread out
+      size_t best = next_++ % workers_.size();
+      for (size_t i = 0; i < workers_.size(); ++i) {
+        if (outstanding_[i].size() < outstanding_[best].size()) {
+          best = i;
+        }
       }
+      return best;
+    }
+    case PoolRouting::Hash: {
+      auto key = options_.hashKey ? options_.hashKey(req) : req.target;
+      return std::hash<std::string_view>()(
+                 std::string_view(key.data(), key.size())) %
+             workers_.size();
     }
+    }
+    ESLANGEXCEPT("Bad pool routing");
   }
 
-private:
-  multi_buffer currentRead_;
-  Www::Request current_;
+  void spawnWorker(Process* parent, size_t i);
+
+  std::shared_ptr<IHandler> handler_;
+  PoolOptions const options_;
+  ResponseStages stages_;
+  std::optional<TSendAddress<Pid>> died_;
+  std::vector<TSendAddress<WorkItem>> workers_;
+  // requests sent to each worker that it has not finished, oldest first
+  std::vector<std::deque<std::pair<TSendAddress<ResponsePart>, uint64_t>>>
+      outstanding_;
+  size_t next_ = 0;
+};
+
+namespace {
+// A long lived process handling requests for sessions, one at a time.
+// Handler exceptions kill it, see Pool::onDied
+class PoolWorker : public Process {
+public:
+  PoolWorker(ProcessArgs i, std::shared_ptr<Www::Server::IHandler> h,
+             ResponseStages stages, std::shared_ptr<Www::Server::Pool> pool,
+             size_t index)
+      : Process(std::move(i)), handler_(std::move(h)),
+        stages_(std::move(stages)), pool_(std::move(pool)), index_(index) {}
+
+  Slot<WorkItem> work{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto item = co_await recv(work);
+      PartSink sink(this, item.reply, item.seq);
+      co_await respond(this, *handler_, stages_, item.req, sink);
+      pool_->done(index_);
+    }
+  }
 
-  // beast doesnt allow me to recreate parser without the optional trick.
-  // SAD!
-  std::optional<http::request_parser<http::string_body>> parser_{
-      http::request_parser<http::string_body>{}};
+private:
+  std::shared_ptr<Www::Server::IHandler> handler_;
+  ResponseStages stages_;
+  std::shared_ptr<Www::Server::Pool> pool_;
+  size_t const index_;
 };
+} // namespace
+
+void Www::Server::Pool::start(Process* parent, TSendAddress<Pid> died) {
+  died_ = died;
+  for (size_t i = 0; i < options_.workers; ++i) {
+    spawnWorker(parent, i);
+  }
+}
+
+void Www::Server::Pool::spawnWorker(Process* parent, size_t i) {
+  auto handler = options_.makeHandler ? options_.makeHandler(i) : handler_;
+  auto pid = parent->spawnLinkNotify<PoolWorker>(
+      *died_, std::move(handler), stages_, shared_from_this(), i);
+  auto address = parent->makeSendAddress(pid, &PoolWorker::work);
+  if (i < workers_.size()) {
+    workers_[i] = address;
+  } else {
+    workers_.push_back(address);
+  }
+}
+
+void Www::Server::Pool::onDied(Process* parent, Pid pid) {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (workers_[i].pid() == pid) {
+      ESLOG(LL::INFO, "Handler pool worker ", i, " died, failing ",
+            outstanding_[i].size(), " requests");
+      for (auto const& [reply, seq] : outstanding_[i]) {
+        parent->send(reply, ResponsePart{seq, {}, true, "handler failed"});
+      }
+      outstanding_[i].clear();
+      spawnWorker(parent, i);
+      return;
+    }
+  }
 }
 
 class SessionRunner : public Process {
 public:
   Tcp::Socket s_;
   std::shared_ptr<Www::Server::IHandler> handler;
+  Www::Server::ServerOptions options;
+  std::shared_ptr<Www::Server::Pool> pool;
+  ResponseStages const stages;
   SessionRunner(ProcessArgs i, Tcp::Socket s,
-                std::shared_ptr<Www::Server::IHandler> h)
-      : Process(std::move(i)), s_(std::move(s)), handler(std::move(h)) {
+                std::shared_ptr<Www::Server::IHandler> h,
+                Www::Server::ServerOptions o,
+                std::shared_ptr<Www::Server::Pool> pool)
+      : Process(std::move(i)), s_(std::move(s)), handler(std::move(h)),
+        options(std::move(o)), pool(std::move(pool)),
+        stages{options.responseCache, options.compression} {
     link(s.pid);
   }
 
   Slot<Tcp::ReceiveData> recv{this};
+  Slot<WebSocket::CloseRequest> closeRequests{this};
+  Slot<ResponsePart> parts{this};
+  // RequestRunners that have finished
+  Slot<Pid> runnerDone{this};
+
   ProcessTask run() {
     Tcp::initRecvSocket(this, s_, recv.address());
     WwwParser parser;
+    parser.setBodyLimit(options.maxBodySize);
+    parser.setStreamBody([h = handler.get()](Www::RequestView const& head) {
+      return h->streamBody(head);
+    });
+    if (options.maxInFlight > 1 || pool) {
+      co_await runConcurrent(parser);
+    } else {
+      co_await runInline(parser);
+    }
+    if (tooLarge_) {
+      co_await rejectTooLarge();
+    }
+  }
+
+private:
+  // responses that have been dispatched but not completely written, in
+  // request order. window_[0] is request number written_
+  struct PendingResponse {
+    std::vector<BufferCollection> parts;
+    // whether any of the response has come back
+    bool started = false;
+    bool done = false;
+    std::optional<Pid> runner;
+    // of the request, for answering it if its handler fails
+    unsigned version = 11;
+    bool keepAlive = true;
+  };
+  std::deque<PendingResponse> window_;
+  uint64_t written_ = 0;
+  // a request body was over maxBodySize, so we are done parsing
+  bool tooLarge_ = false;
+
+  // exceptions do not make it out of a coroutine that has suspended, so catch
+  // this where it happens
+  template <class Fn> auto untilTooLarge(Fn fn) -> decltype(fn()) {
+    try {
+      return fn();
+    } catch (WwwParser::BodyTooLarge const& e) {
+      ESLOG(LL::DEBUG, pid(), ": ", e.what());
+      tooLarge_ = true;
+      return {};
+    }
+  }
+
+  MethodTask<> runInline(WwwParser& parser) {
+    SocketSink sink(this, s_);
     bool keep_alive = true;
     while (keep_alive) {
       auto r = co_await Process::recv(recv);
-      auto recv = parser.push(std::move(r.data));
-      while (co_await recv.next()) {
-        auto& req = recv.take();
-        keep_alive |= req.message.keep_alive();
-        auto resp = co_await handler->getResponse(this, req);
-        resp.message.version(req.message.version());
-        resp.message.set(http::field::server, "Eslang");
-        resp.message.keep_alive(req.message.keep_alive());
-        bool const chunked = resp.message.chunked();
-        StreamBatcher sb(this, s_);
-        if (!chunked) {
-          for
-            co_await(auto buff : parser.convert(resp)) {
-              sb.push(std::move(buff));
-            }
+      parser.push(std::move(r.data));
+      while (auto req = untilTooLarge([&] { return parser.next(); })) {
+        keep_alive |= req->keepAlive;
+        if (isUpgrade(*req)) {
+          if (co_await upgrade(parser, *req, sink)) {
+            co_return;
+          }
+        } else if (parser.streamingBody()) {
+          co_await respondStreaming(parser, *req, sink);
+          if (tooLarge_) {
+            co_return;
+          }
         } else {
-          for
-            co_await(auto buff : parser.convertHeaderOnly(resp)) {
-              sb.push(std::move(buff));
-            }
-          for
-            co_await(auto buff : handler->getChunked(this, req)) {
-              ESLOG(LL::INFO, "get buffer size ", buff.size());
-              auto chunk = http::make_chunk(
-                  boost::asio::const_buffers_1(buff.data(), buff.size()));
-            for
-              co_await(auto b : makeBuffersFromSequence(chunk)) {
-                ESLOG(LL::INFO, "send buffer size ", b.size());
-                sb.push(std::move(b));
-              }
-            }
-          http::fields trailer;
-          for
-            co_await(
-                auto b
-                : makeBuffersFromSequence(http::make_chunk_last(trailer))) {
-              ESLOG(LL::INFO, "send last buffer size ", b.size());
-              sb.push(std::move(b));
+          co_await respond(this, *handler, stages, *req, sink);
+        }
+      }
+      if (tooLarge_) {
+        co_return;
+      }
+    }
+  }
+
+  GenTask<Buffer> readBody(WwwParser& parser) {
+    while (true) {
+      while (auto b = untilTooLarge([&] { return parser.nextBody(); })) {
+        co_yield std::move(*b);
+      }
+      if (tooLarge_ || parser.bodyDone()) {
+        co_return;
+      }
+      auto r = co_await Process::recv(recv);
+      parser.push(std::move(r.data));
+    }
+  }
+
+  MethodTask<> respondStreaming(WwwParser& parser,
+                                Www::RequestView const& head,
+                                IResponseSink& sink) {
+    auto body = readBody(parser);
+    auto resp = co_await handler->getStreamingResponse(this, head, body);
+    // the rest of the body is in the way of the next request
+    while (co_await body.next()) {
+    }
+    if (tooLarge_) {
+      co_return;
+    }
+    // not cached, as the response depends on the body
+    co_await writeResponse(this, *handler,
+                           ResponseStages{nullptr, stages.compression}, head,
+                           std::move(resp), sink);
+  }
+
+  // Answers a request whose body is over ServerOptions::maxBodySize. The
+  // parser cannot carry on after it, so once any responses still in flight
+  // are written, ignore the rest of the connection until the client closes it
+  MethodTask<> rejectTooLarge() {
+    while (!window_.empty()) {
+      co_await waitForParts();
+    }
+    auto resp = statusResponse(http::status::payload_too_large);
+    resp.message.set(http::field::server, "Eslang");
+    write(WwwParser::serialize(resp).toBuffers(false));
+    while (true) {
+      co_await Process::recv(recv);
+    }
+  }
+
+  // Switches the connection to WebSocket framing if the handler accepts it,
+  // after which the session only handles frames until the socket goes.
+  // Returns false if it is not upgraded, having written a response.
+  MethodTask<bool> upgrade(WwwParser& parser, Www::RequestView const& req,
+                           IResponseSink& sink) {
+    auto const key = req.find(http::field::sec_websocket_key);
+    if (req.method != http::verb::get || req.version < 11 || !key ||
+        req.find(http::field::sec_websocket_version) != string_view("13")) {
+      co_await writeResponse(this, *handler, {}, req,
+                             statusResponse(http::status::bad_request), sink);
+      co_return false;
+    }
+    WebSocket::Connection const connection{s_, closeRequests.address()};
+    auto accept = handler->acceptWebSocket(this, req, connection);
+    if (!accept) {
+      co_await writeResponse(this, *handler, {}, req,
+                             statusResponse(http::status::not_found), sink);
+      co_return false;
+    }
+    std::string head = concatString("HTTP/1.1 101 Switching Protocols\r\n"
+                                    "Server: Eslang\r\n"
+                                    "Upgrade: websocket\r\n"
+                                    "Connection: Upgrade\r\n"
+                                    "Sec-WebSocket-Accept: ",
+                                    WebSocket::acceptKey(*key), "\r\n");
+    if (accept->protocol) {
+      head += concatString("Sec-WebSocket-Protocol: ", *accept->protocol,
+                           "\r\n");
+    }
+    head += "\r\n";
+    Tcp::send(this, s_, Buffer::makeCopy(head));
+    if (accept->closed) {
+      addNotifyOnDie(*accept->closed);
+    }
+    ESLOG(LL::DEBUG, pid(), ": Upgraded to WebSocket");
+    co_await runWebSocket(parser.takeBuffered(), connection,
+                          accept->messages);
+    co_return true;
+  }
+
+  // a message being reassembled from fragments
+  struct Fragments {
+    std::optional<WebSocket::Opcode> opcode;
+    BufferCollection data;
+    uint64_t size = 0;
+  };
+
+  // The next whole message, if there is one, answering pings on the way.
+  // throws WebSocket::ProtocolViolation
+  std::optional<WebSocket::Message>
+  nextMessage(WebSocket::FrameParser& frames, Fragments& fragments,
+              WebSocket::Connection const& connection) {
+    using Opcode = WebSocket::Opcode;
+    while (auto frame = frames.next()) {
+      switch (frame->opcode) {
+      case Opcode::Ping:
+        WebSocket::send(this, connection,
+                        WebSocket::makeFrame(Opcode::Pong, frame->payload));
+        continue;
+      case Opcode::Pong:
+        continue;
+      case Opcode::Close:
+        return WebSocket::Message{connection, Opcode::Close,
+                                  std::move(frame->payload)};
+      case Opcode::Continuation:
+        if (!fragments.opcode) {
+          throw WebSocket::ProtocolViolation(WebSocket::ProtocolError,
+                                             "Unexpected continuation");
+        }
+        break;
+      default:
+        if (fragments.opcode) {
+          throw WebSocket::ProtocolViolation(WebSocket::ProtocolError,
+                                             "Expected a continuation");
+        }
+        if (frame->fin) {
+          // the common case, a message in one frame
+          return WebSocket::Message{connection, frame->opcode,
+                                    std::move(frame->payload)};
+        }
+        fragments.opcode = frame->opcode;
+      }
+      fragments.size += frame->payload.size();
+      if (fragments.size > options.maxBodySize) {
+        throw WebSocket::ProtocolViolation(
+            WebSocket::MessageTooBig,
+            concatString("Message of over ", fragments.size, " bytes"));
+      }
+      fragments.data.buffers.push_back(std::move(frame->payload));
+      if (frame->fin) {
+        WebSocket::Message ret{connection, *fragments.opcode,
+                               fragments.data.combine()};
+        fragments = Fragments();
+        return ret;
+      }
+    }
+    return {};
+  }
+
+  MethodTask<> runWebSocket(std::optional<Buffer> buffered,
+                            WebSocket::Connection const connection,
+                            TSendAddress<WebSocket::Message> to) {
+    WebSocket::FrameParser frames(options.maxBodySize);
+    if (buffered) {
+      frames.push(std::move(*buffered));
+    }
+    Fragments fragments;
+    bool close_sent = false;
+    while (true) {
+      std::optional<WebSocket::Message> message;
+      try {
+        message = nextMessage(frames, fragments, connection);
+      } catch (WebSocket::ProtocolViolation const& e) {
+        ESLOG(LL::DEBUG, pid(), ": ", e.what());
+        if (!close_sent) {
+          WebSocket::send(this, connection, WebSocket::makeClose(e.code));
+        }
+        break;
+      }
+      if (message) {
+        bool const closing = message->opcode == WebSocket::Opcode::Close;
+        if (closing && !close_sent) {
+          // echo the status code back
+          auto const& data = message->data;
+          WebSocket::send(this, connection,
+                          WebSocket::makeFrame(
+                              WebSocket::Opcode::Close,
+                              data.slice(0, std::min<size_t>(2, data.size()))));
+        }
+        co_await sendThrottled(to, std::move(*message));
+        if (closing) {
+          break;
+        }
+        continue;
+      }
+      auto [data, close] = co_await tryRecv(recv, closeRequests);
+      if (close && !close_sent) {
+        WebSocket::send(this, connection,
+                        WebSocket::makeClose(close->code, close->reason));
+        close_sent = true;
+      }
+      if (data) {
+        frames.push(std::move(data->data));
+      }
+    }
+    // the client disconnects once it has seen our Close, which kills us
+    while (true) {
+      co_await Process::recv(recv);
+    }
+  }
+
+  MethodTask<> runConcurrent(WwwParser& parser) {
+    uint64_t next_seq = 0;
+    while (true) {
+      while (window_.size() < options.maxInFlight) {
+        auto req = untilTooLarge([&] { return parser.next(); });
+        if (!req) {
+          break;
+        }
+        if (parser.streamingBody() || isUpgrade(*req)) {
+          // the body (or the rest of the connection) arrives through the
+          // session, so handle it here once everything before it has been
+          // written
+          while (!window_.empty()) {
+            co_await waitForParts();
+          }
+          SocketSink sink(this, s_);
+          if (!parser.streamingBody()) {
+            if (co_await upgrade(parser, *req, sink)) {
+              co_return;
             }
+            continue;
+          }
+          co_await respondStreaming(parser, *req, sink);
+          if (tooLarge_) {
+            break;
+          }
+          continue;
+        }
+        dispatch(std::move(*req), next_seq++);
+      }
+      if (tooLarge_) {
+        co_return;
+      }
+      if (window_.size() < options.maxInFlight) {
+        auto [data, part, done] = co_await tryRecv(recv, parts, runnerDone);
+        if (data) {
+          parser.push(std::move(data->data));
+        }
+        if (part) {
+          onPart(std::move(*part));
+        }
+        if (done) {
+          onRunnerDone(*done);
+        }
+      } else {
+        // leave the socket data queued, so that it stops reading
+        co_await waitForParts();
+      }
+    }
+  }
+
+  // handle whatever the runners send next
+  MethodTask<> waitForParts() {
+    auto [part, done] = co_await tryRecv(parts, runnerDone);
+    if (part) {
+      onPart(std::move(*part));
+    }
+    if (done) {
+      onRunnerDone(*done);
+    }
+  }
+
+  void dispatch(Www::RequestView req, uint64_t seq) {
+    window_.emplace_back();
+    window_.back().version = req.version;
+    window_.back().keepAlive = req.keepAlive;
+    if (auto* cache = stages.cache.get()) {
+      if (auto hit = cache->lookup(req, now(), cacheVariant(stages, req))) {
+        onPart(ResponsePart{seq, hit->toBuffers(req.keepAlive), true, {}});
+        return;
+      }
+    }
+    if (pool) {
+      pool->dispatch(this, std::move(req), seq, parts.address());
+      return;
+    }
+    window_.back().runner = spawnNotify<RequestRunner>(
+        runnerDone.address(), handler, stages, std::move(req), seq,
+        parts.address());
+  }
+
+  // runners send all of their response before they finish, so if it is
+  // still pending the handler threw
+  void onRunnerDone(Pid pid) {
+    for (size_t i = 0; i < window_.size(); ++i) {
+      if (window_[i].runner == pid && !window_[i].done) {
+        fail(written_ + i, concatString("handler failed in ", pid));
+        return;
+      }
+    }
+  }
+
+  // Answers the seq'th request with a 500 in its place, so that the rest of
+  // the connection carries on. If some of its response has gone out already
+  // there is no way to say so in HTTP/1.1 but to drop the connection
+  void fail(uint64_t seq, std::string const& why) {
+    auto const& pending = window_.at(seq - written_);
+    if (pending.started) {
+      ESLANGEXCEPT("Request ", seq, " failed part way through: ", why);
+    }
+    ESLOG(LL::INFO, pid(), ": request ", seq, " failed: ", why);
+    auto resp = statusResponse(http::status::internal_server_error);
+    resp.message.version(pending.version);
+    resp.message.set(http::field::server, "Eslang");
+    onPart(ResponsePart{
+        seq, WwwParser::serialize(resp).toBuffers(pending.keepAlive), true,
+        {}});
+  }
+
+  void write(BufferCollection buffers) {
+    if (buffers.buffers.size()) {
+      Tcp::sendMany(this, s_, std::move(buffers));
+    }
+  }
+
+  void onPart(ResponsePart part) {
+    if (part.error) {
+      fail(part.seq, *part.error);
+      return;
+    }
+    auto& pending = window_.at(part.seq - written_);
+    pending.started = true;
+    if (part.seq == written_) {
+      write(std::move(part.buffers));
+    } else {
+      pending.parts.push_back(std::move(part.buffers));
+    }
+    pending.done = part.last;
+    while (!window_.empty() && window_.front().done) {
+      window_.pop_front();
+      ++written_;
+      if (!window_.empty()) {
+        for (auto& b : window_.front().parts) {
+          write(std::move(b));
         }
+        window_.front().parts.clear();
       }
     }
   }
@@ -189,11 +899,25 @@ public:
 
 ProcessTask Www::Server::run() {
   Slot<Tcp::Socket> new_socket{this};
+  Slot<Pid> worker_died{this};
+  if (serverOptions_.handlerPool) {
+    pool_ = std::make_shared<Pool>(
+        handler_, *serverOptions_.handlerPool,
+        ResponseStages{serverOptions_.responseCache,
+                       serverOptions_.compression});
+    pool_->start(this, worker_died.address());
+  }
   Tcp::makeListener(this, new_socket.address(), options_);
   while (true) {
-    auto new_sock = co_await recv(new_socket);
-    ESLOG(LL::DEBUG, "New connect ", new_sock.pid);
-    spawn<SessionRunner>(std::move(new_sock), handler_);
+    auto [new_sock, died] = co_await tryRecv(new_socket, worker_died);
+    if (died) {
+      pool_->onDied(this, *died);
+    }
+    if (new_sock) {
+      ESLOG(LL::DEBUG, "New connect ", new_sock->pid);
+      spawn<SessionRunner>(std::move(*new_sock), handler_, serverOptions_,
+                           pool_);
+    }
   }
 }
 
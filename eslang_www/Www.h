@@ -1,8 +1,12 @@
+#pragma once
 #include <eslang/Context.h>
 #include <eslang_io/Tcp.h>
+#include <eslang_www/WebSocket.h>
 
 #include <boost/beast/http/message.hpp>
 #include <boost/beast/http/string_body.hpp>
+#include <boost/container/small_vector.hpp>
+#include <forward_list>
 
 namespace s {
 
@@ -15,30 +19,162 @@ public:
     std::string toString() const;
   };
 
+  // A parsed request that does not own its data. The method, target, fields
+  // and body are views into the refcounted Buffers they were received in
+  // (which the RequestView keeps alive), so nothing is copied unless the
+  // request was split over multiple reads.
+  struct RequestView {
+    using string_view = boost::beast::string_view;
+    struct Field {
+      boost::beast::http::field name;
+      string_view nameString;
+      string_view value;
+    };
+
+    boost::beast::http::verb method = boost::beast::http::verb::unknown;
+    string_view methodString;
+    string_view target;
+    unsigned version = 11;
+    bool keepAlive = true;
+    boost::container::small_vector<Field, 16> fields;
+    string_view body;
+
+    std::optional<string_view> find(boost::beast::http::field f) const;
+    std::optional<string_view> find(string_view name) const;
+
+    // copies into an owning request
+    Request toRequest() const;
+    std::string toString() const;
+
+    // whatever the views above point into
+    boost::container::small_vector<Buffer, 2> storage;
+    std::forward_list<std::string> owned;
+  };
+
   struct Response {
     boost::beast::http::response<boost::beast::http::string_body> message;
+    // if set, and the server has a ResponseCache, the serialized response is
+    // reused for identical requests for this long
+    std::optional<std::chrono::milliseconds> cacheFor;
+  };
+
+  // A serialized (non chunked) response, split so that the per connection
+  // Connection header can be added without touching the rest.
+  struct SerializedResponse {
+    // status line and headers, without the final CRLF or the keep-alive and
+    // close tokens of the Connection header (any other tokens stay)
+    Buffer head;
+    std::optional<Buffer> body;
+    // of the response, which decides which of those tokens are sent
+    unsigned version = 11;
+
+    // the bytes to write for a request that wants keep_alive (or not)
+    BufferCollection toBuffers(bool keep_alive) const;
   };
 
+  class Client;
+  class Compression;
+  class ResponseCache;
+  class Router;
+
   class Server : public Process {
   public:
     class IHandler {
     public:
       virtual ~IHandler() = default;
-      virtual MethodTask<Response> getResponse(Process*, Request const&) = 0;
-      virtual GenTask<Buffer> getChunked(Process*, Request const&) = 0;
+      virtual MethodTask<Response> getResponse(Process*, Request const&);
+      virtual GenTask<Buffer> getChunked(Process*, Request const&);
+
+      // The server always calls these. The default implementations copy the
+      // request into a Request and call the owning versions above, so
+      // handlers that want to avoid the copy should override these instead.
+      virtual MethodTask<Response> getResponse(Process*, RequestView const&);
+      virtual GenTask<Buffer> getChunked(Process*, RequestView const&);
+
+      // Requests for which this returns true (given just the head) go to
+      // getStreamingResponse as soon as the head arrives, rather than having
+      // their body buffered. They are always handled on the session.
+      virtual bool streamBody(RequestView const& head);
+      // body yields the request body as it arrives, and reading it is what
+      // reads the socket, so a slow handler slows the upload down. Whatever
+      // is not read is discarded after this returns.
+      virtual MethodTask<Response> getStreamingResponse(Process*,
+                                                        RequestView const& head,
+                                                        GenTask<Buffer>& body);
+
+      // Requests to upgrade to a WebSocket come here, on the session. Return
+      // where the connection's messages should go (eg a process spawned for
+      // it), or nothing to refuse it with a 404. Once upgraded, the session
+      // just reads frames, and anything can write to the connection with
+      // WebSocket::send.
+      virtual std::optional<WebSocket::Accept>
+      acceptWebSocket(Process* session, RequestView const& req,
+                      WebSocket::Connection const& connection);
+
       static std::unique_ptr<IHandler> makeSimple(
           std::function<MethodTask<Response>(Process*, Request const&)> f);
     };
+
+    enum class PoolRouting {
+      RoundRobin,
+      // the worker with the fewest requests queued or in progress
+      LeastLoaded,
+      // by PoolOptions::hashKey, so that the same key always goes to the
+      // same worker
+      Hash,
+    };
+
+    struct PoolOptions {
+      size_t workers = 4;
+      PoolRouting routing = PoolRouting::RoundRobin;
+      // for PoolRouting::Hash. defaults to the request target
+      std::function<RequestView::string_view(RequestView const&)> hashKey;
+      // a handler for each worker, for resources that should not be shared.
+      // defaults to every worker using the server's handler
+      std::function<std::shared_ptr<IHandler>(size_t worker)> makeHandler;
+    };
+
+    struct ServerOptions {
+      // shared by all sessions, see Response::cacheFor
+      std::shared_ptr<ResponseCache> responseCache;
+      // gzip or deflate responses for clients that accept it. Cached
+      // responses are kept per encoding
+      std::shared_ptr<Compression> compression;
+      // How many pipelined requests a session handles at once. With more than
+      // one, each request is handled in its own process (so the handler may
+      // be running several requests concurrently) and responses are written
+      // back in request order. The session stops reading from the socket
+      // while this many are outstanding.
+      size_t maxInFlight = 1;
+      // requests with larger bodies (streamed or not) get a 413, after which
+      // the rest of the connection is ignored. 1MB is beast's default.
+      uint64_t maxBodySize = 1024 * 1024;
+      // If set, requests are handled by a pool of long lived worker
+      // processes (each handling one request at a time) rather than on the
+      // session. Sessions still write responses in request order.
+      std::optional<PoolOptions> handlerPool;
+    };
+
+    // the running pool of handler workers, see ServerOptions::handlerPool
+    class Pool;
+
     Server(ProcessArgs i, std::shared_ptr<IHandler> handler,
            Tcp::ListenerOptions options)
+        : Server(std::move(i), std::move(handler), std::move(options),
+                 ServerOptions()) {}
+    Server(ProcessArgs i, std::shared_ptr<IHandler> handler,
+           Tcp::ListenerOptions options, ServerOptions server_options)
         : Process(std::move(i)), handler_(std::move(handler)),
-          options_(std::move(options)) {}
+          options_(std::move(options)),
+          serverOptions_(std::move(server_options)) {}
 
     ProcessTask run();
 
   private:
     std::shared_ptr<IHandler> handler_;
     Tcp::ListenerOptions options_;
+    ServerOptions serverOptions_;
+    std::shared_ptr<Pool> pool_;
   };
 };
-}
\ No newline at end of file
+}
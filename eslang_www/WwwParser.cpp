@@ -0,0 +1,361 @@
+#include "WwwParser.h"
+#include <boost/asio/buffer.hpp>
+#include <boost/beast.hpp>
+
+namespace s {
+
+using namespace boost::beast;
+
+namespace {
+void checkOrThrow(error_code& ec) {
+  if (ec) {
+    ESLANGEXCEPT("Bad error code:", ec.message());
+  }
+}
+
+template <class T> Buffer makeBuffer(T buff) {
+  return Buffer::makeCopy(boost::asio::buffer_cast<char const*>(buff),
+                          boost::asio::buffer_size(buff));
+}
+
+struct SerializeVisitor {
+  SerializeVisitor(std::vector<Buffer>& buffs) : buffs(buffs) {}
+  std::vector<Buffer>& buffs;
+  size_t last = 0;
+
+  template <class T> void operator()(error_code& ec, T b) {
+    checkOrThrow(ec);
+    last = 0;
+    for (auto const& buff : b) {
+      last += boost::asio::buffer_size(buff);
+      buffs.push_back(makeBuffer(buff));
+    }
+  }
+};
+} // namespace
+
+// Builds a RequestView out of the callbacks from beast. Beast hands us views
+// into the buffer passed to put() (except for obsolete folded header values),
+// so as long as we hold a reference to that buffer we can keep them.
+class WwwParser::ViewParser : public http::basic_parser<true> {
+public:
+  ViewParser() { eager(true); }
+  ViewParser(ViewParser&&) = default;
+  ViewParser& operator=(ViewParser&&) = default;
+
+  // the buffer the next put() will be reading from
+  void attach(Buffer const* in) {
+    in_ = in;
+    retained_ = false;
+    ++generation_;
+  }
+
+  Www::RequestView release() { return std::move(view_); }
+  Www::RequestView const& view() const { return view_; }
+
+  // hand the rest of the body to out rather than putting it in the view
+  void streamTo(std::deque<Buffer>* out) { streamTo_ = out; }
+
+private:
+  string_view own(string_view s) {
+    if (s.empty()) {
+      return s;
+    }
+    if (in_->contains(s.data(), s.size())) {
+      if (!retained_) {
+        view_.storage.push_back(*in_);
+        retained_ = true;
+      }
+      return s;
+    }
+    view_.owned.emplace_front(s.data(), s.size());
+    return view_.owned.front();
+  }
+
+  void appendBody(string_view b) {
+    if (b.empty()) {
+      return;
+    }
+    if (streamTo_) {
+      if (in_->contains(b.data(), b.size())) {
+        streamTo_->push_back(in_->slice(
+            reinterpret_cast<unsigned char const*>(b.data()) - in_->data(),
+            b.size()));
+      } else {
+        streamTo_->push_back(Buffer::makeCopy(b.data(), b.size()));
+      }
+    } else if (!bodyOwned_.empty()) {
+      bodyOwned_.append(b.data(), b.size());
+    } else if (view_.body.empty() && in_->contains(b.data(), b.size())) {
+      view_.body = own(b);
+      bodyGeneration_ = generation_;
+    } else if (bodyGeneration_ == generation_ &&
+               view_.body.data() + view_.body.size() == b.data()) {
+      view_.body = string_view(view_.body.data(), view_.body.size() + b.size());
+    } else {
+      // split over reads, or chunked. either way it is not contiguous any more
+      bodyOwned_.assign(view_.body.data(), view_.body.size());
+      bodyOwned_.append(b.data(), b.size());
+      view_.body = {};
+    }
+  }
+
+  void on_request_impl(http::verb method, string_view method_str,
+                       string_view target, int version,
+                       error_code& ec) override {
+    view_.method = method;
+    view_.methodString = own(method_str);
+    view_.target = own(target);
+    view_.version = version;
+  }
+
+  void on_response_impl(int code, string_view reason, int version,
+                        error_code& ec) override {}
+
+  void on_field_impl(http::field name, string_view name_string,
+                     string_view value, error_code& ec) override {
+    view_.fields.push_back({name, own(name_string), own(value)});
+  }
+
+  void on_header_impl(error_code& ec) override {
+    view_.keepAlive = keep_alive();
+  }
+
+  void on_body_init_impl(boost::optional<std::uint64_t> const& content_length,
+                         error_code& ec) override {}
+
+  std::size_t on_body_impl(string_view body, error_code& ec) override {
+    appendBody(body);
+    return body.size();
+  }
+
+  void on_chunk_header_impl(std::uint64_t size, string_view extensions,
+                            error_code& ec) override {}
+
+  std::size_t on_chunk_body_impl(std::uint64_t remain, string_view body,
+                                 error_code& ec) override {
+    appendBody(body);
+    return body.size();
+  }
+
+  void on_finish_impl(error_code& ec) override {
+    if (!bodyOwned_.empty()) {
+      view_.owned.push_front(std::move(bodyOwned_));
+      view_.body = view_.owned.front();
+      bodyOwned_.clear();
+    }
+  }
+
+  Www::RequestView view_;
+  std::deque<Buffer>* streamTo_ = nullptr;
+  Buffer const* in_ = nullptr;
+  bool retained_ = false;
+  uint64_t generation_ = 0;
+  uint64_t bodyGeneration_ = 0;
+  std::string bodyOwned_;
+};
+
+WwwParser::WwwParser() : parser_(std::make_unique<ViewParser>()) {}
+
+WwwParser::~WwwParser() = default;
+
+void WwwParser::push(Buffer data) {
+  if (pending_ && pending_->size()) {
+    // the last request was split over reads, so it needs to be contiguous
+    pending_ = BufferCollection{{*pending_, data}}.combine();
+  } else {
+    pending_ = std::move(data);
+  }
+}
+
+void WwwParser::setStreamBody(
+    std::function<bool(Www::RequestView const&)> f) {
+  streamBody_ = std::move(f);
+  resetParser();
+}
+
+void WwwParser::setBodyLimit(uint64_t limit) {
+  bodyLimit_ = limit;
+  resetParser();
+}
+
+void WwwParser::resetParser() {
+  *parser_ = ViewParser();
+  // stop after the head, so that we can decide whether to stream the body
+  parser_->eager(!streamBody_);
+  if (bodyLimit_) {
+    parser_->body_limit(*bodyLimit_);
+  }
+  headDone_ = false;
+}
+
+bool WwwParser::put() {
+  if (tooLarge_) {
+    throw BodyTooLarge("Request body too large");
+  }
+  Buffer& in = *pending_;
+  parser_->attach(&in);
+  error_code ec;
+  size_t const used =
+      parser_->put(boost::asio::const_buffer(in.data(), in.size()), ec);
+  in.consume(used);
+  if (ec == http::error::need_more) {
+    return false;
+  }
+  if (ec == http::error::body_limit) {
+    tooLarge_ = true;
+    throw BodyTooLarge("Request body too large");
+  }
+  checkOrThrow(ec);
+  return used > 0 || parser_->is_done();
+}
+
+std::optional<Www::RequestView> WwwParser::next() {
+  if (tooLarge_) {
+    throw BodyTooLarge("Request body too large");
+  }
+  if (!bodyDone()) {
+    ESLANGEXCEPT("Body of the last request has not been read");
+  }
+  streaming_ = false;
+  std::optional<Www::RequestView> ret;
+  while (!ret && pending_ && pending_->size() && put()) {
+    if (!headDone_ && parser_->is_header_done()) {
+      headDone_ = true;
+      if (streamBody_ && streamBody_(parser_->view())) {
+        ret = parser_->release();
+        streaming_ = true;
+        bodyParsed_ = parser_->is_done();
+        if (bodyParsed_) {
+          resetParser();
+        } else {
+          parser_->streamTo(&body_);
+        }
+        break;
+      }
+      parser_->eager(true);
+    }
+    if (parser_->is_done()) {
+      ret = parser_->release();
+      resetParser();
+    }
+  }
+  if (pending_ && !pending_->size()) {
+    pending_.reset();
+  }
+  return ret;
+}
+
+std::optional<Buffer> WwwParser::nextBody() {
+  while (body_.empty() && !bodyParsed_ && pending_ && pending_->size() &&
+         put()) {
+    if (parser_->is_done()) {
+      bodyParsed_ = true;
+      resetParser();
+    }
+  }
+  if (pending_ && !pending_->size()) {
+    pending_.reset();
+  }
+  if (body_.empty()) {
+    return {};
+  }
+  Buffer ret = std::move(body_.front());
+  body_.pop_front();
+  return ret;
+}
+
+std::optional<Buffer> WwwParser::takeBuffered() {
+  std::optional<Buffer> ret;
+  ret.swap(pending_);
+  return ret;
+}
+
+Www::SerializedResponse WwwParser::serialize(Www::Response& response) {
+  auto& m = response.message;
+  if (!m.has_content_length() && !m.chunked()) {
+    m.prepare_payload();
+  }
+  // added back per connection by SerializedResponse::toBuffers
+  std::string others;
+  for (auto const& token : http::token_list(m[http::field::connection])) {
+    if (!iequals(token, "close") && !iequals(token, "keep-alive")) {
+      others += others.empty() ? "" : ", ";
+      others.append(token.data(), token.size());
+    }
+  }
+  if (others.empty()) {
+    m.erase(http::field::connection);
+  } else {
+    m.set(http::field::connection, others);
+  }
+  std::string body = std::move(m.body());
+  m.body().clear();
+
+  http::response_serializer<http::string_body> serializer(m);
+  serializer.split(true);
+  std::vector<unsigned char> head;
+  error_code ec;
+  while (!serializer.is_header_done()) {
+    size_t used = 0;
+    serializer.next(ec, [&](error_code& visit_ec, auto const& buffs) {
+      checkOrThrow(visit_ec);
+      for (auto const& b : buffs) {
+        auto const* p = static_cast<unsigned char const*>(b.data());
+        head.insert(head.end(), p, p + b.size());
+        used += b.size();
+      }
+    });
+    checkOrThrow(ec);
+    serializer.consume(used);
+  }
+  // drop the blank line, the Connection header goes before it
+  assert(head.size() >= 2);
+  head.resize(head.size() - 2);
+
+  Www::SerializedResponse ret{Buffer::make(std::move(head)), {}, m.version()};
+  if (body.size()) {
+    ret.body = Buffer::makeCopy(body);
+  }
+  return ret;
+}
+
+GenTask<Buffer> WwwParser::convert(Www::Response& response_in) {
+  Www::Response response(std::move(response_in));
+  http::response_serializer<http::string_body> serializer(
+      std::move(response.message));
+  std::vector<Buffer> buffs;
+  error_code ec;
+  SerializeVisitor visitor(buffs);
+  while (!serializer.is_done()) {
+    visitor.last = 0;
+    serializer.next(ec, visitor);
+    for (auto&& b : buffs) {
+      co_yield std::move(b);
+    }
+    buffs.clear();
+    serializer.consume(visitor.last);
+  }
+}
+
+GenTask<Buffer> WwwParser::convertHeaderOnly(Www::Response const& response) {
+  http::response_serializer<http::string_body> serializer(
+      std::move(response.message));
+  std::vector<Buffer> buffs;
+  error_code ec;
+  SerializeVisitor visitor(buffs);
+  serializer.split(true);
+  while (!serializer.is_done()) {
+    visitor.last = 0;
+    serializer.next(ec, visitor);
+    for (auto&& b : buffs) {
+      co_yield std::move(b);
+    }
+    buffs.clear();
+    serializer.consume(visitor.last);
+    if (serializer.is_header_done()) {
+      co_return;
+    }
+  }
+}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Www.h"
+
+#include <deque>
+
+namespace s {
+
+// Incremental HTTP/1.1 request parser over Tcp buffers.
+// Requests are handed out as RequestViews pointing into the pushed buffers,
+// and pipelined requests in one buffer are split by slicing it rather than
+// copying. The only copy made is when a request header straddles two pushes.
+class WwwParser : NonMovable {
+public:
+  class BodyTooLarge : public EslangException {
+    using EslangException::EslangException;
+  };
+
+  WwwParser();
+  ~WwwParser();
+
+  void push(Buffer data);
+
+  // The next complete request, if there is one. throws on a malformed request,
+  // and BodyTooLarge if the body is over the limit.
+  // If the request's body is being streamed (see setStreamBody) this is just
+  // the head, and the body must be read with nextBody() before calling this
+  // again.
+  std::optional<Www::RequestView> next();
+
+  // Requests for which f returns true (given the head) have their body handed
+  // out in pieces by nextBody() as it arrives, rather than buffered.
+  void setStreamBody(std::function<bool(Www::RequestView const&)> f);
+  // Unset, beast's own limit applies (1MB for requests)
+  void setBodyLimit(uint64_t limit);
+
+  // whether the last request returned by next() is streaming its body
+  bool streamingBody() const { return streaming_; }
+  // the next piece of a streamed body, if any of it has been pushed
+  std::optional<Buffer> nextBody();
+  // whether all of a streamed body has been returned by nextBody()
+  bool bodyDone() const {
+    return !streaming_ || (bodyParsed_ && body_.empty());
+  }
+
+  // bytes pushed that have not been parsed yet
+  size_t buffered() const { return pending_ ? pending_->size() : 0; }
+  // hands over those bytes, once the connection has switched protocols
+  std::optional<Buffer> takeBuffered();
+
+  // serializes a non chunked response into a head and a body buffer
+  static Www::SerializedResponse serialize(Www::Response& response);
+
+  GenTask<Buffer> convert(Www::Response& response);
+  static GenTask<Buffer> convertHeaderOnly(Www::Response const& response);
+
+private:
+  class ViewParser;
+  // parses some of pending_, returning false if it needs more
+  bool put();
+  void resetParser();
+
+  std::optional<Buffer> pending_;
+  std::unique_ptr<ViewParser> parser_;
+  std::function<bool(Www::RequestView const&)> streamBody_;
+  std::optional<uint64_t> bodyLimit_;
+  // whether the current request's head has been through streamBody_
+  bool headDone_ = false;
+  bool streaming_ = false;
+  bool bodyParsed_ = false;
+  bool tooLarge_ = false;
+  std::deque<Buffer> body_;
+};
+}
@@ -0,0 +1,104 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Two processes sending a counter back and forth. Once looking up the
+/// other's slot (makeSendAddress) for every send, and once keeping the
+/// TSendAddress, which stays safe to send to: messages to a process that has
+/// died, or to a later one given the same pid index, are dropped.
+
+namespace s {
+
+struct PingPongOptions {
+  uint64_t messages = 2000000;
+  bool keep = false;
+};
+
+class Ponger : public Process {
+public:
+  Ponger(ProcessArgs i, bool keep) : Process(std::move(i)), keep_(keep) {}
+
+  Slot<uint64_t> in{this};
+  Slot<Pid> peer{this};
+
+  ProcessTask run();
+
+private:
+  bool const keep_;
+};
+
+class Pinger : public Process {
+public:
+  Pinger(ProcessArgs i, PingPongOptions options)
+      : Process(std::move(i)), options_(options) {}
+
+  Slot<uint64_t> in{this};
+
+  ProcessTask run() {
+    auto ponger = spawnLink<Ponger>(options_.keep);
+    co_await send(makeSendAddress(ponger, &Ponger::peer), pid());
+    auto const kept = makeSendAddress(ponger, &Ponger::in);
+    auto const start = now();
+    for (uint64_t i = 0; i < options_.messages; i += 2) {
+      if (options_.keep) {
+        co_await send(kept, i);
+      } else {
+        co_await send(makeSendAddress(ponger, &Ponger::in), i);
+      }
+      co_await recv(in);
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.keep ? "kept addresses" : "looked up each send",
+          ": ", options_.messages / seconds, " messages/s, ",
+          seconds * 1e9 / options_.messages, " ns each");
+  }
+
+private:
+  PingPongOptions const options_;
+};
+
+ProcessTask Ponger::run() {
+  auto const pinger = co_await recv(peer);
+  auto const kept = makeSendAddress(pinger, &Pinger::in);
+  while (true) {
+    auto i = co_await recv(in);
+    if (keep_) {
+      co_await send(kept, i + 1);
+    } else {
+      co_await send(makeSendAddress(pinger, &Pinger::in), i + 1);
+    }
+  }
+}
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "messages", po::value<uint64_t>()->default_value(2000000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::PingPongOptions options;
+  options.messages = vm["messages"].as<uint64_t>();
+  for (bool keep : {false, true}) {
+    options.keep = keep;
+    s::Context c;
+    c.spawn<s::Pinger>(options);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Buffer.h>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Broadcasts one blob to many processes, over and over, and reports how long
+/// each broadcast takes to be received everywhere. Once sending a std::string,
+/// which copies the blob into every message, and once a Binary, which every
+/// message shares. The strings all being in flight at once, the default
+/// keeps to 1000 receivers.
+
+namespace s {
+
+struct FanOutOptions {
+  size_t receivers = 1000;
+  size_t blobSize = 1024 * 1024;
+  size_t rounds = 5;
+  bool binary = false;
+};
+
+// tells the driver each time it has got the blob
+template <class T> class FanOutReceiver : public Process {
+public:
+  FanOutReceiver(ProcessArgs i, TSendAddress<size_t> done)
+      : Process(std::move(i)), done_(std::move(done)) {}
+
+  Slot<T> blobs{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto const blob = co_await recv(blobs);
+      co_await send(done_, blob.size());
+    }
+  }
+
+private:
+  TSendAddress<size_t> const done_;
+};
+
+class FanOutDriver : public Process {
+public:
+  FanOutDriver(ProcessArgs i, FanOutOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<size_t> done{this};
+
+  template <class T> MethodTask<> broadcast(T const& blob) {
+    std::vector<TSendAddress<T>> to;
+    for (size_t i = 0; i < options_.receivers; ++i) {
+      auto pid = spawnLink<FanOutReceiver<T>>(done.address());
+      to.push_back(makeSendAddress(pid, &FanOutReceiver<T>::blobs));
+    }
+    for (size_t round = 0; round < options_.rounds; ++round) {
+      auto const start = now();
+      for (auto const& address : to) {
+        send(address, blob);
+      }
+      size_t bytes = 0;
+      for (size_t i = 0; i < options_.receivers; ++i) {
+        bytes += co_await recv(done);
+      }
+      double const ms =
+          std::chrono::duration<double, std::milli>(now() - start).count();
+      ESLOG(LL::INFO, options_.binary ? "binary" : "string", ": ",
+            options_.receivers, " receivers got ", bytes / (1024 * 1024),
+            " MB in ", ms, " ms");
+    }
+  }
+
+  ProcessTask run() {
+    if (options_.binary) {
+      co_await broadcast(Binary::makeCopy(std::string(options_.blobSize, '?')));
+    } else {
+      co_await broadcast(std::string(options_.blobSize, '?'));
+    }
+    // returning kills the receivers
+  }
+
+private:
+  FanOutOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "receivers", po::value<size_t>()->default_value(1000))(
+      "blobSize", po::value<size_t>()->default_value(1024 * 1024))(
+      "rounds", po::value<size_t>()->default_value(5));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::FanOutOptions options;
+  options.receivers = vm["receivers"].as<size_t>();
+  options.blobSize = vm["blobSize"].as<size_t>();
+  options.rounds = vm["rounds"].as<size_t>();
+  for (bool binary : {false, true}) {
+    options.binary = binary;
+    s::Context c;
+    c.spawn<s::FanOutDriver>(options);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Request/reply round trips between two processes, one at a time. Once the
+/// way it is done by hand (a reply slot, the address looked up each time and
+/// a timedRecv), once through call with the address looked up each time, and
+/// once through call with it kept.
+
+namespace s {
+
+enum class CallHow { Manual, CallLookup, CallKept };
+
+struct CallLatencyOptions {
+  size_t calls = 1000000;
+  CallHow how = CallHow::Manual;
+  std::string name;
+};
+
+struct ManualRequest {
+  uint64_t value;
+  TSendAddress<uint64_t> replyTo;
+};
+
+class Echoer : public Process {
+public:
+  using Process::Process;
+
+  Slot<ManualRequest> manual{this};
+  Slot<Call<uint64_t, uint64_t>> calls{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto r = co_await tryRecv(manual, calls);
+      if (std::get<0>(r)) {
+        co_await send(std::get<0>(r)->replyTo, std::get<0>(r)->value);
+      }
+      if (std::get<1>(r)) {
+        co_await reply(std::get<1>(r)->replyTo, std::get<1>(r)->request);
+      }
+    }
+  }
+};
+
+class CallLatencyDriver : public Process {
+public:
+  CallLatencyDriver(ProcessArgs i, CallLatencyOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<uint64_t> replies{this};
+
+  ProcessTask run() {
+    auto echoer = spawnLink<Echoer>();
+    auto const kept = makeSendAddress(echoer, &Echoer::calls);
+    std::chrono::milliseconds const timeout(1000);
+    auto const start = now();
+    for (uint64_t i = 0; i < options_.calls; ++i) {
+      std::optional<uint64_t> got;
+      switch (options_.how) {
+      case CallHow::Manual: {
+        co_await send(makeSendAddress(echoer, &Echoer::manual),
+                      ManualRequest{i, replies.address()});
+        auto r = co_await timedRecv(timeout, replies);
+        got = std::get<0>(r);
+        break;
+      }
+      case CallHow::CallLookup:
+        got = co_await call(echoer, &Echoer::calls, i, timeout);
+        break;
+      case CallHow::CallKept:
+        got = co_await call(kept, i, timeout);
+        break;
+      }
+      if (got != i) {
+        ESLANGEXCEPT("Call ", i, " went wrong");
+      }
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.name, ": ", options_.calls / seconds,
+          " round trips/s, ", seconds * 1e9 / options_.calls, " ns each");
+  }
+
+private:
+  CallLatencyOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "calls", po::value<size_t>()->default_value(1000000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::CallLatencyOptions options;
+  options.calls = vm["calls"].as<size_t>();
+
+  std::vector<s::CallLatencyOptions> runs;
+  options.name = "by hand";
+  options.how = s::CallHow::Manual;
+  runs.push_back(options);
+  options.name = "call, looking up the address";
+  options.how = s::CallHow::CallLookup;
+  runs.push_back(options);
+  options.name = "call, keeping the address";
+  options.how = s::CallHow::CallKept;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::CallLatencyDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Many producers sending to one consumer, reporting messages/s. The consumer
+/// takes them with recv one at a time, with recvBatch, or by waiting for one
+/// with recvBatch and then draining the slot with drain.
+
+namespace s {
+
+enum class FanInHow { Recv, Batch, Drain };
+
+struct FanInOptions {
+  size_t producers = 1000;
+  size_t messages = 10000;
+  size_t batch = 1024;
+  FanInHow how = FanInHow::Recv;
+  std::string name;
+};
+
+class FanInProducer : public Process {
+public:
+  FanInProducer(ProcessArgs i, TSendAddress<uint64_t> out, size_t messages)
+      : Process(std::move(i)), out_(out), messages_(messages) {}
+
+  ProcessTask run() {
+    for (uint64_t i = 0; i < messages_; ++i) {
+      co_await send(out_, i);
+    }
+  }
+
+private:
+  TSendAddress<uint64_t> const out_;
+  size_t const messages_;
+};
+
+class FanInConsumer : public Process {
+public:
+  FanInConsumer(ProcessArgs i, FanInOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<uint64_t> in{this};
+
+  ProcessTask run() {
+    uint64_t const expected = options_.producers * options_.messages;
+    uint64_t got = 0;
+    uint64_t sum = 0;
+    auto const start = now();
+    for (size_t i = 0; i < options_.producers; ++i) {
+      spawn<FanInProducer>(in.address(), options_.messages);
+    }
+    while (got < expected) {
+      switch (options_.how) {
+      case FanInHow::Recv:
+        sum += co_await recv(in);
+        ++got;
+        break;
+      case FanInHow::Batch:
+        for (auto m : co_await recvBatch(in, options_.batch)) {
+          sum += m;
+          ++got;
+        }
+        break;
+      case FanInHow::Drain:
+        for (auto m : co_await recvBatch(in, 1)) {
+          sum += m;
+          ++got;
+        }
+        for
+          co_await(uint64_t m : drain(in)) {
+            sum += m;
+            ++got;
+          }
+        break;
+      }
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.name, ": ", got / seconds, " messages/s (sum ",
+          sum, ")");
+  }
+
+private:
+  FanInOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "producers", po::value<size_t>()->default_value(1000))(
+      "messages", po::value<size_t>()->default_value(10000))(
+      "batch", po::value<size_t>()->default_value(1024));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::FanInOptions options;
+  options.producers = vm["producers"].as<size_t>();
+  options.messages = vm["messages"].as<size_t>();
+  options.batch = vm["batch"].as<size_t>();
+
+  std::vector<s::FanInOptions> runs;
+  options.name = "recv";
+  options.how = s::FanInHow::Recv;
+  runs.push_back(options);
+  options.name = "recvBatch";
+  options.how = s::FanInHow::Batch;
+  runs.push_back(options);
+  options.name = "drain";
+  options.how = s::FanInHow::Drain;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::FanInConsumer>(run);
+    c.run();
+  }
+  return 0;
+}
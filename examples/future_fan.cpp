@@ -0,0 +1,153 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Fans a batch of jobs out over some workers and gathers their results,
+/// reporting jobs/s. Results come back as typed futures, gathered with
+/// whenAll or awaited one by one, or as reply messages to a slot.
+
+namespace s {
+
+enum class FutureFanHow { WhenAll, Each, Messages };
+
+struct FutureFanOptions {
+  size_t workers = 16;
+  size_t futures = 10000;
+  size_t rounds = 20;
+  FutureFanHow how = FutureFanHow::WhenAll;
+  std::string name;
+};
+
+struct FanJob {
+  uint64_t x;
+  std::optional<Promise<uint64_t>> result;
+  std::optional<TSendAddress<std::pair<size_t, uint64_t>>> replyTo;
+  size_t idx = 0;
+};
+
+class FanWorker : public Process {
+public:
+  using Process::Process;
+
+  Slot<FanJob> jobs{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto job = co_await recv(jobs);
+      if (job.result) {
+        job.result->setValue(job.x * 2);
+      } else {
+        co_await send(*job.replyTo, job.idx, job.x * 2);
+      }
+    }
+  }
+};
+
+class FutureFan : public Process {
+public:
+  FutureFan(ProcessArgs i, FutureFanOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<std::pair<size_t, uint64_t>> replies{this};
+
+  ProcessTask run() {
+    std::vector<TSendAddress<FanJob>> workers;
+    for (size_t i = 0; i < options_.workers; ++i) {
+      workers.push_back(
+          makeSendAddress(spawnLink<FanWorker>(), &FanWorker::jobs));
+    }
+    uint64_t sum = 0;
+    auto const start = now();
+    for (size_t round = 0; round < options_.rounds; ++round) {
+      std::vector<Future<uint64_t>> futures;
+      futures.reserve(options_.futures);
+      for (size_t i = 0; i < options_.futures; ++i) {
+        FanJob job{i};
+        if (options_.how == FutureFanHow::Messages) {
+          job.replyTo = replies.address();
+          job.idx = i;
+        } else {
+          futures.push_back(job.result.emplace().getFuture());
+        }
+        co_await send(workers[i % workers.size()], std::move(job));
+      }
+      switch (options_.how) {
+      case FutureFanHow::WhenAll:
+        for (auto v : co_await whenAll(std::move(futures))) {
+          sum += v;
+        }
+        break;
+      case FutureFanHow::Each:
+        for (auto& f : futures) {
+          sum += co_await f;
+        }
+        break;
+      case FutureFanHow::Messages: {
+        std::vector<uint64_t> got(options_.futures);
+        for (size_t i = 0; i < options_.futures; ++i) {
+          auto r = co_await recv(replies);
+          got[r.first] = r.second;
+        }
+        for (auto v : got) {
+          sum += v;
+        }
+        break;
+      }
+      }
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    double const jobs = options_.rounds * options_.futures;
+    ESLOG(LL::INFO, options_.name, ": ", jobs / seconds, " jobs/s, ",
+          seconds * 1e9 / jobs, " ns each (sum ", sum, ")");
+  }
+
+private:
+  FutureFanOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "workers", po::value<size_t>()->default_value(16))(
+      "futures", po::value<size_t>()->default_value(10000))(
+      "rounds", po::value<size_t>()->default_value(20));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::FutureFanOptions options;
+  options.workers = vm["workers"].as<size_t>();
+  options.futures = vm["futures"].as<size_t>();
+  options.rounds = vm["rounds"].as<size_t>();
+
+  std::vector<s::FutureFanOptions> runs;
+  options.name = "whenAll";
+  options.how = s::FutureFanHow::WhenAll;
+  runs.push_back(options);
+  options.name = "each";
+  options.how = s::FutureFanHow::Each;
+  runs.push_back(options);
+  options.name = "messages";
+  options.how = s::FutureFanHow::Messages;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::FutureFan>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Fans events out to a group of processes and reports deliveries/s. Once
+/// with a send to each member in a loop, once through broadcast and once
+/// through broadcastThrottled.
+
+namespace s {
+
+enum class FanOut { Loop, Broadcast, Throttled };
+
+struct GroupFanOutOptions {
+  size_t members = 100000;
+  size_t rounds = 20;
+  FanOut how = FanOut::Loop;
+  std::string name;
+};
+
+// counts the events it gets
+class FanOutMember : public Process {
+public:
+  FanOutMember(ProcessArgs i, std::shared_ptr<uint64_t> received)
+      : Process(std::move(i)), received_(std::move(received)) {}
+
+  Slot<uint64_t> events{this};
+
+  ProcessTask run() {
+    join("events", events);
+    while (true) {
+      co_await recv(events);
+      ++*received_;
+    }
+  }
+
+private:
+  std::shared_ptr<uint64_t> received_;
+};
+
+class GroupFanOutDriver : public Process {
+public:
+  GroupFanOutDriver(ProcessArgs i, GroupFanOutOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    auto received = std::make_shared<uint64_t>(0);
+    std::vector<TSendAddress<uint64_t>> members;
+    for (size_t i = 0; i < options_.members; ++i) {
+      auto pid = spawnLink<FanOutMember>(received);
+      members.push_back(makeSendAddress(pid, &FanOutMember::events));
+    }
+    while (c()->groupSize("events") < options_.members) {
+      co_await WaitingYield{};
+    }
+    auto const start = now();
+    for (uint64_t round = 0; round < options_.rounds; ++round) {
+      switch (options_.how) {
+      case FanOut::Loop:
+        for (auto const& member : members) {
+          co_await send(member, round);
+        }
+        break;
+      case FanOut::Broadcast:
+        co_await broadcast("events", round);
+        break;
+      case FanOut::Throttled:
+        co_await broadcastThrottled("events", round);
+        break;
+      }
+    }
+    uint64_t const expected = options_.rounds * options_.members;
+    while (*received < expected) {
+      co_await WaitingYield{};
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.name, ": ", expected / seconds,
+          " deliveries/s, ", seconds * 1000 / options_.rounds,
+          " ms a round to ", options_.members, " members");
+    // returning kills the members
+  }
+
+private:
+  GroupFanOutOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "members", po::value<size_t>()->default_value(100000))(
+      "rounds", po::value<size_t>()->default_value(20));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::GroupFanOutOptions options;
+  options.members = vm["members"].as<size_t>();
+  options.rounds = vm["rounds"].as<size_t>();
+
+  std::vector<s::GroupFanOutOptions> runs;
+  options.name = "send in a loop";
+  options.how = s::FanOut::Loop;
+  runs.push_back(options);
+  options.name = "broadcast";
+  options.how = s::FanOut::Broadcast;
+  runs.push_back(options);
+  options.name = "broadcastThrottled";
+  options.how = s::FanOut::Throttled;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::GroupFanOutDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,398 @@
+#include <boost/beast/http.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+
+/// A load generator for a server in another process, eg examples/www.cpp
+/// (--mode http, the default) or the examples/tcp.cpp echo server
+/// (--mode echo --port 25123).
+/// It opens --connections keep-alive connections and either keeps --depth
+/// requests outstanding on each (closed loop), or sends --rate requests a
+/// second between them whether or not earlier ones have been answered (open
+/// loop). In the open loop latency is measured from when each request should
+/// have been sent, so a stalled server is not hidden by sending less.
+/// Prints a JSON summary with latency percentiles from a log-linear
+/// histogram.
+/// eg example_www --sslPort 0 & example_httpload --path /favicon.ico
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+struct HttpLoadOptions {
+  std::string host = "127.0.0.1";
+  uint32_t port = 12345;
+  // "http" or "echo"
+  std::string mode = "http";
+  std::string path = "/";
+  // the size of each echo message
+  size_t size = 64;
+  size_t connections = 16;
+  size_t depth = 1;
+  // total requests a second, for an open loop. 0 means a closed loop
+  double rate = 0;
+  std::chrono::milliseconds warmup{1000};
+  std::chrono::milliseconds duration{10000};
+};
+
+// An HDR style histogram of nanoseconds: exact below 64, then 32 buckets for
+// each power of two, so values are kept to within about 3%
+class LatencyHistogram {
+public:
+  static constexpr size_t kSubBits = 5;
+  static constexpr size_t kSub = 1 << kSubBits;
+
+  void record(std::chrono::nanoseconds latency) {
+    uint64_t const v = std::max<int64_t>(latency.count(), 0);
+    size_t const idx = index(v);
+    if (idx >= counts_.size()) {
+      counts_.resize(idx + 1);
+    }
+    ++counts_[idx];
+    ++total_;
+    sum_ += v;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+  }
+
+  // the smallest recorded value at least p of the values are at or below
+  // (to within its bucket)
+  uint64_t percentile(double p) const {
+    if (!total_) {
+      return 0;
+    }
+    uint64_t const rank = std::max<uint64_t>(1, uint64_t(p * total_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(highest(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t total() const { return total_; }
+  uint64_t min() const { return total_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? double(sum_) / total_ : 0; }
+
+private:
+  static size_t index(uint64_t v) {
+    if (v < 2 * kSub) {
+      return v;
+    }
+    // the top kSubBits + 1 bits of v, past the first 2 * kSub
+    size_t const shift = 63 - __builtin_clzll(v) - kSubBits;
+    return kSub * shift + (v >> shift);
+  }
+
+  // the largest value that lands in bucket idx
+  static uint64_t highest(size_t idx) {
+    if (idx < 2 * kSub) {
+      return idx;
+    }
+    size_t const shift = idx / kSub - 1;
+    return ((uint64_t(idx % kSub + kSub) + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ = 0;
+};
+
+struct HttpLoadStats {
+  LatencyHistogram latency;
+  uint64_t responses = 0;
+  uint64_t non2xx = 0;
+  uint64_t bytesIn = 0;
+  // connections that failed or were closed by the server
+  uint64_t connectionErrors = 0;
+  // whether the warmup is over, and things should be counted
+  bool recording = false;
+};
+
+// the time between sends on each connection in an open loop
+TimePoint::duration openInterval(HttpLoadOptions const& options) {
+  if (options.rate <= 0) {
+    return {};
+  }
+  return std::max(std::chrono::duration_cast<TimePoint::duration>(
+                      std::chrono::duration<double>(options.connections /
+                                                    options.rate)),
+                  TimePoint::duration(1));
+}
+
+// splits the stream of bytes coming back into responses
+class ResponseReader {
+public:
+  explicit ResponseReader(HttpLoadOptions const& options)
+      : echoSize_(options.mode == "echo" ? options.size : 0) {}
+
+  // the number of responses completed by data
+  size_t push(Buffer const& data, HttpLoadStats& stats) {
+    if (echoSize_) {
+      echoed_ += data.size();
+      size_t const done = echoed_ / echoSize_;
+      echoed_ %= echoSize_;
+      return done;
+    }
+    buffered_.append(reinterpret_cast<char const*>(data.data()), data.size());
+    size_t done = 0;
+    size_t at = 0;
+    while (at < buffered_.size()) {
+      if (!parser_) {
+        parser_.emplace();
+        parser_->eager(true);
+        parser_->body_limit(64 * 1024 * 1024);
+      }
+      boost::beast::error_code ec;
+      at += parser_->put(
+          boost::asio::buffer(buffered_.data() + at, buffered_.size() - at),
+          ec);
+      if (ec == http::error::need_more) {
+        break;
+      }
+      if (ec) {
+        ESLANGEXCEPT("Bad response ", ec.message());
+      }
+      if (parser_->is_done()) {
+        if (stats.recording && parser_->get().result_int() / 100 != 2) {
+          ++stats.non2xx;
+        }
+        ++done;
+        parser_.reset();
+      }
+    }
+    buffered_.erase(0, at);
+    return done;
+  }
+
+private:
+  size_t const echoSize_;
+  size_t echoed_ = 0;
+  std::string buffered_;
+  std::optional<http::response_parser<http::string_body>> parser_;
+};
+
+class LoadConnection : public Process {
+public:
+  LoadConnection(ProcessArgs i, HttpLoadOptions options,
+                 std::shared_ptr<HttpLoadStats> stats, TimePoint first)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)), request_(makeRequest(options_)),
+        next_(first) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+  Slot<Pid> closed{this};
+
+  ProcessTask run() {
+    Tcp::ConnectOptions connect(options_.host, options_.port);
+    connect.notifyOnClose = closed.address();
+    socket_ = co_await Tcp::connect(this, std::move(connect));
+    Tcp::initRecvSocket(this, *socket_, recv.address());
+    ResponseReader reader(options_);
+    bool const open = options_.rate > 0;
+    auto const interval = openInterval(options_);
+    if (!open) {
+      for (size_t i = 0; i < options_.depth; ++i) {
+        send(now());
+      }
+    }
+    while (true) {
+      std::optional<Tcp::ReceiveData> data;
+      std::optional<Pid> gone;
+      if (open) {
+        // timers only go to the millisecond (and spinning on zero length
+        // ones starves everything else), so anything due before the next
+        // one goes now, and is timed from now
+        auto const t = now();
+        for (; next_ < t + std::chrono::milliseconds(1); next_ += interval) {
+          send(std::min(next_, t));
+        }
+        std::tie(data, gone) = co_await timedRecv(
+            std::chrono::duration_cast<std::chrono::milliseconds>(next_ - t),
+            recv, closed);
+      } else {
+        std::tie(data, gone) = co_await tryRecv(recv, closed);
+      }
+      if (gone) {
+        ESLANGEXCEPT("Connection closed by ", options_.host, ":",
+                     options_.port);
+      }
+      if (!data) {
+        continue;
+      }
+      auto const t = now();
+      if (stats_->recording) {
+        stats_->bytesIn += data->data.size();
+      }
+      for (size_t done = reader.push(data->data, *stats_); done; --done) {
+        if (sent_.empty()) {
+          ESLANGEXCEPT("Unexpected data from ", options_.host, ":",
+                       options_.port);
+        }
+        if (stats_->recording) {
+          stats_->latency.record(t - sent_.front());
+          ++stats_->responses;
+        }
+        sent_.pop_front();
+        if (!open) {
+          send(t);
+        }
+      }
+    }
+  }
+
+private:
+  static Buffer makeRequest(HttpLoadOptions const& options) {
+    if (options.mode == "echo") {
+      return Buffer::makeCopy(std::string(options.size, 'x'));
+    }
+    return Buffer::makeCopy(concatString("GET ", options.path,
+                                         " HTTP/1.1\r\nHost: ", options.host,
+                                         ":", options.port, "\r\n\r\n"));
+  }
+
+  // when is when the request was meant to go
+  void send(TimePoint when) {
+    Tcp::send(this, *socket_, request_);
+    sent_.push_back(when);
+  }
+
+  HttpLoadOptions const options_;
+  std::shared_ptr<HttpLoadStats> stats_;
+  Buffer const request_;
+  // the next open loop send
+  TimePoint next_;
+  std::optional<Tcp::Socket> socket_;
+  std::deque<TimePoint> sent_;
+};
+
+double toUs(uint64_t ns) { return ns / 1000.0; }
+
+class LoadDriver : public Process {
+public:
+  LoadDriver(ProcessArgs i, HttpLoadOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Pid> died{this};
+
+  ProcessTask run() {
+    auto stats = std::make_shared<HttpLoadStats>();
+    auto const start = now();
+    auto const interval = openInterval(options_);
+    for (size_t i = 0; i < options_.connections; ++i) {
+      // spread the open loop sends out over the connections
+      spawnLinkNotify<LoadConnection>(
+          died.address(), options_, stats,
+          start + interval * i / options_.connections);
+    }
+    co_await waitUntil(start + options_.warmup, *stats);
+    stats->recording = true;
+    auto const begin = now();
+    co_await waitUntil(begin + options_.duration, *stats);
+    double const seconds =
+        std::chrono::duration<double>(now() - begin).count();
+    auto const& l = stats->latency;
+    std::cout << concatString(
+                     "{\"mode\":\"", options_.mode, "\",\"target\":\"",
+                     options_.host, ":", options_.port,
+                     "\",\"connections\":", options_.connections,
+                     ",\"loop\":\"", options_.rate > 0 ? "open" : "closed",
+                     "\",\"depth\":", options_.depth,
+                     ",\"rate\":", options_.rate, ",\"seconds\":", seconds,
+                     ",\"responses\":", stats->responses,
+                     ",\"throughput\":", stats->responses / seconds,
+                     ",\"non2xx\":", stats->non2xx,
+                     ",\"bytesIn\":", stats->bytesIn,
+                     ",\"connectionErrors\":", stats->connectionErrors,
+                     ",\"latencyUs\":{\"min\":", toUs(l.min()),
+                     ",\"mean\":", l.mean() / 1000,
+                     ",\"p50\":", toUs(l.percentile(0.5)),
+                     ",\"p90\":", toUs(l.percentile(0.9)),
+                     ",\"p99\":", toUs(l.percentile(0.99)),
+                     ",\"p999\":", toUs(l.percentile(0.999)),
+                     ",\"max\":", toUs(l.max()), "}}")
+              << std::endl;
+    // returning kills the connections
+  }
+
+private:
+  // counts connections dying meanwhile
+  MethodTask<> waitUntil(TimePoint until, HttpLoadStats& stats) {
+    while (true) {
+      auto const left =
+          std::chrono::duration_cast<std::chrono::milliseconds>(until - now());
+      if (left.count() <= 0) {
+        co_return;
+      }
+      auto [pid] = co_await timedRecv(left, died);
+      if (pid) {
+        ++stats.connectionErrors;
+      }
+    }
+  }
+
+  HttpLoadOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::warning);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "host", po::value<std::string>()->default_value("127.0.0.1"))(
+      "port", po::value<uint32_t>()->default_value(12345))(
+      "mode", po::value<std::string>()->default_value("http"),
+      "http, or echo for a tcp echo server")(
+      "path", po::value<std::string>()->default_value("/"))(
+      "size", po::value<size_t>()->default_value(64), "echo message size")(
+      "connections", po::value<size_t>()->default_value(16))(
+      "depth", po::value<size_t>()->default_value(1),
+      "outstanding requests per connection in a closed loop")(
+      "rate", po::value<double>()->default_value(0),
+      "requests a second in an open loop, 0 for a closed loop")(
+      "warmupMs", po::value<int>()->default_value(1000))(
+      "durationMs", po::value<int>()->default_value(10000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::HttpLoadOptions options;
+  options.host = vm["host"].as<std::string>();
+  options.port = vm["port"].as<uint32_t>();
+  options.mode = vm["mode"].as<std::string>();
+  options.path = vm["path"].as<std::string>();
+  options.size = std::max<size_t>(1, vm["size"].as<size_t>());
+  options.connections = std::max<size_t>(1, vm["connections"].as<size_t>());
+  options.depth = std::max<size_t>(1, vm["depth"].as<size_t>());
+  options.rate = vm["rate"].as<double>();
+  options.warmup = std::chrono::milliseconds(vm["warmupMs"].as<int>());
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+  if (options.mode != "http" && options.mode != "echo") {
+    std::cerr << "Unknown mode " << options.mode << "\n";
+    return 1;
+  }
+
+  s::Context c;
+  c.spawn<s::LoadDriver>(options);
+  c.run();
+  return 0;
+}
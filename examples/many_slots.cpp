@@ -0,0 +1,100 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// A process waiting on 16 slots at once, with senders spreading messages
+/// over all of them, and reports messages/s. Every message wakes it, so this
+/// is mostly the cost of deciding to wake it and of waiting again.
+
+namespace s {
+
+struct ManySlotsOptions {
+  size_t senders = 16;
+  size_t messages = 200000;
+};
+
+class SlotSender : public Process {
+public:
+  SlotSender(ProcessArgs i, std::vector<TSendAddress<uint64_t>> to,
+             size_t messages)
+      : Process(std::move(i)), to_(std::move(to)), messages_(messages) {}
+
+  ProcessTask run() {
+    for (uint64_t i = 0; i < messages_; ++i) {
+      co_await send(to_[i % to_.size()], i);
+    }
+  }
+
+private:
+  std::vector<TSendAddress<uint64_t>> const to_;
+  size_t const messages_;
+};
+
+class ManySlots : public Process {
+public:
+  ManySlots(ProcessArgs i, ManySlotsOptions options)
+      : Process(std::move(i)), options_(options) {}
+
+  Slot<uint64_t> s0{this}, s1{this}, s2{this}, s3{this}, s4{this}, s5{this},
+      s6{this}, s7{this}, s8{this}, s9{this}, s10{this}, s11{this}, s12{this},
+      s13{this}, s14{this}, s15{this};
+
+  ProcessTask run() {
+    std::vector<TSendAddress<uint64_t>> to;
+    for (auto* slot : {&s0, &s1, &s2, &s3, &s4, &s5, &s6, &s7, &s8, &s9, &s10,
+                       &s11, &s12, &s13, &s14, &s15}) {
+      to.push_back(slot->address());
+    }
+    uint64_t const expected = options_.senders * options_.messages;
+    uint64_t got = 0;
+    uint64_t wakeups = 0;
+    auto const start = now();
+    for (size_t i = 0; i < options_.senders; ++i) {
+      spawn<SlotSender>(to, options_.messages);
+    }
+    while (got < expected) {
+      auto r = co_await tryRecv(s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10,
+                                s11, s12, s13, s14, s15);
+      ++wakeups;
+      std::apply([&got](auto const&... m) { ((got += m ? 1 : 0), ...); }, r);
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, got / seconds, " messages/s, ", seconds * 1e9 / got,
+          " ns each, ", wakeups, " wakeups");
+  }
+
+private:
+  ManySlotsOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "senders", po::value<size_t>()->default_value(16))(
+      "messages", po::value<size_t>()->default_value(200000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::ManySlotsOptions options;
+  options.senders = vm["senders"].as<size_t>();
+  options.messages = vm["messages"].as<size_t>();
+  s::Context c;
+  c.spawn<s::ManySlots>(options);
+  c.run();
+  return 0;
+}
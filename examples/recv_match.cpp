@@ -0,0 +1,137 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <deque>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <iostream>
+
+/// Round trips to an echo process while depth unrelated messages sit at the
+/// front of the mailbox. Once with the reply picked out by hand, putting
+/// aside what does not match and looking through it again on every call,
+/// once with recvMatch, and once with recvMatch from a mark set before each
+/// request.
+
+namespace s {
+
+enum class RecvMatchHow { ByHand, Match, Marked };
+
+struct RecvMatchOptions {
+  size_t depth = 10000;
+  size_t calls = 10000;
+  RecvMatchHow how = RecvMatchHow::ByHand;
+};
+
+struct Tagged {
+  uint64_t id;
+  uint64_t payload;
+};
+
+class TaggedEcho : public Process {
+public:
+  using Process::Process;
+
+  Slot<std::pair<uint64_t, TSendAddress<Tagged>>> in{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto r = co_await recv(in);
+      co_await send(r.second, Tagged{r.first, r.first});
+    }
+  }
+};
+
+class RecvMatchDriver : public Process {
+public:
+  RecvMatchDriver(ProcessArgs i, RecvMatchOptions options)
+      : Process(std::move(i)), options_(options) {}
+
+  Slot<Tagged> in{this};
+
+  // looks through what was put aside before, and puts aside what comes in
+  // until the match does
+  MethodTask<Tagged> byHand(uint64_t id) {
+    for (auto it = saved_.begin(); it != saved_.end(); ++it) {
+      if (it->id == id) {
+        Tagged ret = *it;
+        saved_.erase(it);
+        co_return ret;
+      }
+    }
+    while (true) {
+      auto m = co_await recv(in);
+      if (m.id == id) {
+        co_return m;
+      }
+      saved_.push_back(m);
+    }
+  }
+
+  ProcessTask run() {
+    uint64_t const kNoise = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < options_.depth; ++i) {
+      in.queue()->push(Tagged{kNoise, i});
+    }
+    auto echo = spawnLink<TaggedEcho>();
+    auto const address = makeSendAddress(echo, &TaggedEcho::in);
+    auto const start = now();
+    for (uint64_t i = 0; i < options_.calls; ++i) {
+      if (options_.how == RecvMatchHow::Marked) {
+        in.mark();
+      }
+      co_await send(address, std::make_pair(i, in.address()));
+      Tagged got;
+      if (options_.how == RecvMatchHow::ByHand) {
+        got = co_await byHand(i);
+      } else {
+        got = co_await recvMatch(in,
+                                 [i](Tagged const& t) { return t.id == i; });
+      }
+      if (got.payload != i) {
+        ESLANGEXCEPT("Reply ", i, " went wrong");
+      }
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    char const* const names[] = {"by hand", "recvMatch", "marked recvMatch"};
+    ESLOG(LL::INFO, names[static_cast<int>(options_.how)], " with ",
+          options_.depth, " queued: ", options_.calls / seconds,
+          " round trips/s, ", seconds * 1e9 / options_.calls, " ns each");
+  }
+
+private:
+  RecvMatchOptions const options_;
+  std::deque<Tagged> saved_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "depth", po::value<size_t>()->default_value(10000))(
+      "calls", po::value<size_t>()->default_value(10000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::RecvMatchOptions options;
+  options.depth = vm["depth"].as<size_t>();
+  options.calls = vm["calls"].as<size_t>();
+  for (auto how : {s::RecvMatchHow::ByHand, s::RecvMatchHow::Match,
+                   s::RecvMatchHow::Marked}) {
+    options.how = how;
+    s::Context c;
+    c.spawn<s::RecvMatchDriver>(options);
+    c.run();
+  }
+  return 0;
+}
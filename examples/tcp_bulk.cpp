@@ -0,0 +1,185 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <iostream>
+
+/// A bulk transfer over loopback into an unthrottled socket, with each read
+/// sent to the owner on its own and then gathered into batches. The owner
+/// can be given some work to do per message, to see the batches grow when it
+/// falls behind. Reports MB/s and how many messages it took.
+
+namespace s {
+
+struct BulkOptions {
+  uint32_t port = 12357;
+  size_t chunk = 64 * 1024;
+  std::string name;
+  size_t receiveBatchBytes = 0;
+  // spent by the receiver on each message
+  std::chrono::microseconds work{0};
+  std::chrono::milliseconds duration{3000};
+};
+
+struct BulkStats {
+  uint64_t bytes = 0;
+  uint64_t messages = 0;
+};
+
+class BulkSink : public Process {
+public:
+  BulkSink(ProcessArgs i, Tcp::Socket socket, BulkOptions options,
+           std::shared_ptr<BulkStats> stats)
+      : Process(std::move(i)), socket_(socket), options_(std::move(options)),
+        stats_(std::move(stats)) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      stats_->bytes += r.data.size();
+      ++stats_->messages;
+      if (options_.work.count()) {
+        auto const until = now() + options_.work;
+        while (now() < until)
+          ;
+      }
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+  BulkOptions const options_;
+  std::shared_ptr<BulkStats> stats_;
+};
+
+class BulkServer : public Process {
+public:
+  BulkServer(ProcessArgs i, BulkOptions options,
+             std::shared_ptr<BulkStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    Tcp::ListenerOptions listener(options_.port);
+    listener.throttled = false;
+    listener.receiveBatchBytes = options_.receiveBatchBytes;
+    Tcp::makeListener(this, sockets.address(), listener);
+    while (true) {
+      auto socket = co_await recv(sockets);
+      spawn<BulkSink>(socket, options_, stats_);
+    }
+  }
+
+private:
+  BulkOptions const options_;
+  std::shared_ptr<BulkStats> stats_;
+};
+
+// sends chunks as fast as the socket takes them
+class BulkSource : public Process {
+public:
+  BulkSource(ProcessArgs i, BulkOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket = co_await Tcp::connect(
+        this, Tcp::ConnectOptions("127.0.0.1", options_.port));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::string const chunk(options_.chunk, 'x');
+    while (true) {
+      co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(chunk));
+    }
+  }
+
+private:
+  BulkOptions const options_;
+};
+
+class BulkDriver : public Process {
+public:
+  BulkDriver(ProcessArgs i, BulkOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    auto stats = std::make_shared<BulkStats>();
+    spawnLink<BulkServer>(options_, stats);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    spawnLink<BulkSource>(options_);
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    double const mb = stats->bytes / double(1024 * 1024);
+    ESLOG(LL::INFO, options_.name, ": ", mb / seconds, " MB/s, ",
+          stats->messages / mb, " messages/MB, ",
+          stats->bytes / std::max<uint64_t>(stats->messages, 1),
+          " bytes/message");
+    // returning kills the server and source
+  }
+
+private:
+  BulkOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12357))(
+      "chunk", po::value<size_t>()->default_value(64 * 1024))(
+      "workUs", po::value<int>()->default_value(20),
+      "receiver work per message, for the runs with work")(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::BulkOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.chunk = vm["chunk"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+  auto const work = std::chrono::microseconds(vm["workUs"].as<int>());
+
+  std::vector<s::BulkOptions> runs;
+  for (auto w : {std::chrono::microseconds(0), work}) {
+    options.work = w;
+    auto const suffix =
+        w.count() ? s::concatString(", ", w.count(), "us a message") : "";
+    options.name = "each read" + suffix;
+    options.receiveBatchBytes = 0;
+    runs.push_back(options);
+    options.name = "batches up to 256KB" + suffix;
+    options.receiveBatchBytes = 256 * 1024;
+    runs.push_back(options);
+    options.name = "batches up to 1MB" + suffix;
+    options.receiveBatchBytes = 1024 * 1024;
+    runs.push_back(options);
+  }
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::BulkDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,200 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <iostream>
+
+/// Small fixed size messages echoed over loopback, each sent back on its own.
+/// Clients keep a window of messages outstanding per connection. Run once
+/// with sockets writing one buffer at a time and once gathering everything
+/// queued into each write, and reports messages/s and how many writes the
+/// server's sockets made.
+
+namespace s {
+
+struct SmallEchoOptions {
+  uint32_t port = 12358;
+  size_t connections = 8;
+  size_t window = 32;
+  size_t messageSize = 64;
+  std::string name;
+  Tcp::SocketOptions socket;
+  std::chrono::milliseconds duration{3000};
+};
+
+struct SmallEchoStats {
+  uint64_t messages = 0;
+  std::vector<std::shared_ptr<Tcp::SocketStats const>> server;
+};
+
+// splits what it reads into messages and sends each back
+class SmallEchoRunner : public Process {
+public:
+  SmallEchoRunner(ProcessArgs i, Tcp::Socket socket, size_t message_size)
+      : Process(std::move(i)), socket_(socket), messageSize_(message_size) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    std::string partial;
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      partial.append(reinterpret_cast<char const*>(r.data.data()),
+                     r.data.size());
+      size_t at = 0;
+      for (; at + messageSize_ <= partial.size(); at += messageSize_) {
+        co_await Tcp::sendThrottled(
+            this, socket_,
+            Buffer::makeCopy(partial.data() + at, messageSize_));
+      }
+      partial.erase(0, at);
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+  size_t const messageSize_;
+};
+
+class SmallEchoServer : public Process {
+public:
+  SmallEchoServer(ProcessArgs i, SmallEchoOptions options,
+                  std::shared_ptr<SmallEchoStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    Tcp::ListenerOptions listener(options_.port);
+    static_cast<Tcp::SocketOptions&>(listener) = options_.socket;
+    Tcp::makeListener(this, sockets.address(), listener);
+    while (true) {
+      auto socket = co_await recv(sockets);
+      stats_->server.push_back(socket.stats);
+      spawn<SmallEchoRunner>(socket, options_.messageSize);
+    }
+  }
+
+private:
+  SmallEchoOptions const options_;
+  std::shared_ptr<SmallEchoStats> stats_;
+};
+
+// keeps a window of messages outstanding, each sent on its own
+class SmallEchoClient : public Process {
+public:
+  SmallEchoClient(ProcessArgs i, SmallEchoOptions options,
+                  std::shared_ptr<SmallEchoStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::ConnectOptions connect("127.0.0.1", options_.port);
+    static_cast<Tcp::SocketOptions&>(connect) = options_.socket;
+    auto socket = co_await Tcp::connect(this, connect);
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::string const message(options_.messageSize, 'x');
+    for (size_t i = 0; i < options_.window; ++i) {
+      co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(message));
+    }
+    size_t partial = 0;
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      partial += r.data.size();
+      for (; partial >= options_.messageSize;
+           partial -= options_.messageSize) {
+        ++stats_->messages;
+        co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(message));
+      }
+    }
+  }
+
+private:
+  SmallEchoOptions const options_;
+  std::shared_ptr<SmallEchoStats> stats_;
+};
+
+class SmallEchoDriver : public Process {
+public:
+  SmallEchoDriver(ProcessArgs i, SmallEchoOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    auto stats = std::make_shared<SmallEchoStats>();
+    spawnLink<SmallEchoServer>(options_, stats);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    for (size_t i = 0; i < options_.connections; ++i) {
+      spawnLink<SmallEchoClient>(options_, stats);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    Tcp::SocketStats server;
+    for (auto const& s : stats->server) {
+      server.writes += s->writes;
+      server.buffersWritten += s->buffersWritten;
+    }
+    ESLOG(LL::INFO, options_.name, ": ", stats->messages / seconds,
+          " messages/s, server wrote ", server.buffersWritten, " in ",
+          server.writes, " writes");
+    // returning kills the server and clients
+  }
+
+private:
+  SmallEchoOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12358))(
+      "connections", po::value<size_t>()->default_value(8))(
+      "window", po::value<size_t>()->default_value(32))(
+      "messageSize", po::value<size_t>()->default_value(64))(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::SmallEchoOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.connections = vm["connections"].as<size_t>();
+  options.window = vm["window"].as<size_t>();
+  options.messageSize = vm["messageSize"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+
+  std::vector<s::SmallEchoOptions> runs;
+  options.name = "one buffer a write";
+  // full after any one buffer
+  options.socket.maxQueuedBytes = 1;
+  runs.push_back(options);
+  options.name = "gathered writes";
+  options.socket.maxQueuedBytes = s::Tcp::SocketOptions().maxQueuedBytes;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::SmallEchoDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,267 @@
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <iostream>
+
+/// TLS handshakes a second against an in process listener over loopback.
+/// Clients connect, send a byte and get it back, then hang up and do it
+/// again, either from scratch (a full handshake each time) or resuming the
+/// session from their last connection, through a session ticket or the
+/// listener's session cache. The listener uses a self signed certificate made
+/// at startup.
+
+namespace s {
+
+namespace ssl = boost::asio::ssl;
+using boost::asio::ip::tcp;
+
+struct TlsResumeOptions {
+  uint32_t port = 12355;
+  size_t clients = 8;
+  std::string name;
+  bool resume = false;
+  // the most the clients will use
+  int maxVersion = TLS1_3_VERSION;
+  Tcp::TlsOptions tls;
+  std::chrono::milliseconds duration{3000};
+};
+
+struct TlsResumeStats {
+  uint64_t handshakes = 0;
+  uint64_t resumed = 0;
+  // handshakes where the listener picked http/1.1 through ALPN
+  uint64_t alpn = 0;
+};
+
+std::unique_ptr<ssl::context> makeSelfSigned(boost::asio::io_service&) {
+  auto ret = std::make_unique<ssl::context>(ssl::context::tls_server);
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_EC_gen("P-256"),
+                                                          EVP_PKEY_free);
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+  if (!key || !cert) {
+    ESLANGEXCEPT("Could not make a certificate");
+  }
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+  X509_set_pubkey(cert.get(), key.get());
+  auto* name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC,
+      reinterpret_cast<unsigned char const*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  if (!X509_sign(cert.get(), key.get(), EVP_sha256()) ||
+      SSL_CTX_use_certificate(ret->native_handle(), cert.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(ret->native_handle(), key.get()) != 1) {
+    ESLANGEXCEPT("Could not use the certificate");
+  }
+  return ret;
+}
+
+// sends back what it gets
+class TlsEcho : public Process {
+public:
+  TlsEcho(ProcessArgs i, Tcp::Socket socket)
+      : Process(std::move(i)), socket_(socket) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      Tcp::send(this, socket_, std::move(r.data));
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+};
+
+class TlsEchoServer : public Process {
+public:
+  TlsEchoServer(ProcessArgs i, Tcp::ListenerOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    Tcp::makeListener(this, sockets.address(), options_);
+    while (true) {
+      auto socket = co_await recv(sockets);
+      spawn<TlsEcho>(socket);
+    }
+  }
+
+private:
+  Tcp::ListenerOptions const options_;
+};
+
+class HandshakeClient : public Process {
+public:
+  HandshakeClient(ProcessArgs i, TlsResumeOptions options,
+                  std::shared_ptr<TlsResumeStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  ProcessTask run() {
+    ssl::context context(ssl::context::tls_client);
+    SSL_CTX_set_max_proto_version(context.native_handle(),
+                                  options_.maxVersion);
+    static unsigned char const kAlpn[] = "\x08http/1.1";
+    SSL_CTX_set_alpn_protos(context.native_handle(), kAlpn,
+                            sizeof(kAlpn) - 1);
+    std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session(
+        nullptr, SSL_SESSION_free);
+    tcp::endpoint const to(boost::asio::ip::make_address("127.0.0.1"),
+                           options_.port);
+    EslangPromise p;
+    boost::system::error_code error;
+    auto done = [&](boost::system::error_code const& ec, auto&&...) {
+      if (ec == boost::asio::error::operation_aborted) {
+        return;
+      }
+      error = ec;
+      p.setIfUnset();
+    };
+    auto check = [&](char const* what) {
+      if (error) {
+        ESLANGEXCEPT(what, " failed ", error.message());
+      }
+      p = EslangPromise();
+    };
+    while (true) {
+      ssl::stream<tcp::socket> stream(c()->ioService(), context);
+      if (session) {
+        SSL_set_session(stream.native_handle(), session.get());
+      }
+      stream.lowest_layer().async_connect(to, done);
+      co_await WaitOnFuture(&p);
+      check("Connect");
+      stream.lowest_layer().set_option(tcp::no_delay(true));
+      stream.async_handshake(ssl::stream_base::client, done);
+      co_await WaitOnFuture(&p);
+      check("Handshake");
+      // a byte each way, which also brings in any session tickets
+      char byte = 'x';
+      boost::asio::async_write(stream, boost::asio::buffer(&byte, 1), done);
+      co_await WaitOnFuture(&p);
+      check("Write");
+      boost::asio::async_read(stream, boost::asio::buffer(&byte, 1), done);
+      co_await WaitOnFuture(&p);
+      check("Read");
+      auto* native = stream.native_handle();
+      ++stats_->handshakes;
+      stats_->resumed += SSL_session_reused(native);
+      unsigned char const* alpn = nullptr;
+      unsigned int alpn_len = 0;
+      SSL_get0_alpn_selected(native, &alpn, &alpn_len);
+      stats_->alpn += alpn_len == 8;
+      if (options_.resume) {
+        session.reset(SSL_get1_session(native));
+      }
+      // so the listener's end sees a clean close. It hangs up rather than
+      // answering, so how this ends does not matter
+      stream.async_shutdown(done);
+      co_await WaitOnFuture(&p);
+      p = EslangPromise();
+    }
+  }
+
+private:
+  TlsResumeOptions const options_;
+  std::shared_ptr<TlsResumeStats> stats_;
+};
+
+class TlsResumeDriver : public Process {
+public:
+  TlsResumeDriver(ProcessArgs i, TlsResumeOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    Tcp::ListenerOptions listener(options_.port);
+    listener.sslContextFactory = makeSelfSigned;
+    listener.tls = options_.tls;
+    listener.tls.alpn = {"h2", "http/1.1"};
+    listener.tls.stats = std::make_shared<Tcp::TlsStats>();
+    spawnLink<TlsEchoServer>(listener);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto stats = std::make_shared<TlsResumeStats>();
+    for (size_t i = 0; i < options_.clients; ++i) {
+      spawnLink<HandshakeClient>(options_, stats);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    auto const& server = *listener.tls.stats;
+    ESLOG(LL::INFO, options_.name, ": ", stats->handshakes / seconds,
+          " handshakes/s, ", stats->resumed, " of ", stats->handshakes,
+          " resumed (listener saw ", server.resumed, " of ",
+          server.handshakes, ", ", server.failed, " failed, ",
+          server.ticketKeyRotations, " ticket keys), ", stats->alpn,
+          " chose http/1.1");
+    // returning kills the listener and clients
+  }
+
+private:
+  TlsResumeOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12355))(
+      "clients", po::value<size_t>()->default_value(8))(
+      "tls12", "stop the clients at TLS 1.2")(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::TlsResumeOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.clients = vm["clients"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+  if (vm.count("tls12")) {
+    options.maxVersion = TLS1_2_VERSION;
+  }
+
+  std::vector<s::TlsResumeOptions> runs;
+  options.name = "full handshakes";
+  runs.push_back(options);
+  options.name = "resumed from tickets";
+  options.resume = true;
+  options.tls.sessionCacheSize = 0;
+  // so that tickets from the last key get renewed during the run
+  options.tls.ticketKeyLifetime = std::chrono::seconds(1);
+  runs.push_back(options);
+  options.name = "resumed from the session cache";
+  options.tls = s::Tcp::TlsOptions();
+  options.tls.tickets = false;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::TlsResumeDriver>(run);
+    c.run();
+  }
+  return 0;
+}
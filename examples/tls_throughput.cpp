@@ -0,0 +1,231 @@
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <iostream>
+
+/// Bulk TLS sends from an in process listener over loopback, with the
+/// listener encrypting through OpenSSL and then with kernel TLS. Each client
+/// connects and reads whatever the listener sends it for as long as the run
+/// lasts. Everything shares one thread, so this is MB/s for a core doing both
+/// ends. Where the kernel cannot do TLS both runs use OpenSSL, which the
+/// listener's counts show.
+
+namespace s {
+
+namespace ssl = boost::asio::ssl;
+using boost::asio::ip::tcp;
+
+struct TlsThroughputOptions {
+  uint32_t port = 12356;
+  size_t clients = 1;
+  size_t chunk = 64 * 1024;
+  std::string name;
+  int maxVersion = TLS1_3_VERSION;
+  bool ktls = false;
+  std::chrono::milliseconds duration{3000};
+};
+
+std::unique_ptr<ssl::context> makeSelfSigned(boost::asio::io_service&) {
+  auto ret = std::make_unique<ssl::context>(ssl::context::tls_server);
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_EC_gen("P-256"),
+                                                          EVP_PKEY_free);
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+  if (!key || !cert) {
+    ESLANGEXCEPT("Could not make a certificate");
+  }
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+  X509_set_pubkey(cert.get(), key.get());
+  auto* name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC,
+      reinterpret_cast<unsigned char const*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  if (!X509_sign(cert.get(), key.get(), EVP_sha256()) ||
+      SSL_CTX_use_certificate(ret->native_handle(), cert.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(ret->native_handle(), key.get()) != 1) {
+    ESLANGEXCEPT("Could not use the certificate");
+  }
+  return ret;
+}
+
+// sends chunks until it is killed
+class TlsSource : public Process {
+public:
+  TlsSource(ProcessArgs i, Tcp::Socket socket, size_t chunk)
+      : Process(std::move(i)), socket_(socket), chunk_(chunk, 'x') {
+    link(socket.pid);
+  }
+
+  // the clients send nothing, but the socket only starts once it has
+  // somewhere to put what they do
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      co_await Tcp::sendThrottled(this, socket_, Buffer::makeCopy(chunk_));
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+  std::string const chunk_;
+};
+
+class TlsSourceServer : public Process {
+public:
+  TlsSourceServer(ProcessArgs i, Tcp::ListenerOptions options, size_t chunk)
+      : Process(std::move(i)), options_(std::move(options)), chunk_(chunk) {}
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    Tcp::makeListener(this, sockets.address(), options_);
+    while (true) {
+      auto socket = co_await recv(sockets);
+      spawn<TlsSource>(socket, chunk_);
+    }
+  }
+
+private:
+  Tcp::ListenerOptions const options_;
+  size_t const chunk_;
+};
+
+class SinkClient : public Process {
+public:
+  SinkClient(ProcessArgs i, TlsThroughputOptions options,
+             std::shared_ptr<uint64_t> bytes)
+      : Process(std::move(i)), options_(std::move(options)),
+        bytes_(std::move(bytes)) {}
+
+  ProcessTask run() {
+    ssl::context context(ssl::context::tls_client);
+    SSL_CTX_set_max_proto_version(context.native_handle(),
+                                  options_.maxVersion);
+    ssl::stream<tcp::socket> stream(c()->ioService(), context);
+    tcp::endpoint const to(boost::asio::ip::make_address("127.0.0.1"),
+                           options_.port);
+    EslangPromise p;
+    boost::system::error_code error;
+    size_t got = 0;
+    auto done = [&](boost::system::error_code const& ec, size_t bytes = 0) {
+      if (ec == boost::asio::error::operation_aborted) {
+        return;
+      }
+      error = ec;
+      got = bytes;
+      p.setIfUnset();
+    };
+    auto check = [&](char const* what) {
+      if (error) {
+        ESLANGEXCEPT(what, " failed ", error.message());
+      }
+      p = EslangPromise();
+    };
+    stream.lowest_layer().async_connect(
+        to, [&](boost::system::error_code const& ec) { done(ec); });
+    co_await WaitOnFuture(&p);
+    check("Connect");
+    stream.async_handshake(
+        ssl::stream_base::client,
+        [&](boost::system::error_code const& ec) { done(ec); });
+    co_await WaitOnFuture(&p);
+    check("Handshake");
+    std::vector<char> buff(options_.chunk);
+    while (true) {
+      stream.async_read_some(boost::asio::buffer(buff), done);
+      co_await WaitOnFuture(&p);
+      check("Read");
+      *bytes_ += got;
+    }
+  }
+
+private:
+  TlsThroughputOptions const options_;
+  std::shared_ptr<uint64_t> bytes_;
+};
+
+class TlsThroughputDriver : public Process {
+public:
+  TlsThroughputDriver(ProcessArgs i, TlsThroughputOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    Tcp::ListenerOptions listener(options_.port);
+    listener.sslContextFactory = makeSelfSigned;
+    listener.tls.ktls = options_.ktls;
+    listener.tls.stats = std::make_shared<Tcp::TlsStats>();
+    spawnLink<TlsSourceServer>(listener, options_.chunk);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto bytes = std::make_shared<uint64_t>(0);
+    for (size_t i = 0; i < options_.clients; ++i) {
+      spawnLink<SinkClient>(options_, bytes);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    auto const& server = *listener.tls.stats;
+    ESLOG(LL::INFO, options_.name, ": ", *bytes / seconds / (1024 * 1024),
+          " MB/s (kernel TLS on ", server.ktls, " of ", server.handshakes,
+          " connections)");
+    // returning kills the listener and clients
+  }
+
+private:
+  TlsThroughputOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12356))(
+      "clients", po::value<size_t>()->default_value(1))(
+      "chunk", po::value<size_t>()->default_value(64 * 1024))(
+      "tls12", "stop the clients at TLS 1.2")(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::TlsThroughputOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.clients = vm["clients"].as<size_t>();
+  options.chunk = vm["chunk"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+  if (vm.count("tls12")) {
+    options.maxVersion = TLS1_2_VERSION;
+  }
+
+  std::vector<s::TlsThroughputOptions> runs;
+  options.name = "OpenSSL";
+  runs.push_back(options);
+  options.name = "kernel TLS";
+  options.ktls = true;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::TlsThroughputDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Udp.h>
+#include <iostream>
+
+/// Small datagrams over loopback from sending sockets to one receiving
+/// socket, one datagram per system call, then batched through
+/// recvmmsg/sendmmsg, then batched with GSO and GRO as well. Reports packets
+/// a second sent and received and how many system calls that took.
+
+namespace s {
+
+struct PpsOptions {
+  uint32_t port = 12359;
+  size_t senders = 1;
+  size_t size = 64;
+  // datagrams each sender hands its socket at once
+  size_t burst = 32;
+  std::string name;
+  Udp::SocketOptions socket;
+  std::chrono::milliseconds duration{3000};
+};
+
+class PpsReceiver : public Process {
+public:
+  PpsReceiver(ProcessArgs i, Udp::Socket socket)
+      : Process(std::move(i)), socket_(std::move(socket)) {}
+
+  Slot<Udp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Udp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      co_await Process::recv(recv);
+    }
+  }
+
+private:
+  Udp::Socket const socket_;
+};
+
+class PpsSender : public Process {
+public:
+  PpsSender(ProcessArgs i, PpsOptions options, Udp::Endpoint to,
+            std::shared_ptr<std::vector<Udp::Socket>> sockets)
+      : Process(std::move(i)), options_(std::move(options)), to_(to),
+        sockets_(std::move(sockets)) {}
+
+  ProcessTask run() {
+    auto socket = Udp::bind(this, options_.socket);
+    sockets_->push_back(socket);
+    auto const payload = Buffer::makeCopy(std::string(options_.size, 'x'));
+    while (true) {
+      std::vector<Udp::Datagram> burst(options_.burst, {to_, payload});
+      co_await Udp::sendManyThrottled(this, socket, std::move(burst));
+    }
+  }
+
+private:
+  PpsOptions const options_;
+  Udp::Endpoint const to_;
+  std::shared_ptr<std::vector<Udp::Socket>> sockets_;
+};
+
+class PpsDriver : public Process {
+public:
+  PpsDriver(ProcessArgs i, PpsOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    auto receiving = options_.socket;
+    receiving.address = "127.0.0.1";
+    receiving.port = options_.port;
+    receiving.receiveBufferBytes = 4 * 1024 * 1024;
+    receiving.throttled = false;
+    auto socket = Udp::bind(this, receiving);
+    spawnLink<PpsReceiver>(socket);
+    auto senders = std::make_shared<std::vector<Udp::Socket>>();
+    for (size_t i = 0; i < options_.senders; ++i) {
+      spawnLink<PpsSender>(options_, socket.local, senders);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    Udp::SocketStats sent;
+    for (auto const& s : *senders) {
+      sent.datagramsWritten += s.stats->datagramsWritten;
+      sent.writes += s.stats->writes;
+    }
+    auto const& got = *socket.stats;
+    ESLOG(LL::INFO, options_.name, ": sent ", sent.datagramsWritten / seconds,
+          "/s in ", sent.writes / seconds, " writes/s, received ",
+          got.datagramsRead / seconds, "/s in ", got.reads / seconds,
+          " reads/s");
+    // returning kills the sockets
+  }
+
+private:
+  PpsOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12359))(
+      "senders", po::value<size_t>()->default_value(1))(
+      "size", po::value<size_t>()->default_value(64))(
+      "burst", po::value<size_t>()->default_value(32))(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::PpsOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.senders = vm["senders"].as<size_t>();
+  options.size = vm["size"].as<size_t>();
+  options.burst = vm["burst"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+
+  std::vector<s::PpsOptions> runs;
+  options.name = "one a system call";
+  options.socket.batch = 1;
+  runs.push_back(options);
+  options.name = "recvmmsg/sendmmsg";
+  options.socket.batch = 32;
+  runs.push_back(options);
+  options.name = "recvmmsg/sendmmsg with GSO and GRO";
+  options.socket.gso = true;
+  options.socket.gro = true;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::PpsDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -0,0 +1,289 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <iostream>
+
+/// Unix domain sockets against tcp over loopback, between two processes of
+/// one context. Ping pong sends a small message back and forth on one
+/// connection and reports round trips/s; bulk streams big buffers one way
+/// and reports MB/s. Each is also run over tcp connections that the listener
+/// accepts as raw fds and passes over a unix socket to another process, which
+/// adopts them, as a front end handing connections to a worker would.
+
+namespace s {
+
+enum class Transport { Tcp, Unix, HandedOff };
+
+struct UnixVsTcpOptions {
+  uint32_t port = 12360;
+  std::string path = "/tmp/eslang_unix_vs_tcp.sock";
+  Transport transport = Transport::Tcp;
+  bool bulk = false;
+  size_t messageSize = 64;
+  size_t bulkSize = 64 * 1024;
+  std::string name;
+  std::chrono::milliseconds duration{3000};
+};
+
+struct UnixVsTcpStats {
+  uint64_t roundTrips = 0;
+  uint64_t bytes = 0;
+  uint64_t handedOff = 0;
+};
+
+// sends back what it gets, or just counts it for bulk runs
+class UnixVsTcpRunner : public Process {
+public:
+  UnixVsTcpRunner(ProcessArgs i, Tcp::Socket socket, UnixVsTcpOptions options,
+                  std::shared_ptr<UnixVsTcpStats> stats)
+      : Process(std::move(i)), socket_(socket), options_(std::move(options)),
+        stats_(std::move(stats)) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      if (options_.bulk) {
+        stats_->bytes += r.data.size();
+      } else {
+        co_await Tcp::sendThrottled(this, socket_, std::move(r.data));
+      }
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+  UnixVsTcpOptions const options_;
+  std::shared_ptr<UnixVsTcpStats> stats_;
+};
+
+// takes the tcp connections passed over a unix socket and runs them
+class HandOffReceiver : public Process {
+public:
+  HandOffReceiver(ProcessArgs i, Tcp::Socket socket, UnixVsTcpOptions options,
+                  std::shared_ptr<UnixVsTcpStats> stats)
+      : Process(std::move(i)), socket_(socket), options_(std::move(options)),
+        stats_(std::move(stats)) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      for (auto& fd : r.fds) {
+        auto socket = co_await Tcp::adopt(this, std::move(fd), {});
+        ++stats_->handedOff;
+        spawn<UnixVsTcpRunner>(socket, options_, stats_);
+      }
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+  UnixVsTcpOptions const options_;
+  std::shared_ptr<UnixVsTcpStats> stats_;
+};
+
+// accepts tcp connections and passes them on without reading them
+class HandOffFront : public Process {
+public:
+  HandOffFront(ProcessArgs i, UnixVsTcpOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Tcp::Fd> fds{this};
+  // nothing comes here, as the listener sends fds instead
+  Slot<Tcp::Socket> sockets{this};
+  // nor here, as the worker sends nothing back
+  Slot<Tcp::ReceiveData> replies{this};
+
+  ProcessTask run() {
+    auto worker = co_await Tcp::connectUnix(
+        this, Tcp::UnixConnectOptions(options_.path));
+    Tcp::initRecvSocket(this, worker, replies.address());
+    Tcp::ListenerOptions listener(options_.port);
+    listener.acceptFds = fds.address();
+    Tcp::makeListener(this, sockets.address(), listener);
+    while (true) {
+      auto fd = co_await recv(fds);
+      std::vector<Tcp::Fd> pass;
+      pass.push_back(std::move(fd));
+      co_await Tcp::sendFdsThrottled(this, worker, Buffer::makeCopy("f"),
+                                     std::move(pass));
+    }
+  }
+
+private:
+  UnixVsTcpOptions const options_;
+};
+
+class UnixVsTcpServer : public Process {
+public:
+  UnixVsTcpServer(ProcessArgs i, UnixVsTcpOptions options,
+                  std::shared_ptr<UnixVsTcpStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    if (options_.transport == Transport::Tcp) {
+      Tcp::makeListener(this, sockets.address(),
+                        Tcp::ListenerOptions(options_.port));
+    } else {
+      Tcp::makeUnixListener(this, sockets.address(),
+                            Tcp::UnixListenerOptions(options_.path));
+    }
+    if (options_.transport == Transport::HandedOff) {
+      spawnLink<HandOffFront>(options_);
+    }
+    while (true) {
+      auto socket = co_await recv(sockets);
+      if (options_.transport == Transport::HandedOff) {
+        spawn<HandOffReceiver>(socket, options_, stats_);
+      } else {
+        spawn<UnixVsTcpRunner>(socket, options_, stats_);
+      }
+    }
+  }
+
+private:
+  UnixVsTcpOptions const options_;
+  std::shared_ptr<UnixVsTcpStats> stats_;
+};
+
+class UnixVsTcpClient : public Process {
+public:
+  UnixVsTcpClient(ProcessArgs i, UnixVsTcpOptions options,
+                  std::shared_ptr<UnixVsTcpStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  MethodTask<Tcp::Socket> connect() {
+    if (options_.transport == Transport::Unix) {
+      co_return co_await Tcp::connectUnix(
+          this, Tcp::UnixConnectOptions(options_.path));
+    }
+    co_return co_await Tcp::connect(
+        this, Tcp::ConnectOptions("127.0.0.1", options_.port));
+  }
+
+  ProcessTask run() {
+    auto socket = co_await connect();
+    Tcp::initRecvSocket(this, socket, recv.address());
+    if (options_.bulk) {
+      auto const chunk = Buffer::makeCopy(std::string(options_.bulkSize, 'x'));
+      while (true) {
+        co_await Tcp::sendThrottled(this, socket, chunk);
+      }
+    }
+    auto const message =
+        Buffer::makeCopy(std::string(options_.messageSize, 'x'));
+    while (true) {
+      co_await Tcp::sendThrottled(this, socket, message);
+      size_t got = 0;
+      while (got < options_.messageSize) {
+        got += (co_await Process::recv(recv)).data.size();
+      }
+      ++stats_->roundTrips;
+    }
+  }
+
+private:
+  UnixVsTcpOptions const options_;
+  std::shared_ptr<UnixVsTcpStats> stats_;
+};
+
+class UnixVsTcpDriver : public Process {
+public:
+  UnixVsTcpDriver(ProcessArgs i, UnixVsTcpOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    auto stats = std::make_shared<UnixVsTcpStats>();
+    spawnLink<UnixVsTcpServer>(options_, stats);
+    // let the listeners start
+    co_await sleep(std::chrono::milliseconds(10));
+    spawnLink<UnixVsTcpClient>(options_, stats);
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    if (options_.bulk) {
+      ESLOG(LL::INFO, options_.name, ": ",
+            stats->bytes / seconds / (1024 * 1024), " MB/s, ",
+            stats->handedOff, " connections handed off");
+    } else {
+      ESLOG(LL::INFO, options_.name, ": ", stats->roundTrips / seconds,
+            " round trips/s, ", seconds * 1e6 / stats->roundTrips,
+            " us each, ", stats->handedOff, " connections handed off");
+    }
+    // returning kills the server and client
+  }
+
+private:
+  UnixVsTcpOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12360))(
+      "path",
+      po::value<std::string>()->default_value("/tmp/eslang_unix_vs_tcp.sock"))(
+      "messageSize", po::value<size_t>()->default_value(64))(
+      "bulkSize", po::value<size_t>()->default_value(64 * 1024))(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::UnixVsTcpOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.path = vm["path"].as<std::string>();
+  options.messageSize = vm["messageSize"].as<size_t>();
+  options.bulkSize = vm["bulkSize"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+
+  std::vector<s::UnixVsTcpOptions> runs;
+  for (bool bulk : {false, true}) {
+    options.bulk = bulk;
+    std::string const test = bulk ? "bulk over " : "ping pong over ";
+    options.name = test + "tcp";
+    options.transport = s::Transport::Tcp;
+    runs.push_back(options);
+    options.name = test + "unix";
+    options.transport = s::Transport::Unix;
+    runs.push_back(options);
+    options.name = test + "tcp handed off over unix";
+    options.transport = s::Transport::HandedOff;
+    runs.push_back(options);
+  }
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::UnixVsTcpDriver>(run);
+    c.run();
+  }
+  return 0;
+}
@@ -2,26 +2,37 @@
 
 #include <boost/program_options.hpp>
 #include <eslang/Context.h>
+#include <eslang_www/ResponseCache.h>
+#include <eslang_www/Router.h>
 #include <eslang_www/Www.h>
 #include <iostream>
 #include <random>
 
 namespace s {
 
-class ExampleWwwHandler : public Www::Server::IHandler {
+Www::Response notFound() {
+  Www::Response resp{};
+  resp.message.set(boost::beast::http::field::content_type, "text/html");
+  resp.message.result(boost::beast::http::status::not_found);
+  resp.message.body() = "404 not found";
+  resp.message.prepare_payload();
+  resp.cacheFor = std::chrono::seconds(60);
+  return resp;
+}
+
+class ExampleWwwRoute : public Www::Router::IRoute {
   std::mt19937 gen{123456};
+  bool const chunked;
 
-  MethodTask<Www::Response> getResponse(Process* proc,
-                                        Www::Request const& req) override {
+public:
+  explicit ExampleWwwRoute(bool chunked) : chunked(chunked) {}
+
+  MethodTask<Www::Response>
+  getResponse(Process* proc, Www::RequestView const& req,
+              Www::Router::Params const& params) override {
     Www::Response resp{};
     ESLOG(LL::INFO, "Received ", req.toString());
     resp.message.set(boost::beast::http::field::content_type, "text/html");
-    if (req.message.target().find("favicon") != std::string::npos) {
-      resp.message.result(boost::beast::http::status::not_found);
-      resp.message.body() = "404 not found";
-      resp.message.prepare_payload();
-      co_return resp;
-    }
     auto& r = resp.message;
     auto dist = std::uniform_real_distribution<double>{0, 0.75};
     double const sleep = dist(gen);
@@ -34,11 +45,11 @@ class ExampleWwwHandler : public Www::Server::IHandler {
 "<html><head><title>ESLANG</title></head>"
 "<body>Powered by <a href=\"https://github.com/dylanza/eslang\">Eslang</a><br>"
 "Hello, world! from "
-		   , std::string(req.message.target()),
+		   , std::string(params.find("path").value_or("")),
 		   " slept ", sleep,
 		   "</body></html>"
 		   );
-    if (req.message.target().find("chunk") != std::string::npos) {
+    if (chunked) {
       r.chunked(true);
     } else {
       r.prepare_payload();
@@ -46,7 +57,8 @@ class ExampleWwwHandler : public Www::Server::IHandler {
     co_return resp;
   }
 
-  GenTask<Buffer> getChunked(Process* proc, Www::Request const&) override {
+  GenTask<Buffer> getChunked(Process* proc, Www::RequestView const&,
+                             Www::Router::Params const&) override {
     for (int i = 0; i < 10; ++i) {
       co_await proc->sleep(std::chrono::milliseconds(10));
       ESLOG(LL::INFO, "Send chunk ", i);
@@ -54,6 +66,23 @@ class ExampleWwwHandler : public Www::Server::IHandler {
     }
   }
 };
+
+std::shared_ptr<Www::Router> makeExampleRouter() {
+  using boost::beast::http::verb;
+  auto router = std::make_shared<Www::Router>();
+  router->add(verb::get, "/favicon.ico",
+              [](Process*, Www::RequestView const&,
+                 Www::Router::Params const&) -> MethodTask<Www::Response> {
+                co_return notFound();
+              });
+  auto chunked = std::make_shared<ExampleWwwRoute>(true);
+  auto plain = std::make_shared<ExampleWwwRoute>(false);
+  for (auto v : {verb::get, verb::post}) {
+    router->add(v, "/chunk/*path", chunked);
+    router->add(v, "/*path", plain);
+  }
+  return router;
+}
 }
 
 struct Options {
@@ -71,7 +100,8 @@ int main(int argc, char** argv) {
   desc.add_options()("help,h", "Help screen")("ca", po::value<std::string>())(
       "key", po::value<std::string>())("cert", po::value<std::string>())(
       "plainPort", po::value<uint32_t>()->default_value(12345))(
-      "sslPort", po::value<uint32_t>()->default_value(12346));
+      "sslPort", po::value<uint32_t>()->default_value(12346))(
+      "maxInFlight", po::value<size_t>()->default_value(1));
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -82,18 +112,20 @@ int main(int argc, char** argv) {
   }
 
   s::Context c;
+  auto router = s::makeExampleRouter();
+  s::Www::Server::ServerOptions server_options;
+  server_options.responseCache = std::make_shared<s::Www::ResponseCache>();
+  server_options.maxInFlight = vm["maxInFlight"].as<size_t>();
   if (auto v = vm["plainPort"].as<uint32_t>()) {
     s::Tcp::ListenerOptions listener_options(v);
-    c.spawn<s::Www::Server>(std::make_unique<s::ExampleWwwHandler>(),
-                            listener_options);
+    c.spawn<s::Www::Server>(router, listener_options, server_options);
   }
   if (auto v = vm["sslPort"].as<uint32_t>()) {
     s::Tcp::ListenerOptions listener_options(v);
     listener_options = listener_options.withSslFiles(
         vm["ca"].as<std::string>(), vm["cert"].as<std::string>(),
         vm["key"].as<std::string>());
-    c.spawn<s::Www::Server>(std::make_unique<s::ExampleWwwHandler>(),
-                            listener_options);
+    c.spawn<s::Www::Server>(router, listener_options, server_options);
   }
   c.run();
   return 0;
@@ -0,0 +1,286 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Logging.h>
+#include <eslang_www/ResponseCache.h>
+#include <eslang_www/Router.h>
+#include <eslang_www/WwwParser.h>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+/// Micro benchmarks for the pieces of Www::Server that run per request.
+/// These do not touch sockets, so they measure only our own overhead.
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+void* operator new(size_t n) {
+  ++allocations;
+  if (void* p = std::malloc(n)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace s {
+
+struct BenchResult {
+  uint64_t requests = 0;
+  uint64_t allocations = 0;
+  double seconds = 0;
+};
+
+std::ostream& operator<<(std::ostream& s, BenchResult const& r) {
+  s << r.requests / r.seconds << " req/s, "
+    << double(r.allocations) / r.requests << " allocations/req";
+  return s;
+}
+
+template <class Fn> BenchResult measure(uint64_t requests, Fn fn) {
+  BenchResult ret;
+  auto const start_allocations = allocations.load();
+  auto const start = std::chrono::steady_clock::now();
+  fn();
+  ret.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  ret.allocations = allocations.load() - start_allocations;
+  ret.requests = requests;
+  return ret;
+}
+
+// a pipelined stream of requests, cut up the same way TSocketProcess reads it
+std::vector<Buffer> makeReads(size_t n, size_t read_size) {
+  std::string all;
+  for (size_t i = 0; i < n; ++i) {
+    all += concatString("GET /some/path/", i,
+                        "?query=string HTTP/1.1\r\n"
+                        "Host: localhost:12345\r\n"
+                        "User-Agent: eslang-bench/1.0\r\n"
+                        "Accept: text/html,application/json;q=0.9\r\n"
+                        "Accept-Encoding: gzip, deflate\r\n"
+                        "Connection: keep-alive\r\n"
+                        "\r\n");
+  }
+  std::vector<Buffer> ret;
+  for (size_t at = 0; at < all.size(); at += read_size) {
+    ret.push_back(Buffer::makeCopy(all.data() + at,
+                                   std::min(read_size, all.size() - at)));
+  }
+  return ret;
+}
+
+void benchParse(size_t n, size_t rounds) {
+  auto const reads = makeReads(n, 16000);
+  uint64_t total = 0;
+  auto views = measure(n * rounds, [&] {
+    for (size_t r = 0; r < rounds; ++r) {
+      WwwParser parser;
+      for (auto const& b : reads) {
+        parser.push(b);
+        while (auto req = parser.next()) {
+          total += req->target.size();
+        }
+      }
+    }
+  });
+  ESLOG(LL::INFO, "parse (views):     ", views);
+
+  // what the server used to do: every request copied into an owning message
+  auto owning = measure(n * rounds, [&] {
+    for (size_t r = 0; r < rounds; ++r) {
+      WwwParser parser;
+      for (auto const& b : reads) {
+        parser.push(b);
+        while (auto req = parser.next()) {
+          total += req->toRequest().message.target().size();
+        }
+      }
+    }
+  });
+  ESLOG(LL::INFO, "parse (owning):    ", owning);
+  ESLOG(LL::INFO, "checksum ", total);
+}
+
+Www::RequestView parseOne(std::string const& s) {
+  WwwParser parser;
+  parser.push(Buffer::makeCopy(s));
+  return parser.next().value();
+}
+
+Www::Response makeJsonResponse() {
+  Www::Response resp;
+  resp.message.result(boost::beast::http::status::ok);
+  resp.message.set(boost::beast::http::field::content_type,
+                   "application/json");
+  resp.message.set(boost::beast::http::field::server, "Eslang");
+  resp.message.body() = "{\"status\":\"ok\",\"version\":\"1.2.3\","
+                        "\"uptime\":123456,\"checks\":[\"db\",\"cache\"]}";
+  resp.message.prepare_payload();
+  return resp;
+}
+
+void benchCache(size_t n) {
+  auto const req = parseOne("GET /health HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "Accept-Encoding: gzip\r\n"
+                            "\r\n");
+  size_t bytes = 0;
+
+  auto scratch = measure(n, [&] {
+    for (size_t i = 0; i < n; ++i) {
+      auto resp = makeJsonResponse();
+      for (auto const& b : WwwParser::serialize(resp).toBuffers(true).buffers) {
+        bytes += b.size();
+      }
+    }
+  });
+  ESLOG(LL::INFO, "serialize:         ", scratch);
+
+  Www::ResponseCache::Options options;
+  options.keyFields.push_back(boost::beast::http::field::accept_encoding);
+  Www::ResponseCache cache(options);
+  auto const now = std::chrono::steady_clock::now();
+  auto cached = measure(n, [&] {
+    for (size_t i = 0; i < n; ++i) {
+      auto hit = cache.lookup(req, now);
+      if (!hit) {
+        auto resp = makeJsonResponse();
+        cache.store(req, WwwParser::serialize(resp),
+                    now + std::chrono::seconds(60));
+        continue;
+      }
+      for (auto const& b : hit->toBuffers(i % 2).buffers) {
+        bytes += b.size();
+      }
+    }
+  });
+  ESLOG(LL::INFO, "cached:            ", cached);
+  ESLOG(LL::INFO, "cache hits ", cache.stats().hits, " misses ",
+        cache.stats().misses, " bytes ", bytes);
+}
+
+class NullRoute : public Www::Router::IRoute {
+public:
+  MethodTask<Www::Response> getResponse(Process*, Www::RequestView const&,
+                                        Www::Router::Params const&) override {
+    co_return Www::Response();
+  }
+};
+
+std::vector<std::string> splitPath(std::string const& path) {
+  std::vector<std::string> ret;
+  std::stringstream ss(path);
+  std::string seg;
+  while (std::getline(ss, seg, '/')) {
+    if (seg.size()) {
+      ret.push_back(seg);
+    }
+  }
+  return ret;
+}
+
+// what dispatch looks like without a router: try every pattern in turn
+struct LinearRouter {
+  std::vector<std::vector<std::string>> patterns;
+  size_t match(boost::beast::string_view target) const {
+    auto const segs = splitPath(std::string(target.substr(0, target.find('?'))));
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      auto const& p = patterns[i];
+      if (p.size() != segs.size()) {
+        continue;
+      }
+      bool ok = true;
+      for (size_t j = 0; ok && j < p.size(); ++j) {
+        ok = p[j][0] == ':' || p[j] == segs[j];
+      }
+      if (ok) {
+        return i;
+      }
+    }
+    return patterns.size();
+  }
+};
+
+void benchRouter(size_t n, size_t routes) {
+  auto route = std::make_shared<NullRoute>();
+  Www::Router router;
+  LinearRouter linear;
+  for (size_t i = 0; i < routes / 2; ++i) {
+    for (auto const& pattern :
+         {concatString("/api/v", i % 3, "/service", i, "/:id"),
+          concatString("/api/v", i % 3, "/service", i, "/:id/items/:item")}) {
+      router.add(boost::beast::http::verb::get, pattern, route);
+      linear.patterns.push_back(splitPath(pattern));
+    }
+  }
+  std::vector<std::string> targets;
+  for (size_t i = 0; i < 1000; ++i) {
+    size_t const r = (i * 7919) % (routes / 2);
+    targets.push_back(
+        i % 2 ? concatString("/api/v", r % 3, "/service", r, "/", i)
+              : concatString("/api/v", r % 3, "/service", r, "/", i, "/items/",
+                             i * 2, "?verbose=1"));
+  }
+
+  size_t found = 0;
+  auto trie = measure(n, [&] {
+    for (size_t i = 0; i < n; ++i) {
+      Www::Router::Params params;
+      if (router.match(boost::beast::http::verb::get,
+                       targets[i % targets.size()], params)) {
+        found += params.find("id").has_value();
+      }
+    }
+  });
+  ESLOG(LL::INFO, "route trie (", router.size(), " routes): ", trie);
+  if (found != n) {
+    ESLANGEXCEPT("Router matched ", found, " of ", n);
+  }
+
+  size_t const linear_n = std::max<size_t>(1, n / routes);
+  size_t linear_found = 0;
+  auto scan = measure(linear_n, [&] {
+    for (size_t i = 0; i < linear_n; ++i) {
+      linear_found +=
+          linear.match(targets[i % targets.size()]) < linear.patterns.size();
+    }
+  });
+  ESLOG(LL::INFO, "route scan (", linear.patterns.size(), " routes): ", scan,
+        ", matched ", linear_found);
+}
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "requests", po::value<size_t>()->default_value(100000))(
+      "rounds", po::value<size_t>()->default_value(10));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+  size_t const requests = vm["requests"].as<size_t>();
+  size_t const rounds = vm["rounds"].as<size_t>();
+  s::benchParse(requests, rounds);
+  s::benchCache(requests * rounds);
+  for (size_t routes : {10, 1000, 10000}) {
+    s::benchRouter(requests * rounds, routes);
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <boost/beast/http.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Client.h>
+#include <iostream>
+
+/// Small GETs through Www::Client against an in process Www::Server over
+/// loopback: a new connection per request, one keep-alive connection, several
+/// connections, and several connections with pipelining. Callers are
+/// separate processes sharing one pool. Reports req/s.
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+struct ClientOptions {
+  uint32_t port = 12354;
+  size_t callers = 32;
+  std::string name;
+  Www::Client::Options pool;
+  bool keepAlive = true;
+  std::chrono::milliseconds duration{3000};
+};
+
+class HelloHandler : public Www::Server::IHandler {
+public:
+  MethodTask<Www::Response> getResponse(Process*,
+                                        Www::RequestView const&) override {
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.set(http::field::content_type, "text/plain");
+    resp.message.body() = "hello world";
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+};
+
+class ClientCaller : public Process {
+public:
+  ClientCaller(ProcessArgs i, ClientOptions options, Pid pool,
+               std::shared_ptr<uint64_t> responses)
+      : Process(std::move(i)), options_(std::move(options)),
+        client_(this, pool), responses_(std::move(responses)) {}
+
+  ProcessTask run() {
+    while (true) {
+      Www::Request req;
+      req.message.method(http::verb::get);
+      req.message.target("/hello");
+      req.message.keep_alive(options_.keepAlive);
+      co_await client_.request("127.0.0.1", options_.port, std::move(req));
+      ++*responses_;
+    }
+  }
+
+private:
+  ClientOptions const options_;
+  Www::Client client_;
+  std::shared_ptr<uint64_t> responses_;
+};
+
+class ClientDriver : public Process {
+public:
+  ClientDriver(ProcessArgs i, ClientOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    Www::Server::ServerOptions server;
+    server.maxInFlight = options_.pool.maxPipeline;
+    spawnLink<Www::Server>(std::make_shared<HelloHandler>(),
+                           Tcp::ListenerOptions(options_.port), server);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto pool = Www::Client::spawnPool(this, options_.pool);
+    auto responses = std::make_shared<uint64_t>(0);
+    for (size_t i = 0; i < options_.callers; ++i) {
+      spawnLink<ClientCaller>(options_, pool, responses);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.name, ": ", *responses / seconds, " req/s");
+    // returning kills the server, pool and callers
+  }
+
+private:
+  ClientOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12354))(
+      "callers", po::value<size_t>()->default_value(32))(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::ClientOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.callers = vm["callers"].as<size_t>();
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+
+  std::vector<s::ClientOptions> runs;
+  options.name = "connection per request";
+  options.keepAlive = false;
+  options.pool.maxConnections = 1;
+  options.pool.maxPipeline = 1;
+  runs.push_back(options);
+  options.name = "1 keep-alive connection";
+  options.keepAlive = true;
+  runs.push_back(options);
+  options.name = "4 connections";
+  options.pool.maxConnections = 4;
+  runs.push_back(options);
+  options.name = "4 connections, pipelined 8 deep";
+  options.pool.maxPipeline = 8;
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::ClientDriver>(run);
+    c.run();
+  }
+  return 0;
+}
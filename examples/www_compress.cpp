@@ -0,0 +1,225 @@
+#include <boost/beast/http.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Compression.h>
+#include <eslang_www/Www.h>
+#include <iostream>
+
+/// JSON responses from an in process Www::Server over loopback, sent as
+/// they are, gzipped per request, gzipped once through the precompressed
+/// cache (the handler marks them cacheable), and gzipped on the offload pool.
+/// Reports req/s and bytes on the wire per response.
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+struct CompressOptions {
+  uint32_t port = 12353;
+  size_t connections = 4;
+  size_t depth = 8;
+  size_t bodySize = 16 * 1024;
+  std::string name;
+  Www::Server::ServerOptions server;
+  bool cacheable = false;
+  std::chrono::milliseconds duration{3000};
+};
+
+struct CompressStats {
+  uint64_t responses = 0;
+  uint64_t bytes = 0;
+};
+
+std::string makeJson(size_t size) {
+  std::string ret = "[";
+  for (int i = 0; ret.size() < size; ++i) {
+    ret += concatString(i ? "," : "", "{\"id\":", i,
+                        ",\"name\":\"user", i % 97,
+                        "\",\"active\":", i % 3 ? "true" : "false",
+                        ",\"score\":", (i * 7919) % 1000, "}");
+  }
+  return ret + "]";
+}
+
+class JsonHandler : public Www::Server::IHandler {
+public:
+  JsonHandler(size_t size, bool cacheable)
+      : body_(makeJson(size)), cacheable_(cacheable) {}
+
+  MethodTask<Www::Response> getResponse(Process*,
+                                        Www::RequestView const&) override {
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.set(http::field::content_type, "application/json");
+    resp.message.body() = body_;
+    resp.message.prepare_payload();
+    if (cacheable_) {
+      resp.cacheFor = std::chrono::seconds(60);
+    }
+    co_return resp;
+  }
+
+private:
+  std::string const body_;
+  bool const cacheable_;
+};
+
+class CompressClient : public Process {
+public:
+  CompressClient(ProcessArgs i, CompressOptions options,
+                 std::shared_ptr<CompressStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket = co_await Tcp::connect(
+        this, Tcp::ConnectOptions("127.0.0.1", options_.port));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    static Buffer const request =
+        Buffer::makeCopy(std::string("GET /data HTTP/1.1\r\n"
+                                     "Host: localhost\r\n"
+                                     "Accept-Encoding: gzip, deflate\r\n"
+                                     "\r\n"));
+    for (size_t i = 0; i < options_.depth; ++i) {
+      Tcp::send(this, socket, request);
+    }
+    std::string buffered;
+    std::optional<http::response_parser<http::string_body>> parser;
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      stats_->bytes += r.data.size();
+      buffered.append(reinterpret_cast<char const*>(r.data.data()),
+                      r.data.size());
+      size_t at = 0;
+      while (at < buffered.size()) {
+        if (!parser) {
+          parser.emplace();
+          parser->eager(true);
+          parser->body_limit(64 * 1024 * 1024);
+        }
+        boost::beast::error_code ec;
+        at += parser->put(
+            boost::asio::buffer(buffered.data() + at, buffered.size() - at),
+            ec);
+        if (ec == http::error::need_more) {
+          break;
+        }
+        if (ec) {
+          ESLANGEXCEPT("Bad response ", ec.message());
+        }
+        if (parser->is_done()) {
+          parser.reset();
+          ++stats_->responses;
+          Tcp::send(this, socket, request);
+        }
+      }
+      buffered.erase(0, at);
+    }
+  }
+
+private:
+  CompressOptions const options_;
+  std::shared_ptr<CompressStats> stats_;
+};
+
+class CompressDriver : public Process {
+public:
+  CompressDriver(ProcessArgs i, CompressOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    spawnLink<Www::Server>(
+        std::make_shared<JsonHandler>(options_.bodySize, options_.cacheable),
+        Tcp::ListenerOptions(options_.port), options_.server);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto stats = std::make_shared<CompressStats>();
+    for (size_t i = 0; i < options_.connections; ++i) {
+      spawnLink<CompressClient>(options_, stats);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    std::string detail;
+    if (auto* compression = options_.server.compression.get()) {
+      auto const& c = compression->stats();
+      detail = concatString(", compressed ", c.compressed, " (", c.offloaded,
+                            " offloaded), cache hits ", c.cacheHits);
+    }
+    ESLOG(LL::INFO, options_.name, ": ", stats->responses / seconds,
+          " req/s, ",
+          stats->responses ? stats->bytes / stats->responses : 0,
+          " bytes per response", detail);
+    // returning kills the server and clients
+  }
+
+private:
+  CompressOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12353))(
+      "connections", po::value<size_t>()->default_value(4))(
+      "depth", po::value<size_t>()->default_value(8))(
+      "bodyKb", po::value<size_t>()->default_value(16))(
+      "level", po::value<int>()->default_value(6))(
+      "durationMs", po::value<int>()->default_value(3000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::CompressOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.connections = vm["connections"].as<size_t>();
+  options.depth = vm["depth"].as<size_t>();
+  options.bodySize = vm["bodyKb"].as<size_t>() * 1024;
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+
+  s::Www::Compression::Options inline_options;
+  inline_options.level = vm["level"].as<int>();
+  inline_options.offloadThreads = 0;
+  auto offload_options = inline_options;
+  offload_options.offloadThreads = 2;
+  offload_options.offloadMinSize = 0;
+
+  std::vector<s::CompressOptions> runs;
+  options.name = "identity";
+  runs.push_back(options);
+  options.name = "gzip";
+  options.server.compression =
+      std::make_shared<s::Www::Compression>(inline_options);
+  runs.push_back(options);
+  options.name = "gzip offloaded";
+  options.server.compression =
+      std::make_shared<s::Www::Compression>(offload_options);
+  runs.push_back(options);
+  options.name = "gzip precompressed";
+  options.cacheable = true;
+  options.server.compression =
+      std::make_shared<s::Www::Compression>(inline_options);
+  runs.push_back(options);
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::CompressDriver>(run);
+    c.run();
+  }
+  return 0;
+}
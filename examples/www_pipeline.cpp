@@ -0,0 +1,246 @@
+#include <boost/beast/http.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Www.h>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <random>
+
+/// Pipelined HTTP load against an in process Www::Server over loopback.
+/// Each client keeps --depth requests outstanding on one connection, and the
+/// handler takes a random time to respond (and optionally burns some cpu).
+/// The same load is run against sessions handling one request at a time,
+/// handling --maxInFlight at once, and handing them to a pool of
+/// --poolWorkers with each kind of routing.
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+struct LoadOptions {
+  uint32_t port = 12350;
+  size_t connections = 4;
+  size_t depth = 16;
+  std::string name;
+  Www::Server::ServerOptions server;
+  std::chrono::milliseconds maxDelay{10};
+  std::chrono::microseconds cpu{0};
+  std::chrono::milliseconds duration{5000};
+};
+
+struct LoadStats {
+  uint64_t responses = 0;
+  std::vector<double> latencyMs;
+};
+
+class DelayHandler : public Www::Server::IHandler {
+public:
+  DelayHandler(std::chrono::milliseconds max_delay,
+               std::chrono::microseconds cpu)
+      : maxDelay_(max_delay), cpu_(cpu) {}
+
+  MethodTask<Www::Response> getResponse(Process* proc,
+                                        Www::RequestView const& req) override {
+    auto dist = std::uniform_int_distribution<int>{0, (int)maxDelay_.count()};
+    if (int const delay = dist(gen_)) {
+      co_await proc->sleep(std::chrono::milliseconds(delay));
+    }
+    auto const until = std::chrono::steady_clock::now() + cpu_;
+    while (std::chrono::steady_clock::now() < until)
+      ;
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.set(http::field::content_type, "text/plain");
+    resp.message.body() = std::string(req.target);
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+
+private:
+  std::chrono::milliseconds const maxDelay_;
+  std::chrono::microseconds const cpu_;
+  std::mt19937 gen_{123456};
+};
+
+// counts complete responses in a stream of bytes
+class ResponseCounter {
+public:
+  size_t push(Buffer const& data) {
+    buffered_.append(reinterpret_cast<char const*>(data.data()), data.size());
+    size_t done = 0;
+    size_t at = 0;
+    while (at < buffered_.size()) {
+      if (!parser_) {
+        parser_.emplace();
+        parser_->eager(true);
+      }
+      boost::beast::error_code ec;
+      at += parser_->put(
+          boost::asio::buffer(buffered_.data() + at, buffered_.size() - at),
+          ec);
+      if (ec == http::error::need_more) {
+        break;
+      }
+      if (ec) {
+        ESLANGEXCEPT("Bad response ", ec.message());
+      }
+      if (parser_->is_done()) {
+        ++done;
+        parser_.reset();
+      }
+    }
+    buffered_.erase(0, at);
+    return done;
+  }
+
+private:
+  std::string buffered_;
+  std::optional<http::response_parser<http::string_body>> parser_;
+};
+
+class PipelineClient : public Process {
+public:
+  PipelineClient(ProcessArgs i, LoadOptions options,
+                 std::shared_ptr<LoadStats> stats)
+      : Process(std::move(i)), options_(std::move(options)),
+        stats_(std::move(stats)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket = co_await Tcp::connect(
+        this, Tcp::ConnectOptions("127.0.0.1", options_.port));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::deque<TimePoint> sent;
+    uint64_t n = 0;
+    auto send_request = [&] {
+      Tcp::send(this, socket,
+                Buffer::makeCopy(concatString("GET /", n++,
+                                              " HTTP/1.1\r\n"
+                                              "Host: localhost\r\n\r\n")));
+      sent.push_back(now());
+    };
+    for (size_t i = 0; i < options_.depth; ++i) {
+      send_request();
+    }
+    ResponseCounter counter;
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      for (size_t done = counter.push(r.data); done; --done) {
+        stats_->latencyMs.push_back(
+            std::chrono::duration<double, std::milli>(now() - sent.front())
+                .count());
+        sent.pop_front();
+        ++stats_->responses;
+        send_request();
+      }
+    }
+  }
+
+private:
+  LoadOptions const options_;
+  std::shared_ptr<LoadStats> stats_;
+};
+
+double percentile(std::vector<double>& v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  auto it = v.begin() + std::min(v.size() - 1, size_t(p * v.size()));
+  std::nth_element(v.begin(), it, v.end());
+  return *it;
+}
+
+class LoadDriver : public Process {
+public:
+  LoadDriver(ProcessArgs i, LoadOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  ProcessTask run() {
+    spawnLink<Www::Server>(
+        std::make_shared<DelayHandler>(options_.maxDelay, options_.cpu),
+        Tcp::ListenerOptions(options_.port), options_.server);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto stats = std::make_shared<LoadStats>();
+    for (size_t i = 0; i < options_.connections; ++i) {
+      spawnLink<PipelineClient>(options_, stats);
+    }
+    auto const start = now();
+    co_await sleep(options_.duration);
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.name, ": ", stats->responses / seconds,
+          " req/s, latency p50 ", percentile(stats->latencyMs, 0.5),
+          "ms p99 ", percentile(stats->latencyMs, 0.99), "ms p999 ",
+          percentile(stats->latencyMs, 0.999), "ms");
+    // returning kills the server and clients
+  }
+
+private:
+  LoadOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12350))(
+      "connections", po::value<size_t>()->default_value(4))(
+      "depth", po::value<size_t>()->default_value(16))(
+      "maxInFlight", po::value<size_t>()->default_value(16))(
+      "poolWorkers", po::value<size_t>()->default_value(16))(
+      "maxDelayMs", po::value<int>()->default_value(10))(
+      "cpuUs", po::value<int>()->default_value(0))(
+      "durationMs", po::value<int>()->default_value(5000));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::LoadOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.connections = vm["connections"].as<size_t>();
+  options.depth = vm["depth"].as<size_t>();
+  options.maxDelay = std::chrono::milliseconds(vm["maxDelayMs"].as<int>());
+  options.duration = std::chrono::milliseconds(vm["durationMs"].as<int>());
+  options.cpu = std::chrono::microseconds(vm["cpuUs"].as<int>());
+  size_t const max_in_flight = vm["maxInFlight"].as<size_t>();
+
+  std::vector<s::LoadOptions> runs;
+  options.name = "inline";
+  runs.push_back(options);
+  options.name = s::concatString("concurrent ", max_in_flight);
+  options.server.maxInFlight = max_in_flight;
+  runs.push_back(options);
+  using Routing = s::Www::Server::PoolRouting;
+  for (auto [routing, name] :
+       {std::pair(Routing::RoundRobin, "round robin"),
+        std::pair(Routing::LeastLoaded, "least loaded"),
+        std::pair(Routing::Hash, "hash")}) {
+    s::Www::Server::PoolOptions pool;
+    pool.workers = vm["poolWorkers"].as<size_t>();
+    pool.routing = routing;
+    options.name = s::concatString("pool ", pool.workers, " ", name);
+    options.server.handlerPool = pool;
+    runs.push_back(options);
+  }
+  for (auto const& run : runs) {
+    s::Context c;
+    c.spawn<s::LoadDriver>(run);
+    c.run();
+  }
+  return 0;
+}
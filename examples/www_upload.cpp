@@ -0,0 +1,173 @@
+#include <boost/beast/http.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Www.h>
+#include <iostream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/// Concurrent large uploads to an in process Www::Server over loopback,
+/// either streamed through IHandler::getStreamingResponse or buffered whole
+/// before getResponse. Peak RSS is per process, so run once per --mode.
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+struct UploadOptions {
+  uint32_t port = 12351;
+  size_t uploads = 8;
+  uint64_t size = 100 * 1024 * 1024;
+  bool stream = true;
+};
+
+class UploadHandler : public Www::Server::IHandler {
+public:
+  explicit UploadHandler(bool stream) : stream_(stream) {}
+
+  bool streamBody(Www::RequestView const&) override { return stream_; }
+
+  MethodTask<Www::Response>
+  getStreamingResponse(Process*, Www::RequestView const&,
+                       GenTask<Buffer>& body) override {
+    uint64_t received = 0;
+    while (co_await body.next()) {
+      received += body.take().size();
+    }
+    co_return makeResponse(received);
+  }
+
+  MethodTask<Www::Response> getResponse(Process*,
+                                        Www::RequestView const& req) override {
+    co_return makeResponse(req.body.size());
+  }
+
+private:
+  static Www::Response makeResponse(uint64_t received) {
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.body() = concatString(received);
+    resp.message.prepare_payload();
+    return resp;
+  }
+
+  bool const stream_;
+};
+
+class Uploader : public Process {
+public:
+  Uploader(ProcessArgs i, UploadOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket = co_await Tcp::connect(
+        this, Tcp::ConnectOptions("127.0.0.1", options_.port));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    co_await Tcp::sendThrottled(
+        this, socket,
+        Buffer::makeCopy(concatString("POST /upload HTTP/1.1\r\n"
+                                      "Host: localhost\r\n"
+                                      "Content-Length: ",
+                                      options_.size, "\r\n\r\n")));
+    // every write shares the same block
+    static Buffer const block =
+        Buffer::makeCopy(std::string(64 * 1024, 'x'));
+    for (uint64_t sent = 0; sent < options_.size; sent += block.size()) {
+      co_await Tcp::sendThrottled(
+          this, socket,
+          block.slice(0, std::min<uint64_t>(block.size(),
+                                            options_.size - sent)));
+    }
+    auto response = co_await Process::recv(recv);
+    ESLOG(LL::DEBUG, "Upload done: ",
+          std::string(reinterpret_cast<char const*>(response.data.data()),
+                      response.data.size()));
+  }
+
+private:
+  UploadOptions const options_;
+};
+
+long peakRssKb() {
+#ifndef _WIN32
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#else
+  return 0;
+#endif
+}
+
+class UploadDriver : public Process {
+public:
+  UploadDriver(ProcessArgs i, UploadOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<Pid> done{this};
+
+  ProcessTask run() {
+    Www::Server::ServerOptions server_options;
+    server_options.maxBodySize = options_.size;
+    spawnLink<Www::Server>(std::make_shared<UploadHandler>(options_.stream),
+                           Tcp::ListenerOptions(options_.port),
+                           server_options);
+    // let the listener start
+    co_await sleep(std::chrono::milliseconds(10));
+    auto const start = now();
+    for (size_t i = 0; i < options_.uploads; ++i) {
+      spawnNotify<Uploader>(done.address(), options_);
+    }
+    for (size_t i = 0; i < options_.uploads; ++i) {
+      co_await recv(done);
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.stream ? "stream" : "buffer", ": ",
+          options_.uploads, " x ", options_.size / (1024 * 1024), "MB in ",
+          seconds, "s, ",
+          options_.uploads * options_.size / (1024 * 1024) / seconds,
+          " MB/s, peak rss ", peakRssKb() / 1024, "MB");
+  }
+
+private:
+  UploadOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12351))(
+      "uploads", po::value<size_t>()->default_value(8))(
+      "sizeMb", po::value<uint64_t>()->default_value(100))(
+      "mode", po::value<std::string>()->default_value("stream"),
+      "stream or buffer");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::UploadOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.uploads = vm["uploads"].as<size_t>();
+  options.size = vm["sizeMb"].as<uint64_t>() * 1024 * 1024;
+  options.stream = vm["mode"].as<std::string>() != "buffer";
+  s::Context c;
+  c.spawn<s::UploadDriver>(options);
+  c.run();
+  return 0;
+}
@@ -0,0 +1,187 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Www.h>
+#include <iostream>
+
+/// WebSocket fan out from an in process Www::Server over loopback.
+/// --connections clients upgrade to a WebSocket, then each of --rounds
+/// messages is broadcast to all of them as one shared frame. Each client and
+/// server side of a connection is a socket, so 100k connections need around
+/// 200k file descriptors (and listeners are spread over --port onwards, to
+/// keep clear of the ephemeral port range per address).
+
+namespace s {
+
+struct FanoutOptions {
+  uint32_t port = 12352;
+  size_t connections = 100000;
+  size_t perListener = 20000;
+  size_t wave = 1000;
+  size_t rounds = 10;
+  size_t messageSize = 64;
+};
+
+class FanoutHandler : public Www::Server::IHandler {
+public:
+  FanoutHandler(TSendAddress<WebSocket::Message> messages,
+                std::shared_ptr<std::vector<WebSocket::Connection>> accepted)
+      : messages_(messages), accepted_(std::move(accepted)) {}
+
+  std::optional<WebSocket::Accept>
+  acceptWebSocket(Process*, Www::RequestView const&,
+                  WebSocket::Connection const& connection) override {
+    accepted_->push_back(connection);
+    return WebSocket::Accept(messages_);
+  }
+
+private:
+  TSendAddress<WebSocket::Message> messages_;
+  std::shared_ptr<std::vector<WebSocket::Connection>> accepted_;
+};
+
+// upgrades, says it is ready, then exits once it has read expected bytes
+class FanoutClient : public Process {
+public:
+  FanoutClient(ProcessArgs i, uint32_t port, TSendAddress<Pid> ready,
+               uint64_t expected)
+      : Process(std::move(i)), port_(port), ready_(ready),
+        expected_(expected) {}
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket =
+        co_await Tcp::connect(this, Tcp::ConnectOptions("127.0.0.1", port_));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    // the example key from RFC 6455
+    Tcp::send(this, socket,
+              Buffer::makeCopy(std::string("GET /fanout HTTP/1.1\r\n"
+                                           "Host: localhost\r\n"
+                                           "Upgrade: websocket\r\n"
+                                           "Connection: Upgrade\r\n"
+                                           "Sec-WebSocket-Key: "
+                                           "dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                           "Sec-WebSocket-Version: 13\r\n"
+                                           "\r\n")));
+    std::string head;
+    size_t end;
+    while ((end = head.find("\r\n\r\n")) == std::string::npos) {
+      auto r = co_await Process::recv(recv);
+      head.append(reinterpret_cast<char const*>(r.data.data()),
+                  r.data.size());
+    }
+    if (head.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == std::string::npos) {
+      ESLANGEXCEPT("Bad upgrade response ", head);
+    }
+    send(ready_, pid());
+    uint64_t received = head.size() - end - 4;
+    while (received < expected_) {
+      received += (co_await Process::recv(recv)).data.size();
+    }
+  }
+
+private:
+  uint32_t const port_;
+  TSendAddress<Pid> ready_;
+  uint64_t const expected_;
+};
+
+class FanoutDriver : public Process {
+public:
+  FanoutDriver(ProcessArgs i, FanoutOptions options)
+      : Process(std::move(i)), options_(std::move(options)) {}
+
+  Slot<WebSocket::Message> messages{this};
+  Slot<Pid> ready{this};
+  Slot<Pid> done{this};
+
+  ProcessTask run() {
+    auto accepted = std::make_shared<std::vector<WebSocket::Connection>>();
+    auto handler =
+        std::make_shared<FanoutHandler>(messages.address(), accepted);
+    size_t const listeners =
+        (options_.connections + options_.perListener - 1) /
+        options_.perListener;
+    for (size_t i = 0; i < listeners; ++i) {
+      spawnLink<Www::Server>(handler, Tcp::ListenerOptions(options_.port + i));
+    }
+    // let the listeners start
+    co_await sleep(std::chrono::milliseconds(10));
+
+    auto const payload =
+        Buffer::makeCopy(std::string(options_.messageSize, 'x'));
+    uint64_t const expected =
+        options_.rounds *
+        WebSocket::makeFrame(WebSocket::Opcode::Binary, payload).size();
+    auto const connect_start = now();
+    // in waves, so as not to overflow the listen backlog
+    for (size_t i = 0; i < options_.connections;) {
+      size_t const wave = std::min(options_.wave, options_.connections - i);
+      for (size_t j = 0; j < wave; ++j, ++i) {
+        spawnNotify<FanoutClient>(done.address(),
+                                  uint32_t(options_.port +
+                                           i / options_.perListener),
+                                  ready.address(), expected);
+      }
+      for (size_t j = 0; j < wave; ++j) {
+        co_await recv(ready);
+      }
+    }
+    ESLOG(LL::INFO, accepted->size(), " connections upgraded in ",
+          std::chrono::duration<double>(now() - connect_start).count(), "s");
+
+    auto const start = now();
+    for (size_t i = 0; i < options_.rounds; ++i) {
+      WebSocket::broadcast(this, *accepted, WebSocket::Opcode::Binary,
+                           payload);
+    }
+    for (size_t i = 0; i < options_.connections; ++i) {
+      co_await recv(done);
+    }
+    double const seconds =
+        std::chrono::duration<double>(now() - start).count();
+    ESLOG(LL::INFO, options_.rounds, " broadcasts of ", options_.messageSize,
+          " bytes to ", options_.connections, " connections in ", seconds,
+          "s, ", options_.rounds * options_.connections / seconds,
+          " frames/s delivered");
+    // returning kills the servers
+  }
+
+private:
+  FanoutOptions const options_;
+};
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::info);
+  po::options_description desc{"Options"};
+  desc.add_options()("help,h", "Help screen")(
+      "port", po::value<uint32_t>()->default_value(12352))(
+      "connections", po::value<size_t>()->default_value(100000))(
+      "rounds", po::value<size_t>()->default_value(10))(
+      "messageSize", po::value<size_t>()->default_value(64));
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+  if (vm.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  s::FanoutOptions options;
+  options.port = vm["port"].as<uint32_t>();
+  options.connections = vm["connections"].as<size_t>();
+  options.rounds = vm["rounds"].as<size_t>();
+  options.messageSize = vm["messageSize"].as<size_t>();
+  s::Context c;
+  c.spawn<s::FanoutDriver>(options);
+  c.run();
+  return 0;
+}
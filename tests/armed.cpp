@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+// counts its wakeups while waiting on a and b, but never on c
+struct ArmedWaiter : Process {
+  ArmedWaiter(ProcessArgs i, std::shared_ptr<int> wakeups,
+              std::shared_ptr<ArmedWaiter*> self)
+      : Process(std::move(i)), wakeups(std::move(wakeups)) {
+    *self = this;
+  }
+  Slot<int> a{this};
+  Slot<int> b{this};
+  Slot<int> c{this};
+  std::shared_ptr<int> wakeups;
+
+  ProcessTask run() {
+    while (true) {
+      co_await tryRecv(a, b);
+      ++*wakeups;
+    }
+  }
+};
+
+class ArmedApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    auto wakeups = std::make_shared<int>(0);
+    auto self = std::make_shared<ArmedWaiter*>(nullptr);
+    spawnLink<ArmedWaiter>(wakeups, self);
+    co_await WaitingYield{};
+    auto* waiter = *self;
+    ASSERT_TRUE(waiter->a.armed());
+    ASSERT_TRUE(waiter->b.armed());
+    ASSERT_FALSE(waiter->c.armed());
+
+    co_await send(waiter->c.address(), 1);
+    co_await WaitingYield{};
+    ASSERT_EQ(0, *wakeups);
+    ASSERT_EQ(1u, waiter->c.queue()->size());
+
+    co_await send(waiter->b.address(), 2);
+    co_await WaitingYield{};
+    ASSERT_EQ(1, *wakeups);
+    ASSERT_TRUE(waiter->a.armed());
+  }
+};
+}
+
+TEST(Armed, WakesOnlyForArmedSlots) {
+  s::Context c;
+  c.spawn<s::ArmedApp>();
+  c.run();
+  lifetimeChecker.check();
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <thread>
 
 #include "TestCommon.h"
 #include <eslang/Context.h>
@@ -76,6 +77,65 @@ public:
   }
 };
 
+// Yields after each sleep, so the io_service runs out of work (and stops)
+// before the next sleep sets a timer
+class SleepAgainApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; ++i) {
+      co_await sleep(std::chrono::milliseconds(10));
+      co_await WaitingYield{};
+    }
+    auto since = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - now);
+    ASSERT_GE(since.count(), 50);
+  }
+};
+
+// Blocks the thread past the app's first timeout, then wakes it through a
+// promise. So by the time the app runs, the timer for its first wait has
+// already fired, and its handler is queued behind the wake
+class StaleTimerWaker : public Process {
+public:
+  StaleTimerWaker(ProcessArgs i, EslangPromise* wake, TSendAddress<int> out)
+      : Process(std::move(i)), wake_(wake), out_(out) {}
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    wake_->setIfUnset();
+    co_await sleep(std::chrono::milliseconds(50));
+    co_await send(out_, 1);
+  }
+
+private:
+  EslangPromise* const wake_;
+  TSendAddress<int> const out_;
+};
+
+class StaleTimerApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  Slot<int> in{this};
+  EslangPromise wake;
+
+  ProcessTask run() {
+    spawn<StaleTimerWaker>(&wake, in.address());
+    co_await WithWaitingTimeout<WaitingFuture>(std::chrono::milliseconds(10),
+                                               &wake);
+    // the first wait's timer must not end this one
+    auto r = co_await timedRecv(std::chrono::milliseconds(2000), in);
+    ASSERT_TRUE(std::get<0>(r));
+    ASSERT_EQ(1, *std::get<0>(r));
+  }
+};
+
 class SpawnedApp : public Process {
 public:
   LIFETIMECHECK;
@@ -221,3 +281,7 @@ TEST(Basic, Echo) {
 }
 
 TEST(Basic, Sleeping) { runSimple<s::SleepingApp>("Sleeping"); }
+
+TEST(Basic, StaleTimer) { runSimple<s::StaleTimerApp>("Stale timer"); }
+
+TEST(Basic, SleepAgain) { runSimple<s::SleepAgainApp>("Sleep again"); }
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Buffer.h>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+class BinaryFanOut : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  struct Receiver : Process {
+    Slot<Binary> in{this};
+    TSendAddress<Binary> out;
+    Receiver(ProcessArgs i, TSendAddress<Binary> out)
+        : Process(std::move(i)), out(std::move(out)) {}
+
+    ProcessTask run() {
+      auto b = co_await recv(in);
+      // send back the second half
+      co_await send(out, b.slice(b.size() / 2, b.size() - b.size() / 2));
+    }
+  };
+
+  static constexpr size_t kReceivers = 100;
+  Slot<Binary> back{this};
+
+  ProcessTask run() {
+    std::vector<unsigned char> bytes(1024 * 1024);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      bytes[i] = static_cast<unsigned char>(i);
+    }
+    auto const* const original = bytes.data();
+    auto const binary = Binary::make(std::move(bytes));
+    // made from the vector without copying it
+    ASSERT_EQ(original, binary.data());
+    for (size_t i = 0; i < kReceivers; ++i) {
+      auto pid = spawnLink<Receiver>(back.address());
+      co_await send(makeSendAddress(pid, &Receiver::in), binary);
+    }
+    for (size_t i = 0; i < kReceivers; ++i) {
+      auto b = co_await recv(back);
+      ASSERT_TRUE(b.sameStorage(binary));
+      ASSERT_EQ(binary.data() + binary.size() / 2, b.data());
+      ASSERT_EQ(b, binary.slice(binary.size() / 2, binary.size() / 2));
+    }
+  }
+};
+}
+
+TEST(Binary, Slices) {
+  auto const b = s::Binary::makeCopy("hello there");
+  auto const there = b.slice(6, 5);
+  ASSERT_EQ("there", there.view());
+  ASSERT_TRUE(there.sameStorage(b));
+  ASSERT_EQ(b.data() + 6, there.data());
+  ASSERT_EQ(there, s::Binary::makeCopy("there"));
+  ASSERT_FALSE(there.sameStorage(s::Binary::makeCopy("there")));
+  ASSERT_TRUE(b.slice(3, 0).empty());
+}
+
+TEST(Binary, FanOut) {
+  s::Context c;
+  c.spawn<s::BinaryFanOut>();
+  c.run();
+  lifetimeChecker.check();
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+// doubles what it is sent, after waiting as long as it is told to
+struct Doubler : Process {
+  using Process::Process;
+  Slot<Call<int, int>> calls{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto c = co_await recv(calls);
+      if (c.request < 0) {
+        co_await sleep(std::chrono::milliseconds(-c.request));
+      }
+      co_await reply(c.replyTo, c.request * 2);
+    }
+  }
+};
+
+class CallApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    auto doubler = spawnLink<Doubler>();
+    auto const address = makeSendAddress(doubler, &Doubler::calls);
+    auto r = co_await call(address, 21, std::chrono::milliseconds(1000));
+    ASSERT_TRUE(r);
+    ASSERT_EQ(42, *r);
+
+    r = co_await call(doubler, &Doubler::calls, 4,
+                      std::chrono::milliseconds(1000));
+    ASSERT_TRUE(r);
+    ASSERT_EQ(8, *r);
+
+    // times out, and its reply comes during the next call, which drops it
+    r = co_await call(address, -50, std::chrono::milliseconds(10));
+    ASSERT_FALSE(r);
+    r = co_await call(address, 5, std::chrono::milliseconds(1000));
+    ASSERT_TRUE(r);
+    ASSERT_EQ(10, *r);
+
+    // and nothing answers for the dead
+    queueKill(doubler);
+    co_await WaitingYield{};
+    r = co_await call(address, 5, std::chrono::milliseconds(10));
+    ASSERT_FALSE(r);
+  }
+};
+}
+
+TEST(Call, Replies) {
+  s::Context c;
+  c.spawn<s::CallApp>();
+  c.run();
+  lifetimeChecker.check();
+}
@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Compression.h>
+#include <zlib.h>
+
+namespace s {
+namespace {
+
+namespace http = boost::beast::http;
+
+std::string inflateAll(std::string const& in) {
+  z_stream z{};
+  // 32 detects gzip or zlib headers
+  EXPECT_EQ(Z_OK, inflateInit2(&z, 15 + 32));
+  std::string out;
+  z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  z.avail_in = in.size();
+  int ret = Z_OK;
+  while (ret == Z_OK) {
+    char buf[16 * 1024];
+    z.next_out = reinterpret_cast<Bytef*>(buf);
+    z.avail_out = sizeof(buf);
+    ret = inflate(&z, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - z.avail_out);
+  }
+  EXPECT_EQ(Z_STREAM_END, ret);
+  inflateEnd(&z);
+  return out;
+}
+
+std::string toString(Buffer const& b) {
+  return std::string(reinterpret_cast<char const*>(b.data()), b.size());
+}
+
+std::string makeText(size_t size, int seed) {
+  std::string ret;
+  while (ret.size() < size) {
+    ret += concatString("line ", seed, " ", ret.size() % 997, "\n");
+  }
+  ret.resize(size);
+  return ret;
+}
+
+Www::Response textResponse() {
+  Www::Response resp;
+  resp.message.result(http::status::ok);
+  resp.message.set(http::field::content_type, "text/plain");
+  return resp;
+}
+
+// streams chunks through compression, and compresses one whole body
+class CompressApp : public Process {
+public:
+  CompressApp(ProcessArgs i, Www::Compression* compression,
+              std::vector<std::string> chunks, std::string* streamed,
+              std::string* whole)
+      : Process(std::move(i)), compression_(compression),
+        chunks_(std::move(chunks)), streamed_(streamed), whole_(whole) {}
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    auto resp = textResponse();
+    auto stream =
+        compression_->startStream(Www::Compression::Encoding::Gzip, resp);
+    ASSERT_TRUE(stream);
+    std::string compressed;
+    for (auto const& chunk : chunks_) {
+      auto out =
+          co_await compression_->write(this, stream, Buffer::makeCopy(chunk));
+      compressed += toString(out);
+    }
+    compressed += toString(compression_->finish(*stream));
+    *streamed_ = inflateAll(compressed);
+
+    resp = textResponse();
+    resp.message.body() = makeText(100 * 1024, 7);
+    auto body = co_await compression_->compress(
+        this, Www::Compression::Encoding::Deflate, resp);
+    ASSERT_TRUE(body);
+    *whole_ = inflateAll(toString(*body));
+  }
+
+private:
+  Www::Compression* const compression_;
+  std::vector<std::string> const chunks_;
+  std::string* const streamed_;
+  std::string* const whole_;
+};
+
+struct Dier : Process {
+  using Process::Process;
+  ProcessTask run() {
+    co_await WaitingYield{};
+    ESLANGEXCEPT("Dier dies");
+  }
+};
+
+// is killed by a linked process while its write is on the pool
+class AbandonApp : public Process {
+public:
+  AbandonApp(ProcessArgs i, Www::Compression* compression)
+      : Process(std::move(i)), compression_(compression) {}
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    auto resp = textResponse();
+    auto stream =
+        compression_->startStream(Www::Compression::Encoding::Gzip, resp);
+    spawnLink<Dier>();
+    co_await compression_->write(this, stream,
+                                 Buffer::makeCopy(makeText(8 << 20, 3)));
+    FAIL() << "Should have been killed";
+  }
+
+private:
+  Www::Compression* const compression_;
+};
+
+struct AbandonDriver : Process {
+  AbandonDriver(ProcessArgs i, Www::Compression* compression)
+      : Process(std::move(i)), compression_(compression) {}
+
+  ProcessTask run() {
+    Slot<Pid> done{this};
+    for (int i = 0; i < 4; ++i) {
+      spawnNotify<AbandonApp>(done.address(), compression_);
+    }
+    for (int i = 0; i < 4; ++i) {
+      co_await recv(done);
+    }
+  }
+
+  Www::Compression* const compression_;
+};
+
+Www::Compression::Options offloadEverything() {
+  Www::Compression::Options options;
+  options.offloadThreads = 2;
+  options.offloadMinSize = 0;
+  return options;
+}
+} // namespace
+}
+
+TEST(Compression, Offloaded) {
+  using namespace s;
+  Www::Compression compression(offloadEverything());
+  std::vector<std::string> chunks;
+  std::string expected;
+  for (int i = 0; i < 20; ++i) {
+    chunks.push_back(makeText(i * 3000 + 1, i));
+    expected += chunks.back();
+  }
+  std::string streamed;
+  std::string whole;
+  {
+    Context c;
+    c.spawn<CompressApp>(&compression, chunks, &streamed, &whole);
+    c.run();
+  }
+  lifetimeChecker.check();
+  EXPECT_EQ(expected, streamed);
+  EXPECT_EQ(makeText(100 * 1024, 7), whole);
+  EXPECT_EQ(21u, compression.stats().offloaded);
+}
+
+TEST(Compression, Inline) {
+  using namespace s;
+  auto options = offloadEverything();
+  options.offloadThreads = 0;
+  Www::Compression compression(options);
+  std::vector<std::string> chunks = {makeText(5000, 1), makeText(1, 2),
+                                     makeText(70000, 3)};
+  std::string streamed;
+  std::string whole;
+  {
+    Context c;
+    c.spawn<CompressApp>(&compression, chunks, &streamed, &whole);
+    c.run();
+  }
+  lifetimeChecker.check();
+  EXPECT_EQ(chunks[0] + chunks[1] + chunks[2], streamed);
+  EXPECT_EQ(makeText(100 * 1024, 7), whole);
+  EXPECT_EQ(0u, compression.stats().offloaded);
+}
+
+TEST(Compression, AbandonedOffload) {
+  using namespace s;
+  // outlives the context, so its pool finishes jobs nobody waits for
+  Www::Compression compression(offloadEverything());
+  {
+    Context c;
+    c.spawn<AbandonDriver>(&compression);
+    c.run();
+  }
+  lifetimeChecker.check();
+}
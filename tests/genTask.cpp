@@ -327,6 +327,50 @@ public:
       }
   }
 };
+
+class GenNextAfterEnd : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  GenTask<int> yieldOne() {
+    LIFETIMECHECK;
+    co_yield 1;
+  }
+
+  ProcessTask run() {
+    LIFETIMECHECK;
+    auto ret = yieldOne();
+    EXPECT_TRUE(co_await ret.next());
+    EXPECT_FALSE(co_await ret.next());
+    // a finished generator must not be resumed again
+    EXPECT_FALSE(co_await ret.next());
+  }
+};
+
+class GenEndsAfterWait : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  GenTask<int> yieldThenWait() {
+    LIFETIMECHECK;
+    co_yield 1;
+    co_await sleep(std::chrono::milliseconds(1));
+  }
+
+  ProcessTask run() {
+    LIFETIMECHECK;
+    int x = 0;
+    auto ret = yieldThenWait();
+    while (co_await ret.next()) {
+      ++x;
+    }
+    EXPECT_EQ(1, x);
+    // it last suspended waiting, not yielding, which must not stick
+    EXPECT_FALSE(co_await ret.next());
+  }
+};
 }
 
 template <class T> void run() {
@@ -343,4 +387,6 @@ TEST(GenBasic, GenThrows) { run<s::GenThrows>(); }
 TEST(GenBasic, GenDestroy) { run<s::GenDestroy>(); }
 TEST(GenBasic, ForEach) { run<s::ForEach>(); }
 TEST(GenBasic, GenMultiTask) { run<s::GenMultiTask>(); }
-TEST(GenBasic, StackInversion) { run<s::GenStackInversion>(); }
\ No newline at end of file
+TEST(GenBasic, StackInversion) { run<s::GenStackInversion>(); }
+TEST(GenBasic, NextAfterEnd) { run<s::GenNextAfterEnd>(); }
+TEST(GenBasic, GenEndsAfterWait) { run<s::GenEndsAfterWait>(); }
\ No newline at end of file
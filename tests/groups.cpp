@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+struct GroupMember : Process {
+  Slot<int> in{this};
+  Slot<bool> leaveGroup{this};
+  TSendAddress<int> out;
+  std::chrono::milliseconds delay;
+  GroupMember(ProcessArgs i, TSendAddress<int> out,
+              std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+      : Process(std::move(i)), out(std::move(out)), delay(delay) {}
+
+  ProcessTask run() {
+    join("members", in);
+    while (true) {
+      auto r = co_await tryRecv(in, leaveGroup);
+      if (std::get<1>(r)) {
+        leave("members");
+      }
+      if (std::get<0>(r)) {
+        if (delay.count()) {
+          co_await sleep(delay);
+        }
+        co_await send(out, *std::get<0>(r));
+      }
+    }
+  }
+};
+
+class GroupBroadcast : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  static constexpr size_t kMembers = 50;
+  Slot<int> back{this};
+
+  MethodTask<size_t> collect(int expected) {
+    size_t ret = 0;
+    while (true) {
+      auto r = co_await timedRecv(std::chrono::milliseconds(20), back);
+      if (!std::get<0>(r)) {
+        co_return ret;
+      }
+      ASSERT_EQ(expected, *std::get<0>(r));
+      ++ret;
+    }
+  }
+
+  ProcessTask run() {
+    std::vector<Pid> members;
+    for (size_t i = 0; i < kMembers; ++i) {
+      members.push_back(spawnLink<GroupMember>(back.address()));
+    }
+    while (c()->groupSize("members") < kMembers) {
+      co_await WaitingYield{};
+    }
+    co_await broadcast("members", 7);
+    auto got = co_await collect(7);
+    ASSERT_EQ(kMembers, got);
+
+    // dying and leaving both take members out
+    queueKill(members[0]);
+    co_await send(makeSendAddress(members[1], &GroupMember::leaveGroup), true);
+    while (c()->groupSize("members") > kMembers - 2) {
+      co_await WaitingYield{};
+    }
+    co_await broadcast("members", 8);
+    got = co_await collect(8);
+    ASSERT_EQ(kMembers - 2, got);
+  }
+};
+
+class GroupThrottled : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  Slot<int> back{this};
+
+  ProcessTask run() {
+    auto slow = spawnLink<GroupMember>(back.address(),
+                                       std::chrono::milliseconds(1));
+    spawnLink<GroupMember>(back.address());
+    while (c()->groupSize("members") < 2) {
+      co_await WaitingYield{};
+    }
+    auto const slow_in = makeSendAddress(slow, &GroupMember::in);
+    for (int i = 0; i < 50; ++i) {
+      co_await broadcastThrottled("members", i);
+      ASSERT_LE(c()->queued(slow_in), MessageQueue<int>::kThrottle);
+      // the replies are not what is being tested
+      while (!back.queue()->empty()) {
+        back.queue()->pop();
+      }
+    }
+  }
+};
+}
+
+TEST(Groups, Broadcast) {
+  s::Context c;
+  c.spawn<s::GroupBroadcast>();
+  c.run();
+  lifetimeChecker.check();
+}
+
+TEST(Groups, Throttled) {
+  s::Context c;
+  c.spawn<s::GroupThrottled>();
+  c.run();
+  lifetimeChecker.check();
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang_io/Ktls.h>
+
+namespace s {
+namespace {
+
+using Cipher = KtlsKeys::Cipher;
+
+std::vector<unsigned char> fromHex(std::string const& hex) {
+  std::vector<unsigned char> ret;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    ret.push_back(std::stoi(hex.substr(i, 2), nullptr, 16));
+  }
+  return ret;
+}
+
+std::string toHex(std::vector<unsigned char> const& v) {
+  static char const kDigits[] = "0123456789abcdef";
+  std::string ret;
+  for (auto c : v) {
+    ret += kDigits[c >> 4];
+    ret += kDigits[c & 0xf];
+  }
+  return ret;
+}
+
+std::string seqOf(KtlsKeys const& keys) {
+  return toHex(std::vector<unsigned char>(keys.seq, keys.seq + 8));
+}
+
+// bytes from, from + 1, ...
+std::vector<unsigned char> counting(unsigned char from, size_t len) {
+  std::vector<unsigned char> ret;
+  for (size_t i = 0; i < len; ++i) {
+    ret.push_back(from + i);
+  }
+  return ret;
+}
+} // namespace
+}
+
+TEST(Ktls, Tls13) {
+  using namespace s;
+  // the server's application traffic secret from RFC 8448 3 (Simple 1-RTT
+  // Handshake), with TLS_AES_128_GCM_SHA256
+  auto const secret = fromHex("a11af9f05531f856ad47116b45a95032"
+                              "8204b4f44bfb6b3a4b4f1f3fcb631643");
+  auto keys =
+      KtlsKeys::fromTls13Secret(Cipher::Aes128Gcm, EVP_sha256(), secret, 0);
+  ASSERT_TRUE(keys);
+  EXPECT_TRUE(keys->tls13);
+  EXPECT_EQ("9f02283b6c9c07efc26bb9f2ac92e356", toHex(keys->key));
+  // the RFC's iv, cf782b88dd83549aadf1e984, split as the kernel takes it
+  EXPECT_EQ("cf782b88", toHex(keys->salt));
+  EXPECT_EQ("dd83549aadf1e984", toHex(keys->iv));
+  EXPECT_EQ("0000000000000000", seqOf(*keys));
+
+  // carrying on after the records OpenSSL sent
+  keys = KtlsKeys::fromTls13Secret(Cipher::Aes128Gcm, EVP_sha256(), secret,
+                                   0x0102);
+  ASSERT_TRUE(keys);
+  EXPECT_EQ("9f02283b6c9c07efc26bb9f2ac92e356", toHex(keys->key));
+  EXPECT_EQ("0000000000000102", seqOf(*keys));
+}
+
+TEST(Ktls, Tls12) {
+  using namespace s;
+  // expected values worked out separately from the PRF in RFC 5246 5 and
+  // the key block layout in 6.3
+  auto const master = counting(0, 48);
+  auto const client_random = counting(0x40, 32);
+  auto const server_random = counting(0x80, 32);
+
+  auto keys =
+      KtlsKeys::fromTls12Master(Cipher::Aes128Gcm, EVP_sha256(), master,
+                                client_random, server_random, 3);
+  ASSERT_TRUE(keys);
+  EXPECT_FALSE(keys->tls13);
+  EXPECT_EQ("42c3a103d08d01b711b292bfd1f33247", toHex(keys->key));
+  EXPECT_EQ("1f21ed64", toHex(keys->salt));
+  // the explicit nonce is the sequence number, as OpenSSL's is
+  EXPECT_EQ("0000000000000003", toHex(keys->iv));
+  EXPECT_EQ("0000000000000003", seqOf(*keys));
+
+  // with SHA384 for the PRF
+  keys = KtlsKeys::fromTls12Master(Cipher::Aes256Gcm, EVP_sha384(), master,
+                                   client_random, server_random, 1);
+  ASSERT_TRUE(keys);
+  EXPECT_EQ("03c0472368c11f6751efc2d81d6b896d"
+            "8db6be95536abb42a66b015259cf7264",
+            toHex(keys->key));
+  EXPECT_EQ("2036945c", toHex(keys->salt));
+  EXPECT_EQ("0000000000000001", toHex(keys->iv));
+
+  // chacha's whole nonce is fixed, and has no salt
+  keys = KtlsKeys::fromTls12Master(Cipher::Chacha20Poly1305, EVP_sha256(),
+                                   master, client_random, server_random, 1);
+  ASSERT_TRUE(keys);
+  EXPECT_EQ("3e5667ef1f21ed64b616b533929f8e73"
+            "7406938bbae4d1387dbb67a32bbfd03f",
+            toHex(keys->key));
+  EXPECT_EQ("", toHex(keys->salt));
+  EXPECT_EQ("218aeb811ebeced2da38d56b", toHex(keys->iv));
+  EXPECT_EQ("0000000000000001", seqOf(*keys));
+}
@@ -49,6 +49,28 @@ public:
   }
 };
 
+// has no default constructor, so can only be returned once made
+struct NoDefault {
+  explicit NoDefault(int i) : i(i) {}
+  int i;
+};
+
+class MethodNoDefault : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+  MethodTask<NoDefault> makeCoro(int i) {
+    LIFETIMECHECK;
+    co_await WaitingYield{};
+    co_return NoDefault(i);
+  }
+
+  ProcessTask run() {
+    auto got = co_await makeCoro(7);
+    ASSERT_EQ(7, got.i);
+  }
+};
+
 class MethodThrows : public Process {
 public:
   using Process::Process;
@@ -124,5 +146,6 @@ template <class T> void run() {
 
 TEST(MethodTask, Counter) { run<s::MethodCounter>(); }
 TEST(MethodTask, Basic) { run<s::MethodBasic>(); }
+TEST(MethodTask, NoDefault) { run<s::MethodNoDefault>(); }
 TEST(MethodTask, Throws) { run<s::MethodThrows>(); }
 TEST(MethodTask, StackInversion) { run<s::MethodStackInversion>(); }
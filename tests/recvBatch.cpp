@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+// sends from..to to out, one at a time
+struct Counter : Process {
+  Counter(ProcessArgs i, TSendAddress<int> out, int from, int to)
+      : Process(std::move(i)), out(out), from(from), to(to) {}
+  TSendAddress<int> out;
+  int from;
+  int to;
+
+  ProcessTask run() {
+    for (int i = from; i < to; ++i) {
+      co_await send(out, i);
+    }
+  }
+};
+
+class RecvBatchApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  Slot<int> in{this};
+
+  ProcessTask run() {
+    spawn<Counter>(in.address(), 0, 25);
+    while (in.queue()->size() < 25) {
+      co_await WaitingYield{};
+    }
+    auto batch = co_await recvBatch(in, 10);
+    ASSERT_EQ(10u, batch.size());
+    ASSERT_EQ(0, batch.front());
+    ASSERT_EQ(9, batch.back());
+    batch = co_await recvBatch(in, 10);
+    ASSERT_EQ(10u, batch.size());
+    batch = co_await recvBatch(in, 10);
+    ASSERT_EQ((std::vector<int>{20, 21, 22, 23, 24}), batch);
+
+    // waits for there to be something
+    spawn<Counter>(in.address(), 25, 26);
+    batch = co_await recvBatch(in, 10);
+    ASSERT_EQ(std::vector<int>{25}, batch);
+
+    spawn<Counter>(in.address(), 26, 30);
+    while (in.queue()->size() < 4) {
+      co_await WaitingYield{};
+    }
+    int expected = 26;
+    for
+      co_await(int i : drain(in)) {
+        ASSERT_EQ(expected, i);
+        ++expected;
+      }
+    ASSERT_EQ(30, expected);
+    ASSERT_TRUE(in.queue()->empty());
+
+    // and draining nothing ends straight away
+    for
+      co_await(int i : drain(in)) { ASSERT_TRUE(false) << i; }
+  }
+};
+}
+
+TEST(RecvBatch, Batches) {
+  s::Context c;
+  c.spawn<s::RecvBatchApp>();
+  c.run();
+  lifetimeChecker.check();
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+// sends back what it is sent, after waiting as long as it is told to
+struct DelayedEcho : Process {
+  using Process::Process;
+  Slot<std::pair<int, TSendAddress<int>>> in{this};
+
+  ProcessTask run() {
+    while (true) {
+      auto r = co_await recv(in);
+      if (r.first < 0) {
+        co_await sleep(std::chrono::milliseconds(-r.first));
+      }
+      co_await send(r.second, r.first);
+    }
+  }
+};
+
+class RecvMatchApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  Slot<int> in{this};
+
+  ProcessTask run() {
+    for (int i = 1; i <= 5; ++i) {
+      co_await send(in.address(), i);
+    }
+    while (in.queue()->size() < 5) {
+      co_await WaitingYield{};
+    }
+    // takes from the middle and leaves the rest in order
+    int got = co_await recvMatch(in, [](int i) { return i == 3; });
+    ASSERT_EQ(3, got);
+    got = co_await recvMatch(in, [](int i) { return i % 2 == 0; });
+    ASSERT_EQ(2, got);
+    ASSERT_EQ(3u, in.queue()->size());
+
+    // waits past non matching messages that come in
+    auto echo = spawnLink<DelayedEcho>();
+    auto const address = makeSendAddress(echo, &DelayedEcho::in);
+    co_await send(address, std::make_pair(-20, in.address()));
+    co_await send(address, std::make_pair(100, in.address()));
+    co_await send(address, std::make_pair(-5, in.address()));
+    got = co_await recvMatch(in, [](int i) { return i == -5; });
+    ASSERT_EQ(-5, got);
+
+    auto timed = co_await timedRecvMatch(std::chrono::milliseconds(10), in,
+                                         [](int i) { return i == 6; });
+    ASSERT_FALSE(timed);
+    timed = co_await timedRecvMatch(std::chrono::milliseconds(1000), in,
+                                    [](int i) { return i == 100; });
+    ASSERT_TRUE(timed);
+    ASSERT_EQ(100, *timed);
+
+    std::vector<int> rest;
+    while (!in.queue()->empty()) {
+      rest.push_back(in.queue()->pop().val());
+    }
+    ASSERT_EQ((std::vector<int>{1, 4, 5, -20}), rest);
+
+    // a match starts from the mark, which follows its message as those in
+    // front of it go
+    for (int i = 1; i <= 3; ++i) {
+      co_await send(in.address(), i);
+    }
+    while (in.queue()->size() < 3) {
+      co_await WaitingYield{};
+    }
+    in.mark();
+    co_await send(address, std::make_pair(2, in.address()));
+    co_await send(address, std::make_pair(7, in.address()));
+    ASSERT_EQ(1, in.queue()->pop().val());
+    ASSERT_EQ(2u, in.queue()->marked());
+    got = co_await recvMatch(in, [](int i) { return i == 2; });
+    ASSERT_EQ(2, got);
+    // that was the echoed 2, not the one queued before the mark. Matching
+    // cleared the mark, so the next match looks from the front again
+    ASSERT_EQ(0u, in.queue()->marked());
+    got = co_await recvMatch(in, [](int i) { return i == 7; });
+    ASSERT_EQ(7, got);
+    got = co_await recvMatch(in, [](int i) { return i > 1; });
+    ASSERT_EQ(2, got);
+    ASSERT_EQ(1u, in.queue()->size());
+    ASSERT_EQ(3, in.queue()->pop().val());
+  }
+};
+}
+
+TEST(RecvMatch, Selects) {
+  s::Context c;
+  c.spawn<s::RecvMatchApp>();
+  c.run();
+  lifetimeChecker.check();
+}
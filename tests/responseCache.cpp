@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang_www/ResponseCache.h>
+
+namespace s {
+namespace {
+
+namespace http = boost::beast::http;
+
+// a GET for target, with fields
+Www::RequestView makeRequest(
+    std::string const& target,
+    std::vector<std::pair<http::field, std::string>> const& fields = {}) {
+  Www::RequestView req;
+  req.method = http::verb::get;
+  req.methodString = "GET";
+  req.owned.push_front(target);
+  req.target = req.owned.front();
+  for (auto const& [name, value] : fields) {
+    req.owned.push_front(value);
+    req.fields.push_back({name, http::to_string(name), req.owned.front()});
+  }
+  return req;
+}
+
+Www::SerializedResponse makeResponse(std::string const& body) {
+  return Www::SerializedResponse{
+      Buffer::makeCopy(std::string("HTTP/1.1 200 OK\r\n")),
+      Buffer::makeCopy(body)};
+}
+
+// the body of what lookup finds, or "miss"
+std::string lookupBody(Www::ResponseCache& cache,
+                       Www::RequestView const& req, TimePoint now,
+                       Www::ResponseCache::string_view variant = {}) {
+  auto found = cache.lookup(req, now, variant);
+  if (!found) {
+    return "miss";
+  }
+  return std::string(reinterpret_cast<char const*>(found->body->data()),
+                     found->body->size());
+}
+
+TimePoint const kNow = std::chrono::steady_clock::now();
+auto const kSecond = std::chrono::seconds(1);
+} // namespace
+}
+
+TEST(ResponseCache, Expires) {
+  using namespace s;
+  Www::ResponseCache cache;
+  auto const req = makeRequest("/a");
+  cache.store(req, makeResponse("a"), kNow + kSecond);
+  EXPECT_EQ("a", lookupBody(cache, req, kNow));
+  EXPECT_EQ("a", lookupBody(cache, req, kNow + kSecond / 2));
+  // expiring on the dot, and going once it has
+  EXPECT_EQ("miss", lookupBody(cache, req, kNow + kSecond));
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ("miss", lookupBody(cache, req, kNow));
+
+  auto const& stats = cache.stats();
+  EXPECT_EQ(2u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(1u, stats.expired);
+
+  // storing again replaces, with the new expiry
+  cache.store(req, makeResponse("old"), kNow + kSecond);
+  cache.store(req, makeResponse("new"), kNow + 3 * kSecond);
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ("new", lookupBody(cache, req, kNow + 2 * kSecond));
+}
+
+TEST(ResponseCache, EvictsLeastRecentlyUsed) {
+  using namespace s;
+  Www::ResponseCache::Options options;
+  options.maxEntries = 3;
+  Www::ResponseCache cache(options);
+  auto const forever = kNow + 1000 * kSecond;
+  for (auto t : {"/a", "/b", "/c"}) {
+    cache.store(makeRequest(t), makeResponse(t), forever);
+  }
+  // a is used, so b is the oldest
+  EXPECT_EQ("/a", lookupBody(cache, makeRequest("/a"), kNow));
+  cache.store(makeRequest("/d"), makeResponse("/d"), forever);
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(1u, cache.stats().evicted);
+  EXPECT_EQ("miss", lookupBody(cache, makeRequest("/b"), kNow));
+  EXPECT_EQ("/a", lookupBody(cache, makeRequest("/a"), kNow));
+  EXPECT_EQ("/c", lookupBody(cache, makeRequest("/c"), kNow));
+  EXPECT_EQ("/d", lookupBody(cache, makeRequest("/d"), kNow));
+
+  // replacing an entry does not evict another
+  cache.store(makeRequest("/c"), makeResponse("/c2"), forever);
+  EXPECT_EQ(1u, cache.stats().evicted);
+  EXPECT_EQ("/c2", lookupBody(cache, makeRequest("/c"), kNow));
+
+  options.maxEntries = 0;
+  Www::ResponseCache none(options);
+  none.store(makeRequest("/a"), makeResponse("/a"), forever);
+  EXPECT_EQ(0u, none.size());
+  EXPECT_EQ("miss", lookupBody(none, makeRequest("/a"), kNow));
+}
+
+TEST(ResponseCache, Invalidates) {
+  using namespace s;
+  Www::ResponseCache cache;
+  auto const forever = kNow + 1000 * kSecond;
+  for (auto t : {"/users/1", "/users/1?full=1", "/users/2", "/usersx",
+                 "/static/a.css"}) {
+    cache.store(makeRequest(t), makeResponse(t), forever);
+  }
+  auto head = makeRequest("/users/2");
+  head.method = http::verb::head;
+  head.methodString = "HEAD";
+  cache.store(head, makeResponse("head"), forever);
+
+  // just that method and exact target
+  cache.invalidate(http::verb::get, "/users/2");
+  EXPECT_EQ("miss", lookupBody(cache, makeRequest("/users/2"), kNow));
+  EXPECT_EQ("head", lookupBody(cache, head, kNow));
+  EXPECT_EQ("/users/1", lookupBody(cache, makeRequest("/users/1"), kNow));
+  EXPECT_EQ(1u, cache.stats().invalidated);
+
+  // any method, any target starting with it
+  cache.invalidatePrefix("/users/");
+  EXPECT_EQ("miss", lookupBody(cache, makeRequest("/users/1"), kNow));
+  EXPECT_EQ("miss", lookupBody(cache, makeRequest("/users/1?full=1"), kNow));
+  EXPECT_EQ("miss", lookupBody(cache, head, kNow));
+  EXPECT_EQ("/usersx", lookupBody(cache, makeRequest("/usersx"), kNow));
+  EXPECT_EQ(4u, cache.stats().invalidated);
+  EXPECT_EQ(2u, cache.size());
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(6u, cache.stats().invalidated);
+}
+
+TEST(ResponseCache, Variants) {
+  using namespace s;
+  Www::ResponseCache::Options options;
+  options.keyFields = {http::field::accept_encoding, http::field::accept};
+  Www::ResponseCache cache(options);
+  auto const forever = kNow + 1000 * kSecond;
+  auto const plain = makeRequest("/a");
+  auto const gzip =
+      makeRequest("/a", {{http::field::accept_encoding, "gzip"}});
+  // same values in another order of fields
+  auto const gzip_json =
+      makeRequest("/a", {{http::field::accept, "application/json"},
+                         {http::field::accept_encoding, "gzip"}});
+  auto const json_gzip =
+      makeRequest("/a", {{http::field::accept_encoding, "gzip"},
+                         {http::field::accept, "application/json"}});
+  // fields that are not in the key do not matter
+  auto const gzip_agent =
+      makeRequest("/a", {{http::field::user_agent, "test"},
+                         {http::field::accept_encoding, "gzip"}});
+
+  cache.store(plain, makeResponse("plain"), forever);
+  cache.store(gzip, makeResponse("gzip"), forever);
+  cache.store(gzip_json, makeResponse("gzip json"), forever);
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ("plain", lookupBody(cache, plain, kNow));
+  EXPECT_EQ("gzip", lookupBody(cache, gzip, kNow));
+  EXPECT_EQ("gzip", lookupBody(cache, gzip_agent, kNow));
+  EXPECT_EQ("gzip json", lookupBody(cache, json_gzip, kNow));
+
+  // the variant the server picked keys apart responses to one request
+  cache.store(gzip, makeResponse("gzipped"), forever, "gzip");
+  EXPECT_EQ("gzipped", lookupBody(cache, gzip, kNow, "gzip"));
+  EXPECT_EQ("gzip", lookupBody(cache, gzip, kNow));
+  EXPECT_EQ("miss", lookupBody(cache, gzip, kNow, "br"));
+
+  // and invalidating a target drops every variant of it
+  cache.invalidate(http::verb::get, "/a");
+  EXPECT_EQ(0u, cache.size());
+}
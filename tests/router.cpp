@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Router.h>
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+// answers with its name and the parameters it was given
+class NamedRoute : public Www::Router::IRoute {
+public:
+  explicit NamedRoute(std::string name) : name(std::move(name)) {}
+  MethodTask<Www::Response> getResponse(
+      Process*, Www::RequestView const&,
+      Www::Router::Params const& params) override {
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.body() = describe(params);
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+
+  std::string describe(Www::Router::Params const& params) const {
+    std::string ret = name;
+    for (auto const& [k, v] : params.values) {
+      ret += concatString(" ", std::string(k), "=", std::string(v));
+    }
+    return ret;
+  }
+
+  std::string const name;
+};
+
+struct RouterTest {
+  Www::Router router;
+
+  void add(http::verb method, std::string pattern) {
+    router.add(method, pattern, std::make_shared<NamedRoute>(concatString(
+                                    http::to_string(method), " ", pattern)));
+  }
+
+  // what method and target matched, or "none"
+  std::string match(http::verb method, std::string const& target) const {
+    Www::Router::Params params;
+    auto* route = router.match(method, target, params);
+    if (!route) {
+      return "none";
+    }
+    return static_cast<NamedRoute*>(route)->describe(params);
+  }
+};
+
+// runs each request through Router::getResponse
+class RouterApp : public Process {
+public:
+  using Requests = std::vector<std::pair<http::verb, std::string>>;
+  RouterApp(ProcessArgs i, Www::Router* router, Requests requests,
+            std::vector<Www::Response>* responses)
+      : Process(std::move(i)), router_(router),
+        requests_(std::move(requests)), responses_(responses) {}
+  LIFETIMECHECK;
+
+  ProcessTask run() {
+    for (auto const& [method, target] : requests_) {
+      Www::RequestView req;
+      req.method = method;
+      req.target = target;
+      responses_->push_back(co_await router_->getResponse(this, req));
+    }
+  }
+
+private:
+  Www::Router* const router_;
+  Requests const requests_;
+  std::vector<Www::Response>* const responses_;
+};
+
+std::vector<Www::Response> runRequests(Www::Router& router,
+                                       RouterApp::Requests requests) {
+  std::vector<Www::Response> responses;
+  {
+    Context c;
+    c.spawn<RouterApp>(&router, std::move(requests), &responses);
+    c.run();
+  }
+  lifetimeChecker.check();
+  return responses;
+}
+}
+
+TEST(Router, Matches) {
+  using namespace s;
+  RouterTest t;
+  t.add(http::verb::get, "/");
+  t.add(http::verb::get, "/users/me");
+  t.add(http::verb::get, "/users/:id");
+  t.add(http::verb::get, "/users/:id/files/*path");
+  t.add(http::verb::get, "/static/*rest");
+  EXPECT_EQ(5u, t.router.size());
+
+  EXPECT_EQ("GET /", t.match(http::verb::get, "/"));
+  EXPECT_EQ("GET /users/me", t.match(http::verb::get, "/users/me"));
+  EXPECT_EQ("GET /users/:id id=42", t.match(http::verb::get, "/users/42"));
+  EXPECT_EQ("GET /users/:id id=42",
+            t.match(http::verb::get, "/users/42?me=1"));
+  EXPECT_EQ("GET /users/:id/files/*path id=42 path=a/b",
+            t.match(http::verb::get, "/users/42/files/a/b"));
+  EXPECT_EQ("GET /users/:id/files/*path id=42 path=",
+            t.match(http::verb::get, "/users/42/files"));
+  // the literal "me" has no files below it, so this backtracks to :id
+  EXPECT_EQ("GET /users/:id/files/*path id=me path=x",
+            t.match(http::verb::get, "/users/me/files/x"));
+  EXPECT_EQ("GET /static/*rest rest=css/site.css",
+            t.match(http::verb::get, "/static/css/site.css"));
+  EXPECT_EQ("none", t.match(http::verb::get, "/users"));
+  EXPECT_EQ("none", t.match(http::verb::get, "/users/42/other"));
+  EXPECT_EQ("none", t.match(http::verb::post, "/users/42"));
+}
+
+TEST(Router, MethodFallsBack) {
+  using namespace s;
+  RouterTest t;
+  t.add(http::verb::get, "/favicon.ico");
+  t.add(http::verb::post, "/*path");
+  t.add(http::verb::get, "/items/:id");
+  t.add(http::verb::put, "/items/:id");
+
+  EXPECT_EQ("GET /favicon.ico", t.match(http::verb::get, "/favicon.ico"));
+  EXPECT_EQ("POST /*path path=favicon.ico",
+            t.match(http::verb::post, "/favicon.ico"));
+  EXPECT_EQ("POST /*path path=", t.match(http::verb::post, "/"));
+  EXPECT_EQ("POST /*path path=items/3",
+            t.match(http::verb::post, "/items/3"));
+  EXPECT_EQ("none", t.match(http::verb::delete_, "/favicon.ico"));
+}
+
+TEST(Router, BadPatterns) {
+  using namespace s;
+  RouterTest t;
+  t.add(http::verb::get, "/a/:id");
+  EXPECT_THROW(t.add(http::verb::get, "/a/:id"), EslangException);
+  EXPECT_THROW(t.add(http::verb::get, "/a/:other"), EslangException);
+  EXPECT_THROW(t.add(http::verb::get, "/b/*rest/c"), EslangException);
+  EXPECT_NO_THROW(t.add(http::verb::post, "/a/:id"));
+  EXPECT_EQ(2u, t.router.size());
+}
+
+TEST(Router, Responses) {
+  using namespace s;
+  RouterTest t;
+  t.add(http::verb::get, "/favicon.ico");
+  t.add(http::verb::post, "/*path");
+  t.add(http::verb::get, "/only/get");
+  t.add(http::verb::put, "/only/:x");
+  auto responses =
+      runRequests(t.router, {{http::verb::post, "/favicon.ico"},
+                             {http::verb::delete_, "/favicon.ico"},
+                             {http::verb::delete_, "/only/get"}});
+  ASSERT_EQ(3u, responses.size());
+  EXPECT_EQ(http::status::ok, responses[0].message.result());
+  EXPECT_EQ("POST /*path path=favicon.ico", responses[0].message.body());
+
+  EXPECT_EQ(http::status::method_not_allowed, responses[1].message.result());
+  EXPECT_EQ("GET, POST", responses[1].message[http::field::allow]);
+
+  // every route matching the path counts, however specific
+  EXPECT_EQ(http::status::method_not_allowed, responses[2].message.result());
+  EXPECT_EQ("GET, PUT, POST", responses[2].message[http::field::allow]);
+
+  RouterTest u;
+  u.add(http::verb::get, "/only/get");
+  responses = runRequests(u.router, {{http::verb::get, "/only/got"},
+                                     {http::verb::get, "/only/get"}});
+  ASSERT_EQ(2u, responses.size());
+  EXPECT_EQ(http::status::not_found, responses[0].message.result());
+  EXPECT_EQ(http::status::ok, responses[1].message.result());
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+
+namespace s {
+namespace {
+
+size_t constexpr kMessageSize = 64;
+// far more than the owner's slot and the socket's queue hold between them
+size_t constexpr kWindow = 2000;
+size_t constexpr kMessages = 4 * kWindow;
+uint32_t constexpr kPort = 12394;
+
+Tcp::SocketOptions oneBufferAWrite() {
+  Tcp::SocketOptions options;
+  // full after any one buffer
+  options.maxQueuedBytes = 1;
+  return options;
+}
+
+// sends back each message it reads, on its own
+class EchoRunner : public Process {
+public:
+  EchoRunner(ProcessArgs i, Tcp::Socket socket)
+      : Process(std::move(i)), socket_(socket) {
+    link(socket.pid);
+  }
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::initRecvSocket(this, socket_, recv.address());
+    std::string partial;
+    while (true) {
+      auto r = co_await Process::recv(recv);
+      partial.append(reinterpret_cast<char const*>(r.data.data()),
+                     r.data.size());
+      size_t at = 0;
+      for (; at + kMessageSize <= partial.size(); at += kMessageSize) {
+        co_await Tcp::sendThrottled(
+            this, socket_, Buffer::makeCopy(partial.data() + at, kMessageSize));
+      }
+      partial.erase(0, at);
+    }
+  }
+
+private:
+  Tcp::Socket const socket_;
+};
+
+class EchoServer : public Process {
+public:
+  using Process::Process;
+
+  Slot<Tcp::Socket> sockets{this};
+
+  ProcessTask run() {
+    Tcp::ListenerOptions listener(kPort);
+    static_cast<Tcp::SocketOptions&>(listener) = oneBufferAWrite();
+    Tcp::makeListener(this, sockets.address(), listener);
+    while (true) {
+      // dies with its socket
+      spawn<EchoRunner>(co_await recv(sockets));
+    }
+  }
+};
+
+// Writes a whole window before reading any of it back. Its socket fills
+// its slot with echoes meanwhile, and has to keep taking writes while it
+// waits for room there.
+class EchoClient : public Process {
+public:
+  EchoClient(ProcessArgs i, size_t* echoed)
+      : Process(std::move(i)), echoed_(echoed) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    Tcp::ConnectOptions connect("127.0.0.1", kPort);
+    static_cast<Tcp::SocketOptions&>(connect) = oneBufferAWrite();
+    auto socket = co_await Tcp::connect(this, connect);
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::string const message(kMessageSize, 'x');
+    size_t sent = 0;
+    for (; sent < kWindow; ++sent) {
+      co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(message));
+    }
+    size_t partial = 0;
+    while (*echoed_ < kMessages) {
+      auto r = co_await Process::recv(recv);
+      partial += r.data.size();
+      for (; partial >= kMessageSize; partial -= kMessageSize) {
+        ++*echoed_;
+        if (sent < kMessages) {
+          ++sent;
+          co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(message));
+        }
+      }
+    }
+  }
+
+private:
+  size_t* const echoed_;
+};
+
+class EchoDriver : public Process {
+public:
+  EchoDriver(ProcessArgs i, size_t* echoed, bool* finished)
+      : Process(std::move(i)), echoed_(echoed), finished_(finished) {}
+
+  ProcessTask run() {
+    spawnLink<EchoServer>();
+    co_await sleep(std::chrono::milliseconds(10));
+    Slot<Pid> done{this};
+    spawnLinkNotify<EchoClient>(done.address(), echoed_);
+    auto r = co_await timedRecv(std::chrono::milliseconds(20000), done);
+    *finished_ = bool(std::get<0>(r));
+    // returning kills the server (and the client, if it is stuck)
+  }
+
+private:
+  size_t* const echoed_;
+  bool* const finished_;
+};
+} // namespace
+}
+
+TEST(TcpEcho, WindowLargerThanQueues) {
+  size_t echoed = 0;
+  bool finished = false;
+  {
+    s::Context c;
+    c.spawn<s::EchoDriver>(&echoed, &finished);
+    c.run();
+  }
+  lifetimeChecker.check();
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(s::kMessages, echoed);
+}
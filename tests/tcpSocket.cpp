@@ -0,0 +1,385 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Tcp.h>
+#include <unistd.h>
+
+namespace s {
+namespace {
+
+size_t constexpr kBurst = 512 * 1024;
+size_t constexpr kMaxBatch = 256 * 1024;
+// what a socket reads into when it is not gathering
+size_t constexpr kReadSize = 16000;
+
+// both ends of one connection, as the process that made them owns them
+struct Pair {
+  Tcp::Socket client;
+  Tcp::Socket server;
+};
+
+// a socket only writes once it has somewhere to send what it reads, so the
+// client's goes to back
+MethodTask<Pair> connectTcp(Process* p, Slot<Tcp::Socket>& accepted,
+                            Slot<Tcp::ReceiveData>& back, uint32_t port,
+                            Tcp::SocketOptions server,
+                            Tcp::ConnectOptions client) {
+  Tcp::ListenerOptions listener(port);
+  static_cast<Tcp::SocketOptions&>(listener) = server;
+  Tcp::makeListener(p, accepted.address(), listener);
+  co_await p->sleep(std::chrono::milliseconds(10));
+  auto client_socket = co_await Tcp::connect(p, client);
+  auto server_socket = co_await p->recv(accepted);
+  Tcp::initRecvSocket(p, client_socket, back.address());
+  co_return Pair{client_socket, server_socket};
+}
+
+std::string unixPath() {
+  return concatString("/tmp/eslang_test_", getpid(), ".sock");
+}
+
+MethodTask<Pair> connectUnix(Process* p, Slot<Tcp::Socket>& accepted,
+                             Slot<Tcp::ReceiveData>& back,
+                             Tcp::SocketOptions server,
+                             Tcp::UnixConnectOptions client) {
+  Tcp::UnixListenerOptions listener(unixPath());
+  static_cast<Tcp::SocketOptions&>(listener) = server;
+  Tcp::makeUnixListener(p, accepted.address(), listener);
+  co_await p->sleep(std::chrono::milliseconds(10));
+  auto client_socket = co_await Tcp::connectUnix(p, client);
+  auto server_socket = co_await p->recv(accepted);
+  Tcp::initRecvSocket(p, client_socket, back.address());
+  co_return Pair{client_socket, server_socket};
+}
+
+// what arrived at one end, one entry for each ReceiveData
+struct Received {
+  std::string data;
+  std::vector<size_t> sizes;
+  // the fds, and where in data the ReceiveData they came with started
+  std::vector<std::pair<size_t, Tcp::Fd>> fds;
+};
+
+// reads until all of want has arrived, or nothing more does
+MethodTask<> readUntil(Process* p, Slot<Tcp::ReceiveData>& slot,
+                       Received* received, size_t want) {
+  while (received->data.size() < want) {
+    auto r = co_await p->timedRecv(std::chrono::milliseconds(2000), slot);
+    if (!std::get<0>(r)) {
+      co_return;
+    }
+    auto& rd = *std::get<0>(r);
+    for (auto& fd : rd.fds) {
+      received->fds.emplace_back(received->data.size(), std::move(fd));
+    }
+    received->sizes.push_back(rd.data.size());
+    received->data.append(reinterpret_cast<char const*>(rd.data.data()),
+                          rd.data.size());
+  }
+}
+
+std::string letters(size_t len, size_t seed = 0) {
+  std::string ret;
+  for (size_t i = 0; i < len; ++i) {
+    ret.push_back(char('a' + (seed + i) % 26));
+  }
+  return ret;
+}
+
+// the sizes of what the server end gathered, from bursts sent while its
+// owner was busy, either side of some small reads it kept up with
+struct BatchSizes {
+  std::vector<size_t> first;
+  std::vector<size_t> small;
+  std::vector<size_t> second;
+};
+
+class BatchApp : public Process {
+public:
+  BatchApp(ProcessArgs i, BatchSizes* sizes)
+      : Process(std::move(i)), sizes_(sizes) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::Socket> accepted{this};
+  Slot<Tcp::ReceiveData> back{this};
+  Slot<Tcp::ReceiveData> in{this};
+
+  ProcessTask run() {
+    Tcp::SocketOptions server;
+    server.throttled = false;
+    server.receiveBatchBytes = kMaxBatch;
+    auto pair = co_await connectTcp(this, accepted, back, 12400, server,
+                                    Tcp::ConnectOptions("127.0.0.1", 12400));
+    Tcp::initRecvSocket(this, pair.server, in.address());
+    sizes_->first = co_await burst(pair.client);
+    for (size_t i = 0; i < 8; ++i) {
+      Received got;
+      Tcp::send(this, pair.client, Buffer::makeCopy(letters(100)));
+      co_await readUntil(this, in, &got, 100);
+      EXPECT_EQ(letters(100), got.data);
+      sizes_->small.insert(sizes_->small.end(), got.sizes.begin(),
+                           got.sizes.end());
+    }
+    sizes_->second = co_await burst(pair.client);
+  }
+
+private:
+  MethodTask<std::vector<size_t>> burst(Tcp::Socket const& client) {
+    auto const sent = letters(kBurst);
+    co_await Tcp::sendThrottled(this, client, Buffer::makeCopy(sent));
+    // not taking any while it arrives
+    co_await sleep(std::chrono::milliseconds(50));
+    Received got;
+    co_await readUntil(this, in, &got, kBurst);
+    EXPECT_EQ(kBurst, got.data.size());
+    EXPECT_TRUE(sent == got.data);
+    co_return got.sizes;
+  }
+
+  BatchSizes* const sizes_;
+};
+
+// sends count buffers of size to the client end all at once, and counts the
+// writes they took
+class GatherApp : public Process {
+public:
+  GatherApp(ProcessArgs i, uint32_t port, size_t max_queued, size_t count,
+            size_t size, uint64_t* writes)
+      : Process(std::move(i)), port_(port), maxQueued_(max_queued),
+        count_(count), size_(size), writes_(writes) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::Socket> accepted{this};
+  Slot<Tcp::ReceiveData> back{this};
+  Slot<Tcp::ReceiveData> in{this};
+
+  ProcessTask run() {
+    Tcp::ConnectOptions client("127.0.0.1", port_);
+    client.maxQueuedBytes = maxQueued_;
+    auto pair =
+        co_await connectTcp(this, accepted, back, port_, Tcp::SocketOptions(), client);
+    Tcp::initRecvSocket(this, pair.server, in.address());
+    auto const& stats = *pair.client.stats;
+    auto const writes = stats.writes;
+    auto const buffers = stats.buffersWritten;
+    std::string sent;
+    for (size_t i = 0; i < count_; ++i) {
+      sent += letters(size_, i);
+      Tcp::send(this, pair.client, Buffer::makeCopy(letters(size_, i)));
+    }
+    Received got;
+    co_await readUntil(this, in, &got, sent.size());
+    EXPECT_EQ(sent, got.data);
+    EXPECT_EQ(count_, stats.buffersWritten - buffers);
+    EXPECT_EQ(0u, stats.queuedBytes);
+    *writes_ = stats.writes - writes;
+  }
+
+private:
+  uint32_t const port_;
+  size_t const maxQueued_;
+  size_t const count_;
+  size_t const size_;
+  uint64_t* const writes_;
+};
+
+uint64_t countWrites(uint32_t port, size_t max_queued, size_t count,
+                     size_t size) {
+  uint64_t writes = 0;
+  {
+    Context c;
+    c.spawn<GatherApp>(port, max_queued, count, size, &writes);
+    c.run();
+  }
+  lifetimeChecker.check();
+  return writes;
+}
+
+// a pipe's read end, with id written into it for whoever reads it
+Tcp::Fd makeTaggedFd(char id, std::vector<Tcp::Fd>* write_ends) {
+  int fds[2];
+  EXPECT_EQ(0, pipe(fds));
+  EXPECT_EQ(1, write(fds[1], &id, 1));
+  write_ends->emplace_back(fds[1]);
+  return Tcp::Fd(fds[0]);
+}
+
+char readTag(Tcp::Fd const& fd) {
+  char id = 0;
+  EXPECT_EQ(1, read(fd.get(), &id, 1));
+  return id;
+}
+
+// passes fds over a unix socket with some of what it sends, and notes which
+// came with which ReceiveData, as "offset:tag"
+class FdApp : public Process {
+public:
+  FdApp(ProcessArgs i, Tcp::SocketOptions server,
+        std::vector<std::string>* got)
+      : Process(std::move(i)), server_(server), got_(got) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::Socket> accepted{this};
+  Slot<Tcp::ReceiveData> back{this};
+  Slot<Tcp::ReceiveData> in{this};
+
+  ProcessTask run() {
+    auto pair = co_await connectUnix(this, accepted, back, server_,
+                                     Tcp::UnixConnectOptions(unixPath()));
+    Tcp::initRecvSocket(this, pair.server, in.address());
+    std::vector<Tcp::Fd> write_ends;
+    std::vector<Tcp::Fd> first;
+    first.push_back(makeTaggedFd('1', &write_ends));
+    std::vector<Tcp::Fd> third;
+    third.push_back(makeTaggedFd('2', &write_ends));
+    third.push_back(makeTaggedFd('3', &write_ends));
+    co_await Tcp::sendFdsThrottled(this, pair.client,
+                                   Buffer::makeCopy(std::string("first")),
+                                   std::move(first));
+    co_await Tcp::sendThrottled(this, pair.client,
+                                Buffer::makeCopy(std::string("second")));
+    co_await Tcp::sendFdsThrottled(this, pair.client,
+                                   Buffer::makeCopy(std::string("third")),
+                                   std::move(third));
+    Received received;
+    co_await readUntil(this, in, &received, 16);
+    EXPECT_EQ("firstsecondthird", received.data);
+    // each with the ReceiveData holding the first byte sent with it
+    std::vector<size_t> starts = {0};
+    for (auto size : received.sizes) {
+      starts.push_back(starts.back() + size);
+    }
+    auto holding = [&](size_t offset) {
+      return *(std::upper_bound(starts.begin(), starts.end(), offset) - 1);
+    };
+    for (auto const& [at, fd] : received.fds) {
+      got_->push_back(concatString(at, ":", readTag(fd)));
+    }
+    got_->push_back(concatString("first:", holding(0)));
+    got_->push_back(concatString("third:", holding(11)));
+  }
+
+private:
+  Tcp::SocketOptions const server_;
+  std::vector<std::string>* const got_;
+};
+
+// passes fds over a socket that cannot take them, and notes whether the
+// socket died of it
+class BadFdApp : public Process {
+public:
+  BadFdApp(ProcessArgs i, bool unix_socket, size_t count, bool* died)
+      : Process(std::move(i)), unix_(unix_socket), count_(count),
+        died_(died) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::Socket> accepted{this};
+  Slot<Tcp::ReceiveData> back{this};
+  Slot<Pid> closed{this};
+
+  ProcessTask run() {
+    std::optional<Pair> pair;
+    if (unix_) {
+      Tcp::UnixConnectOptions client(unixPath());
+      client.notifyOnClose = closed.address();
+      pair = co_await connectUnix(this, accepted, back, Tcp::SocketOptions(),
+                                  client);
+    } else {
+      Tcp::ConnectOptions client("127.0.0.1", 12403);
+      client.notifyOnClose = closed.address();
+      pair = co_await connectTcp(this, accepted, back, 12403, Tcp::SocketOptions(),
+                                 client);
+    }
+    std::vector<Tcp::Fd> write_ends;
+    std::vector<Tcp::Fd> fds;
+    for (size_t i = 0; i < count_; ++i) {
+      fds.push_back(makeTaggedFd('x', &write_ends));
+    }
+    co_await Tcp::sendFdsThrottled(this, pair->client,
+                                   Buffer::makeCopy(std::string("fds")),
+                                   std::move(fds));
+    auto r = co_await timedRecv(std::chrono::milliseconds(1000), closed);
+    *died_ = bool(std::get<0>(r));
+  }
+
+private:
+  bool const unix_;
+  size_t const count_;
+  bool* const died_;
+};
+
+bool diesPassing(bool unix_socket, size_t count) {
+  bool died = false;
+  {
+    Context c;
+    c.spawn<BadFdApp>(unix_socket, count, &died);
+    c.run();
+  }
+  lifetimeChecker.check();
+  return died;
+}
+} // namespace
+}
+
+TEST(TcpSocket, ReceiveBatchesGrowAndShrink) {
+  using namespace s;
+  BatchSizes sizes;
+  {
+    Context c;
+    c.spawn<BatchApp>(&sizes);
+    c.run();
+  }
+  lifetimeChecker.check();
+  ASSERT_FALSE(sizes.first.empty());
+  ASSERT_FALSE(sizes.second.empty());
+  // growing past one read while the owner is behind, up to the limit
+  auto const biggest =
+      *std::max_element(sizes.first.begin(), sizes.first.end());
+  EXPECT_GT(biggest, kReadSize);
+  EXPECT_LE(biggest, kMaxBatch);
+  EXPECT_EQ(std::vector<size_t>(8, 100), sizes.small);
+  // and starting from one read again once it has kept up
+  EXPECT_LE(sizes.second.front(), kReadSize);
+  EXPECT_GT(*std::max_element(sizes.second.begin(), sizes.second.end()),
+            kReadSize);
+}
+
+TEST(TcpSocket, SendsGatheredIntoOneWrite) {
+  using namespace s;
+  EXPECT_EQ(1u, countWrites(12401, 1024 * 1024, 100, 100));
+}
+
+TEST(TcpSocket, GatheringStopsAtMaxQueuedBytes) {
+  using namespace s;
+  // three make it full, so they go three at a time
+  EXPECT_EQ(4u, countWrites(12402, 1000, 10, 400));
+}
+
+TEST(TcpSocket, FdsArriveWithTheirData) {
+  using namespace s;
+  Tcp::SocketOptions batched;
+  batched.throttled = false;
+  batched.receiveBatchBytes = kMaxBatch;
+  for (auto const& server : {Tcp::SocketOptions(), batched}) {
+    std::vector<std::string> got;
+    {
+      Context c;
+      c.spawn<FdApp>(server, &got);
+      c.run();
+    }
+    lifetimeChecker.check();
+    ASSERT_EQ(5u, got.size()) << server.throttled;
+    EXPECT_EQ(concatString(got[3].substr(6), ":1"), got[0]);
+    EXPECT_EQ(concatString(got[4].substr(6), ":2"), got[1]);
+    EXPECT_EQ(concatString(got[4].substr(6), ":3"), got[2]);
+  }
+}
+
+TEST(TcpSocket, FdsRejected) {
+  using namespace s;
+  EXPECT_FALSE(diesPassing(true, 64));
+  EXPECT_TRUE(diesPassing(true, 65));
+  EXPECT_TRUE(diesPassing(false, 1));
+}
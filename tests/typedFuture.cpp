@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/asio/deadline_timer.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+
+namespace s {
+
+// sets its promise after yielding a few times, or breaks it if told to
+struct PromiseSetter : Process {
+  PromiseSetter(ProcessArgs i, Promise<int> promise, int value, int yields,
+                bool fail)
+      : Process(std::move(i)), promise(std::move(promise)), value(value),
+        yields(yields), fail(fail) {}
+  Promise<int> promise;
+  int value;
+  int yields;
+  bool fail;
+
+  ProcessTask run() {
+    for (int i = 0; i < yields; ++i) {
+      co_await WaitingYield{};
+    }
+    if (fail) {
+      promise.setException(std::runtime_error("failed"));
+    } else {
+      promise.setValue(value);
+    }
+  }
+};
+
+class TypedFutureApp : public Process {
+public:
+  using Process::Process;
+  LIFETIMECHECK;
+
+  Future<int> setLater(int value, int yields, bool fail = false) {
+    Promise<int> promise;
+    auto ret = promise.getFuture();
+    spawn<PromiseSetter>(std::move(promise), value, yields, fail);
+    return ret;
+  }
+
+  ProcessTask run() {
+    // ready before we wait, or only after
+    Promise<int> now;
+    now.setValue(1);
+    int got = co_await now.getFuture();
+    ASSERT_EQ(1, got);
+    got = co_await setLater(2, 3);
+    ASSERT_EQ(2, got);
+
+    bool threw = false;
+    try {
+      co_await setLater(0, 1, true);
+    } catch (std::runtime_error const& e) {
+      threw = true;
+      ASSERT_EQ(std::string("failed"), e.what());
+    }
+    ASSERT_TRUE(threw);
+
+    // a promise going away unset breaks it
+    threw = false;
+    auto broken = Promise<int>().getFuture();
+    ASSERT_TRUE(broken.isReady());
+    try {
+      co_await broken;
+    } catch (EslangException const&) {
+      threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    // set from an asio handler
+    Promise<int> fromTimer;
+    auto timerFuture = fromTimer.getFuture();
+    boost::asio::deadline_timer timer(c()->ioService());
+    timer.expires_from_now(boost::posix_time::milliseconds(5));
+    timer.async_wait([&fromTimer](boost::system::error_code const&) {
+      fromTimer.setValue(5);
+    });
+    got = co_await timerFuture;
+    ASSERT_EQ(5, got);
+
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 5; ++i) {
+      futures.push_back(setLater(i * 10, 5 - i));
+    }
+    auto all = co_await whenAll(std::move(futures));
+    ASSERT_EQ((std::vector<int>{0, 10, 20, 30, 40}), all);
+    all = co_await whenAll(std::vector<Future<int>>{});
+    ASSERT_TRUE(all.empty());
+
+    futures.clear();
+    futures.push_back(setLater(7, 1));
+    futures.push_back(setLater(8, 1, true));
+    threw = false;
+    try {
+      co_await whenAll(std::move(futures));
+    } catch (std::runtime_error const&) {
+      threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    futures.clear();
+    futures.push_back(setLater(1, 10));
+    futures.push_back(setLater(2, 2));
+    futures.push_back(setLater(3, 6));
+    auto first = co_await whenAny(std::move(futures));
+    ASSERT_EQ(1u, first.first);
+    ASSERT_EQ(2, first.second);
+  }
+};
+}
+
+TEST(TypedFuture, SetAndCombine) {
+  s::Context c;
+  c.spawn<s::TypedFutureApp>();
+  c.run();
+  lifetimeChecker.check();
+}
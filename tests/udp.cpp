@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_io/Udp.h>
+
+namespace s {
+namespace {
+
+// runs of same sized datagrams (which GSO sends as one, and GRO reads as
+// one) with a shorter one ending some, then odd sizes. Each starts with its
+// index so that they can be told apart
+std::vector<std::string> makeDatagrams() {
+  std::vector<std::string> ret;
+  auto add = [&](size_t size) {
+    auto d = concatString(ret.size(), ":");
+    d.resize(size, 'a' + ret.size() % 26);
+    ret.push_back(std::move(d));
+  };
+  for (size_t run = 0; run < 10; ++run) {
+    for (size_t i = 0; i < 20; ++i) {
+      add(1000);
+    }
+    if (run % 2) {
+      add(300);
+    }
+  }
+  for (size_t i = 0; i < 50; ++i) {
+    add(10 + i * 37);
+  }
+  return ret;
+}
+
+// sends datagrams from one socket to another over loopback
+class UdpLoopbackApp : public Process {
+public:
+  UdpLoopbackApp(ProcessArgs i, Udp::SocketOptions options,
+                 std::vector<std::string> sent, std::vector<std::string>* got)
+      : Process(std::move(i)), options_(std::move(options)),
+        sent_(std::move(sent)), got_(got) {}
+  LIFETIMECHECK;
+
+  Slot<Udp::ReceiveData> in{this};
+
+  ProcessTask run() {
+    auto receiving = options_;
+    receiving.address = "127.0.0.1";
+    receiving.receiveBufferBytes = 4 * 1024 * 1024;
+    auto receiver = Udp::bind(this, receiving);
+    Udp::initRecvSocket(this, receiver, in.address());
+    auto sender = Udp::bind(this, options_);
+
+    std::vector<Udp::Datagram> datagrams;
+    for (auto const& d : sent_) {
+      datagrams.emplace_back(receiver.local, Buffer::makeCopy(d));
+    }
+    co_await Udp::sendManyThrottled(this, sender, std::move(datagrams));
+    while (got_->size() < sent_.size()) {
+      auto r = co_await timedRecv(std::chrono::milliseconds(2000), in);
+      if (!std::get<0>(r)) {
+        break;
+      }
+      for (auto const& d : std::get<0>(r)->datagrams) {
+        got_->emplace_back(reinterpret_cast<char const*>(d.data.data()),
+                           d.data.size());
+      }
+    }
+    EXPECT_EQ(sent_.size(), sender.stats->datagramsWritten);
+    EXPECT_EQ(0u, sender.stats->writeErrors);
+    EXPECT_EQ(sent_.size(), receiver.stats->datagramsRead);
+  }
+
+private:
+  Udp::SocketOptions const options_;
+  std::vector<std::string> const sent_;
+  std::vector<std::string>* const got_;
+};
+
+void runLoopback(Udp::SocketOptions options) {
+  auto const sent = makeDatagrams();
+  std::vector<std::string> got;
+  {
+    Context c;
+    c.spawn<UdpLoopbackApp>(options, sent, &got);
+    c.run();
+  }
+  lifetimeChecker.check();
+  // loopback neither drops (with a big enough receive buffer) nor reorders
+  EXPECT_EQ(sent, got);
+}
+} // namespace
+}
+
+TEST(Udp, OneAtATime) {
+  s::Udp::SocketOptions options;
+  options.batch = 1;
+  s::runLoopback(options);
+}
+
+TEST(Udp, Batched) {
+  s::Udp::SocketOptions options;
+  options.batch = 32;
+  s::runLoopback(options);
+}
+
+TEST(Udp, Segmented) {
+  // where the kernel cannot do GSO or GRO this falls back to the above
+  s::Udp::SocketOptions options;
+  options.batch = 32;
+  options.gso = true;
+  options.gro = true;
+  s::runLoopback(options);
+}
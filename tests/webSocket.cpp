@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <eslang_www/WebSocket.h>
+
+namespace s {
+namespace {
+
+using Opcode = WebSocket::Opcode;
+
+uint32_t constexpr kKey = 0x12345678;
+
+std::string toString(Buffer const& b) {
+  return std::string(reinterpret_cast<char const*>(b.data()), b.size());
+}
+
+// a frame as a client sends it, with the smallest length encoding
+std::string clientFrame(Opcode opcode, std::string const& payload,
+                        bool fin = true, bool masked = true) {
+  std::string ret;
+  ret.push_back(char((fin ? 0x80 : 0) | uint8_t(opcode)));
+  uint8_t const mask_bit = masked ? 0x80 : 0;
+  size_t const len = payload.size();
+  if (len < 126) {
+    ret.push_back(char(mask_bit | len));
+  } else if (len <= 0xffff) {
+    ret.push_back(char(mask_bit | 126));
+    ret.push_back(char(len >> 8));
+    ret.push_back(char(len));
+  } else {
+    ret.push_back(char(mask_bit | 127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      ret.push_back(char(uint64_t(len) >> shift));
+    }
+  }
+  std::string body = payload;
+  if (masked) {
+    ret.append(reinterpret_cast<char const*>(&kKey), 4);
+    WebSocket::mask(reinterpret_cast<unsigned char*>(body.data()),
+                    body.size(), kKey);
+  }
+  return ret + body;
+}
+
+// a payload that masking cannot leave unchanged by accident
+std::string makePayload(size_t len) {
+  std::string ret;
+  for (size_t i = 0; i < len; ++i) {
+    ret.push_back(char('a' + i % 26));
+  }
+  return ret;
+}
+
+// pushes data split at each of splits, and describes every frame parsed as
+// "opcode fin payload"
+std::vector<std::string> parse(std::string const& data,
+                               std::vector<size_t> splits = {}) {
+  WebSocket::FrameParser parser(1 << 20);
+  std::vector<std::string> ret;
+  splits.push_back(data.size());
+  size_t at = 0;
+  for (auto split : splits) {
+    parser.push(Buffer::makeCopy(data.data() + at, split - at));
+    at = split;
+    while (auto frame = parser.next()) {
+      ret.push_back(concatString(int(frame->opcode), frame->fin ? " fin " : " ",
+                                 toString(frame->payload)));
+    }
+  }
+  return ret;
+}
+
+// what parsing a lone frame throws, as "code what"
+std::string rejection(std::string const& data, uint64_t max_payload = 1000) {
+  WebSocket::FrameParser parser(max_payload);
+  parser.push(Buffer::makeCopy(data));
+  try {
+    parser.next();
+  } catch (WebSocket::ProtocolViolation const& e) {
+    return concatString(e.code, " ", e.what());
+  }
+  return "accepted";
+}
+} // namespace
+}
+
+TEST(WebSocket, SplitFrames) {
+  using namespace s;
+  // lengths in 7, 16 and 64 bits, and a fragmented message
+  auto const small = makePayload(125);
+  auto const medium = makePayload(126);
+  auto const large = makePayload(70000);
+  auto const all = clientFrame(Opcode::Text, small) +
+                   clientFrame(Opcode::Binary, medium) +
+                   clientFrame(Opcode::Binary, large) +
+                   clientFrame(Opcode::Text, "ab", false) +
+                   clientFrame(Opcode::Ping, "") +
+                   clientFrame(Opcode::Continuation, "cd");
+  std::vector<std::string> const expected = {
+      "1 fin " + small, "2 fin " + medium, "2 fin " + large, "1 ab",
+      "9 fin ",         "0 fin cd"};
+  EXPECT_EQ(expected, parse(all));
+  // everywhere in the headers of the first two, and through the rest
+  size_t const headers = clientFrame(Opcode::Text, small).size() + 10;
+  for (size_t split = 1; split < all.size();
+       split += split < headers ? 1 : 997) {
+    EXPECT_EQ(expected, parse(all, {split})) << "split at " << split;
+  }
+
+  // a payload in one read is a slice of it, unmasked in place
+  WebSocket::FrameParser parser(1000);
+  auto const read = Buffer::makeCopy(clientFrame(Opcode::Text, small));
+  parser.push(read);
+  auto frame = parser.next();
+  ASSERT_TRUE(frame);
+  EXPECT_TRUE(frame->payload.sameStorage(read));
+  EXPECT_EQ(small, toString(frame->payload));
+  EXPECT_FALSE(parser.next());
+}
+
+TEST(WebSocket, Rejects) {
+  using namespace s;
+  EXPECT_EQ("1002 Unmasked frame",
+            rejection(clientFrame(Opcode::Text, "a", true, false)));
+  EXPECT_EQ("1002 Bad control frame",
+            rejection(clientFrame(Opcode::Ping, "a", false)));
+  EXPECT_EQ("1002 Bad control frame",
+            rejection(clientFrame(Opcode::Close, makePayload(126))));
+  EXPECT_EQ("accepted", rejection(clientFrame(Opcode::Ping, makePayload(125))));
+  EXPECT_EQ("1002 Bad opcode 3", rejection(clientFrame(Opcode(3), "a")));
+  auto reserved = clientFrame(Opcode::Text, "a");
+  reserved[0] |= 0x40;
+  EXPECT_EQ("1002 Reserved bits set", rejection(reserved));
+  // on the length alone, before the payload has arrived
+  EXPECT_EQ("1009 Frame of 1001 bytes",
+            rejection(clientFrame(Opcode::Binary, makePayload(1001))
+                          .substr(0, 10)));
+  EXPECT_EQ("accepted",
+            rejection(clientFrame(Opcode::Binary, makePayload(1000))));
+}
+
+TEST(WebSocket, Mask) {
+  using namespace s;
+  // from none to past two whole words, and from every alignment
+  auto const data = makePayload(40);
+  auto const* key = reinterpret_cast<unsigned char const*>(&kKey);
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t len = 0; offset + len <= data.size(); ++len) {
+      std::string masked = data;
+      WebSocket::mask(reinterpret_cast<unsigned char*>(masked.data()) + offset,
+                      len, kKey);
+      std::string expected = data;
+      for (size_t i = 0; i < len; ++i) {
+        expected[offset + i] ^= key[i % 4];
+      }
+      EXPECT_EQ(expected, masked) << offset << " " << len;
+    }
+  }
+}
+
+TEST(WebSocket, MakeFrame) {
+  using namespace s;
+  for (size_t len : {0, 125, 126, 0xffff, 0x10000}) {
+    auto const frame = WebSocket::makeFrame(Opcode::Binary, makePayload(len));
+    // the same as a client's, without the mask
+    EXPECT_EQ(clientFrame(Opcode::Binary, makePayload(len), true, false),
+              toString(frame))
+        << len;
+  }
+}
+
+TEST(WebSocket, MakeClose) {
+  using namespace s;
+  auto reasonOf = [](Buffer const& frame) {
+    EXPECT_EQ(0x88, frame.data()[0]);
+    EXPECT_EQ(frame.size() - 2, frame.data()[1]);
+    EXPECT_EQ(1000, frame.data()[2] << 8 | frame.data()[3]);
+    return toString(frame).substr(4);
+  };
+  EXPECT_EQ("bye", reasonOf(WebSocket::makeClose(1000, "bye")));
+  auto const fits = std::string(123, 'a');
+  EXPECT_EQ(fits, reasonOf(WebSocket::makeClose(1000, fits)));
+  EXPECT_EQ(fits, reasonOf(WebSocket::makeClose(1000, fits + "b")));
+  // a three byte code point across the limit is left out whole
+  std::string euros = "a";
+  for (size_t i = 0; i < 41; ++i) {
+    euros += "\xe2\x82\xac";
+  }
+  EXPECT_EQ(euros.substr(0, 121), reasonOf(WebSocket::makeClose(1000, euros)));
+  // and one ending on it is kept
+  EXPECT_EQ(euros.substr(1),
+            reasonOf(WebSocket::makeClose(1000, euros.substr(1))));
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Client.h>
+
+namespace s {
+
+namespace http = boost::beast::http;
+
+// echoes the request body (or target), /slow takes a second, and /chunked
+// is 100 chunks of 1000 letters. HEADs just get the Content-Length
+class ClientTestHandler : public Www::Server::IHandler {
+public:
+  MethodTask<Www::Response> getResponse(Process* p,
+                                        Www::RequestView const& req) override {
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    if (req.target == "/slow") {
+      co_await p->sleep(std::chrono::milliseconds(1000));
+    }
+    if (req.target == "/chunked") {
+      resp.message.chunked(true);
+      co_return resp;
+    }
+    auto const& echo = req.body.size() ? req.body : req.target;
+    if (req.method == http::verb::head) {
+      resp.message.content_length(echo.size());
+      co_return resp;
+    }
+    resp.message.body() = std::string(echo.data(), echo.size());
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+
+  GenTask<Buffer> getChunked(Process*, Www::RequestView const&) override {
+    for (int i = 0; i < 100; ++i) {
+      co_yield Buffer::makeCopy(std::string(1000, 'a' + i % 26));
+    }
+  }
+};
+
+struct ClientTestOptions {
+  uint32_t port;
+  Www::Client::Options pool;
+  Www::Server::ServerOptions server;
+};
+
+// runs body with a server on options.port and a pool for it
+class ClientTestDriver : public Process {
+public:
+  using Body = std::function<MethodTask<>(Process*, Pid pool)>;
+  ClientTestDriver(ProcessArgs i, ClientTestOptions options, Body body)
+      : Process(std::move(i)), options_(std::move(options)),
+        body_(std::move(body)) {}
+
+  ProcessTask run() {
+    spawnLink<Www::Server>(std::make_shared<ClientTestHandler>(),
+                           Tcp::ListenerOptions(options_.port),
+                           options_.server);
+    co_await sleep(std::chrono::milliseconds(10));
+    auto pool = Www::Client::spawnPool(this, options_.pool);
+    co_await body_(this, pool);
+  }
+
+private:
+  ClientTestOptions const options_;
+  Body const body_;
+};
+
+// makes requests from its own process, so that failing them only kills it
+class ClientTestCaller : public Process {
+public:
+  using Body = std::function<MethodTask<>(Www::Client&)>;
+  ClientTestCaller(ProcessArgs i, Pid pool, std::chrono::milliseconds timeout,
+                   Body body)
+      : Process(std::move(i)), client_(this, pool, timeout),
+        body_(std::move(body)) {}
+
+  ProcessTask run() { co_await body_(client_); }
+
+private:
+  Www::Client client_;
+  Body const body_;
+};
+
+std::string toString(Buffer const& b) {
+  return std::string(reinterpret_cast<char const*>(b.data()), b.size());
+}
+
+void runClientTest(ClientTestOptions options, ClientTestDriver::Body body) {
+  Context c;
+  c.spawn<ClientTestDriver>(std::move(options), std::move(body));
+  c.run();
+}
+}
+
+TEST(WwwClient, Requests) {
+  using namespace s;
+  std::vector<std::string> got;
+  runClientTest(
+      ClientTestOptions{12390, {}, {}},
+      [&](Process* p, Pid pool) -> MethodTask<> {
+        Www::Client client(p, pool);
+        auto resp = co_await client.get("127.0.0.1", 12390, "/hello");
+        got.push_back(resp.message.body());
+
+        Www::Request post;
+        post.message.method(http::verb::post);
+        post.message.target("/post");
+        post.message.body() = "some body";
+        resp = co_await client.request("127.0.0.1", 12390, std::move(post));
+        got.push_back(resp.message.body());
+
+        Www::Request head;
+        head.message.method(http::verb::head);
+        head.message.target("/head");
+        resp = co_await client.request("127.0.0.1", 12390, std::move(head));
+        got.push_back(
+            concatString(resp.message[http::field::content_length], ",",
+                         resp.message.body().size()));
+
+        // the server hangs up after this one, so the next needs a new
+        // connection
+        Www::Request close;
+        close.message.method(http::verb::get);
+        close.message.target("/close");
+        close.message.keep_alive(false);
+        resp = co_await client.request("127.0.0.1", 12390, std::move(close));
+        got.push_back(resp.message.body());
+        resp = co_await client.get("127.0.0.1", 12390, "/again");
+        got.push_back(resp.message.body());
+
+        Www::Request chunked;
+        chunked.message.method(http::verb::get);
+        chunked.message.target("/chunked");
+        auto streamed = std::move(
+            co_await client.stream("127.0.0.1", 12390, std::move(chunked)));
+        std::string body;
+        while (co_await streamed.body.next()) {
+          body += toString(streamed.body.take());
+        }
+        got.push_back(
+            concatString(streamed.head.message.chunked(), ",", body.size(),
+                         ",", body.substr(0, 2), body.substr(body.size() - 2)));
+      });
+  std::vector<std::string> const expected = {
+      "/hello", "some body", "5,0", "/close", "/again", "1,100000,aavv"};
+  EXPECT_EQ(expected, got);
+}
+
+TEST(WwwClient, Pipelined) {
+  using namespace s;
+  size_t constexpr kCallers = 20;
+  size_t constexpr kRequests = 10;
+  size_t correct = 0;
+  ClientTestOptions options{12391, {}, {}};
+  // everything has to share one connection
+  options.pool.maxConnections = 1;
+  options.server.maxInFlight = 8;
+  runClientTest(options, [&](Process* p, Pid pool) -> MethodTask<> {
+    Slot<Pid> done{p};
+    for (size_t i = 0; i < kCallers; ++i) {
+      p->spawnNotify<ClientTestCaller>(
+          done.address(), pool, std::chrono::milliseconds(5000),
+          [&, i](Www::Client& client) -> MethodTask<> {
+            for (size_t j = 0; j < kRequests; ++j) {
+              auto const target = concatString("/", i, "/", j);
+              auto resp = co_await client.get("127.0.0.1", 12391, target);
+              correct += resp.message.body() == target;
+            }
+          });
+    }
+    for (size_t i = 0; i < kCallers; ++i) {
+      co_await p->recv(done);
+    }
+  });
+  EXPECT_EQ(kCallers * kRequests, correct);
+}
+
+TEST(WwwClient, Failures) {
+  using namespace s;
+  bool timed_out_returned = false;
+  bool refused_returned = false;
+  std::string after;
+  runClientTest(
+      ClientTestOptions{12392, {}, {}},
+      [&](Process* p, Pid pool) -> MethodTask<> {
+        Slot<Pid> done{p};
+        auto const start = p->now();
+        p->spawnNotify<ClientTestCaller>(
+            done.address(), pool, std::chrono::milliseconds(100),
+            [&](Www::Client& client) -> MethodTask<> {
+              co_await client.get("127.0.0.1", 12392, "/slow");
+              timed_out_returned = true;
+            });
+        co_await p->recv(done);
+        EXPECT_LT(p->now() - start, std::chrono::milliseconds(900));
+
+        // nothing listens here
+        p->spawnNotify<ClientTestCaller>(
+            done.address(), pool, std::chrono::milliseconds(5000),
+            [&](Www::Client& client) -> MethodTask<> {
+              co_await client.get("127.0.0.1", 12393, "/");
+              refused_returned = true;
+            });
+        co_await p->recv(done);
+
+        // the timed out request's connection was dropped, so this does not
+        // wait behind it
+        Www::Client client(p, pool, std::chrono::milliseconds(500));
+        auto resp = co_await client.get("127.0.0.1", 12392, "/after");
+        after = resp.message.body();
+      });
+  EXPECT_FALSE(timed_out_returned);
+  EXPECT_FALSE(refused_returned);
+  EXPECT_EQ("/after", after);
+}
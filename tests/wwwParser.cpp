@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang_www/WwwParser.h>
+#include <sstream>
+
+namespace s {
+namespace {
+
+namespace http = boost::beast::http;
+
+std::string const kGet = "GET /a/b?c=d HTTP/1.1\r\n"
+                         "Host: example.com\r\n"
+                         "X-Long: " +
+                         std::string(300, 'x') + "\r\n"
+                         "\r\n";
+
+std::string const kPost = "POST /upload HTTP/1.1\r\n"
+                          "Host: example.com\r\n"
+                          "Content-Length: 11\r\n"
+                          "\r\n"
+                          "hello world";
+
+std::string const kChunked = "POST /chunks HTTP/1.0\r\n"
+                             "Transfer-Encoding: chunked\r\n"
+                             "Connection: keep-alive\r\n"
+                             "\r\n"
+                             "5\r\nhello\r\n"
+                             "1;ext=1\r\n \r\n"
+                             "a\r\n0123456789\r\n"
+                             "0\r\n"
+                             "\r\n";
+
+std::string toString(Www::RequestView::string_view s) {
+  return std::string(s.data(), s.size());
+}
+
+// the bits of a request the tests look at, on one line
+std::string describe(Www::RequestView const& req) {
+  std::string ret = concatString(toString(req.methodString), " ",
+                                 toString(req.target), " ", req.version,
+                                 req.keepAlive ? " keep" : " close");
+  for (auto const& field : req.fields) {
+    ret += concatString(" ", toString(field.nameString), "=",
+                        field.value.size() > 20 ? "..."
+                                                : toString(field.value));
+  }
+  return ret + concatString(" [", toString(req.body), "]");
+}
+
+// pushes data split at each of splits, and describes every request parsed
+std::vector<std::string> parse(std::string const& data,
+                               std::vector<size_t> splits = {}) {
+  WwwParser parser;
+  std::vector<std::string> ret;
+  // kept until the end, to check that they stay valid while more is parsed
+  std::vector<Www::RequestView> requests;
+  splits.push_back(data.size());
+  size_t at = 0;
+  for (auto split : splits) {
+    parser.push(Buffer::makeCopy(data.data() + at, split - at));
+    at = split;
+    while (auto req = parser.next()) {
+      requests.push_back(std::move(*req));
+    }
+  }
+  EXPECT_EQ(0u, parser.buffered());
+  for (auto const& req : requests) {
+    ret.push_back(describe(req));
+  }
+  return ret;
+}
+
+std::string describeGet() {
+  return "GET /a/b?c=d 11 keep Host=example.com X-Long=... []";
+}
+
+std::string describePost() {
+  return "POST /upload 11 keep Host=example.com Content-Length=11 "
+         "[hello world]";
+}
+
+std::string describeChunked() {
+  return "POST /chunks 10 keep Transfer-Encoding=chunked "
+         "Connection=keep-alive [hello 0123456789]";
+}
+
+std::string concatBuffers(BufferCollection const& c) {
+  std::string ret;
+  for (auto const& b : c.buffers) {
+    ret.append(reinterpret_cast<char const*>(b.data()), b.size());
+  }
+  return ret;
+}
+
+// what the server wrote before responses were serialized once for every
+// connection: the whole message, after keep_alive
+std::string beastSerialize(Www::Response resp, bool keep_alive) {
+  resp.message.keep_alive(keep_alive);
+  std::ostringstream ss;
+  ss << resp.message;
+  return ss.str();
+}
+} // namespace
+}
+
+TEST(WwwParser, SplitAnywhere) {
+  using namespace s;
+  for (auto const& request : {kGet, kPost, kChunked}) {
+    auto const whole = parse(request);
+    ASSERT_EQ(1u, whole.size());
+    for (size_t split = 1; split < request.size(); ++split) {
+      EXPECT_EQ(whole, parse(request, {split})) << "split at " << split;
+    }
+  }
+  EXPECT_EQ(describeGet(), parse(kGet)[0]);
+  EXPECT_EQ(describePost(), parse(kPost)[0]);
+  EXPECT_EQ(describeChunked(), parse(kChunked)[0]);
+  // a byte at a time
+  std::vector<size_t> every;
+  for (size_t i = 1; i < kChunked.size(); ++i) {
+    every.push_back(i);
+  }
+  EXPECT_EQ((std::vector<std::string>{describeChunked()}),
+            parse(kChunked, every));
+}
+
+TEST(WwwParser, Pipelined) {
+  using namespace s;
+  auto const all = kGet + kPost + kChunked + kGet;
+  std::vector<std::string> const expected = {describeGet(), describePost(),
+                                             describeChunked(), describeGet()};
+  EXPECT_EQ(expected, parse(all));
+  // splits inside the head of one and the body of another
+  EXPECT_EQ(expected, parse(all, {kGet.size() + 10, kGet.size() +
+                                                        kPost.size() - 3}));
+
+  // in one buffer, the views slice it rather than copying
+  WwwParser parser;
+  parser.push(Buffer::makeCopy(kGet + kPost));
+  auto get = parser.next();
+  auto post = parser.next();
+  ASSERT_TRUE(get && post);
+  EXPECT_FALSE(parser.next());
+  EXPECT_TRUE(get->owned.empty());
+  EXPECT_TRUE(post->owned.empty());
+  EXPECT_EQ(describeGet(), describe(*get));
+  EXPECT_EQ(describePost(), describe(*post));
+}
+
+TEST(WwwParser, StreamedBody) {
+  using namespace s;
+  WwwParser parser;
+  parser.setStreamBody([](Www::RequestView const& req) {
+    return req.target.starts_with("/chunks");
+  });
+  auto const all = kChunked + kPost;
+  parser.push(Buffer::makeCopy(all.substr(0, 90)));
+  auto req = parser.next();
+  ASSERT_TRUE(req);
+  EXPECT_TRUE(parser.streamingBody());
+  EXPECT_TRUE(req->body.empty());
+  EXPECT_THROW(parser.next(), EslangException);
+  std::string body;
+  auto take = [&] {
+    while (auto b = parser.nextBody()) {
+      body.append(reinterpret_cast<char const*>(b->data()), b->size());
+    }
+  };
+  take();
+  EXPECT_FALSE(parser.bodyDone());
+  parser.push(Buffer::makeCopy(all.substr(90)));
+  take();
+  EXPECT_TRUE(parser.bodyDone());
+  EXPECT_EQ("hello 0123456789", body);
+  req = parser.next();
+  ASSERT_TRUE(req);
+  EXPECT_FALSE(parser.streamingBody());
+  EXPECT_EQ(describePost(), describe(*req));
+}
+
+TEST(WwwParser, BodyLimit) {
+  using namespace s;
+  WwwParser parser;
+  parser.setBodyLimit(10);
+  parser.push(Buffer::makeCopy(kPost));
+  EXPECT_THROW(parser.next(), WwwParser::BodyTooLarge);
+  // and stays that way
+  EXPECT_THROW(parser.next(), WwwParser::BodyTooLarge);
+}
+
+TEST(WwwParser, SerializeMatchesBeast) {
+  using namespace s;
+  for (unsigned version : {10u, 11u}) {
+    for (bool keep_alive : {true, false}) {
+      for (std::string connection : {"", "close", "keep-alive"}) {
+        Www::Response resp;
+        resp.message.version(version);
+        resp.message.result(http::status::ok);
+        resp.message.set(http::field::server, "Eslang");
+        if (connection.size()) {
+          resp.message.set(http::field::connection, connection);
+        }
+        resp.message.set(http::field::content_type, "text/plain");
+        resp.message.body() = "some body";
+        resp.message.prepare_payload();
+        auto const expected = beastSerialize(resp, keep_alive);
+        auto const serialized = WwwParser::serialize(resp);
+        EXPECT_EQ(expected, concatBuffers(serialized.toBuffers(keep_alive)))
+            << version << " " << keep_alive << " " << connection;
+      }
+    }
+  }
+
+  // other tokens stay, as a header of their own
+  Www::Response resp;
+  resp.message.result(http::status::ok);
+  resp.message.set(http::field::connection, "close, x-other");
+  resp.message.prepare_payload();
+  EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: x-other\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            concatBuffers(WwwParser::serialize(resp).toBuffers(false)));
+}
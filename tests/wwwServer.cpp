@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+
+#include "TestCommon.h"
+#include <boost/beast/http.hpp>
+#include <eslang/Context.h>
+#include <eslang/Logging.h>
+#include <eslang_www/Www.h>
+
+namespace s {
+namespace {
+
+namespace http = boost::beast::http;
+
+// /sleep/N answers after N ms, /throw throws (once it has suspended), and
+// everything else answers straight away. Bodies are the target. /upload*
+// streams the request body, and answers with how much there was
+class ServerTestHandler : public Www::Server::IHandler {
+public:
+  bool streamBody(Www::RequestView const& head) override {
+    return head.target.starts_with("/upload");
+  }
+
+  MethodTask<Www::Response>
+  getStreamingResponse(Process*, Www::RequestView const& head,
+                       GenTask<Buffer>& body) override {
+    size_t bytes = 0;
+    size_t pieces = 0;
+    while (co_await body.next()) {
+      bytes += body.take().size();
+      ++pieces;
+    }
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.body() = concatString(
+        std::string(head.target.data(), head.target.size()), " ", bytes,
+        pieces > 1 ? " in pieces" : "");
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+
+  MethodTask<Www::Response> getResponse(Process* p,
+                                        Www::RequestView const& req) override {
+    std::string const target(req.target.data(), req.target.size());
+    if (target.rfind("/sleep/", 0) == 0) {
+      co_await p->sleep(std::chrono::milliseconds(std::stoi(target.substr(7))));
+    }
+    if (target == "/throw") {
+      co_await WaitingYield{};
+      ESLANGEXCEPT("Handler throws");
+    }
+    Www::Response resp;
+    resp.message.result(http::status::ok);
+    resp.message.body() = target;
+    resp.message.prepare_payload();
+    co_return resp;
+  }
+};
+
+// written a piece at a time, expecting responses once all of it is
+struct Batch {
+  std::vector<std::string> writes;
+  size_t responses;
+};
+
+Batch gets(std::vector<std::string> const& targets) {
+  std::string data;
+  for (auto const& t : targets) {
+    data += concatString("GET ", t, " HTTP/1.1\r\nHost: test\r\n\r\n");
+  }
+  return Batch{{data}, targets.size()};
+}
+
+std::string post(std::string const& target, size_t size) {
+  return concatString("POST ", target, " HTTP/1.1\r\nContent-Length: ", size,
+                      "\r\n\r\n", std::string(size, 'b'));
+}
+
+// takes the complete responses off the front of data, as "status body"
+std::vector<std::string> takeResponses(std::string& data) {
+  std::vector<std::string> ret;
+  while (data.size()) {
+    http::response_parser<http::string_body> parser;
+    parser.eager(true);
+    boost::system::error_code ec;
+    size_t const used =
+        parser.put(boost::asio::buffer(data.data(), data.size()), ec);
+    if (ec == http::error::need_more || !parser.is_done()) {
+      break;
+    }
+    EXPECT_FALSE(ec) << ec.message();
+    auto const& m = parser.get();
+    ret.push_back(concatString(m.result_int(), " ", m.body()));
+    data.erase(0, used);
+  }
+  return ret;
+}
+
+// pipelines each batch of requests down one connection, and reads all of
+// their responses before sending the next
+class PipelineClient : public Process {
+public:
+  PipelineClient(ProcessArgs i, uint32_t port, std::vector<Batch> batches,
+                 std::vector<std::string>* got)
+      : Process(std::move(i)), port_(port), batches_(std::move(batches)),
+        got_(got) {}
+  LIFETIMECHECK;
+
+  Slot<Tcp::ReceiveData> recv{this};
+
+  ProcessTask run() {
+    auto socket =
+        co_await Tcp::connect(this, Tcp::ConnectOptions("127.0.0.1", port_));
+    Tcp::initRecvSocket(this, socket, recv.address());
+    std::string data;
+    for (auto const& batch : batches_) {
+      for (auto const& write : batch.writes) {
+        if (&write != &batch.writes.front()) {
+          // so that the server reads it separately
+          co_await sleep(std::chrono::milliseconds(5));
+        }
+        co_await Tcp::sendThrottled(this, socket, Buffer::makeCopy(write));
+      }
+      size_t const want = got_->size() + batch.responses;
+      while (got_->size() < want) {
+        auto r = co_await timedRecv(std::chrono::milliseconds(2000), recv);
+        if (!std::get<0>(r)) {
+          co_return;
+        }
+        auto const& d = std::get<0>(r)->data;
+        data.append(reinterpret_cast<char const*>(d.data()), d.size());
+        for (auto& resp : takeResponses(data)) {
+          got_->push_back(std::move(resp));
+        }
+      }
+    }
+  }
+
+private:
+  uint32_t const port_;
+  std::vector<Batch> const batches_;
+  std::vector<std::string>* const got_;
+};
+
+class ServerTestDriver : public Process {
+public:
+  ServerTestDriver(ProcessArgs i, uint32_t port,
+                   Www::Server::ServerOptions options,
+                   std::vector<Batch> batches, std::vector<std::string>* got)
+      : Process(std::move(i)), port_(port), options_(std::move(options)),
+        batches_(std::move(batches)), got_(got) {}
+
+  ProcessTask run() {
+    spawnLink<Www::Server>(std::make_shared<ServerTestHandler>(),
+                           Tcp::ListenerOptions(port_), options_);
+    co_await sleep(std::chrono::milliseconds(10));
+    Slot<Pid> done{this};
+    spawnNotify<PipelineClient>(done.address(), port_, batches_, got_);
+    co_await recv(done);
+  }
+
+private:
+  uint32_t const port_;
+  Www::Server::ServerOptions const options_;
+  std::vector<Batch> const batches_;
+  std::vector<std::string>* const got_;
+};
+
+std::vector<std::string>
+runPipelined(uint32_t port, Www::Server::ServerOptions options,
+             std::vector<Batch> batches) {
+  std::vector<std::string> got;
+  {
+    Context c;
+    c.spawn<ServerTestDriver>(port, std::move(options), std::move(batches),
+                              &got);
+    c.run();
+  }
+  lifetimeChecker.check();
+  return got;
+}
+
+std::string const kFailed = "500 500 Internal Server Error";
+std::string const kTooLarge = "413 413 Payload Too Large";
+} // namespace
+}
+
+TEST(WwwServer, OutOfOrderCompletion) {
+  using namespace s;
+  Www::Server::ServerOptions options;
+  options.maxInFlight = 8;
+  // the later ones finish first, and one fails in the middle
+  auto got = runPipelined(
+      12396, options,
+      {gets({"/sleep/60", "/sleep/30", "/throw", "/sleep/0", "/now"}),
+       gets({"/after"})});
+  std::vector<std::string> const expected = {
+      "200 /sleep/60", "200 /sleep/30", kFailed, "200 /sleep/0",
+      "200 /now",      "200 /after"};
+  EXPECT_EQ(expected, got);
+}
+
+TEST(WwwServer, PoolWorkerDies) {
+  using namespace s;
+  Www::Server::ServerOptions options;
+  options.maxInFlight = 8;
+  options.handlerPool.emplace();
+  options.handlerPool->workers = 2;
+  options.handlerPool->routing = Www::Server::PoolRouting::RoundRobin;
+  // worker 1 dies on /throw, failing /queued which is waiting behind it, and
+  // is replaced for the next batch
+  auto got = runPipelined(
+      12397, options,
+      {gets({"/sleep/30", "/throw", "/sleep/0", "/queued", "/last"}),
+       gets({"/again", "/more"})});
+  std::vector<std::string> const expected = {
+      "200 /sleep/30", kFailed,   "200 /sleep/0", kFailed,
+      "200 /last",     "200 /again", "200 /more"};
+  EXPECT_EQ(expected, got);
+}
+
+TEST(WwwServer, StreamedBody) {
+  using namespace s;
+  auto const upload = post("/upload", 3000);
+  auto const chunked = std::string("POST /upload/chunked HTTP/1.1\r\n"
+                                   "Transfer-Encoding: chunked\r\n\r\n"
+                                   "3e8\r\n") +
+                       std::string(1000, 'c') + "\r\n";
+  // the body of each arrives over several reads, with a request after it
+  auto const after = post("/buffered", 10) + gets({"/a"}).writes[0];
+  std::vector<Batch> const batches = {
+      Batch{{upload.substr(0, 1000), upload.substr(1000, 1000),
+             upload.substr(2000) + after},
+            3},
+      Batch{{chunked, chunked.substr(chunked.find("3e8")),
+             "0\r\n\r\n" + gets({"/b"}).writes[0]},
+            2}};
+  std::vector<std::string> const expected = {
+      "200 /upload 3000 in pieces", "200 /buffered", "200 /a",
+      "200 /upload/chunked 2000 in pieces", "200 /b"};
+  for (size_t in_flight : {1, 8}) {
+    Www::Server::ServerOptions options;
+    options.maxInFlight = in_flight;
+    EXPECT_EQ(expected, runPipelined(12398, options, batches)) << in_flight;
+  }
+}
+
+TEST(WwwServer, BodyTooLarge) {
+  using namespace s;
+  for (size_t in_flight : {1, 8}) {
+    Www::Server::ServerOptions options;
+    options.maxInFlight = in_flight;
+    options.maxBodySize = 1000;
+    // what comes after is ignored
+    auto const after = gets({"/ignored"}).writes[0];
+    auto got = runPipelined(
+        12399, options,
+        {Batch{{gets({"/sleep/20"}).writes[0] + post("/post", 1000) +
+                post("/big", 1001) + after},
+               3}});
+    EXPECT_EQ((std::vector<std::string>{"200 /sleep/20", "200 /post",
+                                        kTooLarge}),
+              got)
+        << in_flight;
+    // streamed, once some of it has been handed to the handler
+    auto const big = post("/upload", 5000);
+    got = runPipelined(
+        12399, options,
+        {Batch{{big.substr(0, 500), big.substr(500) + after}, 1}});
+    EXPECT_EQ((std::vector<std::string>{kTooLarge}), got) << in_flight;
+  }
+}